@@ -6,12 +6,14 @@
  * files for more details.
  */
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <uuid/uuid.h>
 
 #include "cgpt.h"
+#include "cgpt_nor.h"
 #include "vboot_host.h"
 
 const char* progname;
@@ -37,8 +39,51 @@ struct {
   {"prioritize", cmd_prioritize,
    "Reorder the priority of all kernel partitions"},
   {"legacy", cmd_legacy, "Switch between GPT and Legacy GPT"},
+  {"batch", cmd_batch, "Run many commands with one load and save of the GPT"},
 };
 
+// Returns the index of the command with the given name or unique prefix, or
+// -1 if there isn't one.
+static int FindCommand(const char *command) {
+  int i;
+  int match_count = 0;
+  int match_index = 0;
+
+  for (i = 0; command && i < sizeof(cmds)/sizeof(cmds[0]); ++i) {
+    // exact match?
+    if (0 == strcmp(cmds[i].name, command)) {
+      match_index = i;
+      match_count = 1;
+      break;
+    }
+    // unique match?
+    else if (0 == strncmp(cmds[i].name, command, strlen(command))) {
+      match_index = i;
+      match_count++;
+    }
+  }
+
+  return match_count == 1 ? match_index : -1;
+}
+
+int RunCommand(int argc, char *argv[]) {
+  int i = FindCommand(argv[0]);
+
+  if (i < 0) {
+    Error("unknown command: %s\n", argv[0]);
+    return CGPT_FAILED;
+  }
+
+  // Start getopt over, at argv[1]
+#ifdef HAVE_MACOS
+  optreset = 1;
+  optind = 1;
+#else
+  optind = 0;
+#endif
+  return cmds[i].fp(argc, argv);
+}
+
 void Usage(void) {
   int i;
 
@@ -52,10 +97,53 @@ void Usage(void) {
   printf("\nFor more detailed usage, use %s COMMAND -h\n\n", progname);
 }
 
+// Runs the command in 'argv' on the GPT of 'mtd_device', which is kept in the
+// RW_GPT area of NOR flash.  The area is read into memory, the command is run
+// on it as if given "-D <size of mtd_device>", and what changed is written
+// back if the command succeeds.
+static int RunOnNorFlash(int argc, char *argv[], const char *mtd_device) {
+  struct nor_flash flash;
+  struct nor_area area;
+  char drive_size[32];
+  uint64_t size;
+  char **nor_argv;
+  int retval;
+
+  if (GetMtdSize(mtd_device, &size) != 0) {
+    Error("Cannot get the size of %s.\n", mtd_device);
+    return CGPT_FAILED;
+  }
+
+  NorFlashOpenHost(&flash);
+  if (NorAreaRead(&flash, "RW_GPT", &area) != 0) {
+    NorFlashClose(&flash);
+    return CGPT_FAILED;
+  }
+
+  // argv[1] onwards, then "-D <size>"
+  nor_argv = calloc(argc + 2, sizeof(char *));
+  require(nor_argv);
+  memcpy(nor_argv, argv + 1, (argc - 1) * sizeof(char *));
+  snprintf(drive_size, sizeof(drive_size), "%" PRIu64, size);
+  nor_argv[argc - 1] = "-D";
+  nor_argv[argc] = drive_size;
+
+  DriveUseMemory(mtd_device, area.data, area.size);
+  retval = RunCommand(argc + 1, nor_argv);
+  DriveUseMemory(NULL, NULL, 0);
+  free(nor_argv);
+
+  if (retval == CGPT_OK && NorAreaWrite(&flash, &area) != 0)
+    retval = CGPT_FAILED;
+
+  NorAreaFree(&area);
+  NorFlashClose(&flash);
+  return retval;
+}
+
 int main(int argc, char *argv[]) {
+  const char *mtd_device;
   int i;
-  int match_count = 0;
-  int match_index = 0;
   char* command;
 
   progname = strrchr(argv[0], '/');
@@ -69,26 +157,17 @@ int main(int argc, char *argv[]) {
     return CGPT_FAILED;
   }
 
+  mtd_device = FindMtdDevice(argc, (const char *const *)argv);
+  if (mtd_device)
+    return RunOnNorFlash(argc, argv, mtd_device);
+
   // increment optind now, so that getopt skips argv[0] in command function
   command = argv[optind++];
 
   // Find the command to invoke.
-  for (i = 0; command && i < sizeof(cmds)/sizeof(cmds[0]); ++i) {
-    // exact match?
-    if (0 == strcmp(cmds[i].name, command)) {
-      match_index = i;
-      match_count = 1;
-      break;
-    }
-    // unique match?
-    else if (0 == strncmp(cmds[i].name, command, strlen(command))) {
-      match_index = i;
-      match_count++;
-    }
-  }
-
-  if (match_count == 1)
-    return cmds[match_index].fp(argc, argv);
+  i = FindCommand(command);
+  if (i >= 0)
+    return cmds[i].fp(argc, argv);
 
   // Couldn't find a single matching command.
   Usage();
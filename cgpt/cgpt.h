@@ -47,6 +47,9 @@ struct drive {
   GptData gpt;
   struct pmbr pmbr;
   int fd;       /* file descriptor */
+  uint8_t *mem;       /* buffer of a memory drive, or NULL */
+  uint64_t mem_size;
+  int mem_writable;   /* memory drive was opened for writing */
 };
 
 // Opens a block device or file, loads raw GPT data from it.
@@ -63,6 +66,21 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
 int DriveClose(struct drive *drive, int update_as_needed);
 int CheckValid(const struct drive *drive);
 
+// Makes DriveOpen() of 'drive_path' use the 'size' bytes at 'buf' as the
+// drive, so changes are left in 'buf'.  A NULL 'drive_path' stops this.
+void DriveUseMemory(const char *drive_path, uint8_t *buf, uint64_t size);
+
+// Opens a batch on 'drive_path'.  Until DriveBatchEnd(), DriveOpen() only
+// accepts 'drive_path', and it and DriveClose() read and write the GPT in
+// memory instead of on the drive.  If 'drive_size' is non-zero, it is used
+// when DriveOpen() is given a 'drive_size' of 0.
+//
+// Returns CGPT_FAILED if the drive can't be opened or a batch is already open.
+int DriveBatchBegin(const char *drive_path, uint64_t drive_size);
+// Closes the batch, first writing everything DriveClose() saved to the drive
+// if 'update_as_needed' is non-zero.  Otherwise the drive isn't changed.
+int DriveBatchEnd(int update_as_needed);
+
 /* Loads sectors from 'drive'.
  * *buf is pointed to an allocated memory when returned, and should be
  * freed.
@@ -203,6 +221,11 @@ int cmd_boot(int argc, char *argv[]);
 int cmd_find(int argc, char *argv[]);
 int cmd_prioritize(int argc, char *argv[]);
 int cmd_legacy(int argc, char *argv[]);
+int cmd_batch(int argc, char *argv[]);
+
+// Runs the command named by argv[0] (or a unique prefix of it) with the
+// options and DRIVE in the rest of argv.
+int RunCommand(int argc, char *argv[]);
 
 #define ARRAY_COUNT(array) (sizeof(array)/sizeof((array)[0]))
 const char *GptError(int errnum);
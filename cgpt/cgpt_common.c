@@ -76,6 +76,129 @@ int CheckValid(const struct drive *drive) {
   return CGPT_OK;
 }
 
+/*
+ * Memory drive.  DriveOpen() of its path uses a buffer the caller already
+ * holds, such as a GPT read from NOR flash, instead of opening the path.
+ * Memory drives have no file descriptor; they're read and written in place.
+ */
+static struct {
+  const char *path;
+  uint8_t *buf;
+  uint64_t size;
+} memory_drive;
+
+static int IsMemoryDrive(const char *drive_path) {
+  return memory_drive.path && !strcmp(drive_path, memory_drive.path);
+}
+
+void DriveUseMemory(const char *drive_path, uint8_t *buf, uint64_t size) {
+  memory_drive.path = drive_path;
+  memory_drive.buf = buf;
+  memory_drive.size = size;
+}
+
+/*
+ * Batch mode.  While a batch is open, the sectors DriveOpen() and DriveClose()
+ * read and write on the batch drive are kept in memory, so that a series of
+ * commands reads the GPT from the drive once and writes it once when the batch
+ * is closed.  See DriveBatchBegin().
+ */
+#define BATCH_BLOCK_BYTES 512
+
+struct batch_block {
+  uint64_t offset;
+  int dirty;
+  uint8_t data[BATCH_BLOCK_BYTES];
+};
+
+static struct {
+  char *path;
+  uint64_t drive_size;
+  int fd;
+  struct batch_block *blocks;
+  size_t count;
+  size_t allocated;
+} batch;
+
+static int InBatch(int fd) {
+  return batch.path && fd >= 0 && fd == batch.fd;
+}
+
+// Returns the cached block at 'offset', reading it from the drive first if
+// 'load' is non-zero.  Returns NULL if error.
+static struct batch_block *BatchBlock(uint64_t offset, int load) {
+  struct batch_block *b;
+  size_t i;
+
+  for (i = 0; i < batch.count; i++)
+    if (batch.blocks[i].offset == offset)
+      return batch.blocks + i;
+
+  if (batch.count == batch.allocated) {
+    size_t allocated = batch.allocated ? batch.allocated * 2 : 64;
+    b = realloc(batch.blocks, allocated * sizeof(*b));
+    if (!b) {
+      Error("Cannot allocate batch buffer\n");
+      return NULL;
+    }
+    batch.blocks = b;
+    batch.allocated = allocated;
+  }
+
+  b = batch.blocks + batch.count;
+  b->offset = offset;
+  b->dirty = 0;
+  if (load && pread(batch.fd, b->data, BATCH_BLOCK_BYTES, offset) !=
+      BATCH_BLOCK_BYTES) {
+    Error("Can't read %d bytes at %llu\n", BATCH_BLOCK_BYTES,
+          (unsigned long long)offset);
+    return NULL;
+  }
+  batch.count++;
+  return b;
+}
+
+// Reads or writes 'count' bytes at 'offset' through the batch cache.
+static int BatchAccess(uint8_t *buf, uint64_t offset, uint64_t count,
+                       int write) {
+  struct batch_block *b;
+
+  if (offset % BATCH_BLOCK_BYTES || count % BATCH_BLOCK_BYTES) {
+    Error("Unaligned access in batch mode\n");
+    return CGPT_FAILED;
+  }
+
+  for (; count; offset += BATCH_BLOCK_BYTES, buf += BATCH_BLOCK_BYTES,
+       count -= BATCH_BLOCK_BYTES) {
+    b = BatchBlock(offset, !write);
+    if (!b)
+      return CGPT_FAILED;
+    if (write) {
+      memcpy(b->data, buf, BATCH_BLOCK_BYTES);
+      b->dirty = 1;
+    } else {
+      memcpy(buf, b->data, BATCH_BLOCK_BYTES);
+    }
+  }
+  return CGPT_OK;
+}
+
+// Returns non-zero if an access is to a memory drive, and within its buffer.
+static int InMemory(const struct drive *drive, uint64_t offset, uint64_t count,
+                    int write) {
+  if (!drive->mem || (write && !drive->mem_writable))
+    return 0;
+  return offset <= drive->mem_size && count <= drive->mem_size - offset;
+}
+
+static void MemoryAccess(struct drive *drive, uint8_t *buf, uint64_t offset,
+                         uint64_t count, int write) {
+  if (write)
+    memcpy(drive->mem + offset, buf, count);
+  else
+    memcpy(buf, drive->mem + offset, count);
+}
+
 int Load(struct drive *drive, uint8_t **buf,
                 const uint64_t sector,
                 const uint64_t sector_bytes,
@@ -99,6 +222,17 @@ int Load(struct drive *drive, uint8_t **buf,
   *buf = malloc(count);
   require(*buf);
 
+  if (InBatch(drive->fd)) {
+    if (CGPT_OK != BatchAccess(*buf, sector * sector_bytes, count, 0))
+      goto error_free;
+    return CGPT_OK;
+  }
+
+  if (InMemory(drive, sector * sector_bytes, count, 0)) {
+    MemoryAccess(drive, *buf, sector * sector_bytes, count, 0);
+    return CGPT_OK;
+  }
+
   if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET)) {
     Error("Can't seek: %s\n", strerror(errno));
     goto error_free;
@@ -120,6 +254,14 @@ error_free:
 
 
 int ReadPMBR(struct drive *drive) {
+  if (InBatch(drive->fd))
+    return BatchAccess((uint8_t *)&drive->pmbr, 0, sizeof(struct pmbr), 0);
+
+  if (InMemory(drive, 0, sizeof(struct pmbr), 0)) {
+    MemoryAccess(drive, (uint8_t *)&drive->pmbr, 0, sizeof(struct pmbr), 0);
+    return CGPT_OK;
+  }
+
   if (-1 == lseek(drive->fd, 0, SEEK_SET))
     return CGPT_FAILED;
 
@@ -131,6 +273,14 @@ int ReadPMBR(struct drive *drive) {
 }
 
 int WritePMBR(struct drive *drive) {
+  if (InBatch(drive->fd))
+    return BatchAccess((uint8_t *)&drive->pmbr, 0, sizeof(struct pmbr), 1);
+
+  if (InMemory(drive, 0, sizeof(struct pmbr), 1)) {
+    MemoryAccess(drive, (uint8_t *)&drive->pmbr, 0, sizeof(struct pmbr), 1);
+    return CGPT_OK;
+  }
+
   if (-1 == lseek(drive->fd, 0, SEEK_SET))
     return CGPT_FAILED;
 
@@ -151,6 +301,14 @@ int Save(struct drive *drive, const uint8_t *buf,
   require(buf);
   count = sector_bytes * sector_count;
 
+  if (InBatch(drive->fd))
+    return BatchAccess((uint8_t *)buf, sector * sector_bytes, count, 1);
+
+  if (InMemory(drive, sector * sector_bytes, count, 1)) {
+    MemoryAccess(drive, (uint8_t *)buf, sector * sector_bytes, count, 1);
+    return CGPT_OK;
+  }
+
   if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET))
     return CGPT_FAILED;
 
@@ -256,7 +414,8 @@ static int GptSave(struct drive *drive) {
     }
 
     // Sync primary GPT before touching secondary so one is always valid.
-    if (drive->gpt.modified & (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1))
+    if ((drive->gpt.modified & (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1))
+        && !InBatch(drive->fd))
       if (fsync(drive->fd) < 0 && errno == EIO) {
         errors++;
         Error("I/O error when trying to write primary GPT\n");
@@ -339,21 +498,47 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
   // Clear struct for proper error handling.
   memset(drive, 0, sizeof(struct drive));
 
-  drive->fd = open(drive_path, mode | 
-#ifndef HAVE_MACOS
-		               O_LARGEFILE |
-#endif
-			       O_NOFOLLOW);
-  if (drive->fd == -1) {
-    Error("Can't open %s: %s\n", drive_path, strerror(errno));
-    return CGPT_FAILED;
+  if (batch.path) {
+    if (strcmp(drive_path, batch.path)) {
+      Error("Only %s can be used in this batch\n", batch.path);
+      return CGPT_FAILED;
+    }
+    if (!drive_size)
+      drive_size = batch.drive_size;
+    if (drive_size != batch.drive_size) {
+      Error("Drive size must be the same for the whole batch\n");
+      return CGPT_FAILED;
+    }
   }
 
   uint64_t gpt_drive_size;
-  if (ObtainDriveSize(drive->fd, &gpt_drive_size, &sector_bytes) != 0) {
-    Error("Can't get drive size and bytes per sector for %s: %s\n",
-          drive_path, strerror(errno));
-    goto error_close;
+  if (IsMemoryDrive(drive_path)) {
+    drive->fd = -1;
+    drive->mem = memory_drive.buf;
+    drive->mem_size = memory_drive.size;
+    drive->mem_writable = (mode & O_ACCMODE) != O_RDONLY;
+    gpt_drive_size = memory_drive.size;
+    sector_bytes = 512;
+  } else {
+    if (batch.path) {
+      drive->fd = batch.fd;
+    } else {
+      drive->fd = open(drive_path, mode |
+#ifndef HAVE_MACOS
+                                   O_LARGEFILE |
+#endif
+                                   O_NOFOLLOW);
+      if (drive->fd == -1) {
+        Error("Can't open %s: %s\n", drive_path, strerror(errno));
+        return CGPT_FAILED;
+      }
+    }
+
+    if (ObtainDriveSize(drive->fd, &gpt_drive_size, &sector_bytes) != 0) {
+      Error("Can't get drive size and bytes per sector for %s: %s\n",
+            drive_path, strerror(errno));
+      goto error_close;
+    }
   }
 
   drive->gpt.gpt_drive_sectors = gpt_drive_size / sector_bytes;
@@ -365,7 +550,6 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
     drive->gpt.flags = GPT_FLAG_EXTERNAL;
   }
 
-
   if (GptLoad(drive, sector_bytes)) {
     goto error_close;
   }
@@ -388,6 +572,11 @@ int DriveClose(struct drive *drive, int update_as_needed) {
     }
   }
 
+  // The batch drive stays open until DriveBatchEnd(), and memory drives
+  // belong to whoever set them up.
+  if (InBatch(drive->fd) || drive->fd < 0)
+    return errors ? CGPT_FAILED : CGPT_OK;
+
   // Sync early! Only sync file descriptor here, and leave the whole system sync
   // outside cgpt because whole system sync would trigger tons of disk accesses
   // and timeout tests.
@@ -399,6 +588,97 @@ int DriveClose(struct drive *drive, int update_as_needed) {
 }
 
 
+int DriveBatchBegin(const char *drive_path, uint64_t drive_size) {
+  require(drive_path);
+
+  if (batch.path) {
+    Error("A batch is already open for %s\n", batch.path);
+    return CGPT_FAILED;
+  }
+
+  // Memory drives are already in memory, so are used as they are
+  if (IsMemoryDrive(drive_path)) {
+    batch.fd = -1;
+    goto out;
+  }
+
+  batch.fd = open(drive_path, O_RDWR |
+#ifndef HAVE_MACOS
+                              O_LARGEFILE |
+#endif
+                              O_NOFOLLOW);
+  if (batch.fd == -1) {
+    Error("Can't open %s: %s\n", drive_path, strerror(errno));
+    return CGPT_FAILED;
+  }
+
+out:
+  batch.path = strdup(drive_path);
+  require(batch.path);
+  batch.drive_size = drive_size;
+  batch.count = 0;
+  return CGPT_OK;
+}
+
+static int CompareBatchBlocks(const void *a, const void *b) {
+  const struct batch_block *ba = a, *bb = b;
+
+  if (ba->offset == bb->offset)
+    return 0;
+  return ba->offset < bb->offset ? -1 : 1;
+}
+
+int DriveBatchEnd(int update_as_needed) {
+  uint64_t size = 0;
+  uint32_t sector_bytes;
+  int synced = 0;
+  int errors = 0;
+  size_t i;
+
+  if (!batch.path)
+    return CGPT_FAILED;
+
+  if (update_as_needed && batch.fd >= 0) {
+    if (ObtainDriveSize(batch.fd, &size, &sector_bytes) != 0) {
+      Error("Can't get size of %s: %s\n", batch.path, strerror(errno));
+      errors++;
+    }
+
+    // Write in drive order, syncing the first half of the drive (PMBR and
+    // primary GPT) before touching the second half, as GptSave() does.
+    qsort(batch.blocks, batch.count, sizeof(*batch.blocks),
+          CompareBatchBlocks);
+    for (i = 0; i < batch.count && !errors; i++) {
+      struct batch_block *b = batch.blocks + i;
+
+      if (!b->dirty)
+        continue;
+      if (!synced && b->offset >= size / 2) {
+        if (fsync(batch.fd) < 0 && errno == EIO) {
+          Error("I/O error when trying to write primary GPT\n");
+          errors++;
+          break;
+        }
+        synced = 1;
+      }
+      if (pwrite(batch.fd, b->data, BATCH_BLOCK_BYTES, b->offset) !=
+          BATCH_BLOCK_BYTES) {
+        Error("Cannot write %s: %s\n", batch.path, strerror(errno));
+        errors++;
+      }
+    }
+    fsync(batch.fd);
+  }
+
+  if (batch.fd >= 0)
+    close(batch.fd);
+  free(batch.path);
+  free(batch.blocks);
+  memset(&batch, 0, sizeof(batch));
+
+  return errors ? CGPT_FAILED : CGPT_OK;
+}
+
 /* GUID conversion functions. Accepted format:
  *
  *   "C12A7328-F81F-11D2-BA4B-00A0C93EC93B"
@@ -3,7 +3,12 @@
 // found in the LICENSE file.
 
 #include <ctype.h>
+#include <pthread.h>
 #include <string.h>
+#ifndef HAVE_MACOS
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#endif
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -15,22 +20,33 @@
 
 #define BUFSIZE 1024
 
-// fill comparebuf with the data to be examined, returning true on success.
-static int FillBuffer(CgptFindParams *params, int fd, uint64_t pos,
-                       uint64_t count) {
-  uint8_t *bufptr = params->comparebuf;
+// Most drives scan_real_devs() searches at once
+#define MAX_SCAN_THREADS 8
 
-  if (-1 == lseek(fd, pos, SEEK_SET))
-    return 0;
+// A partition which matches the search criteria
+struct find_match {
+  int partnum;
+  GptEntry entry;
+};
+
+// The matches found on one drive
+struct find_result {
+  char *filename;
+  struct find_match *matches;
+  int count;
+};
 
+// fill buf with the data to be examined, returning true on success.
+static int FillBuffer(int fd, uint8_t *buf, uint64_t pos, uint64_t count) {
   // keep reading until done or error
   while (count) {
-    ssize_t bytes_read = read(fd, bufptr, count);
+    ssize_t bytes_read = pread(fd, buf, count, pos);
     // negative means error, 0 means (unexpected) EOF
     if (bytes_read <= 0)
       return 0;
     count -= bytes_read;
-    bufptr += bytes_read;
+    buf += bytes_read;
+    pos += bytes_read;
   }
 
   return 1;
@@ -38,7 +54,7 @@ static int FillBuffer(CgptFindParams *params, int fd, uint64_t pos,
 
 // check partition data content. return true for match, 0 for no match or error
 static int match_content(CgptFindParams *params, struct drive *drive,
-                             GptEntry *entry) {
+                         GptEntry *entry, uint8_t *comparebuf) {
   uint64_t part_size;
 
   if (!params->matchlen)
@@ -52,7 +68,7 @@ static int match_content(CgptFindParams *params, struct drive *drive,
   }
 
   // Read the partition data.
-  if (!FillBuffer(params, drive->fd,
+  if (!FillBuffer(drive->fd, comparebuf,
     (drive->gpt.sector_bytes * entry->starting_lba) + params->matchoffset,
                   params->matchlen)) {
     Error("unable to read partition data\n");
@@ -60,7 +76,7 @@ static int match_content(CgptFindParams *params, struct drive *drive,
   }
 
   // Compare it
-  if (0 == memcmp(params->matchbuf, params->comparebuf, params->matchlen)) {
+  if (0 == memcmp(params->matchbuf, comparebuf, params->matchlen)) {
     return 1;
   }
 
@@ -108,15 +124,14 @@ static void chromeos_mtd_show(CgptFindParams *params, char *filename,
   }
 }
 
-// This returns true if a GPT partition matches the search criteria. If a match
-// isn't found (or if the file doesn't contain a GPT), it returns false. The
-// filename and partition number that matched is left in a global, since we
-// could have multiple hits.
+// This collects the GPT partitions which match the search criteria in
+// 'result'. If none are found (or if the file doesn't contain a GPT), it
+// returns false.
 static int gpt_search(CgptFindParams *params, struct drive *drive,
-                      char *filename) {
+                      struct find_result *result, uint8_t *comparebuf) {
   int i;
   GptEntry *entry;
-  int retval = 0;
+  struct find_match *matches;
   char partlabel[GPT_PARTNAME_LEN];
 
   if (GPT_SUCCESS != GptSanityCheck(&drive->gpt)) {
@@ -138,37 +153,184 @@ static int gpt_search(CgptFindParams *params, struct drive *drive,
                                  sizeof(entry->name) / sizeof(entry->name[0]),
                                  (uint8_t *)partlabel, sizeof(partlabel))) {
         Error("The label cannot be converted from UTF16, so abort.\n");
-        return 0;
+        return result->count;
       }
       if (!strncmp(params->label, partlabel, sizeof(partlabel)))
         found = 1;
     }
-    if (found && match_content(params, drive, entry)) {
-      params->hits++;
-      retval++;
-      showmatch(params, filename, i+1, entry);
-      if (!params->match_partnum)
-        params->match_partnum = i+1;
+    if (found && match_content(params, drive, entry, comparebuf)) {
+      matches = realloc(result->matches,
+                        (result->count + 1) * sizeof(*matches));
+      require(matches);
+      matches[result->count].partnum = i + 1;
+      memcpy(&matches[result->count].entry, entry, sizeof(*entry));
+      result->matches = matches;
+      result->count++;
     }
   }
 
-  return retval;
+  return result->count;
 }
 
-static int do_search(CgptFindParams *params, char *fileName) {
+// Shows the matches found on a drive, in partition order. Returns the number
+// of matches.
+static int report_matches(CgptFindParams *params, struct find_result *result) {
+  int i;
+
+  for (i = 0; i < result->count; i++) {
+    params->hits++;
+    showmatch(params, result->filename, result->matches[i].partnum,
+              &result->matches[i].entry);
+    if (!params->match_partnum)
+      params->match_partnum = result->matches[i].partnum;
+  }
+
+  return result->count;
+}
+
+static int search_drive(CgptFindParams *params, struct find_result *result,
+                        uint8_t *comparebuf) {
   int retval;
   struct drive drive;
 
-  if (CGPT_OK != DriveOpen(fileName, &drive, O_RDONLY, params->drive_size))
+  if (CGPT_OK != DriveOpen(result->filename, &drive, O_RDONLY,
+                           params->drive_size))
     return 0;
 
-  retval = gpt_search(params, &drive, fileName);
+  retval = gpt_search(params, &drive, result, comparebuf);
 
   (void) DriveClose(&drive, 0);
 
   return retval;
 }
 
+static int do_search(CgptFindParams *params, char *fileName) {
+  struct find_result result = { fileName, NULL, 0 };
+  int retval;
+
+  search_drive(params, &result, params->comparebuf);
+  retval = report_matches(params, &result);
+  free(result.matches);
+
+  return retval;
+}
+
+static int is_gpt_signature(const GptHeader *h) {
+  return !memcmp(h->signature, GPT_HEADER_SIGNATURE,
+                 GPT_HEADER_SIGNATURE_SIZE) ||
+         !memcmp(h->signature, GPT_HEADER_SIGNATURE2,
+                 GPT_HEADER_SIGNATURE_SIZE) ||
+         !memcmp(h->signature, GPT_HEADER_SIGNATURE_IGNORED,
+                 GPT_HEADER_SIGNATURE_SIZE);
+}
+
+// Returns true if the drive has a GPT header, primary or secondary, so it's
+// worth loading its partition entries.
+static int has_gpt_header(const char *filename) {
+  uint8_t buf[GPT_HEADER_SIGNATURE_SIZE];
+  uint32_t sector_bytes = 512;
+  uint64_t size = 0;
+  struct stat st;
+  int retval = 0;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+#ifndef HAVE_MACOS
+  if (0 == fstat(fd, &st) && S_ISBLK(st.st_mode)) {
+    if (ioctl(fd, BLKSSZGET, &sector_bytes) < 0 ||
+        ioctl(fd, BLKGETSIZE64, &size) < 0)
+      goto out;
+  } else
+#endif
+  if (0 == fstat(fd, &st)) {
+    size = st.st_size;
+  }
+
+  // Primary header, then secondary header
+  if (FillBuffer(fd, buf, sector_bytes, sizeof(buf)) &&
+      is_gpt_signature((GptHeader *)buf))
+    retval = 1;
+  else if (size >= 2 * sector_bytes &&
+           FillBuffer(fd, buf, size - sector_bytes, sizeof(buf)) &&
+           is_gpt_signature((GptHeader *)buf))
+    retval = 1;
+
+out:
+  close(fd);
+  return retval;
+}
+
+// Drives being searched by scan_drives()
+struct scan_state {
+  CgptFindParams *params;
+  struct find_result *results;
+  int count;
+  int next;
+  pthread_mutex_t lock;
+};
+
+static void *scan_worker(void *arg) {
+  struct scan_state *state = arg;
+  CgptFindParams *params = state->params;
+  uint8_t *comparebuf = NULL;
+  int i;
+
+  if (params->matchlen) {
+    comparebuf = malloc(params->matchlen);
+    require(comparebuf);
+  }
+
+  while (1) {
+    pthread_mutex_lock(&state->lock);
+    i = state->next++;
+    pthread_mutex_unlock(&state->lock);
+    if (i >= state->count)
+      break;
+
+    // Only load the GPT of drives which have one
+    if (has_gpt_header(state->results[i].filename))
+      search_drive(params, state->results + i, comparebuf);
+  }
+
+  free(comparebuf);
+  return NULL;
+}
+
+// Searches the drives in 'results' in parallel, then shows their matches in
+// drive order. Returns the number of drives with matches.
+static int scan_drives(CgptFindParams *params, struct find_result *results,
+                       int count) {
+  pthread_t threads[MAX_SCAN_THREADS - 1];
+  struct scan_state state;
+  int num_threads = 0;
+  int found = 0;
+  int i;
+
+  state.params = params;
+  state.results = results;
+  state.count = count;
+  state.next = 0;
+  pthread_mutex_init(&state.lock, NULL);
+
+  // This thread searches too, along with up to MAX_SCAN_THREADS - 1 others
+  while (num_threads < count - 1 && num_threads < MAX_SCAN_THREADS - 1 &&
+         0 == pthread_create(&threads[num_threads], NULL, scan_worker, &state))
+    num_threads++;
+  scan_worker(&state);
+  for (i = 0; i < num_threads; i++)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&state.lock);
+
+  for (i = 0; i < count; i++) {
+    if (report_matches(params, results + i))
+      found++;
+  }
+
+  return found;
+}
 
 #define PROC_MTD "/proc/mtd"
 #define PROC_PARTITIONS "/proc/partitions"
@@ -230,6 +392,9 @@ static int scan_real_devs(CgptFindParams *params) {
 
   size_t line_length = 0;
   char *line = NULL;
+  struct find_result *results = NULL;
+  int count = 0;
+  int i;
   partname_prev[0] = '\0';
   while (getline(&line, &line_length, fp) != -1) {
     int ma, mi;
@@ -244,9 +409,12 @@ static int scan_real_devs(CgptFindParams *params) {
     if (!strncmp(partname_prev, partname, strlen(partname_prev)) &&
         strlen(partname_prev)) {
       if ((pathname = is_wholedev(partname_prev))) {
-        if (do_search(params, pathname)) {
-          found++;
-        }
+        results = realloc(results, (count + 1) * sizeof(*results));
+        require(results);
+        memset(results + count, 0, sizeof(*results));
+        results[count].filename = strdup(pathname);
+        require(results[count].filename);
+        count++;
       }
     }
 
@@ -255,6 +423,13 @@ static int scan_real_devs(CgptFindParams *params) {
 
   fclose(fp);
 
+  found = scan_drives(params, results, count);
+  for (i = 0; i < count; i++) {
+    free(results[i].filename);
+    free(results[i].matches);
+  }
+  free(results);
+
   fp = fopen(PROC_MTD, "re");
   if (!fp) {
     free(line);
@@ -270,26 +445,28 @@ static int scan_real_devs(CgptFindParams *params) {
                partname, &sz, &erasesz, name) != 4)
       continue;
     if (strcmp(partname, "mtd0") == 0) {
-      char temp_dir[] = "/tmp/cgpt_find.XXXXXX";
+      struct nor_flash flash;
+      struct nor_area area;
       if (params->drive_size == 0) {
         if (GetMtdSize("/dev/mtd0", &params->drive_size) != 0) {
           perror("GetMtdSize");
           goto cleanup;
         }
       }
-      if (ReadNorFlash(temp_dir) != 0) {
-        perror("ReadNorFlash");
+      NorFlashOpenHost(&flash);
+      if (NorAreaRead(&flash, "RW_GPT", &area) != 0) {
+        NorFlashClose(&flash);
         goto cleanup;
       }
-      char nor_file[64];
-      if (snprintf(nor_file, sizeof(nor_file), "%s/rw_gpt", temp_dir) > 0) {
-        params->show_fn = chromeos_mtd_show;
-        if (do_search(params, nor_file)) {
-          found++;
-        }
-        params->show_fn = NULL;
+      DriveUseMemory("/dev/mtd0", area.data, area.size);
+      params->show_fn = chromeos_mtd_show;
+      if (do_search(params, "/dev/mtd0")) {
+        found++;
       }
-      RemoveDir(temp_dir);
+      params->show_fn = NULL;
+      DriveUseMemory(NULL, NULL, 0);
+      NorAreaFree(&area);
+      NorFlashClose(&flash);
       break;
     }
   }
@@ -16,12 +16,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include "cgpt.h"
 #include "cgpt_nor.h"
+#include "fmap.h"
+#include "host_misc.h"
 
 static const char FLASHROM_PATH[] = "/usr/sbin/flashrom";
 
@@ -92,172 +95,314 @@ int ForkExecL(const char *cwd, const char *cmd, ...) {
   return ret;
 }
 
-static int read_write(int source_fd,
-                      uint64_t size,
-                      const char *src_name,
-                      int idx) {
+static int remove_file_or_dir(const char *fpath, const struct stat *sb,
+                              int typeflag, struct FTW *ftwbuf) {
+  return remove(fpath);
+}
+
+int RemoveDir(const char *dir) {
+  return nftw(dir, remove_file_or_dir, 20, FTW_DEPTH | FTW_PHYS);
+}
+
+// Runs flashrom in 'dir' with the given arguments, keeping it from writing
+// to our stdout.  Returns 0 if success.
+static int RunFlashrom(const char *dir, const char *area_arg,
+                       const char *op, const char *extra) {
+  int ret;
+  int fd_flags = fcntl(1, F_GETFD);
+  // Close stdout on exec so that flashrom does not muck up cgpt's output.
+  if (0 != fcntl(1, F_SETFD, FD_CLOEXEC))
+    Warning("Can't stop flashrom from mucking up our output\n");
+  ret = ForkExecL(dir, FLASHROM_PATH, "-i", area_arg, op, extra, NULL);
+  // Restore stdout flags
+  if (0 != fcntl(1, F_SETFD, fd_flags))
+    Warning("Can't restore stdout flags\n");
+  return ret;
+}
+
+// flashrom backend.  flashrom reads and writes whole FMAP areas, so the
+// halves of an area are its erase blocks, written as the <name>_PRIMARY and
+// <name>_SECONDARY areas.
+static int HostReadArea(struct nor_flash *flash, const char *name,
+                        struct nor_area *area) {
+  char dir[] = "/tmp/cgpt_nor.XXXXXX";
+  char *area_arg = NULL;
+  char *file = NULL;
   int ret = 1;
-  const int bufsize = 4096;
-  char *buf = malloc(bufsize);
-  if (buf == NULL) {
-    goto clean_exit;
-  }
 
-  ret++;
-  char *dest;
-  if (asprintf(&dest, "%s_%d", src_name, idx) == -1) {
-    goto free_buf;
+  if (mkdtemp(dir) == NULL) {
+    Error("Cannot create a temporary directory.\n");
+    return ret;
   }
+  if (asprintf(&area_arg, "%s:area", name) == -1 ||
+      asprintf(&file, "%s/area", dir) == -1)
+    goto cleanup;
 
-  ret++;
-  int dest_fd = open(dest, O_WRONLY | O_CLOEXEC | O_CREAT, 0600);
-  if (dest_fd < 0) {
-    goto free_dest;
+  if (RunFlashrom(dir, area_arg, "-r", NULL) != 0) {
+    Error("Cannot exec flashrom to read from %s section.\n", name);
+    goto cleanup;
   }
-
-  ret++;
-  uint64_t copied = 0;
-  ssize_t nr_read;
-  ssize_t nr_write;
-  while (copied < size) {
-    size_t to_read = size - copied;
-    if (to_read > bufsize) {
-      to_read = bufsize;
-    }
-    nr_read = read(source_fd, buf, to_read);
-    if (nr_read < 0) {
-      goto close_dest_fd;
-    }
-    nr_write = 0;
-    while (nr_write < nr_read) {
-      ssize_t s = write(dest_fd, buf + nr_write, nr_read - nr_write);
-      if (s < 0) {
-        goto close_dest_fd;
-      }
-      nr_write += s;
-    }
-    copied += nr_read;
+  area->data = ReadFile(file, &area->size);
+  if (area->data == NULL)
+    goto cleanup;
+  if (area->size & 1) {
+    Error("%s is not in two halves.\n", name);
+    goto cleanup;
   }
-
+  area->offset = 0;
+  flash->erase_size = area->size / 2;
   ret = 0;
 
-close_dest_fd:
-  close(dest_fd);
-free_dest:
-  free(dest);
-free_buf:
-  free(buf);
-clean_exit:
+cleanup:
+  free(area_arg);
+  free(file);
+  RemoveDir(dir);
   return ret;
 }
 
-static int split_gpt(const char *dir_name, const char *file_name) {
+static int HostWriteArea(struct nor_flash *flash, struct nor_area *area,
+                         uint64_t offset, uint64_t size) {
+  const char *half = offset < area->size / 2 ? "PRIMARY" : "SECONDARY";
+  char dir[] = "/tmp/cgpt_nor.XXXXXX";
+  char *area_arg = NULL;
+  char *file = NULL;
   int ret = 1;
-  char *source;
-  if (asprintf(&source, "%s/%s", dir_name, file_name) == -1) {
-    goto clean_exit;
-  }
 
-  ret++;
-  int fd = open(source, O_RDONLY | O_CLOEXEC);
-  if (fd < 0) {
-    goto free_source;
+  if (mkdtemp(dir) == NULL) {
+    Error("Cannot create a temporary directory.\n");
+    return ret;
   }
+  if (asprintf(&area_arg, "%s_%s:half", area->name, half) == -1 ||
+      asprintf(&file, "%s/half", dir) == -1)
+    goto cleanup;
 
-  ret++;
-  struct stat stat;
-  if (fstat(fd, &stat) != 0 || (stat.st_size & 1) != 0) {
-    goto close_fd;
-  }
-  uint64_t half_size = stat.st_size / 2;
+  if (WriteFile(file, area->data + offset, size) != 0)
+    goto cleanup;
+  if (RunFlashrom(dir, area_arg, "-w", "--fast-verify") == 0)
+    ret = 0;
+
+cleanup:
+  free(area_arg);
+  free(file);
+  RemoveDir(dir);
+  return ret;
+}
 
-  ret++;
-  if (read_write(fd, half_size, source, 1) != 0 ||
-      read_write(fd, half_size, source, 2) != 0) {
-    goto close_fd;
+static int HostSync(struct nor_flash *flash) {
+  return 0;
+}
+
+static void HostClose(struct nor_flash *flash) {
+}
+
+void NorFlashOpenHost(struct nor_flash *flash) {
+  memset(flash, 0, sizeof(*flash));
+  flash->read_area = HostReadArea;
+  flash->write_area = HostWriteArea;
+  flash->sync = HostSync;
+  flash->close = HostClose;
+  flash->fd = -1;
+}
+
+// File backend, for flash image files.  The whole flash is read to find its
+// FMAP, then areas are read and written in place.
+static int FileReadArea(struct nor_flash *flash, const char *name,
+                        struct nor_area *area) {
+  FmapAreaHeader *ah;
+  uint8_t *image;
+  int ret = 1;
+
+  image = malloc(flash->size);
+  if (image == NULL)
+    return ret;
+  if (pread(flash->fd, image, flash->size, 0) != flash->size) {
+    Error("Cannot read the flash: %s\n", strerror(errno));
+    goto cleanup;
+  }
+  if (!fmap_find_by_name(image, flash->size, NULL, name, &ah)) {
+    Error("Cannot find %s in the flash map.\n", name);
+    goto cleanup;
+  }
+  if ((uint64_t)ah->area_offset + ah->area_size > flash->size) {
+    Error("%s is outside the flash.\n", name);
+    goto cleanup;
   }
 
+  area->offset = ah->area_offset;
+  area->size = ah->area_size;
+  area->data = malloc(area->size);
+  if (area->data == NULL)
+    goto cleanup;
+  memcpy(area->data, image + area->offset, area->size);
   ret = 0;
-close_fd:
-  close(fd);
-free_source:
-  free(source);
-clean_exit:
+
+cleanup:
+  free(image);
   return ret;
 }
 
-static int remove_file_or_dir(const char *fpath, const struct stat *sb,
-                              int typeflag, struct FTW *ftwbuf) {
-  return remove(fpath);
+static int FileWriteArea(struct nor_flash *flash, struct nor_area *area,
+                         uint64_t offset, uint64_t size) {
+  if (pwrite(flash->fd, area->data + offset, size,
+             area->offset + offset) != size) {
+    Error("Cannot write the flash: %s\n", strerror(errno));
+    return 1;
+  }
+  return 0;
 }
 
-int RemoveDir(const char *dir) {
-  return nftw(dir, remove_file_or_dir, 20, FTW_DEPTH | FTW_PHYS);
+static int FileSync(struct nor_flash *flash) {
+  return fsync(flash->fd);
 }
 
-// Read RW_GPT from NOR flash to "rw_gpt" in a temp dir |temp_dir_template|.
-// |temp_dir_template| is passed to mkdtemp() so it must satisfy all
-// requirements by mkdtemp.
-int ReadNorFlash(char *temp_dir_template) {
-  int ret = 0;
+static void FileClose(struct nor_flash *flash) {
+  close(flash->fd);
+}
 
-  // Create a temp dir to work in.
-  ret++;
-  if (mkdtemp(temp_dir_template) == NULL) {
-    Error("Cannot create a temporary directory.\n");
-    return ret;
+int NorFlashOpenFile(struct nor_flash *flash, const char *path) {
+  struct stat stat;
+
+  memset(flash, 0, sizeof(*flash));
+  flash->fd = open(path, O_RDWR | O_CLOEXEC);
+  if (flash->fd < 0) {
+    Error("Can't open %s: %s\n", path, strerror(errno));
+    return 1;
   }
+  if (fstat(flash->fd, &stat) != 0)
+    goto error_close;
 
-  // Read RW_GPT section from NOR flash to "rw_gpt".
-  ret++;
-  int fd_flags = fcntl(1, F_GETFD);
-  // Close stdout on exec so that flashrom does not muck up cgpt's output.
-  if (0 != fcntl(1, F_SETFD, FD_CLOEXEC))
-    Warning("Can't stop flashrom from mucking up our output\n");
-  if (ForkExecL(temp_dir_template, FLASHROM_PATH, "-i", "RW_GPT:rw_gpt", "-r",
-                NULL) != 0) {
-    Error("Cannot exec flashrom to read from RW_GPT section.\n");
-    RemoveDir(temp_dir_template);
+  if (S_ISREG(stat.st_mode)) {
+    flash->size = stat.st_size;
+    flash->erase_size = NOR_IMAGE_ERASE_SIZE;
   } else {
-    ret = 0;
+    Error("%s is not a flash image.\n", path);
+    close(flash->fd);
+    return 1;
   }
 
-  // Restore stdout flags
-  if (0 != fcntl(1, F_SETFD, fd_flags))
-    Warning("Can't restore stdout flags\n");
-  return ret;
+  flash->read_area = FileReadArea;
+  flash->write_area = FileWriteArea;
+  flash->sync = FileSync;
+  flash->close = FileClose;
+  return 0;
+
+error_close:
+  Error("Can't get the size of %s: %s\n", path, strerror(errno));
+  close(flash->fd);
+  return 1;
 }
 
-// Write "rw_gpt" back to NOR flash. We write the file in two parts for safety.
-int WriteNorFlash(const char *dir) {
-  int ret = 0;
-  ret++;
-  if (split_gpt(dir, "rw_gpt") != 0) {
-    Error("Cannot split rw_gpt in two.\n");
-    return ret;
+void NorFlashClose(struct nor_flash *flash) {
+  flash->close(flash);
+}
+
+int NorAreaRead(struct nor_flash *flash, const char *name,
+                struct nor_area *area) {
+  memset(area, 0, sizeof(*area));
+  area->name = name;
+  if (flash->read_area(flash, name, area) != 0)
+    goto error_free;
+
+  // Each half is written separately, so must be whole erase blocks.
+  if (area->size & 1 || !flash->erase_size ||
+      area->offset % flash->erase_size ||
+      (area->size / 2) % flash->erase_size) {
+    Error("%s is not aligned to the flash erase blocks.\n", name);
+    goto error_free;
   }
-  ret++;
+
+  area->orig = malloc(area->size);
+  if (area->orig == NULL)
+    goto error_free;
+  memcpy(area->orig, area->data, area->size);
+  return 0;
+
+error_free:
+  NorAreaFree(area);
+  return 1;
+}
+
+int NorAreaWrite(struct nor_flash *flash, struct nor_area *area) {
+  uint64_t half = area->size / 2;
+  uint64_t start, offset;
   int nr_fails = 0;
-  int fd_flags = fcntl(1, F_GETFD);
-  // Close stdout on exec so that flashrom does not muck up cgpt's output.
-  if (0 != fcntl(1, F_SETFD, FD_CLOEXEC))
-    Warning("Can't stop flashrom from mucking up our output\n");
-  if (ForkExecL(dir, FLASHROM_PATH, "-i", "RW_GPT_PRIMARY:rw_gpt_1",
-                "-w", "--fast-verify", NULL) != 0) {
-    Warning("Cannot write the 1st half of rw_gpt back with flashrom.\n");
-    nr_fails++;
-  }
-  if (ForkExecL(dir, FLASHROM_PATH, "-i", "RW_GPT_SECONDARY:rw_gpt_2",
-                "-w", "--fast-verify", NULL) != 0) {
-    Warning("Cannot write the 2nd half of rw_gpt back with flashrom.\n");
-    nr_fails++;
+
+  // Write the first half before the second, for safety.
+  for (start = 0; start < area->size; start += half) {
+    int written = 0;
+    int failed = 0;
+
+    for (offset = start; offset < start + half; offset += flash->erase_size) {
+      if (!memcmp(area->data + offset, area->orig + offset,
+                  flash->erase_size))
+        continue;
+      if (flash->write_area(flash, area, offset, flash->erase_size) != 0) {
+        failed = 1;
+        break;
+      }
+      memcpy(area->orig + offset, area->data + offset, flash->erase_size);
+      written = 1;
+    }
+    if (written && flash->sync(flash) != 0)
+      failed = 1;
+
+    if (failed) {
+      Warning("Cannot write the %s half of %s back.\n",
+              start ? "2nd" : "1st", area->name);
+      nr_fails++;
+    }
   }
-  if (0 != fcntl(1, F_SETFD, fd_flags))
-    Warning("Can't restore stdout flags\n");
+
   switch (nr_fails) {
-    case 0: ret = 0; break;
+    case 0: return 0;
     case 1: Warning("It might still be okay.\n"); break;
-    case 2: Error("Cannot write both parts back with flashrom.\n"); break;
+    case 2: Error("Cannot write both parts back.\n"); break;
   }
-  return ret;
+  return 1;
+}
+
+void NorAreaFree(struct nor_area *area) {
+  free(area->data);
+  free(area->orig);
+  area->data = NULL;
+  area->orig = NULL;
+}
+
+// Check if cmdline |argv| has "-D". "-D" signifies that GPT structs are stored
+// off device, and hence we should not use NOR flash.
+static bool has_dash_D(int argc, const char *const argv[]) {
+  int i;
+  // We go from 2, because the second arg is a cgpt command such as "create".
+  for (i = 2; i < argc; ++i) {
+    if (strcmp("-D", argv[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Check if |device_path| is an MTD device based on its major number being 90.
+static bool is_mtd(const char *device_path) {
+  struct stat stat;
+  if (lstat(device_path, &stat) != 0) {
+    return false;
+  }
+
+  if (major(stat.st_rdev) != MTD_CHAR_MAJOR) {
+    return false;
+  }
+
+  return true;
+}
+
+const char *FindMtdDevice(int argc, const char *const argv[]) {
+  int i;
+  if (argc <= 2 || has_dash_D(argc, argv))
+    return NULL;
+  for (i = 2; i < argc; ++i) {
+    if (is_mtd(argv[i])) {
+      return argv[i];
+    }
+  }
+  return NULL;
 }
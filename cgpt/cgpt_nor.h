@@ -2,8 +2,8 @@
  * Use of this source code is governed by a BSD-style license that can be
  * found in the LICENSE file.
  *
- * This module provides some utility functions to use "flashrom" to read from
- * and write to NOR flash.
+ * This module provides some utility functions to read from and write to NOR
+ * flash, either directly or through "flashrom".
  */
 
 #ifndef VBOOT_REFERCENCE_CGPT_CGPT_NOR_H_
@@ -23,12 +23,61 @@ int ForkExecL(const char *cwd, const char *cmd, ...);
 // Exec "rm" to remove |dir|.
 int RemoveDir(const char *dir);
 
-// Read RW_GPT from NOR flash to "rw_gpt" in a temp dir |temp_dir_template|.
-// |temp_dir_template| is passed to mkdtemp() so it must satisfy all
-// requirements by mkdtemp().
-int ReadNorFlash(char *temp_dir_template);
+// Flash images are taken to have erase blocks this big.
+#define NOR_IMAGE_ERASE_SIZE 4096
 
-// Write "rw_gpt" back to NOR flash. We write the file in two parts for safety.
-int WriteNorFlash(const char *dir);
+struct nor_area;
+
+// A NOR flash, accessed through one of the backends below.
+struct nor_flash {
+  // Reads FMAP area |name| into |area|. Returns 0 on success.
+  int (*read_area)(struct nor_flash *flash, const char *name,
+                   struct nor_area *area);
+  // Erases and writes |size| bytes of |area| from |offset| into it, both
+  // multiples of |erase_size|. Returns 0 on success.
+  int (*write_area)(struct nor_flash *flash, struct nor_area *area,
+                    uint64_t offset, uint64_t size);
+  // Flushes what write_area() wrote. Returns 0 on success.
+  int (*sync)(struct nor_flash *flash);
+  void (*close)(struct nor_flash *flash);
+
+  uint64_t size;
+  uint32_t erase_size;
+  int fd;
+};
+
+// An FMAP area of a NOR flash, held in memory.
+struct nor_area {
+  const char *name;
+  uint64_t offset;  // in the flash
+  uint64_t size;
+  uint8_t *data;    // contents, which the caller may change
+  uint8_t *orig;    // contents as last read from or written to the flash
+};
+
+// Use flashrom to access the host's NOR flash.
+void NorFlashOpenHost(struct nor_flash *flash);
+
+// Access the flash image file |path| directly. This function returns 0 on
+// success.
+int NorFlashOpenFile(struct nor_flash *flash, const char *path);
+
+void NorFlashClose(struct nor_flash *flash);
+
+// Read FMAP area |name| from |flash| into memory. Its halves must be whole
+// erase blocks. This function returns 0 on success.
+int NorAreaRead(struct nor_flash *flash, const char *name,
+                struct nor_area *area);
+
+// Write back the erase blocks of |area| which changed since it was read. The
+// first half of the area is written and synced before the second, for
+// safety. This function returns 0 on success.
+int NorAreaWrite(struct nor_flash *flash, struct nor_area *area);
+
+void NorAreaFree(struct nor_area *area);
+
+// Return the element in |argv| that is an MTD device, whose GPT is in NOR
+// flash, or NULL if there is none or "-D" says the GPT is somewhere else.
+const char *FindMtdDevice(int argc, const char *const argv[]);
 
 #endif  // VBOOT_REFERCENCE_CGPT_CGPT_NOR_H_
@@ -0,0 +1,178 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "host_misc.h"
+#include "vboot_host.h"
+
+extern const char* progname;
+
+// Longest command line, and most words on it
+#define MAX_LINE 4096
+#define MAX_ARGS 64
+
+static void Usage(void)
+{
+  printf("\nUsage: %s batch [OPTIONS] DRIVE\n\n"
+         "Run cgpt commands on DRIVE, reading the GPT once and writing it\n"
+         "once at the end. Nothing is written if any command fails or the\n"
+         "GPT isn't valid at the end.\n\n"
+         "Each line of input is a command and its options, without DRIVE:\n\n"
+         "  add -i 2 -t kernel -b 4096 -s 32768 -l \"KERN-A\"\n"
+         "  prioritize -i 2\n\n"
+         "Words may be quoted with \"\" or ''. Blank lines and lines starting\n"
+         "with # are ignored.\n\n"
+         "Options:\n"
+         "  -f FILE      Read commands from FILE instead of stdin\n"
+         "  -D NUM       Size (in bytes) of the disk where partitions reside\n"
+         "                 default 0, meaning partitions and GPT structs are\n"
+         "                 both on DRIVE\n"
+         "\n", progname);
+}
+
+// Runs the commands in 'fp' on the batch drive.  Returns CGPT_OK if they all
+// succeed.
+static int RunBatch(FILE *fp, const char *script_name, char *drive_name) {
+  char line[MAX_LINE];
+  char *words[MAX_ARGS + 2];
+  int line_num = 0;
+  int count;
+
+  while (fgets(line, sizeof(line), fp)) {
+    line_num++;
+    if (!strchr(line, '\n') && !feof(fp)) {
+      Error("%s:%d: line too long\n", script_name, line_num);
+      return CGPT_FAILED;
+    }
+
+    count = SplitWords(line, words, MAX_ARGS);
+    if (count < 0) {
+      Error("%s:%d: too many words or unclosed quote\n",
+            script_name, line_num);
+      return CGPT_FAILED;
+    }
+    if (!count)
+      continue;
+
+    words[count++] = drive_name;
+    words[count] = NULL;
+    if (CGPT_OK != RunCommand(count, words)) {
+      Error("%s:%d: %s failed\n", script_name, line_num, words[0]);
+      return CGPT_FAILED;
+    }
+  }
+
+  if (ferror(fp)) {
+    Error("Can't read %s\n", script_name);
+    return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
+
+// Checks that the GPT the batch leaves behind is valid.
+static int CheckBatchResult(const char *drive_name) {
+  struct drive drive;
+  int gpt_retval;
+  int rv = CGPT_OK;
+
+  if (CGPT_OK != DriveOpen(drive_name, &drive, O_RDONLY, 0))
+    return CGPT_FAILED;
+
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("GptSanityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    rv = CGPT_FAILED;
+  }
+
+  DriveClose(&drive, 0);
+  return rv;
+}
+
+int cmd_batch(int argc, char *argv[]) {
+  const char *script_name = NULL;
+  uint64_t drive_size = 0;
+  char *drive_name;
+  FILE *fp = stdin;
+  int rv;
+
+  int c;
+  char* e = 0;
+  int errorcnt = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hf:D:")) != -1)
+  {
+    switch (c)
+    {
+    case 'f':
+      script_name = optarg;
+      break;
+    case 'D':
+      drive_size = strtoull(optarg, &e, 0);
+      errorcnt += check_int_parse(c, e);
+      break;
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc) {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  drive_name = argv[optind];
+
+  if (script_name && strcmp(script_name, "-")) {
+    fp = fopen(script_name, "r");
+    if (!fp) {
+      Error("Can't open %s: %s\n", script_name, strerror(errno));
+      return CGPT_FAILED;
+    }
+  } else {
+    script_name = "<stdin>";
+  }
+
+  if (CGPT_OK != DriveBatchBegin(drive_name, drive_size)) {
+    if (fp != stdin)
+      fclose(fp);
+    return CGPT_FAILED;
+  }
+
+  rv = RunBatch(fp, script_name, drive_name);
+  if (fp != stdin)
+    fclose(fp);
+  if (rv == CGPT_OK)
+    rv = CheckBatchResult(drive_name);
+
+  if (rv != CGPT_OK) {
+    Error("Not writing any changes to %s\n", drive_name);
+    DriveBatchEnd(0);
+    return CGPT_FAILED;
+  }
+
+  return DriveBatchEnd(1);
+}
@@ -7,21 +7,16 @@
 #include "2sha.h"
 #include "2hmac.h"
 
-int hmac(enum vb2_hash_algorithm alg,
-	 const void *key, uint32_t key_size,
-	 const void *msg, uint32_t msg_size,
-	 uint8_t *mac, uint32_t mac_size)
+int hmac_key_init(struct vb2_hmac_key *hk, enum vb2_hash_algorithm alg,
+		  const void *key, uint32_t key_size)
 {
 	uint32_t block_size;
 	uint32_t digest_size;
 	uint8_t k[VB2_MAX_BLOCK_SIZE];
-	uint8_t o_pad[VB2_MAX_BLOCK_SIZE];
-	uint8_t i_pad[VB2_MAX_BLOCK_SIZE];
-	uint8_t b[VB2_MAX_DIGEST_SIZE];
-	struct vb2_digest_context dc;
+	uint8_t pad[VB2_MAX_BLOCK_SIZE];
 	int i;
 
-	if (!key | !msg | !mac)
+	if (!hk || !key)
 		return -1;
 
 	digest_size = vb2_digest_size(alg);
@@ -29,9 +24,6 @@ int hmac(enum vb2_hash_algorithm alg,
 	if (!digest_size || !block_size)
 		return -1;
 
-	if (mac_size < digest_size)
-		return -1;
-
 	if (key_size > block_size) {
 		vb2_digest_buffer((uint8_t *)key, key_size, alg, k, block_size);
 		key_size = digest_size;
@@ -41,20 +33,79 @@ int hmac(enum vb2_hash_algorithm alg,
 	if (key_size < block_size)
 		memset(k + key_size, 0, block_size - key_size);
 
-	for (i = 0; i < block_size; i++) {
-		o_pad[i] = 0x5c ^ k[i];
-		i_pad[i] = 0x36 ^ k[i];
-	}
+	/* Absorb one block of each padded key; this is what gets reused */
+	for (i = 0; i < block_size; i++)
+		pad[i] = 0x36 ^ k[i];
+	vb2_digest_init(&hk->inner, alg);
+	vb2_digest_extend(&hk->inner, pad, block_size);
+
+	for (i = 0; i < block_size; i++)
+		pad[i] = 0x5c ^ k[i];
+	vb2_digest_init(&hk->outer, alg);
+	vb2_digest_extend(&hk->outer, pad, block_size);
+
+	return 0;
+}
+
+int hmac_init(struct vb2_hmac_context *ctx, const struct vb2_hmac_key *hk)
+{
+	if (!ctx || !hk)
+		return -1;
+
+	ctx->key = hk;
+	memcpy(&ctx->dc, &hk->inner, sizeof(ctx->dc));
+
+	return 0;
+}
+
+int hmac_update(struct vb2_hmac_context *ctx,
+		const void *msg, uint32_t msg_size)
+{
+	if (!ctx || !msg)
+		return -1;
+
+	return vb2_digest_extend(&ctx->dc, msg, msg_size);
+}
 
-	vb2_digest_init(&dc, alg);
-	vb2_digest_extend(&dc, i_pad, block_size);
-	vb2_digest_extend(&dc, msg, msg_size);
-	vb2_digest_finalize(&dc, b, digest_size);
+int hmac_final(struct vb2_hmac_context *ctx, uint8_t *mac, uint32_t mac_size)
+{
+	uint8_t b[VB2_MAX_DIGEST_SIZE];
+	uint32_t digest_size;
 
-	vb2_digest_init(&dc, alg);
-	vb2_digest_extend(&dc, o_pad, block_size);
-	vb2_digest_extend(&dc, b, digest_size);
-	vb2_digest_finalize(&dc, mac, mac_size);
+	if (!ctx || !mac)
+		return -1;
+
+	digest_size = vb2_digest_size(ctx->dc.hash_alg);
+	if (mac_size < digest_size)
+		return -1;
+
+	vb2_digest_finalize(&ctx->dc, b, digest_size);
+
+	memcpy(&ctx->dc, &ctx->key->outer, sizeof(ctx->dc));
+	vb2_digest_extend(&ctx->dc, b, digest_size);
+	vb2_digest_finalize(&ctx->dc, mac, mac_size);
 
 	return 0;
 }
+
+int hmac(enum vb2_hash_algorithm alg,
+	 const void *key, uint32_t key_size,
+	 const void *msg, uint32_t msg_size,
+	 uint8_t *mac, uint32_t mac_size)
+{
+	struct vb2_hmac_key hk;
+	struct vb2_hmac_context ctx;
+
+	if (!key | !msg | !mac)
+		return -1;
+
+	if (mac_size < vb2_digest_size(alg))
+		return -1;
+
+	if (hmac_key_init(&hk, alg, key, key_size) ||
+	    hmac_init(&ctx, &hk) ||
+	    hmac_update(&ctx, msg, msg_size))
+		return -1;
+
+	return hmac_final(&ctx, mac, mac_size);
+}
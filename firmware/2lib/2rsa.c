@@ -14,36 +14,211 @@
 #include "2rsa.h"
 #include "2sha.h"
 
+/*
+ * On 64-bit targets the compiler gives us 64x64->128 bit multiplies, so do
+ * the Montgomery arithmetic on 64-bit limbs.  That halves the number of
+ * inner loop iterations, and each one is about as fast as a 32-bit one.
+ */
+#if defined(__SIZEOF_INT128__) && !defined(VB2_RSA_LIMB32)
+#define VB2_RSA_LIMB64
+#endif
+
+/**
+ * Return a[] >= mod
+ */
+int vb2_mont_ge(const struct vb2_public_key *key, uint32_t *a)
+{
+	uint32_t i;
+	for (i = key->arrsize; i;) {
+		--i;
+		if (a[i] < key->n[i])
+			return 0;
+		if (a[i] > key->n[i])
+			return 1;
+	}
+	return 1;  /* equal */
+}
+
+#ifdef VB2_RSA_LIMB64
+
+typedef unsigned __int128 uint128_t;
+
+/* Number of 64-bit limbs in the key */
+static inline uint32_t limbs64(const struct vb2_public_key *key)
+{
+	return key->arrsize / 2;
+}
+
+/* Limb i of a key array; key arrays are only 32-bit aligned */
+static inline uint64_t key_limb64(const uint32_t *a, uint32_t i)
+{
+	return a[2 * i] | (uint64_t)a[2 * i + 1] << 32;
+}
+
+/**
+ * -1 / n[0] mod 2^64, extended from the key's 32-bit n0inv
+ */
+static uint64_t n0inv64(const struct vb2_public_key *key)
+{
+	uint64_t n0 = key_limb64(key->n, 0);
+	uint64_t inv = -(uint64_t)key->n0inv;  /* 1 / n0 mod 2^32 */
+
+	/* One Newton step doubles the number of correct bits */
+	inv *= 2 - n0 * inv;
+	return -inv;
+}
+
 /**
  * a[] -= mod
  */
-static void subM(const struct vb2_public_key *key, uint32_t *a)
+static void subM64(const struct vb2_public_key *key, uint64_t *a)
 {
-	int64_t A = 0;
+	uint64_t borrow = 0, t;
 	uint32_t i;
-	for (i = 0; i < key->arrsize; ++i) {
-		A += (uint64_t)a[i] - key->n[i];
-		a[i] = (uint32_t)A;
-		A >>= 32;
+
+	for (i = 0; i < limbs64(key); ++i) {
+		uint64_t n = key_limb64(key->n, i);
+
+		t = a[i] - n - borrow;
+		borrow = (a[i] < n) | ((a[i] == n) & borrow);
+		a[i] = t;
 	}
 }
 
 /**
  * Return a[] >= mod
  */
-int vb2_mont_ge(const struct vb2_public_key *key, uint32_t *a)
+static int mont_ge64(const struct vb2_public_key *key, const uint64_t *a)
 {
 	uint32_t i;
-	for (i = key->arrsize; i;) {
-		--i;
-		if (a[i] < key->n[i])
+
+	for (i = limbs64(key); i;) {
+		uint64_t n = key_limb64(key->n, --i);
+
+		if (a[i] < n)
 			return 0;
-		if (a[i] > key->n[i])
+		if (a[i] > n)
 			return 1;
 	}
 	return 1;  /* equal */
 }
 
+/**
+ * Montgomery c[] += a * b[] / R % mod
+ *
+ * b[] is a key array if b_is_key, else a 64-bit work array.
+ */
+static void montMulAdd64(const struct vb2_public_key *key,
+			 uint64_t n0inv,
+			 uint64_t *c,
+			 const uint64_t a,
+			 const void *b,
+			 int b_is_key)
+{
+	const uint64_t *b64 = b;
+	uint64_t bi = b_is_key ? key_limb64(b, 0) : b64[0];
+	uint128_t A = (uint128_t)a * bi + c[0];
+	uint64_t d0 = (uint64_t)A * n0inv;
+	uint128_t B = (uint128_t)d0 * key_limb64(key->n, 0) + (uint64_t)A;
+	uint32_t i;
+
+	for (i = 1; i < limbs64(key); ++i) {
+		bi = b_is_key ? key_limb64(b, i) : b64[i];
+		A = (A >> 64) + (uint128_t)a * bi + c[i];
+		B = (B >> 64) + (uint128_t)d0 * key_limb64(key->n, i) +
+			(uint64_t)A;
+		c[i - 1] = (uint64_t)B;
+	}
+
+	A = (A >> 64) + (B >> 64);
+
+	c[i - 1] = (uint64_t)A;
+
+	if (A >> 64)
+		subM64(key, c);
+}
+
+/**
+ * Montgomery c[] += 0 * b[] / R % mod
+ */
+static void montMulAdd064(const struct vb2_public_key *key,
+			  uint64_t n0inv,
+			  uint64_t *c)
+{
+	uint64_t d0 = c[0] * n0inv;
+	uint128_t B = (uint128_t)d0 * key_limb64(key->n, 0) + c[0];
+	uint32_t i;
+
+	for (i = 1; i < limbs64(key); ++i) {
+		B = (B >> 64) + (uint128_t)d0 * key_limb64(key->n, i) + c[i];
+		c[i - 1] = (uint64_t)B;
+	}
+
+	c[i - 1] = B >> 64;
+}
+
+/**
+ * Montgomery c[] = a[] * b[] / R % mod
+ */
+static void montMul64(const struct vb2_public_key *key,
+		      uint64_t n0inv,
+		      uint64_t *c,
+		      const uint64_t *a,
+		      const void *b,
+		      int b_is_key)
+{
+	uint32_t i;
+
+	for (i = 0; i < limbs64(key); ++i)
+		c[i] = 0;
+	for (i = 0; i < limbs64(key); ++i)
+		montMulAdd64(key, n0inv, c, a[i], b, b_is_key);
+}
+
+/* Montgomery c[] = a[] * 1 / R % key. */
+static void montMul164(const struct vb2_public_key *key,
+		       uint64_t n0inv,
+		       uint64_t *c,
+		       const uint64_t *a)
+{
+	uint32_t i;
+
+	for (i = 0; i < limbs64(key); ++i)
+		c[i] = 0;
+
+	montMulAdd64(key, n0inv, c, 1, a, 0);
+	for (i = 1; i < limbs64(key); ++i)
+		montMulAdd064(key, n0inv, c);
+}
+
+typedef uint64_t vb2_limb_t;
+typedef uint128_t vb2_dlimb_t;
+#define LIMB_BITS 64
+#define NLIMBS(key) limbs64(key)
+#define KEY_LIMB(a, i) key_limb64(a, i)
+#define SUB_MOD(key, a) subM64(key, a)
+#define N0INV(key) n0inv64(key)
+#define MONT_GE(key, a) mont_ge64(key, a)
+#define MONT_MUL(key, ninv, c, a, b) montMul64(key, ninv, c, a, b, 0)
+#define MONT_MUL_RR(key, ninv, c, a) montMul64(key, ninv, c, a, (key)->rr, 1)
+#define MONT_MUL1(key, ninv, c, a) montMul164(key, ninv, c, a)
+
+#else  /* !VB2_RSA_LIMB64 */
+
+/**
+ * a[] -= mod
+ */
+static void subM(const struct vb2_public_key *key, uint32_t *a)
+{
+	int64_t A = 0;
+	uint32_t i;
+	for (i = 0; i < key->arrsize; ++i) {
+		A += (uint64_t)a[i] - key->n[i];
+		a[i] = (uint32_t)A;
+		A >>= 32;
+	}
+}
+
 /**
  * Montgomery c[] += a * b[] / R % mod
  */
@@ -123,64 +298,274 @@ static void montMul1(const struct vb2_public_key *key,
 		montMulAdd0(key, c, a);
 }
 
+typedef uint32_t vb2_limb_t;
+typedef uint64_t vb2_dlimb_t;
+#define LIMB_BITS 32
+#define NLIMBS(key) ((key)->arrsize)
+#define KEY_LIMB(a, i) ((a)[i])
+#define SUB_MOD(key, a) subM(key, a)
+#define N0INV(key) ((key)->n0inv)
+#define MONT_GE(key, a) vb2_mont_ge(key, a)
+#define MONT_MUL(key, ninv, c, a, b) montMul(key, c, a, b)
+#define MONT_MUL_RR(key, ninv, c, a) montMul(key, c, a, (key)->rr)
+#define MONT_MUL1(key, ninv, c, a) montMul1(key, c, a)
+
+#endif  /* VB2_RSA_LIMB64 */
+
+/*
+ * Montgomery squaring.  Squaring needs only about half the limb products of
+ * a general multiply, since a[i] * a[j] == a[j] * a[i].
+ *
+ * This works a column at a time (product scanning): all the products which
+ * land in limb k of the square, and of the multiples of the modulus added to
+ * reduce it, are summed in a three-limb accumulator.  That keeps the inner
+ * loops free of stores to memory.
+ */
+
+/* Three-limb accumulator */
+struct mont_acc {
+	vb2_dlimb_t lo;
+	vb2_limb_t hi;
+};
+
+static inline __attribute__((always_inline))
+void acc_add(struct mont_acc *acc, vb2_dlimb_t p)
+{
+	acc->lo += p;
+	acc->hi += acc->lo < p;
+}
+
+/* Shift the accumulator right one limb, returning the limb shifted out */
+static inline __attribute__((always_inline))
+vb2_limb_t acc_shift(struct mont_acc *acc)
+{
+	vb2_limb_t out = (vb2_limb_t)acc->lo;
+
+	acc->lo = (acc->lo >> LIMB_BITS) | (vb2_dlimb_t)acc->hi << LIMB_BITS;
+	acc->hi = 0;
+	return out;
+}
+
+/*
+ * Add one column of the square of a[]: the products a[i] * a[j] with
+ * i + j == start + end.  Products with i != j appear twice in the column, so
+ * each is computed once and doubled.
+ */
+static inline __attribute__((always_inline))
+void acc_sqr_column(struct mont_acc *acc, const vb2_limb_t *a,
+		    uint32_t start, uint32_t end)
+{
+	struct mont_acc cross = {0, 0};
+	uint32_t i, j;
+
+	for (i = start, j = end; i < j; i++, j--)
+		acc_add(&cross, (vb2_dlimb_t)a[i] * a[j]);
+
+	/* Double the cross products; this can't overflow three limbs */
+	cross.hi = cross.hi << 1 |
+		(vb2_limb_t)(cross.lo >> (2 * LIMB_BITS - 1));
+	cross.lo <<= 1;
+	acc_add(acc, cross.lo);
+	acc->hi += cross.hi;
+
+	if (i == j)
+		acc_add(acc, (vb2_dlimb_t)a[i] * a[i]);
+}
+
+static inline __attribute__((always_inline))
+void mont_sqr_core(const struct vb2_public_key *key,
+		   vb2_limb_t ninv,
+		   vb2_limb_t *c,
+		   const vb2_limb_t *a,
+		   vb2_limb_t *m,
+		   const uint32_t n)
+{
+	struct mont_acc acc = {0, 0};
+	uint32_t j, k;
+
+	/* Low half: pick m[k] so that limb k of the sum is zero */
+	for (k = 0; k < n; k++) {
+		acc_sqr_column(&acc, a, 0, k);
+		for (j = 0; j < k; j++)
+			acc_add(&acc, (vb2_dlimb_t)m[j] *
+				KEY_LIMB(key->n, k - j));
+		m[k] = (vb2_limb_t)acc.lo * ninv;
+		acc_add(&acc, (vb2_dlimb_t)m[k] * KEY_LIMB(key->n, 0));
+		acc_shift(&acc);
+	}
+
+	/* High half is the result */
+	for (k = n; k < 2 * n; k++) {
+		acc_sqr_column(&acc, a, k - n + 1, n - 1);
+		for (j = k - n + 1; j < n; j++)
+			acc_add(&acc, (vb2_dlimb_t)m[j] *
+				KEY_LIMB(key->n, k - j));
+		c[k - n] = acc_shift(&acc);
+	}
+
+	/* Like montMul(), the result is only reduced below R, not below mod */
+	if (acc.lo)
+		SUB_MOD(key, c);
+}
+
+#ifdef CHROMEOS_ENVIRONMENT
+
+/*
+ * Copies with the key size fixed at compile time, so the compiler can unroll
+ * and schedule the loops.  Host only, since they cost code size.
+ */
+#define MONT_SQR_FIXED(bits)						\
+	static void montSqr##bits(const struct vb2_public_key *key,	\
+				  vb2_limb_t ninv, vb2_limb_t *c,	\
+				  const vb2_limb_t *a, vb2_limb_t *tmp)	\
+	{								\
+		mont_sqr_core(key, ninv, c, a, tmp, (bits) / LIMB_BITS); \
+	}
+
+MONT_SQR_FIXED(2048)
+MONT_SQR_FIXED(3072)
+MONT_SQR_FIXED(4096)
+MONT_SQR_FIXED(8192)
+
+/* Squaring implementation; see vb2_rsa_set_sqr_impl() */
+static enum vb2_rsa_sqr_impl sqr_impl;
+
+int vb2_rsa_set_sqr_impl(enum vb2_rsa_sqr_impl impl)
+{
+	if (impl >= VB2_RSA_SQR_COUNT)
+		return VB2_ERROR_RSA_VERIFY_PARAM;
+
+	sqr_impl = impl;
+	return VB2_SUCCESS;
+}
+
+#endif  /* CHROMEOS_ENVIRONMENT */
+
+static void montSqrGeneric(const struct vb2_public_key *key,
+			   vb2_limb_t ninv,
+			   vb2_limb_t *c,
+			   const vb2_limb_t *a,
+			   vb2_limb_t *tmp)
+{
+	mont_sqr_core(key, ninv, c, a, tmp, NLIMBS(key));
+}
+
+/**
+ * Montgomery c[] = a[] * a[] / R % mod
+ *
+ * @param key		Key
+ * @param ninv		-1 / n[0] mod 2^LIMB_BITS
+ * @param c		Destination
+ * @param a		Value to square
+ * @param tmp		Scratch space; same length as c[] and a[]
+ */
+static void montSqr(const struct vb2_public_key *key,
+		    vb2_limb_t ninv,
+		    vb2_limb_t *c,
+		    const vb2_limb_t *a,
+		    vb2_limb_t *tmp)
+{
+#ifdef CHROMEOS_ENVIRONMENT
+	if (sqr_impl == VB2_RSA_SQR_MUL) {
+		MONT_MUL(key, ninv, c, a, a);
+		return;
+	}
+	if (sqr_impl == VB2_RSA_SQR_FIXED) {
+		switch (key->arrsize * 32) {
+		case 2048:
+			montSqr2048(key, ninv, c, a, tmp);
+			return;
+		case 3072:
+			montSqr3072(key, ninv, c, a, tmp);
+			return;
+		case 4096:
+			montSqr4096(key, ninv, c, a, tmp);
+			return;
+		case 8192:
+			montSqr8192(key, ninv, c, a, tmp);
+			return;
+		}
+	}
+#endif
+
+	montSqrGeneric(key, ninv, c, a, tmp);
+}
+
+/* Convert from big endian byte array to little endian limb array. */
+static void load_limbs(const struct vb2_public_key *key, vb2_limb_t *a,
+		       const uint8_t *in)
+{
+	const uint32_t n = NLIMBS(key);
+	vb2_limb_t tmp;
+	int i, j;
+
+	for (i = 0; i < (int)n; ++i) {
+		const uint8_t *p = in + (n - 1 - i) * (LIMB_BITS / 8);
+
+		for (j = 0, tmp = 0; j < LIMB_BITS / 8; j++)
+			tmp = (tmp << 8) | p[j];
+		a[i] = tmp;
+	}
+}
+
 /**
  * In-place public exponentiation.
  *
+ * R = 2^(key bits) for either limb size, so the precomputed key->rr works
+ * with 64-bit limbs too.
+ *
  * @param key		Key to use in signing
  * @param inout		Input and output big-endian byte array
  * @param workbuf32	Work buffer; caller must verify this is
- *			(3 * key->arrsize) elements long.
+ *			(3 * key->arrsize) elements long, and aligned for
+ *			vb2_limb_t.
  * @param exp		RSA public exponent: either 65537 (F4) or 3
  */
 static void modpow(const struct vb2_public_key *key, uint8_t *inout,
 		uint32_t *workbuf32, int exp)
 {
-	uint32_t *a = workbuf32;
-	uint32_t *aR = a + key->arrsize;
-	uint32_t *aaR = aR + key->arrsize;
-	uint32_t *aaa = aaR;  /* Re-use location. */
-	int i;
-
-	/* Convert from big endian byte array to little endian word array. */
-	for (i = 0; i < (int)key->arrsize; ++i) {
-		uint32_t tmp =
-			(inout[((key->arrsize - 1 - i) * 4) + 0] << 24) |
-			(inout[((key->arrsize - 1 - i) * 4) + 1] << 16) |
-			(inout[((key->arrsize - 1 - i) * 4) + 2] << 8) |
-			(inout[((key->arrsize - 1 - i) * 4) + 3] << 0);
-		a[i] = tmp;
-	}
-
-	montMul(key, aR, a, key->rr);  /* aR = a * RR / R mod M   */
+	const uint32_t n = NLIMBS(key);
+	const vb2_limb_t ninv = N0INV(key);
+	vb2_limb_t *a = (vb2_limb_t *)workbuf32;
+	vb2_limb_t *aR = a + n;
+	vb2_limb_t *aaR = aR + n;
+	vb2_limb_t *aaa = aaR;  /* Re-use location. */
+	vb2_limb_t tmp;
+	int i, j;
+
+	load_limbs(key, a, inout);
+
+	MONT_MUL_RR(key, ninv, aR, a);  /* aR = a * RR / R mod M   */
 	if (exp == 3) {
-		montMul(key, aaR, aR, aR); /* aaR = aR * aR / R mod M */
-		montMul(key, a, aaR, aR); /* a = aaR * aR / R mod M */
-		montMul1(key, aaa, a); /* aaa = a * 1 / R mod M */
+		/* a is overwritten next, so use it as scratch space */
+		montSqr(key, ninv, aaR, aR, a);  /* aaR = aR * aR / R mod M */
+		MONT_MUL(key, ninv, a, aaR, aR);  /* a = aaR * aR / R mod M */
+		MONT_MUL1(key, ninv, aaa, a);  /* aaa = a * 1 / R mod M */
 	} else {
-		/* Exponent 65537 */
+		/*
+		 * Exponent 65537.  Use a as scratch space for the squarings
+		 * and reload it from inout afterwards.
+		 */
 		for (i = 0; i < 16; i+=2) {
-			montMul(key, aaR, aR, aR);  /* aaR = aR * aR / R mod M */
-			montMul(key, aR, aaR, aaR);  /* aR = aaR * aaR / R mod M */
+			montSqr(key, ninv, aaR, aR, a);  /* aaR = aR^2 / R */
+			montSqr(key, ninv, aR, aaR, a);  /* aR = aaR^2 / R */
 		}
-		montMul(key, aaa, aR, a);  /* aaa = aR * a / R mod M */
+		load_limbs(key, a, inout);
+		MONT_MUL(key, ninv, aaa, aR, a);  /* aaa = aR * a / R mod M */
 	}
 
 	/* Make sure aaa < mod; aaa is at most 1x mod too large. */
-	if (vb2_mont_ge(key, aaa)) {
-		subM(key, aaa);
-	}
+	if (MONT_GE(key, aaa))
+		SUB_MOD(key, aaa);
 
 	/* Convert to bigendian byte array */
-	for (i = (int)key->arrsize - 1; i >= 0; --i) {
-		uint32_t tmp = aaa[i];
-		*inout++ = (uint8_t)(tmp >> 24);
-		*inout++ = (uint8_t)(tmp >> 16);
-		*inout++ = (uint8_t)(tmp >>  8);
-		*inout++ = (uint8_t)(tmp >>  0);
+	for (i = (int)n - 1; i >= 0; --i) {
+		tmp = aaa[i];
+		for (j = LIMB_BITS - 8; j >= 0; j -= 8)
+			*inout++ = (uint8_t)(tmp >> j);
 	}
 }
 
-
 static const uint8_t crypto_to_sig[] = {
 	VB2_SIG_RSA1024,
 	VB2_SIG_RSA1024,
@@ -360,45 +745,53 @@ int vb2_check_padding(const uint8_t *sig, const struct vb2_public_key *key)
 	return result ? VB2_ERROR_RSA_PADDING : VB2_SUCCESS;
 }
 
-int vb2_rsa_verify_digest(const struct vb2_public_key *key,
-			  uint8_t *sig,
-			  const uint8_t *digest,
-			  const struct vb2_workbuf *wb)
+/**
+ * Check that a key can be used for verification.
+ *
+ * @param key		Key to check
+ * @param exp		Destination for the key's public exponent
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+static int rsa_check_key(const struct vb2_public_key *key, int *exp)
 {
-	struct vb2_workbuf wblocal = *wb;
-	uint32_t *workbuf32;
-	uint32_t key_bytes;
-	int sig_size;
-	int pad_size;
-	int exp;
-	int rv;
-
-	if (!key || !sig || !digest)
-		return VB2_ERROR_RSA_VERIFY_PARAM;
+	uint32_t sig_size = vb2_rsa_sig_size(key->sig_alg);
 
-	sig_size = vb2_rsa_sig_size(key->sig_alg);
-	exp = vb2_rsa_exponent(key->sig_alg);
-	if (!sig_size || !exp) {
+	*exp = vb2_rsa_exponent(key->sig_alg);
+	if (!sig_size || !*exp) {
 		VB2_DEBUG("Invalid signature type!\n");
 		return VB2_ERROR_RSA_VERIFY_ALGORITHM;
 	}
 
 	/* Signature length should be same as key length */
-	key_bytes = key->arrsize * sizeof(uint32_t);
-	if (key_bytes != sig_size) {
+	if (key->arrsize * sizeof(uint32_t) != sig_size) {
 		VB2_DEBUG("Signature is of incorrect length!\n");
 		return VB2_ERROR_RSA_VERIFY_SIG_LEN;
 	}
 
-	workbuf32 = vb2_workbuf_alloc(&wblocal, 3 * key_bytes);
-	if (!workbuf32) {
-		VB2_DEBUG("ERROR - vboot2 work buffer too small!\n");
-		return VB2_ERROR_RSA_VERIFY_WORKBUF;
-	}
+	return VB2_SUCCESS;
+}
 
-	modpow(key, sig, workbuf32, exp);
+/**
+ * Verify one signature with a key already checked by rsa_check_key().
+ *
+ * @param key		Key to use in signature verification
+ * @param sig		Signature to verify (destroyed in process)
+ * @param digest	Digest of signed data
+ * @param workbuf32	Work buffer of (3 * key->arrsize) elements
+ * @param exp		Key's public exponent
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+static int rsa_verify_one(const struct vb2_public_key *key,
+			  uint8_t *sig,
+			  const uint8_t *digest,
+			  uint32_t *workbuf32,
+			  int exp)
+{
+	uint32_t key_bytes = key->arrsize * sizeof(uint32_t);
+	int pad_size;
+	int rv;
 
-	vb2_workbuf_free(&wblocal, 3 * key_bytes);
+	modpow(key, sig, workbuf32, exp);
 
 	/*
 	 * Check padding.  Only fail immediately if the padding size is bad.
@@ -414,7 +807,7 @@ int vb2_rsa_verify_digest(const struct vb2_public_key *key,
 	 * use vb2_safe_memcmp() just to be on the safe side.  (That's also why
 	 * we don't return before this check if the padding check failed.)
 	 */
-	pad_size = sig_size - vb2_digest_size(key->hash_alg);
+	pad_size = key_bytes - vb2_digest_size(key->hash_alg);
 	if (vb2_safe_memcmp(sig + pad_size, digest, key_bytes - pad_size)) {
 		VB2_DEBUG("Digest check failed!\n");
 		if (!rv)
@@ -423,3 +816,79 @@ int vb2_rsa_verify_digest(const struct vb2_public_key *key,
 
 	return rv;
 }
+
+int vb2_rsa_verify_digest(const struct vb2_public_key *key,
+			  uint8_t *sig,
+			  const uint8_t *digest,
+			  const struct vb2_workbuf *wb)
+{
+	struct vb2_workbuf wblocal = *wb;
+	uint32_t *workbuf32;
+	uint32_t key_bytes;
+	int exp;
+	int rv;
+
+	if (!key || !sig || !digest)
+		return VB2_ERROR_RSA_VERIFY_PARAM;
+
+	rv = rsa_check_key(key, &exp);
+	if (rv)
+		return rv;
+
+	key_bytes = key->arrsize * sizeof(uint32_t);
+	workbuf32 = vb2_workbuf_alloc(&wblocal, 3 * key_bytes);
+	if (!workbuf32) {
+		VB2_DEBUG("ERROR - vboot2 work buffer too small!\n");
+		return VB2_ERROR_RSA_VERIFY_WORKBUF;
+	}
+
+	return rsa_verify_one(key, sig, digest, workbuf32, exp);
+}
+
+int vb2_rsa_verify_digests(const struct vb2_public_key *key,
+			   const struct vb2_rsa_verify_item *items,
+			   int *results,
+			   uint32_t count,
+			   const struct vb2_workbuf *wb)
+{
+	struct vb2_workbuf wblocal = *wb;
+	uint32_t *workbuf32;
+	uint32_t key_bytes;
+	uint32_t i;
+	int exp;
+	int rv, first_rv = VB2_SUCCESS;
+
+	if (!key || (count && (!items || !results)))
+		return VB2_ERROR_RSA_VERIFY_PARAM;
+
+	/* Checks which apply to every item are only done once */
+	rv = rsa_check_key(key, &exp);
+	if (!rv) {
+		key_bytes = key->arrsize * sizeof(uint32_t);
+		workbuf32 = vb2_workbuf_alloc(&wblocal, 3 * key_bytes);
+		if (!workbuf32) {
+			VB2_DEBUG("ERROR - vboot2 work buffer too small!\n");
+			rv = VB2_ERROR_RSA_VERIFY_WORKBUF;
+		}
+	}
+	if (rv) {
+		for (i = 0; i < count; i++)
+			results[i] = rv;
+		return rv;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!items[i].sig || !items[i].digest)
+			results[i] = VB2_ERROR_RSA_VERIFY_PARAM;
+		else
+			results[i] = rsa_verify_one(key, items[i].sig,
+						    items[i].digest,
+						    workbuf32, exp);
+		if (results[i] && !first_rv)
+			first_rv = results[i];
+	}
+
+	vb2_workbuf_free(&wblocal, 3 * key_bytes);
+
+	return first_rv;
+}
@@ -9,6 +9,7 @@
 #include "2sysincludes.h"
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 
 /*
  * Some machines lack byteswap.h and endian.h. These have to use the
@@ -36,7 +37,16 @@ static uint32_t ror31(uint32_t val)
 	return (val >> 31) | (val << 1);
 }
 
-static void sha1_transform(struct vb2_sha1_context *ctx)
+/* Load a big-endian word, which may not be aligned */
+static uint32_t load_be32(const uint8_t *p)
+{
+	uint32_t w;
+
+	memcpy(&w, p, sizeof(w));
+	return bswap_32(w);
+}
+
+static void sha1_transform_c(struct vb2_sha1_context *ctx, const uint8_t *p)
 {
 	/* Note that this array uses 80*4=320 bytes of stack */
 	uint32_t W[80];
@@ -51,7 +61,7 @@ static void sha1_transform(struct vb2_sha1_context *ctx)
 
 #define SHA_F1(A,B,C,D,E,t)				\
 	E += ror27(A) +					\
-		(W[t] = bswap_32(ctx->buf.w[t])) +	\
+		(W[t] = load_be32(p + 4 * (t))) +	\
 		(D^(B&(C^D))) + 0x5A827999;		\
 	B = ror2(B);
 
@@ -134,64 +144,18 @@ static void sha1_transform(struct vb2_sha1_context *ctx)
 	ctx->state[4] += E;
 }
 
-void vb2_sha1_update(struct vb2_sha1_context *ctx,
-		     const uint8_t *data,
-		     uint32_t size)
-{
-	int i = ctx->count % sizeof(ctx->buf);
-	const uint8_t *p = (const uint8_t*)data;
-
-	ctx->count += size;
-
-	while (size > sizeof(ctx->buf) - i) {
-		memcpy(&ctx->buf.b[i], p, sizeof(ctx->buf) - i);
-		size -= sizeof(ctx->buf) - i;
-		p += sizeof(ctx->buf) - i;
-		sha1_transform(ctx);
-		i = 0;
-	}
-
-	while (size--) {
-		ctx->buf.b[i++] = *p++;
-		if (i == sizeof(ctx->buf)) {
-			sha1_transform(ctx);
-			i = 0;
-		}
-	}
-}
-
-uint8_t *vb2_sha1_finalize(struct vb2_sha1_context *ctx)
-{
-	uint32_t cnt = ctx->count * 8;
-	int i;
-
-	vb2_sha1_update(ctx, (uint8_t*)"\x80", 1);
-	while ((ctx->count % sizeof(ctx->buf)) != (sizeof(ctx->buf) - 8)) {
-		vb2_sha1_update(ctx, (uint8_t*)"\0", 1);
-	}
-
-	for (i = 0; i < 8; ++i) {
-		uint8_t tmp = cnt >> ((7 - i) * 8);
-		vb2_sha1_update(ctx, &tmp, 1);
-	}
-
-	for (i = 0; i < 5; i++) {
-		ctx->buf.w[i] = bswap_32(ctx->state[i]);
-	}
-
-	return ctx->buf.b;
-}
+/* The block buffer, as bytes */
+#define SHA1_BUF(ctx) ((ctx)->buf.b)
 
 #else   /* #if defined(HAVE_ENDIAN_H) && defined(HAVE_LITTLE_ENDIAN) */
 
 #define rol(bits, value) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
-static void sha1_transform(struct vb2_sha1_context *ctx)
+static void sha1_transform_c(struct vb2_sha1_context *ctx, const uint8_t *p)
 {
 	/* Note that this array uses 80*4=320 bytes of stack */
 	uint32_t W[80];
 	uint32_t A, B, C, D, E;
-	uint8_t *p = ctx->buf;
 	int t;
 
 	for(t = 0; t < 16; ++t) {
@@ -238,27 +202,66 @@ static void sha1_transform(struct vb2_sha1_context *ctx)
 	ctx->state[4] += E;
 }
 
+#define SHA1_BUF(ctx) ((ctx)->buf)
+
+#endif /* endianness */
+
+static void sha1_transform(struct vb2_sha1_context *ctx,
+			   const uint8_t *data,
+			   unsigned int block_nb)
+{
+	if (!block_nb)
+		return;
+
+#ifdef VB2_SHA_X86
+	if (vb2_sha1_get_backend() == VB2_SHA_BACKEND_SHA_NI) {
+		vb2_sha1_transform_shani(ctx->state, data, block_nb);
+		return;
+	}
+#endif
+
+	for (; block_nb; block_nb--, data += VB2_SHA1_BLOCK_SIZE)
+		sha1_transform_c(ctx, data);
+}
+
 void vb2_sha1_update(struct vb2_sha1_context *ctx,
 		     const uint8_t *data,
 		     uint32_t size)
 {
 	int i = (int)(ctx->count % sizeof(ctx->buf));
 	const uint8_t* p = (const uint8_t*) data;
+	uint32_t n;
 
 	ctx->count += size;
 
-	while (size--) {
-		ctx->buf[i++] = *p++;
-		if (i == sizeof(ctx->buf)) {
-			sha1_transform(ctx);
-			i = 0;
-		}
+	/* Top up a partial block left over from the last update */
+	if (i) {
+		n = sizeof(ctx->buf) - i;
+		if (n > size)
+			n = size;
+		memcpy(SHA1_BUF(ctx) + i, p, n);
+		p += n;
+		size -= n;
+		i += n;
+		if (i < sizeof(ctx->buf))
+			return;
+		sha1_transform(ctx, SHA1_BUF(ctx), 1);
 	}
+
+	/* Hash whole blocks straight from the input */
+	n = size / VB2_SHA1_BLOCK_SIZE;
+	sha1_transform(ctx, p, n);
+	p += n * VB2_SHA1_BLOCK_SIZE;
+	size -= n * VB2_SHA1_BLOCK_SIZE;
+
+	memcpy(SHA1_BUF(ctx), p, size);
 }
 
-void vb2_sha1_finalize(struct vb2_sha1_context *ctx, uint8_t *digest)
+void vb2_sha1_finalize_size(struct vb2_sha1_context *ctx,
+			    uint8_t *digest,
+			    uint64_t size)
 {
-	uint32_t cnt = ctx->count << 3;
+	uint64_t cnt = size << 3;
 	int i;
 
 	vb2_sha1_update(ctx, (uint8_t*)"\x80", 1);
@@ -266,7 +269,7 @@ void vb2_sha1_finalize(struct vb2_sha1_context *ctx, uint8_t *digest)
 		vb2_sha1_update(ctx, (uint8_t*)"\0", 1);
 	}
 	for (i = 0; i < 8; ++i) {
-		uint8_t tmp = (uint8_t)((uint64_t)cnt >> ((7 - i) * 8));
+		uint8_t tmp = (uint8_t)(cnt >> ((7 - i) * 8));
 		vb2_sha1_update(ctx, &tmp, 1);
 	}
 
@@ -279,7 +282,48 @@ void vb2_sha1_finalize(struct vb2_sha1_context *ctx, uint8_t *digest)
 	}
 }
 
-#endif /* endianness */
+void vb2_sha1_finalize(struct vb2_sha1_context *ctx, uint8_t *digest)
+{
+	vb2_sha1_finalize_size(ctx, digest, ctx->count);
+}
+
+#ifdef VB2_SHA_X86
+/* Backend in use; resolved on first use if VB2_SHA_BACKEND_AUTO */
+static enum vb2_sha_backend sha1_backend;
+#endif
+
+int vb2_sha1_set_backend(enum vb2_sha_backend backend)
+{
+	switch (backend) {
+	case VB2_SHA_BACKEND_AUTO:
+	case VB2_SHA_BACKEND_C:
+		break;
+#ifdef VB2_SHA_X86
+	case VB2_SHA_BACKEND_SHA_NI:
+		if (vb2_sha_x86_supported(VB2_HASH_SHA1, backend))
+			break;
+		return VB2_ERROR_SHA_BACKEND_UNSUPPORTED;
+#endif
+	default:
+		return VB2_ERROR_SHA_BACKEND_UNSUPPORTED;
+	}
+
+#ifdef VB2_SHA_X86
+	sha1_backend = backend;
+#endif
+	return VB2_SUCCESS;
+}
+
+enum vb2_sha_backend vb2_sha1_get_backend(void)
+{
+#ifdef VB2_SHA_X86
+	if (sha1_backend == VB2_SHA_BACKEND_AUTO)
+		sha1_backend = vb2_sha_x86_best(VB2_HASH_SHA1);
+	return sha1_backend;
+#else
+	return VB2_SHA_BACKEND_C;
+#endif
+}
 
 void vb2_sha1_init(struct vb2_sha1_context *ctx)
 {
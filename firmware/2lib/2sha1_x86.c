@@ -0,0 +1,89 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * SHA-1 compression function using x86 SHA extensions.  Only built for host
+ * utilities; selected at runtime by vb2_sha1_get_backend().
+ */
+
+#include <immintrin.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+#define TARGET_SHANI __attribute__((target("sha,sse4.1,ssse3")))
+
+/* Four rounds; sha1rnds4 needs the round function as an immediate. */
+static inline __m128i TARGET_SHANI sha1_rounds4(__m128i abcd, __m128i e,
+						int group)
+{
+	switch (group / 5) {
+	case 0:
+		return _mm_sha1rnds4_epu32(abcd, e, 0);
+	case 1:
+		return _mm_sha1rnds4_epu32(abcd, e, 1);
+	case 2:
+		return _mm_sha1rnds4_epu32(abcd, e, 2);
+	default:
+		return _mm_sha1rnds4_epu32(abcd, e, 3);
+	}
+}
+
+void TARGET_SHANI vb2_sha1_transform_shani(uint32_t *state,
+					   const uint8_t *data,
+					   unsigned int block_nb)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL,
+					     0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e0, e0_save, e, e_next;
+	__m128i msg[4];
+	int i;
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state),
+				 0x1B);
+	e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+	for (; block_nb; block_nb--, data += VB2_SHA1_BLOCK_SIZE) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		for (i = 0; i < 4; i++)
+			msg[i] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)
+						(data + 16 * i)), bswap);
+
+		/* 20 groups of 4 rounds */
+		e = _mm_add_epi32(e0, msg[0]);
+		e_next = abcd;
+		abcd = sha1_rounds4(abcd, e, 0);
+
+		for (i = 1; i < 20; i++) {
+			__m128i *cur = &msg[i & 3];
+
+			e = _mm_sha1nexte_epu32(e_next, *cur);
+			e_next = abcd;
+
+			/* Message schedule for groups i + 1 to i + 3 */
+			if (i >= 3 && i < 19)
+				msg[(i + 1) & 3] = _mm_sha1msg2_epu32(
+					msg[(i + 1) & 3], *cur);
+
+			abcd = sha1_rounds4(abcd, e, i);
+
+			if (i < 17)
+				msg[(i + 3) & 3] = _mm_sha1msg1_epu32(
+					msg[(i + 3) & 3], *cur);
+			if (i >= 2 && i < 18)
+				msg[(i + 2) & 3] = _mm_xor_si128(
+					msg[(i + 2) & 3], *cur);
+		}
+
+		e0 = _mm_sha1nexte_epu32(e_next, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = _mm_extract_epi32(e0, 3);
+}
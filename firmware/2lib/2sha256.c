@@ -38,6 +38,7 @@
 #include "2sysincludes.h"
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 
 #define SHFR(x, n)    (x >> n)
 #define ROTR(x, n)   ((x >> n) | (x << ((sizeof(x) << 3) - n)))
@@ -77,7 +78,7 @@
 #define SHA256_EXP(a, b, c, d, e, f, g, h, j)				\
 	{								\
 		t1 = wv[h] + SHA256_F2(wv[e]) + CH(wv[e], wv[f], wv[g]) \
-			+ sha256_k[j] + w[j];				\
+			+ vb2_sha256_k[j] + w[j];			\
 		t2 = SHA256_F1(wv[a]) + MAJ(wv[a], wv[b], wv[c]);       \
 		wv[d] += t1;                                            \
 		wv[h] = t1 + t2;                                        \
@@ -88,7 +89,7 @@ static const uint32_t sha256_h0[8] = {
 	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
 };
 
-static const uint32_t sha256_k[64] = {
+const uint32_t vb2_sha256_k[64] = {
 	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
 	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
 	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
@@ -126,9 +127,87 @@ void vb2_sha256_init(struct vb2_sha256_context *ctx)
 	ctx->total_size = 0;
 }
 
-static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
-				 const uint8_t *message,
-				 unsigned int block_nb)
+#ifdef VB2_SHA_X86
+/* Backend in use; resolved on first use if VB2_SHA_BACKEND_AUTO */
+static enum vb2_sha_backend sha256_backend;
+#endif
+
+int vb2_sha256_set_backend(enum vb2_sha_backend backend)
+{
+	switch (backend) {
+	case VB2_SHA_BACKEND_AUTO:
+	case VB2_SHA_BACKEND_C:
+		break;
+#ifdef VB2_SHA_X86
+	case VB2_SHA_BACKEND_AVX2:
+	case VB2_SHA_BACKEND_SHA_NI:
+		if (vb2_sha_x86_supported(VB2_HASH_SHA256, backend))
+			break;
+		return VB2_ERROR_SHA_BACKEND_UNSUPPORTED;
+#endif
+	default:
+		return VB2_ERROR_SHA_BACKEND_UNSUPPORTED;
+	}
+
+#ifdef VB2_SHA_X86
+	sha256_backend = backend;
+#endif
+	return VB2_SUCCESS;
+}
+
+enum vb2_sha_backend vb2_sha256_get_backend(void)
+{
+#ifdef VB2_SHA_X86
+	if (sha256_backend == VB2_SHA_BACKEND_AUTO)
+		sha256_backend = vb2_sha_x86_best(VB2_HASH_SHA256);
+	return sha256_backend;
+#else
+	return VB2_SHA_BACKEND_C;
+#endif
+}
+
+#ifdef VB2_SHA_X86
+/* Backend used by vb2_digest_buffers() */
+static enum vb2_sha_backend sha256_multi_backend;
+#endif
+
+int vb2_sha256_set_multi_backend(enum vb2_sha_backend backend)
+{
+	switch (backend) {
+	case VB2_SHA_BACKEND_AUTO:
+	case VB2_SHA_BACKEND_C:
+		break;
+#ifdef VB2_SHA_X86
+	case VB2_SHA_BACKEND_AVX2:
+	case VB2_SHA_BACKEND_AVX512:
+		if (vb2_sha_x86_supported(VB2_HASH_SHA256, backend))
+			break;
+		return VB2_ERROR_SHA_BACKEND_UNSUPPORTED;
+#endif
+	default:
+		return VB2_ERROR_SHA_BACKEND_UNSUPPORTED;
+	}
+
+#ifdef VB2_SHA_X86
+	sha256_multi_backend = backend;
+#endif
+	return VB2_SUCCESS;
+}
+
+enum vb2_sha_backend vb2_sha256_get_multi_backend(void)
+{
+#ifdef VB2_SHA_X86
+	if (sha256_multi_backend == VB2_SHA_BACKEND_AUTO)
+		sha256_multi_backend = vb2_sha_x86_best_multi();
+	return sha256_multi_backend;
+#else
+	return VB2_SHA_BACKEND_C;
+#endif
+}
+
+static void vb2_sha256_transform_c(struct vb2_sha256_context *ctx,
+				   const uint8_t *message,
+				   unsigned int block_nb)
 {
 	/* Note that these arrays use 72*4=288 bytes of stack */
 	uint32_t w[64];
@@ -159,7 +238,7 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 
 		for (j = 0; j < 64; j++) {
 			t1 = wv[7] + SHA256_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
-				+ sha256_k[j] + w[j];
+				+ vb2_sha256_k[j] + w[j];
 			t2 = SHA256_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
 			wv[7] = wv[6];
 			wv[6] = wv[5];
@@ -243,6 +322,29 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 	}
 }
 
+static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
+				 const uint8_t *message,
+				 unsigned int block_nb)
+{
+	if (!block_nb)
+		return;
+
+#ifdef VB2_SHA_X86
+	switch (vb2_sha256_get_backend()) {
+	case VB2_SHA_BACKEND_SHA_NI:
+		vb2_sha256_transform_shani(ctx->h, message, block_nb);
+		return;
+	case VB2_SHA_BACKEND_AVX2:
+		vb2_sha256_transform_avx2(ctx->h, message, block_nb);
+		return;
+	default:
+		break;
+	}
+#endif
+
+	vb2_sha256_transform_c(ctx, message, block_nb);
+}
+
 void vb2_sha256_update(struct vb2_sha256_context *ctx,
 		       const uint8_t *data,
 		       uint32_t size)
@@ -278,11 +380,13 @@ void vb2_sha256_update(struct vb2_sha256_context *ctx,
 	ctx->total_size += (block_nb + 1) << 6;
 }
 
-void vb2_sha256_finalize(struct vb2_sha256_context *ctx, uint8_t *digest)
+void vb2_sha256_finalize_size(struct vb2_sha256_context *ctx,
+			      uint8_t *digest,
+			      uint64_t size)
 {
 	unsigned int block_nb;
 	unsigned int pm_size;
-	unsigned int size_b;
+	uint64_t size_b;
 #ifndef UNROLL_LOOPS
 	int i;
 #endif
@@ -290,12 +394,13 @@ void vb2_sha256_finalize(struct vb2_sha256_context *ctx, uint8_t *digest)
 	block_nb = (1 + ((VB2_SHA256_BLOCK_SIZE - 9)
 			 < (ctx->size % VB2_SHA256_BLOCK_SIZE)));
 
-	size_b = (ctx->total_size + ctx->size) << 3;
+	size_b = size << 3;
 	pm_size = block_nb << 6;
 
 	memset(ctx->block + ctx->size, 0, pm_size - ctx->size);
 	ctx->block[ctx->size] = 0x80;
-	UNPACK32(size_b, ctx->block + pm_size - 4);
+	UNPACK32((uint32_t)(size_b >> 32), ctx->block + pm_size - 8);
+	UNPACK32((uint32_t)size_b, ctx->block + pm_size - 4);
 
 	vb2_sha256_transform(ctx, ctx->block, block_nb);
 
@@ -315,6 +420,12 @@ void vb2_sha256_finalize(struct vb2_sha256_context *ctx, uint8_t *digest)
 #endif /* !UNROLL_LOOPS */
 }
 
+void vb2_sha256_finalize(struct vb2_sha256_context *ctx, uint8_t *digest)
+{
+	vb2_sha256_finalize_size(ctx, digest,
+				 (uint64_t)ctx->total_size + ctx->size);
+}
+
 void vb2_sha256_extend(const uint8_t *from, const uint8_t *by, uint8_t *to)
 {
 	struct vb2_sha256_context dc;
@@ -0,0 +1,343 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Multi-buffer SHA-256 for x86-64 hosts.  Each SIMD lane hashes a different
+ * buffer: 8 lanes with AVX2, 16 with AVX-512.  When a lane's buffer is done
+ * the next pending buffer is started in that lane, so buffers of different
+ * sizes keep all lanes busy.
+ */
+
+#include <immintrin.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx2")))
+
+#define MB_MAX_LANES 16
+
+/* Hash state for all lanes; word i of lane j is state[i][j] */
+typedef uint32_t mb_state_t[8][MB_MAX_LANES];
+
+/* Processes one block in every lane */
+typedef void (*mb_kernel_t)(mb_state_t state, const uint8_t * const *blocks);
+
+struct mb_lane {
+	/* Next whole block of input, and number of whole blocks left */
+	const uint8_t *data;
+	uint32_t blocks;
+
+	/* Next padded final block, and number of those left */
+	const uint8_t *tail_next;
+	uint32_t tail_blocks;
+
+	/* Index of the buffer being hashed in this lane */
+	uint32_t job;
+	int active;
+
+	uint8_t tail[2 * VB2_SHA256_BLOCK_SIZE];
+};
+
+static const uint32_t sha256_h0[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/* Fed to lanes which have run out of buffers; the result is discarded */
+static const uint8_t idle_block[VB2_SHA256_BLOCK_SIZE];
+
+/*
+ * AVX2 kernel: 8 lanes.  The rounds are the textbook ones with each variable
+ * holding the same word for all lanes.
+ */
+
+#define ROR_256(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), \
+				      _mm256_slli_epi32(x, 32 - (n)))
+#define XOR3_256(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+
+static void TARGET_AVX2 sha256_x8_block(mb_state_t state,
+					const uint8_t * const *blocks)
+{
+	const __m256i bswap = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	__m256i v[8], w[16], r[8], t[8], u[8];
+	__m256i t1, t2, s0, s1;
+	int i, j;
+
+	for (i = 0; i < 8; i++)
+		v[i] = _mm256_loadu_si256((const __m256i *)state[i]);
+
+	/* Load and transpose so w[j] holds message word j of every lane */
+	for (j = 0; j < 16; j += 8) {
+		for (i = 0; i < 8; i++)
+			r[i] = _mm256_shuffle_epi8(_mm256_loadu_si256(
+				(const __m256i *)(blocks[i] + 4 * j)), bswap);
+
+		for (i = 0; i < 8; i += 2) {
+			t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+			t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+		}
+		for (i = 0; i < 8; i += 4) {
+			u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+			u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+			u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+			u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+		}
+		for (i = 0; i < 4; i++) {
+			w[j + i] = _mm256_permute2x128_si256(u[i], u[i + 4],
+							     0x20);
+			w[j + i + 4] = _mm256_permute2x128_si256(u[i],
+								 u[i + 4],
+								 0x31);
+		}
+	}
+
+	/* v[0..7] are a..h */
+	for (j = 0; j < 64; j++) {
+		if (j >= 16) {
+			__m256i w2 = w[(j - 2) & 15], w15 = w[(j - 15) & 15];
+
+			s0 = XOR3_256(ROR_256(w15, 7), ROR_256(w15, 18),
+				      _mm256_srli_epi32(w15, 3));
+			s1 = XOR3_256(ROR_256(w2, 17), ROR_256(w2, 19),
+				      _mm256_srli_epi32(w2, 10));
+			w[j & 15] = _mm256_add_epi32(
+				_mm256_add_epi32(w[j & 15], s0),
+				_mm256_add_epi32(w[(j - 7) & 15], s1));
+		}
+
+		s1 = XOR3_256(ROR_256(v[4], 6), ROR_256(v[4], 11),
+			      ROR_256(v[4], 25));
+		t1 = _mm256_xor_si256(_mm256_and_si256(v[4], v[5]),
+				      _mm256_andnot_si256(v[4], v[6]));
+		t1 = _mm256_add_epi32(_mm256_add_epi32(v[7], s1),
+				      _mm256_add_epi32(t1, w[j & 15]));
+		t1 = _mm256_add_epi32(t1, _mm256_set1_epi32(vb2_sha256_k[j]));
+
+		s0 = XOR3_256(ROR_256(v[0], 2), ROR_256(v[0], 13),
+			      ROR_256(v[0], 22));
+		t2 = _mm256_or_si256(_mm256_and_si256(v[0], v[1]),
+				     _mm256_and_si256(v[2], _mm256_or_si256(
+							v[0], v[1])));
+		t2 = _mm256_add_epi32(s0, t2);
+
+		v[7] = v[6];
+		v[6] = v[5];
+		v[5] = v[4];
+		v[4] = _mm256_add_epi32(v[3], t1);
+		v[3] = v[2];
+		v[2] = v[1];
+		v[1] = v[0];
+		v[0] = _mm256_add_epi32(t1, t2);
+	}
+
+	for (i = 0; i < 8; i++)
+		_mm256_storeu_si256((__m256i *)state[i], _mm256_add_epi32(
+			v[i], _mm256_loadu_si256((const __m256i *)state[i])));
+}
+
+/*
+ * AVX-512 kernel: 16 lanes.  Message words are gathered straight from the
+ * lanes' blocks, and rotates and three-input logic functions are single
+ * instructions.
+ */
+
+static void TARGET_AVX512 sha256_x16_block(mb_state_t state,
+					   const uint8_t * const *blocks)
+{
+	const __m256i bswap = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	__m512i v[8], w[16];
+	__m512i t1, t2, s0, s1;
+	__m512i addr_lo, addr_hi, four;
+	__m256i lo, hi;
+	int i, j;
+
+	for (i = 0; i < 8; i++)
+		v[i] = _mm512_loadu_si512(state[i]);
+
+	addr_lo = _mm512_loadu_si512(blocks);
+	addr_hi = _mm512_loadu_si512(blocks + 8);
+	four = _mm512_set1_epi64(4);
+	for (j = 0; j < 16; j++) {
+		lo = _mm512_i64gather_epi32(addr_lo, NULL, 1);
+		hi = _mm512_i64gather_epi32(addr_hi, NULL, 1);
+		w[j] = _mm512_inserti64x4(_mm512_castsi256_si512(
+			_mm256_shuffle_epi8(lo, bswap)),
+			_mm256_shuffle_epi8(hi, bswap), 1);
+		addr_lo = _mm512_add_epi64(addr_lo, four);
+		addr_hi = _mm512_add_epi64(addr_hi, four);
+	}
+
+	for (j = 0; j < 64; j++) {
+		if (j >= 16) {
+			__m512i w2 = w[(j - 2) & 15], w15 = w[(j - 15) & 15];
+
+			s0 = _mm512_ternarylogic_epi32(
+				_mm512_ror_epi32(w15, 7),
+				_mm512_ror_epi32(w15, 18),
+				_mm512_srli_epi32(w15, 3), 0x96);
+			s1 = _mm512_ternarylogic_epi32(
+				_mm512_ror_epi32(w2, 17),
+				_mm512_ror_epi32(w2, 19),
+				_mm512_srli_epi32(w2, 10), 0x96);
+			w[j & 15] = _mm512_add_epi32(
+				_mm512_add_epi32(w[j & 15], s0),
+				_mm512_add_epi32(w[(j - 7) & 15], s1));
+		}
+
+		/* 0x96 = x ^ y ^ z, 0xCA = CH, 0xE8 = MAJ */
+		s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(v[4], 6),
+					       _mm512_ror_epi32(v[4], 11),
+					       _mm512_ror_epi32(v[4], 25),
+					       0x96);
+		t1 = _mm512_ternarylogic_epi32(v[4], v[5], v[6], 0xCA);
+		t1 = _mm512_add_epi32(_mm512_add_epi32(v[7], s1),
+				      _mm512_add_epi32(t1, w[j & 15]));
+		t1 = _mm512_add_epi32(t1, _mm512_set1_epi32(vb2_sha256_k[j]));
+
+		s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(v[0], 2),
+					       _mm512_ror_epi32(v[0], 13),
+					       _mm512_ror_epi32(v[0], 22),
+					       0x96);
+		t2 = _mm512_ternarylogic_epi32(v[0], v[1], v[2], 0xE8);
+		t2 = _mm512_add_epi32(s0, t2);
+
+		v[7] = v[6];
+		v[6] = v[5];
+		v[5] = v[4];
+		v[4] = _mm512_add_epi32(v[3], t1);
+		v[3] = v[2];
+		v[2] = v[1];
+		v[1] = v[0];
+		v[0] = _mm512_add_epi32(t1, t2);
+	}
+
+	for (i = 0; i < 8; i++)
+		_mm512_storeu_si512(state[i], _mm512_add_epi32(
+			v[i], _mm512_loadu_si512(state[i])));
+}
+
+/* Start hashing buffer job in lane n. */
+static void mb_lane_start(struct mb_lane *lane, mb_state_t state, int n,
+			  const uint8_t *buf, uint32_t size, uint32_t job)
+{
+	uint32_t rem = size % VB2_SHA256_BLOCK_SIZE;
+	uint64_t bits = (uint64_t)size << 3;
+	uint8_t *end;
+	int i;
+
+	lane->data = buf;
+	lane->blocks = size / VB2_SHA256_BLOCK_SIZE;
+	lane->tail_next = lane->tail;
+	lane->tail_blocks = rem + 9 > VB2_SHA256_BLOCK_SIZE ? 2 : 1;
+	lane->job = job;
+	lane->active = 1;
+
+	/* Build the padded final block(s) */
+	memset(lane->tail, 0, sizeof(lane->tail));
+	memcpy(lane->tail, buf + size - rem, rem);
+	lane->tail[rem] = 0x80;
+	end = lane->tail + lane->tail_blocks * VB2_SHA256_BLOCK_SIZE;
+	for (i = 1; i <= 8; i++, bits >>= 8)
+		end[-i] = (uint8_t)bits;
+
+	for (i = 0; i < 8; i++)
+		state[i][n] = sha256_h0[i];
+}
+
+/* Store the digest for lane n. */
+static void mb_lane_finish(mb_state_t state, int n, uint8_t *digest)
+{
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		digest[4 * i + 0] = (uint8_t)(state[i][n] >> 24);
+		digest[4 * i + 1] = (uint8_t)(state[i][n] >> 16);
+		digest[4 * i + 2] = (uint8_t)(state[i][n] >> 8);
+		digest[4 * i + 3] = (uint8_t)state[i][n];
+	}
+}
+
+void vb2_sha256_multi_x86(const uint8_t * const *bufs,
+			  const uint32_t *sizes,
+			  uint32_t count,
+			  uint8_t *digests,
+			  uint32_t stride,
+			  enum vb2_sha_backend backend)
+{
+	struct mb_lane lanes[MB_MAX_LANES];
+	mb_state_t state __attribute__((aligned(64)));
+	const uint8_t *blocks[MB_MAX_LANES];
+	mb_kernel_t kernel;
+	uint32_t next = 0;
+	int num_lanes, busy = 0;
+	int i;
+
+	if (backend == VB2_SHA_BACKEND_AVX512) {
+		kernel = sha256_x16_block;
+		num_lanes = 16;
+	} else {
+		kernel = sha256_x8_block;
+		num_lanes = 8;
+	}
+
+	for (i = 0; i < num_lanes; i++) {
+		lanes[i].active = 0;
+		if (next < count) {
+			mb_lane_start(&lanes[i], state, i, bufs[next],
+				      sizes[next], next);
+			next++;
+			busy++;
+		}
+	}
+
+	while (busy) {
+		for (i = 0; i < num_lanes; i++) {
+			struct mb_lane *lane = &lanes[i];
+
+			if (!lane->active)
+				blocks[i] = idle_block;
+			else if (lane->blocks)
+				blocks[i] = lane->data;
+			else
+				blocks[i] = lane->tail_next;
+		}
+
+		kernel(state, blocks);
+
+		for (i = 0; i < num_lanes; i++) {
+			struct mb_lane *lane = &lanes[i];
+
+			if (!lane->active)
+				continue;
+
+			if (lane->blocks) {
+				lane->blocks--;
+				lane->data += VB2_SHA256_BLOCK_SIZE;
+				continue;
+			}
+
+			lane->tail_next += VB2_SHA256_BLOCK_SIZE;
+			if (--lane->tail_blocks)
+				continue;
+
+			/* This buffer is done; start the next one */
+			mb_lane_finish(state, i, digests + lane->job * stride);
+			lane->active = 0;
+			busy--;
+			if (next < count) {
+				mb_lane_start(lane, state, i, bufs[next],
+					      sizes[next], next);
+				next++;
+				busy++;
+			}
+		}
+	}
+}
@@ -0,0 +1,220 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * SHA-256 compression functions using x86 SHA extensions and AVX2.  These are
+ * only built for host utilities and are selected at runtime by
+ * vb2_sha256_get_backend(), so each function carries its own target attribute
+ * instead of relying on global -m flags.
+ */
+
+#include <immintrin.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+#define TARGET_SHANI __attribute__((target("sha,sse4.1,ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2,bmi2")))
+
+/*
+ * SHA extensions: each sha256rnds2 does two rounds, and sha256msg1/msg2
+ * compute the message schedule four words at a time.  The state is kept as
+ * ABEF/CDGH as the instructions expect.
+ */
+void TARGET_SHANI vb2_sha256_transform_shani(uint32_t *h,
+					     const uint8_t *data,
+					     unsigned int block_nb)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i state0, state1, abef_save, cdgh_save;
+	__m128i msg[4], wk, tmp;
+	int i;
+
+	/* Load state and reorder from ABCD/EFGH to ABEF/CDGH */
+	tmp = _mm_loadu_si128((const __m128i *)&h[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&h[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);
+	state1 = _mm_shuffle_epi32(state1, 0x1B);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	for (; block_nb; block_nb--, data += VB2_SHA256_BLOCK_SIZE) {
+		abef_save = state0;
+		cdgh_save = state1;
+
+		for (i = 0; i < 4; i++)
+			msg[i] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)
+						(data + 16 * i)), bswap);
+
+		/* 16 groups of 4 rounds */
+		for (i = 0; i < 16; i++) {
+			__m128i *cur = &msg[i & 3];
+
+			wk = _mm_add_epi32(*cur, _mm_loadu_si128(
+				(const __m128i *)&vb2_sha256_k[4 * i]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+
+			/* Finish the schedule for the next group */
+			if (i >= 3 && i < 15) {
+				__m128i *next = &msg[(i + 1) & 3];
+
+				tmp = _mm_alignr_epi8(*cur, msg[(i + 3) & 3],
+						      4);
+				*next = _mm_add_epi32(*next, tmp);
+				*next = _mm_sha256msg2_epu32(*next, *cur);
+			}
+
+			wk = _mm_shuffle_epi32(wk, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+
+			/* Start the schedule for the group after next */
+			if (i >= 1 && i < 13) {
+				__m128i *prev = &msg[(i + 3) & 3];
+
+				*prev = _mm_sha256msg1_epu32(*prev, *cur);
+			}
+		}
+
+		state0 = _mm_add_epi32(state0, abef_save);
+		state1 = _mm_add_epi32(state1, cdgh_save);
+	}
+
+	/* Reorder back to ABCD/EFGH and store */
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i *)&h[0], state0);
+	_mm_storeu_si128((__m128i *)&h[4], state1);
+}
+
+/*
+ * AVX2: the message schedule for two consecutive blocks is computed at once,
+ * one block per 128-bit lane, then the rounds run as scalar code using the
+ * precomputed W + K values.
+ */
+
+#define ROR32_V(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), \
+				      _mm256_slli_epi32(x, 32 - (n)))
+#define SIGMA0_V(x) _mm256_xor_si256(_mm256_xor_si256(ROR32_V(x, 7), \
+				ROR32_V(x, 18)), _mm256_srli_epi32(x, 3))
+#define SIGMA1_V(x) _mm256_xor_si256(_mm256_xor_si256(ROR32_V(x, 17), \
+				ROR32_V(x, 19)), _mm256_srli_epi32(x, 10))
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define SUM0(x) (ROR32(x, 2) ^ ROR32(x, 13) ^ ROR32(x, 22))
+#define SUM1(x) (ROR32(x, 6) ^ ROR32(x, 11) ^ ROR32(x, 25))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+/*
+ * Compute the next four schedule words from the previous sixteen, held in
+ * x0 (oldest) through x3 (newest).
+ */
+static inline __m256i TARGET_AVX2 sha256_schedule4(__m256i x0, __m256i x1,
+						   __m256i x2, __m256i x3)
+{
+	const __m256i lo_mask = _mm256_setr_epi32(-1, -1, 0, 0, -1, -1, 0, 0);
+	__m256i w7 = _mm256_alignr_epi8(x3, x2, 4);
+	__m256i w15 = _mm256_alignr_epi8(x1, x0, 4);
+	__m256i t, w2;
+
+	t = _mm256_add_epi32(_mm256_add_epi32(x0, w7), SIGMA0_V(w15));
+
+	/* Words 0-1 depend on W[t-2], W[t-1] which are in x3 */
+	w2 = _mm256_shuffle_epi32(x3, 0xFE);
+	t = _mm256_add_epi32(t, _mm256_and_si256(SIGMA1_V(w2), lo_mask));
+
+	/* Words 2-3 depend on words 0-1 just computed */
+	w2 = _mm256_shuffle_epi32(t, 0x40);
+	t = _mm256_add_epi32(t, _mm256_andnot_si256(lo_mask, SIGMA1_V(w2)));
+
+	return t;
+}
+
+/* Fill wk[0] (and wk[1] if two_blocks) with W + K for each round. */
+static void TARGET_AVX2 sha256_schedule_avx2(const uint8_t *data,
+					     int two_blocks,
+					     uint32_t wk[2][64])
+{
+	const __m256i bswap = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	__m256i x[4], v;
+	__m128i lo, hi;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		lo = _mm_loadu_si128((const __m128i *)(data + 16 * i));
+		hi = two_blocks ? _mm_loadu_si128((const __m128i *)
+				(data + VB2_SHA256_BLOCK_SIZE + 16 * i)) : lo;
+		v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		x[i] = _mm256_shuffle_epi8(v, bswap);
+	}
+
+	for (i = 0; i < 16; i++) {
+		if (i >= 4)
+			x[i & 3] = sha256_schedule4(x[i & 3], x[(i + 1) & 3],
+						    x[(i + 2) & 3],
+						    x[(i + 3) & 3]);
+		v = _mm256_add_epi32(x[i & 3], _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i *)
+					&vb2_sha256_k[4 * i])));
+		_mm_storeu_si128((__m128i *)&wk[0][4 * i],
+				 _mm256_castsi256_si128(v));
+		_mm_storeu_si128((__m128i *)&wk[1][4 * i],
+				 _mm256_extracti128_si256(v, 1));
+	}
+}
+
+/* One round; the caller rotates the variable names instead of moving them */
+#define ROUND(a, b, c, d, e, f, g, h, wk)				\
+	do {								\
+		uint32_t t1 = h + SUM1(e) + CH(e, f, g) + (wk);		\
+		d += t1;						\
+		h = t1 + SUM0(a) + MAJ(a, b, c);			\
+	} while (0)
+
+static void TARGET_AVX2 sha256_rounds(uint32_t *state, const uint32_t *wk)
+{
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+	int j;
+
+	for (j = 0; j < 64; j += 8) {
+		ROUND(a, b, c, d, e, f, g, h, wk[j + 0]);
+		ROUND(h, a, b, c, d, e, f, g, wk[j + 1]);
+		ROUND(g, h, a, b, c, d, e, f, wk[j + 2]);
+		ROUND(f, g, h, a, b, c, d, e, wk[j + 3]);
+		ROUND(e, f, g, h, a, b, c, d, wk[j + 4]);
+		ROUND(d, e, f, g, h, a, b, c, wk[j + 5]);
+		ROUND(c, d, e, f, g, h, a, b, wk[j + 6]);
+		ROUND(b, c, d, e, f, g, h, a, wk[j + 7]);
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void TARGET_AVX2 vb2_sha256_transform_avx2(uint32_t *h,
+					   const uint8_t *data,
+					   unsigned int block_nb)
+{
+	uint32_t wk[2][64] __attribute__((aligned(32)));
+
+	for (; block_nb >= 2; block_nb -= 2) {
+		sha256_schedule_avx2(data, 1, wk);
+		sha256_rounds(h, wk[0]);
+		sha256_rounds(h, wk[1]);
+		data += 2 * VB2_SHA256_BLOCK_SIZE;
+	}
+
+	if (block_nb) {
+		sha256_schedule_avx2(data, 0, wk);
+		sha256_rounds(h, wk[0]);
+	}
+}
@@ -38,6 +38,7 @@
 #include "2sysincludes.h"
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 
 #define SHFR(x, n)    (x >> n)
 #define ROTR(x, n)   ((x >> n) | (x << ((sizeof(x) << 3) - n)))
@@ -93,7 +94,7 @@
 #define SHA512_EXP(a, b, c, d, e, f, g ,h, j)				\
 	{								\
 		t1 = wv[h] + SHA512_F2(wv[e]) + CH(wv[e], wv[f], wv[g]) \
-			+ sha512_k[j] + w[j];				\
+			+ vb2_sha512_k[j] + w[j];			\
 		t2 = SHA512_F1(wv[a]) + MAJ(wv[a], wv[b], wv[c]);       \
 		wv[d] += t1;                                            \
 		wv[h] = t1 + t2;                                        \
@@ -106,7 +107,7 @@ static const uint64_t sha512_h0[8] = {
 	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
 };
 
-static const uint64_t sha512_k[80] = {
+const uint64_t vb2_sha512_k[80] = {
 	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
 	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
 	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
@@ -169,9 +170,47 @@ void vb2_sha512_init(struct vb2_sha512_context *ctx)
 	ctx->total_size = 0;
 }
 
-static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
-			     const uint8_t *message,
-                             unsigned int block_nb)
+#ifdef VB2_SHA_X86
+/* Backend in use; resolved on first use if VB2_SHA_BACKEND_AUTO */
+static enum vb2_sha_backend sha512_backend;
+#endif
+
+int vb2_sha512_set_backend(enum vb2_sha_backend backend)
+{
+	switch (backend) {
+	case VB2_SHA_BACKEND_AUTO:
+	case VB2_SHA_BACKEND_C:
+		break;
+#ifdef VB2_SHA_X86
+	case VB2_SHA_BACKEND_AVX2:
+		if (vb2_sha_x86_supported(VB2_HASH_SHA512, backend))
+			break;
+		return VB2_ERROR_SHA_BACKEND_UNSUPPORTED;
+#endif
+	default:
+		return VB2_ERROR_SHA_BACKEND_UNSUPPORTED;
+	}
+
+#ifdef VB2_SHA_X86
+	sha512_backend = backend;
+#endif
+	return VB2_SUCCESS;
+}
+
+enum vb2_sha_backend vb2_sha512_get_backend(void)
+{
+#ifdef VB2_SHA_X86
+	if (sha512_backend == VB2_SHA_BACKEND_AUTO)
+		sha512_backend = vb2_sha_x86_best(VB2_HASH_SHA512);
+	return sha512_backend;
+#else
+	return VB2_SHA_BACKEND_C;
+#endif
+}
+
+static void vb2_sha512_transform_c(struct vb2_sha512_context *ctx,
+				   const uint8_t *message,
+				   unsigned int block_nb)
 {
 	/* Note that these arrays use 88*8=704 bytes of stack */
 	uint64_t w[80];
@@ -255,7 +294,7 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 
 		for (j = 0; j < 80; j++) {
 			t1 = wv[7] + SHA512_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
-				+ sha512_k[j] + w[j];
+				+ vb2_sha512_k[j] + w[j];
 			t2 = SHA512_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
 			wv[7] = wv[6];
 			wv[6] = wv[5];
@@ -273,6 +312,23 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 	}
 }
 
+static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
+				 const uint8_t *message,
+				 unsigned int block_nb)
+{
+	if (!block_nb)
+		return;
+
+#ifdef VB2_SHA_X86
+	if (vb2_sha512_get_backend() == VB2_SHA_BACKEND_AVX2) {
+		vb2_sha512_transform_avx2(ctx->h, message, block_nb);
+		return;
+	}
+#endif
+
+	vb2_sha512_transform_c(ctx, message, block_nb);
+}
+
 void vb2_sha512_update(struct vb2_sha512_context *ctx,
 		       const uint8_t *data,
 		       uint32_t size)
@@ -308,11 +364,13 @@ void vb2_sha512_update(struct vb2_sha512_context *ctx,
 	ctx->total_size += (block_nb + 1) << 7;
 }
 
-void vb2_sha512_finalize(struct vb2_sha512_context *ctx, uint8_t *digest)
+void vb2_sha512_finalize_size(struct vb2_sha512_context *ctx,
+			      uint8_t *digest,
+			      uint64_t size)
 {
 	unsigned int block_nb;
 	unsigned int pm_size;
-	unsigned int size_b;
+	uint64_t size_b;
 
 #ifndef UNROLL_LOOPS_SHA512
 	int i;
@@ -321,12 +379,14 @@ void vb2_sha512_finalize(struct vb2_sha512_context *ctx, uint8_t *digest)
 	block_nb = 1 + ((VB2_SHA512_BLOCK_SIZE - 17)
 			< (ctx->size % VB2_SHA512_BLOCK_SIZE));
 
-	size_b = (ctx->total_size + ctx->size) << 3;
+	size_b = size << 3;
 	pm_size = block_nb << 7;
 
+	/* The length field is 128 bits; the top 61 are always zero here */
 	memset(ctx->block + ctx->size, 0, pm_size - ctx->size);
 	ctx->block[ctx->size] = 0x80;
-	UNPACK32(size_b, ctx->block + pm_size - 4);
+	ctx->block[pm_size - 9] = (uint8_t)(size >> 61);
+	UNPACK64(size_b, ctx->block + pm_size - 8);
 
 	vb2_sha512_transform(ctx, ctx->block, block_nb);
 
@@ -344,3 +404,9 @@ void vb2_sha512_finalize(struct vb2_sha512_context *ctx, uint8_t *digest)
 		UNPACK64(ctx->h[i], &digest[i << 3]);
 #endif /* UNROLL_LOOPS_SHA512 */
 }
+
+void vb2_sha512_finalize(struct vb2_sha512_context *ctx, uint8_t *digest)
+{
+	vb2_sha512_finalize_size(ctx, digest,
+				 (uint64_t)ctx->total_size + ctx->size);
+}
@@ -0,0 +1,120 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * SHA-512 compression function using AVX2.  Only built for host utilities;
+ * selected at runtime by vb2_sha512_get_backend().
+ *
+ * The message schedule is computed four 64-bit words at a time in a ymm
+ * register, then the rounds run as scalar code (using BMI2 rotates) on the
+ * precomputed W + K values.
+ */
+
+#include <immintrin.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2,bmi2")))
+
+#define ROR64_V(x, n) _mm256_or_si256(_mm256_srli_epi64(x, n), \
+				      _mm256_slli_epi64(x, 64 - (n)))
+#define SIGMA0_V(x) _mm256_xor_si256(_mm256_xor_si256(ROR64_V(x, 1), \
+				ROR64_V(x, 8)), _mm256_srli_epi64(x, 7))
+#define SIGMA1_V(x) _mm256_xor_si256(_mm256_xor_si256(ROR64_V(x, 19), \
+				ROR64_V(x, 61)), _mm256_srli_epi64(x, 6))
+
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+#define SUM0(x) (ROR64(x, 28) ^ ROR64(x, 34) ^ ROR64(x, 39))
+#define SUM1(x) (ROR64(x, 14) ^ ROR64(x, 18) ^ ROR64(x, 41))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+/* Words 1-3 of lo followed by word 0 of hi */
+static inline __m256i TARGET_AVX2 shift_in_word(__m256i lo, __m256i hi)
+{
+	return _mm256_alignr_epi8(_mm256_permute2x128_si256(lo, hi, 0x21),
+				  lo, 8);
+}
+
+/*
+ * Compute the next four schedule words from the previous sixteen, held in
+ * x0 (oldest) through x3 (newest).
+ */
+static inline __m256i TARGET_AVX2 sha512_schedule4(__m256i x0, __m256i x1,
+						   __m256i x2, __m256i x3)
+{
+	const __m256i lo_mask = _mm256_setr_epi64x(-1, -1, 0, 0);
+	__m256i w7 = shift_in_word(x2, x3);
+	__m256i w15 = shift_in_word(x0, x1);
+	__m256i t, w2;
+
+	t = _mm256_add_epi64(_mm256_add_epi64(x0, w7), SIGMA0_V(w15));
+
+	/* Words 0-1 depend on W[t-2], W[t-1] which are in x3 */
+	w2 = _mm256_permute4x64_epi64(x3, 0xEE);
+	t = _mm256_add_epi64(t, _mm256_and_si256(SIGMA1_V(w2), lo_mask));
+
+	/* Words 2-3 depend on words 0-1 just computed */
+	w2 = _mm256_permute4x64_epi64(t, 0x44);
+	t = _mm256_add_epi64(t, _mm256_andnot_si256(lo_mask, SIGMA1_V(w2)));
+
+	return t;
+}
+
+/* One round; the caller rotates the variable names instead of moving them */
+#define ROUND(a, b, c, d, e, f, g, h, wk)				\
+	do {								\
+		uint64_t t1 = h + SUM1(e) + CH(e, f, g) + (wk);		\
+		d += t1;						\
+		h = t1 + SUM0(a) + MAJ(a, b, c);			\
+	} while (0)
+
+void TARGET_AVX2 vb2_sha512_transform_avx2(uint64_t *state,
+					   const uint8_t *data,
+					   unsigned int block_nb)
+{
+	const __m256i bswap = _mm256_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	uint64_t wk[80] __attribute__((aligned(32)));
+	uint64_t a, b, c, d, e, f, g, h;
+	__m256i x[4], v;
+	int i;
+
+	for (; block_nb; block_nb--, data += VB2_SHA512_BLOCK_SIZE) {
+		for (i = 0; i < 4; i++)
+			x[i] = _mm256_shuffle_epi8(_mm256_loadu_si256(
+				(const __m256i *)(data + 32 * i)), bswap);
+
+		for (i = 0; i < 20; i++) {
+			if (i >= 4)
+				x[i & 3] = sha512_schedule4(x[i & 3],
+							    x[(i + 1) & 3],
+							    x[(i + 2) & 3],
+							    x[(i + 3) & 3]);
+			v = _mm256_add_epi64(x[i & 3], _mm256_loadu_si256(
+				(const __m256i *)&vb2_sha512_k[4 * i]));
+			_mm256_store_si256((__m256i *)&wk[4 * i], v);
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+		for (i = 0; i < 80; i += 8) {
+			ROUND(a, b, c, d, e, f, g, h, wk[i + 0]);
+			ROUND(h, a, b, c, d, e, f, g, wk[i + 1]);
+			ROUND(g, h, a, b, c, d, e, f, wk[i + 2]);
+			ROUND(f, g, h, a, b, c, d, e, wk[i + 3]);
+			ROUND(e, f, g, h, a, b, c, d, wk[i + 4]);
+			ROUND(d, e, f, g, h, a, b, c, wk[i + 5]);
+			ROUND(c, d, e, f, g, h, a, b, wk[i + 6]);
+			ROUND(b, c, d, e, f, g, h, a, wk[i + 7]);
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+	}
+}
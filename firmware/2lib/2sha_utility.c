@@ -8,6 +8,7 @@
 #include "2sysincludes.h"
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 
 #if VB2_SUPPORT_SHA1
 #define CTH_SHA1 VB2_HASH_SHA1
@@ -116,6 +117,45 @@ const char *vb2_get_hash_algorithm_name(enum vb2_hash_algorithm alg)
 	}
 }
 
+const char *vb2_get_sha_backend_name(enum vb2_sha_backend backend)
+{
+	switch (backend) {
+	case VB2_SHA_BACKEND_AUTO:
+		return "auto";
+	case VB2_SHA_BACKEND_C:
+		return "c";
+	case VB2_SHA_BACKEND_AVX2:
+		return "avx2";
+	case VB2_SHA_BACKEND_SHA_NI:
+		return "sha_ni";
+	case VB2_SHA_BACKEND_AVX512:
+		return "avx512";
+	default:
+		return VB2_INVALID_ALG_NAME;
+	}
+}
+
+int vb2_digest_set_backend(enum vb2_hash_algorithm hash_alg,
+			   enum vb2_sha_backend backend)
+{
+	switch (hash_alg) {
+#if VB2_SUPPORT_SHA1
+	case VB2_HASH_SHA1:
+		return vb2_sha1_set_backend(backend);
+#endif
+#if VB2_SUPPORT_SHA256
+	case VB2_HASH_SHA256:
+		return vb2_sha256_set_backend(backend);
+#endif
+#if VB2_SUPPORT_SHA512
+	case VB2_HASH_SHA512:
+		return vb2_sha512_set_backend(backend);
+#endif
+	default:
+		return VB2_ERROR_SHA_BACKEND_UNSUPPORTED;
+	}
+}
+
 int vb2_digest_init(struct vb2_digest_context *dc,
 		    enum vb2_hash_algorithm hash_alg)
 {
@@ -196,6 +236,64 @@ int vb2_digest_finalize(struct vb2_digest_context *dc,
 	}
 }
 
+int vb2_digest64_init(struct vb2_digest64_context *dc,
+		      enum vb2_hash_algorithm hash_alg)
+{
+	dc->total_size = 0;
+	return vb2_digest_init(&dc->dc, hash_alg);
+}
+
+int vb2_digest64_extend(struct vb2_digest64_context *dc,
+			const uint8_t *buf,
+			uint64_t size)
+{
+	uint32_t chunk;
+	int rv;
+
+	/* Feed the algorithm context at most 1 GiB at a time */
+	while (size) {
+		chunk = size < 0x40000000 ? (uint32_t)size : 0x40000000;
+		rv = vb2_digest_extend(&dc->dc, buf, chunk);
+		if (rv)
+			return rv;
+		dc->total_size += chunk;
+		buf += chunk;
+		size -= chunk;
+	}
+
+	return VB2_SUCCESS;
+}
+
+int vb2_digest64_finalize(struct vb2_digest64_context *dc,
+			  uint8_t *digest,
+			  uint32_t digest_size)
+{
+	if (digest_size < vb2_digest_size(dc->dc.hash_alg))
+		return VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE;
+
+	switch (dc->dc.hash_alg) {
+#if VB2_SUPPORT_SHA1
+	case VB2_HASH_SHA1:
+		vb2_sha1_finalize_size(&dc->dc.sha1, digest, dc->total_size);
+		return VB2_SUCCESS;
+#endif
+#if VB2_SUPPORT_SHA256
+	case VB2_HASH_SHA256:
+		vb2_sha256_finalize_size(&dc->dc.sha256, digest,
+					 dc->total_size);
+		return VB2_SUCCESS;
+#endif
+#if VB2_SUPPORT_SHA512
+	case VB2_HASH_SHA512:
+		vb2_sha512_finalize_size(&dc->dc.sha512, digest,
+					 dc->total_size);
+		return VB2_SUCCESS;
+#endif
+	default:
+		return VB2_ERROR_SHA_FINALIZE_ALGORITHM;
+	}
+}
+
 int vb2_digest_buffer(const uint8_t *buf,
 		      uint32_t size,
 		      enum vb2_hash_algorithm hash_alg,
@@ -215,3 +313,40 @@ int vb2_digest_buffer(const uint8_t *buf,
 
 	return vb2_digest_finalize(&dc, digest, digest_size);
 }
+
+int vb2_digest_buffers(const uint8_t * const *bufs,
+		       const uint32_t *sizes,
+		       uint32_t count,
+		       enum vb2_hash_algorithm hash_alg,
+		       uint8_t *digests,
+		       uint32_t digest_size)
+{
+	uint32_t i;
+	int rv;
+
+	if (!vb2_digest_size(hash_alg))
+		return VB2_ERROR_SHA_INIT_ALGORITHM;
+	if (digest_size < vb2_digest_size(hash_alg))
+		return VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE;
+
+#ifdef VB2_SHA_X86
+	if (hash_alg == VB2_HASH_SHA256 && count > 1) {
+		enum vb2_sha_backend backend = vb2_sha256_get_multi_backend();
+
+		if (backend != VB2_SHA_BACKEND_C) {
+			vb2_sha256_multi_x86(bufs, sizes, count, digests,
+					     digest_size, backend);
+			return VB2_SUCCESS;
+		}
+	}
+#endif
+
+	for (i = 0; i < count; i++) {
+		rv = vb2_digest_buffer(bufs[i], sizes[i], hash_alg,
+				       digests + i * digest_size, digest_size);
+		if (rv)
+			return rv;
+	}
+
+	return VB2_SUCCESS;
+}
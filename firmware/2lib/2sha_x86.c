@@ -0,0 +1,137 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Runtime CPU feature detection for the x86-64 SHA backends.  This file is
+ * only built for host utilities, so it may use compiler-provided system
+ * headers directly.
+ */
+
+#include <cpuid.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+/* Older compilers don't name all the feature bits */
+#ifndef bit_SHA
+#define bit_SHA		(1 << 29)
+#endif
+#ifndef bit_AVX512F
+#define bit_AVX512F	(1 << 16)
+#endif
+
+/* XCR0 bits for SSE, AVX and AVX-512 register state */
+#define XCR0_SSE	(1 << 1)
+#define XCR0_AVX	(1 << 2)
+#define XCR0_AVX512	(7 << 5)
+
+/* Bit set in the cached features once CPUID has been probed */
+#define VB2_X86_FEATURE_PROBED	(1U << 31)
+
+static uint32_t cpu_features;
+
+static uint64_t read_xcr0(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ volatile("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+uint32_t vb2_x86_cpu_features(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	uint32_t features = VB2_X86_FEATURE_PROBED;
+	int ymm_enabled = 0, zmm_enabled = 0;
+	uint64_t xcr0;
+
+	if (cpu_features)
+		return cpu_features & ~VB2_X86_FEATURE_PROBED;
+
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		if (ecx & bit_SSSE3)
+			features |= VB2_X86_FEATURE_SSSE3;
+		if (ecx & bit_SSE4_1)
+			features |= VB2_X86_FEATURE_SSE41;
+		if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX)) {
+			xcr0 = read_xcr0();
+			ymm_enabled = (xcr0 & (XCR0_SSE | XCR0_AVX)) ==
+				(XCR0_SSE | XCR0_AVX);
+			zmm_enabled = ymm_enabled &&
+				(xcr0 & XCR0_AVX512) == XCR0_AVX512;
+		}
+	}
+
+	if (__get_cpuid_max(0, NULL) >= 7) {
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		if ((ebx & bit_AVX2) && ymm_enabled)
+			features |= VB2_X86_FEATURE_AVX2;
+		if (ebx & bit_BMI2)
+			features |= VB2_X86_FEATURE_BMI2;
+		if (ebx & bit_SHA)
+			features |= VB2_X86_FEATURE_SHA;
+		if ((ebx & bit_AVX512F) && zmm_enabled)
+			features |= VB2_X86_FEATURE_AVX512F;
+	}
+
+	cpu_features = features;
+	return features & ~VB2_X86_FEATURE_PROBED;
+}
+
+int vb2_sha_x86_supported(enum vb2_hash_algorithm hash_alg,
+			  enum vb2_sha_backend backend)
+{
+	uint32_t f = vb2_x86_cpu_features();
+	uint32_t need;
+
+	switch (backend) {
+	case VB2_SHA_BACKEND_C:
+		return 1;
+	case VB2_SHA_BACKEND_AVX2:
+		if (hash_alg != VB2_HASH_SHA256 && hash_alg != VB2_HASH_SHA512)
+			return 0;
+		need = VB2_X86_FEATURE_AVX2 | VB2_X86_FEATURE_BMI2;
+		break;
+	case VB2_SHA_BACKEND_SHA_NI:
+		if (hash_alg != VB2_HASH_SHA1 && hash_alg != VB2_HASH_SHA256)
+			return 0;
+		need = VB2_X86_FEATURE_SHA | VB2_X86_FEATURE_SSSE3 |
+			VB2_X86_FEATURE_SSE41;
+		break;
+	case VB2_SHA_BACKEND_AVX512:
+		if (hash_alg != VB2_HASH_SHA256)
+			return 0;
+		need = VB2_X86_FEATURE_AVX512F | VB2_X86_FEATURE_AVX2;
+		break;
+	default:
+		return 0;
+	}
+
+	return (f & need) == need;
+}
+
+enum vb2_sha_backend vb2_sha_x86_best(enum vb2_hash_algorithm hash_alg)
+{
+	if (vb2_sha_x86_supported(hash_alg, VB2_SHA_BACKEND_SHA_NI))
+		return VB2_SHA_BACKEND_SHA_NI;
+	if (vb2_sha_x86_supported(hash_alg, VB2_SHA_BACKEND_AVX2))
+		return VB2_SHA_BACKEND_AVX2;
+	return VB2_SHA_BACKEND_C;
+}
+
+enum vb2_sha_backend vb2_sha_x86_best_multi(void)
+{
+	/*
+	 * 16 lanes of AVX-512 beat SHA-NI on one buffer at a time; 8 lanes of
+	 * AVX2 don't, so only use those on CPUs without SHA-NI.
+	 */
+	if (vb2_sha_x86_supported(VB2_HASH_SHA256, VB2_SHA_BACKEND_AVX512))
+		return VB2_SHA_BACKEND_AVX512;
+	if (vb2_sha_x86_supported(VB2_HASH_SHA256, VB2_SHA_BACKEND_SHA_NI))
+		return VB2_SHA_BACKEND_C;
+	if (vb2_sha_x86_supported(VB2_HASH_SHA256, VB2_SHA_BACKEND_AVX2))
+		return VB2_SHA_BACKEND_AVX2;
+	return VB2_SHA_BACKEND_C;
+}
@@ -8,6 +8,65 @@
 
 #include <stdint.h>
 #include "2crypto.h"
+#include "2sha.h"
+
+/*
+ * HMAC key state.  Holds the hash states after absorbing the inner and outer
+ * padded key blocks, so MACs with the same key don't need to hash them again.
+ */
+struct vb2_hmac_key {
+	struct vb2_digest_context inner;
+	struct vb2_digest_context outer;
+};
+
+/* Context for computing one HMAC incrementally */
+struct vb2_hmac_context {
+	const struct vb2_hmac_key *key;
+	struct vb2_digest_context dc;
+};
+
+/**
+ * Precompute HMAC key state.
+ *
+ * @param hk		Key state to initialize
+ * @param alg		Hash algorithm ID
+ * @param key		HMAC key
+ * @param key_size	HMAC key size
+ * @return 0 if success, non-zero if error.
+ */
+int hmac_key_init(struct vb2_hmac_key *hk, enum vb2_hash_algorithm alg,
+		  const void *key, uint32_t key_size);
+
+/**
+ * Start computing a HMAC.
+ *
+ * @param ctx		Context to initialize
+ * @param hk		Key state from hmac_key_init().  Must stay valid until
+ *			hmac_final() is called.
+ * @return 0 if success, non-zero if error.
+ */
+int hmac_init(struct vb2_hmac_context *ctx, const struct vb2_hmac_key *hk);
+
+/**
+ * Add data to a HMAC.
+ *
+ * @param ctx		Context from hmac_init()
+ * @param msg		Message data
+ * @param msg_size	Size of message data
+ * @return 0 if success, non-zero if error.
+ */
+int hmac_update(struct vb2_hmac_context *ctx,
+		const void *msg, uint32_t msg_size);
+
+/**
+ * Finish a HMAC.
+ *
+ * @param ctx		Context from hmac_init()
+ * @param mac		Computed message authentication code
+ * @param mac_size	Size of the buffer pointed by <mac>
+ * @return 0 if success, non-zero if error.
+ */
+int hmac_final(struct vb2_hmac_context *ctx, uint8_t *mac, uint32_t mac_size);
 
 /**
  * Compute HMAC
@@ -45,6 +45,9 @@ enum vb2_return_code {
 	/* Digest size buffer too small in vb2_digest_finalize() */
 	VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE,
 
+	/* Backend not supported by this build or CPU in vb2_*_set_backend() */
+	VB2_ERROR_SHA_BACKEND_UNSUPPORTED,
+
         /**********************************************************************
 	 * RSA errors
 	 */
@@ -777,6 +780,21 @@ enum vb2_return_code {
 	/* Not enough buffer space to hold signature in vb2_sign_object() */
 	VB2_SIGN_OBJECT_OVERFLOW,
 
+	/* Unable to determine signature size in vb2_signing_init() */
+	VB2_SIGNING_INIT_SIG_SIZE,
+
+	/* Unable to get digest info in vb2_signing_init() */
+	VB2_SIGNING_INIT_DIGEST_INFO,
+
+	/* Signature buffer too small in vb2_signing_sign_digest() */
+	VB2_SIGNING_SIG_SIZE,
+
+	/* Unable to calculate digest in vb2_signing_sign() */
+	VB2_SIGNING_DIGEST,
+
+	/* RSA encrypt failed in vb2_signing_sign_digest() */
+	VB2_SIGNING_RSA_ENCRYPT,
+
         /**********************************************************************
 	 * Errors generated by host library keyblock functions
 	 */
@@ -63,6 +63,33 @@ int vb2_check_padding(const uint8_t *sig, const struct vb2_public_key *key);
 /* Size of work buffer sufficient for vb2_rsa_verify_digest() worst case */
 #define VB2_VERIFY_RSA_DIGEST_WORKBUF_BYTES (3 * 1024)
 
+#ifdef CHROMEOS_ENVIRONMENT
+
+/* Ways of doing the modular squarings in vb2_rsa_verify_digest() */
+enum vb2_rsa_sqr_impl {
+	/* Squaring specialized for the key size if there is one (default) */
+	VB2_RSA_SQR_FIXED = 0,
+
+	/* Squaring for any key size */
+	VB2_RSA_SQR_GENERIC,
+
+	/* General Montgomery multiply of the value by itself */
+	VB2_RSA_SQR_MUL,
+
+	/* Number of implementations */
+	VB2_RSA_SQR_COUNT
+};
+
+/**
+ * Select the squaring implementation; used to benchmark them.
+ *
+ * @param impl		Implementation to use
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_rsa_set_sqr_impl(enum vb2_rsa_sqr_impl impl);
+
+#endif  /* CHROMEOS_ENVIRONMENT */
+
 /**
  * Verify a RSA PKCS1.5 signature against an expected hash digest.
  *
@@ -77,4 +104,33 @@ int vb2_rsa_verify_digest(const struct vb2_public_key *key,
 			  const uint8_t *digest,
 			  const struct vb2_workbuf *wb);
 
+/* One signature to check with vb2_rsa_verify_digests() */
+struct vb2_rsa_verify_item {
+	uint8_t *sig;		/* Signature to verify (destroyed in process) */
+	const uint8_t *digest;	/* Digest of signed data */
+};
+
+/**
+ * Verify several RSA PKCS1.5 signatures made with the same key.
+ *
+ * This gives the same results as calling vb2_rsa_verify_digest() on each
+ * item, but checks the key and allocates work buffer space only once.
+ * Host code which wants to use all CPUs should call
+ * vb2_rsa_verify_digests_parallel() instead.
+ *
+ * @param key		Key to use in signature verification
+ * @param items		Array of count signatures and digests
+ * @param results	Destination for count results; results[i] is
+ *			VB2_SUCCESS if items[i] verified, else an error code.
+ * @param count		Number of items
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS if every item verified, else the first non-zero
+ * entry in results[].
+ */
+int vb2_rsa_verify_digests(const struct vb2_public_key *key,
+			   const struct vb2_rsa_verify_item *items,
+			   int *results,
+			   uint32_t count,
+			   const struct vb2_workbuf *wb);
+
 #endif  /* VBOOT_REFERENCE_2RSA_H_ */
@@ -96,6 +96,87 @@ struct vb2_digest_context {
 	int using_hwcrypto;
 };
 
+/*
+ * Digest context for messages of 4 GiB or more.  The length kept in the
+ * algorithm contexts is only 32 bits wide, and changing that would change the
+ * layout of structs shared with firmware, so the full length is tracked here.
+ */
+struct vb2_digest64_context {
+	struct vb2_digest_context dc;
+
+	/* Total bytes hashed so far */
+	uint64_t total_size;
+};
+
+/*
+ * Implementations of the hash compression functions.  Host builds on x86-64
+ * pick the fastest one the CPU supports at runtime; firmware builds always
+ * use the portable C code.
+ */
+enum vb2_sha_backend {
+	/* Fastest backend supported by this build and CPU */
+	VB2_SHA_BACKEND_AUTO = 0,
+
+	/* Portable C implementation; always available */
+	VB2_SHA_BACKEND_C,
+
+	/* AVX2 message schedule, scalar rounds (x86-64 host only; SHA-256 and
+	 * SHA-512) */
+	VB2_SHA_BACKEND_AVX2,
+
+	/* x86 SHA extensions (x86-64 host only; SHA-1 and SHA-256) */
+	VB2_SHA_BACKEND_SHA_NI,
+
+	/* AVX-512 (x86-64 host only; multi-buffer SHA-256) */
+	VB2_SHA_BACKEND_AVX512,
+
+	/* Number of backends */
+	VB2_SHA_BACKEND_COUNT
+};
+
+/**
+ * Select the implementation used by subsequent hash operations.
+ *
+ * This is mainly useful for testing and benchmarking; callers normally leave
+ * the backend at VB2_SHA_BACKEND_AUTO.
+ *
+ * @param backend	Backend to use
+ * @return VB2_SUCCESS, or VB2_ERROR_SHA_BACKEND_UNSUPPORTED if the backend
+ * isn't available for this algorithm, in this build or on this CPU.
+ */
+int vb2_sha1_set_backend(enum vb2_sha_backend backend);
+int vb2_sha256_set_backend(enum vb2_sha_backend backend);
+int vb2_sha512_set_backend(enum vb2_sha_backend backend);
+
+/**
+ * Return the implementation used for a hash algorithm.
+ *
+ * @return The backend in use; never VB2_SHA_BACKEND_AUTO.
+ */
+enum vb2_sha_backend vb2_sha1_get_backend(void);
+enum vb2_sha_backend vb2_sha256_get_backend(void);
+enum vb2_sha_backend vb2_sha512_get_backend(void);
+
+/**
+ * Select the implementation used by vb2_digest_buffers() for SHA-256.
+ *
+ * VB2_SHA_BACKEND_AVX2 and VB2_SHA_BACKEND_AVX512 hash 8 or 16 buffers at
+ * once in SIMD lanes.  VB2_SHA_BACKEND_C hashes the buffers one after another
+ * using the single-buffer backend.  VB2_SHA_BACKEND_AUTO doesn't pick AVX2
+ * on CPUs with SHA-NI, where it's no faster, but it can still be selected.
+ *
+ * @param backend	Backend to use
+ * @return VB2_SUCCESS, or VB2_ERROR_SHA_BACKEND_UNSUPPORTED.
+ */
+int vb2_sha256_set_multi_backend(enum vb2_sha_backend backend);
+
+/**
+ * Return the implementation used by vb2_digest_buffers() for SHA-256.
+ *
+ * @return The backend in use; never VB2_SHA_BACKEND_AUTO.
+ */
+enum vb2_sha_backend vb2_sha256_get_multi_backend(void);
+
 /**
  * Initialize a hash context.
  *
@@ -177,6 +258,25 @@ int vb2_hash_block_size(enum vb2_hash_algorithm alg);
  */
 const char *vb2_get_hash_algorithm_name(enum vb2_hash_algorithm alg);
 
+/**
+ * Return the name of a hash backend.
+ *
+ * @param backend	Backend
+ * @return A string naming the backend, or VB2_INVALID_ALG_NAME if invalid.
+ */
+const char *vb2_get_sha_backend_name(enum vb2_sha_backend backend);
+
+/**
+ * Select the implementation used for a hash algorithm.
+ *
+ * @param hash_alg	Hash algorithm
+ * @param backend	Backend to use
+ * @return VB2_SUCCESS, or non-zero if the algorithm or backend isn't
+ * supported.
+ */
+int vb2_digest_set_backend(enum vb2_hash_algorithm hash_alg,
+			   enum vb2_sha_backend backend);
+
 /**
  * Initialize a digest context for doing block-style digesting.
  *
@@ -213,6 +313,40 @@ int vb2_digest_finalize(struct vb2_digest_context *dc,
 			uint8_t *digest,
 			uint32_t digest_size);
 
+/**
+ * Initialize a digest context for a message which may be 4 GiB or longer.
+ *
+ * @param dc		Digest context
+ * @param hash_alg	Hash algorithm
+ * @return VB2_SUCCESS, or non-zero on error.
+ */
+int vb2_digest64_init(struct vb2_digest64_context *dc,
+		      enum vb2_hash_algorithm hash_alg);
+
+/**
+ * Extend a 64-bit digest with a buffer of data.
+ *
+ * @param dc		Digest context
+ * @param buf		Data to hash
+ * @param size		Length of data in bytes
+ * @return VB2_SUCCESS, or non-zero on error.
+ */
+int vb2_digest64_extend(struct vb2_digest64_context *dc,
+			const uint8_t *buf,
+			uint64_t size);
+
+/**
+ * Finalize a 64-bit digest and store the result.
+ *
+ * @param dc		Digest context
+ * @param digest	Destination for digest
+ * @param digest_size	Length of digest buffer in bytes.
+ * @return VB2_SUCCESS, or non-zero on error.
+ */
+int vb2_digest64_finalize(struct vb2_digest64_context *dc,
+			  uint8_t *digest,
+			  uint32_t digest_size);
+
 /**
  * Calculate the digest of a buffer and store the result.
  *
@@ -229,4 +363,27 @@ int vb2_digest_buffer(const uint8_t *buf,
 		      uint8_t *digest,
 		      uint32_t digest_size);
 
+/**
+ * Calculate the digests of several independent buffers.
+ *
+ * This gives the same results as calling vb2_digest_buffer() on each buffer,
+ * but on hosts with wide vector units SHA-256 digests are computed several
+ * at a time.  This is worthwhile when hashing many small-to-medium objects.
+ *
+ * @param bufs		Array of count pointers to data to hash
+ * @param sizes		Array of count data lengths in bytes
+ * @param count		Number of buffers
+ * @param hash_alg	Hash algorithm
+ * @param digests	Destination for digests; digest i is stored at
+ *			digests + i * digest_size.
+ * @param digest_size	Length of each digest slot in bytes.
+ * @return VB2_SUCCESS, or non-zero on error.
+ */
+int vb2_digest_buffers(const uint8_t * const *bufs,
+		       const uint32_t *sizes,
+		       uint32_t count,
+		       enum vb2_hash_algorithm hash_alg,
+		       uint8_t *digests,
+		       uint32_t digest_size);
+
 #endif  /* VBOOT_REFERENCE_2SHA_H_ */
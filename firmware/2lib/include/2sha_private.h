@@ -0,0 +1,136 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Internal definitions shared between the portable SHA implementations and
+ * the accelerated host backends.  Not part of the public API.
+ */
+
+#ifndef VBOOT_REFERENCE_2SHA_PRIVATE_H_
+#define VBOOT_REFERENCE_2SHA_PRIVATE_H_
+
+#include "2sha.h"
+
+/* Round constants */
+extern const uint32_t vb2_sha256_k[64];
+extern const uint64_t vb2_sha512_k[80];
+
+/**
+ * Finalize a hash digest, given the total length of the message.
+ *
+ * The contexts only track the low 32 bits of the length, which is enough to
+ * find the partial block but not to pad the message.  The 64-bit digest API
+ * counts the length itself and passes it in here.
+ *
+ * @param ctx		Hash context
+ * @param digest	Destination for hash; must be VB_SHA*_DIGEST_SIZE bytes
+ * @param size		Total length of the message in bytes
+ */
+void vb2_sha1_finalize_size(struct vb2_sha1_context *ctx,
+			    uint8_t *digest,
+			    uint64_t size);
+void vb2_sha256_finalize_size(struct vb2_sha256_context *ctx,
+			      uint8_t *digest,
+			      uint64_t size);
+void vb2_sha512_finalize_size(struct vb2_sha512_context *ctx,
+			      uint8_t *digest,
+			      uint64_t size);
+
+#ifdef VB2_SHA_X86
+
+/* CPU features detected by vb2_x86_cpu_features() */
+#define VB2_X86_FEATURE_SSSE3	(1 << 0)
+#define VB2_X86_FEATURE_SSE41	(1 << 1)
+#define VB2_X86_FEATURE_AVX2	(1 << 2)
+#define VB2_X86_FEATURE_BMI2	(1 << 3)
+#define VB2_X86_FEATURE_SHA	(1 << 4)
+#define VB2_X86_FEATURE_AVX512F	(1 << 5)
+
+/**
+ * Return the x86 CPU features usable by the SHA backends.
+ *
+ * Vector features are only reported if the OS saves the matching register
+ * state.  The result is computed once and cached.
+ *
+ * @return A bitmask of VB2_X86_FEATURE_* flags.
+ */
+uint32_t vb2_x86_cpu_features(void);
+
+/**
+ * Check whether a backend can be used for a hash algorithm on this CPU.
+ *
+ * @param hash_alg	Hash algorithm
+ * @param backend	Backend (not VB2_SHA_BACKEND_AUTO)
+ * @return 1 if supported, 0 if not.
+ */
+int vb2_sha_x86_supported(enum vb2_hash_algorithm hash_alg,
+			  enum vb2_sha_backend backend);
+
+/**
+ * Return the fastest backend supported for a hash algorithm on this CPU.
+ *
+ * @param hash_alg	Hash algorithm
+ * @return The backend; VB2_SHA_BACKEND_C if nothing faster is available.
+ */
+enum vb2_sha_backend vb2_sha_x86_best(enum vb2_hash_algorithm hash_alg);
+
+/**
+ * Return the fastest multi-buffer backend for SHA-256 on this CPU.
+ *
+ * @return The backend; VB2_SHA_BACKEND_C if buffers should be hashed one at
+ * a time.
+ */
+enum vb2_sha_backend vb2_sha_x86_best_multi(void);
+
+/**
+ * Accelerated SHA-256 compression functions.
+ *
+ * @param h		Hash state (8 words), updated in place
+ * @param data		Message blocks
+ * @param block_nb	Number of VB2_SHA256_BLOCK_SIZE blocks in data
+ */
+void vb2_sha256_transform_avx2(uint32_t *h, const uint8_t *data,
+			       unsigned int block_nb);
+void vb2_sha256_transform_shani(uint32_t *h, const uint8_t *data,
+				unsigned int block_nb);
+
+/**
+ * Accelerated SHA-512 compression function.
+ *
+ * @param h		Hash state (8 words), updated in place
+ * @param data		Message blocks
+ * @param block_nb	Number of VB2_SHA512_BLOCK_SIZE blocks in data
+ */
+void vb2_sha512_transform_avx2(uint64_t *h, const uint8_t *data,
+			       unsigned int block_nb);
+
+/**
+ * Accelerated SHA-1 compression function.
+ *
+ * @param state		Hash state (5 words), updated in place
+ * @param data		Message blocks
+ * @param block_nb	Number of VB2_SHA1_BLOCK_SIZE blocks in data
+ */
+void vb2_sha1_transform_shani(uint32_t *state, const uint8_t *data,
+			      unsigned int block_nb);
+
+/**
+ * Hash several buffers with SHA-256 in SIMD lanes.
+ *
+ * @param bufs		Array of count pointers to data to hash
+ * @param sizes		Array of count data lengths in bytes
+ * @param count		Number of buffers
+ * @param digests	Destination; digest i goes at digests + i * stride
+ * @param stride	Distance between digests in bytes
+ * @param backend	VB2_SHA_BACKEND_AVX2 or VB2_SHA_BACKEND_AVX512
+ */
+void vb2_sha256_multi_x86(const uint8_t * const *bufs,
+			  const uint32_t *sizes,
+			  uint32_t count,
+			  uint8_t *digests,
+			  uint32_t stride,
+			  enum vb2_sha_backend backend);
+
+#endif  /* VB2_SHA_X86 */
+
+#endif  /* VBOOT_REFERENCE_2SHA_PRIVATE_H_ */
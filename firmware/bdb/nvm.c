@@ -39,13 +39,40 @@ static int nvmrw_validate(const void *buf, uint32_t size)
 	return BDB_SUCCESS;
 }
 
-static int nvmrw_verify(const struct bdb_secrets *secrets,
+/*
+ * Compute the HMAC key state for the NVM-RW secret into *hk.  Returns hk, or
+ * NULL if there are no secrets.  Functions given a NULL key state return the
+ * same errors they return for missing secrets.
+ */
+static const struct vb2_hmac_key *nvmrw_hmac_key(
+		const struct bdb_secrets *secrets, struct vb2_hmac_key *hk)
+{
+	if (!secrets || hmac_key_init(hk, VB2_HASH_SHA256,
+				      secrets->nvm_rw, BDB_SECRET_SIZE))
+		return NULL;
+
+	return hk;
+}
+
+static int nvmrw_hmac(const struct vb2_hmac_key *hk, const struct nvmrw *nvm,
+		      uint8_t *mac, uint32_t mac_size)
+{
+	struct vb2_hmac_context hc;
+
+	if (hmac_init(&hc, hk) ||
+	    hmac_update(&hc, nvm, nvm->struct_size - sizeof(nvm->hmac)))
+		return -1;
+
+	return hmac_final(&hc, mac, mac_size);
+}
+
+static int nvmrw_verify(const struct vb2_hmac_key *hk,
 			const struct nvmrw *nvm, uint32_t size)
 {
 	uint8_t mac[NVM_HMAC_SIZE];
 	int rv;
 
-	if (!secrets || !nvm)
+	if (!hk || !nvm)
 		return BDB_ERROR_NVM_INVALID_PARAMETER;
 
 	rv = nvmrw_validate(nvm, size);
@@ -53,8 +80,7 @@ static int nvmrw_verify(const struct bdb_secrets *secrets,
 		return rv;
 
 	/* Compute and verify HMAC */
-	if (hmac(VB2_HASH_SHA256, secrets->nvm_rw, BDB_SECRET_SIZE,
-		 nvm, nvm->struct_size - sizeof(mac), mac, sizeof(mac)))
+	if (nvmrw_hmac(hk, nvm, mac, sizeof(mac)))
 		return BDB_ERROR_NVM_RW_HMAC;
 	/* TODO: Use safe_memcmp */
 	if (memcmp(mac, nvm->hmac, sizeof(mac)))
@@ -63,16 +89,14 @@ static int nvmrw_verify(const struct bdb_secrets *secrets,
 	return BDB_SUCCESS;
 }
 
-int nvmrw_write(struct vba_context *ctx, enum nvm_type type)
+static int write_nvmrw(struct vba_context *ctx, enum nvm_type type,
+		       const struct vb2_hmac_key *hk)
 {
 	struct nvmrw *nvm = &ctx->nvmrw;
 	int retry = NVM_MAX_WRITE_RETRY;
 	int rv;
 
-	if (!ctx)
-		return BDB_ERROR_NVM_INVALID_PARAMETER;
-
-	if (!ctx->secrets)
+	if (!hk)
 		return BDB_ERROR_NVM_INVALID_SECRET;
 
 	rv = nvmrw_validate(nvm, sizeof(*nvm));
@@ -80,9 +104,7 @@ int nvmrw_write(struct vba_context *ctx, enum nvm_type type)
 		return rv;
 
 	/* Update HMAC */
-	hmac(VB2_HASH_SHA256, ctx->secrets->nvm_rw, BDB_SECRET_SIZE,
-	     nvm, nvm->struct_size - sizeof(nvm->hmac),
-	     nvm->hmac, sizeof(nvm->hmac));
+	nvmrw_hmac(hk, nvm, nvm->hmac, sizeof(nvm->hmac));
 
 	while (retry--) {
 		uint8_t buf[sizeof(struct nvmrw)];
@@ -100,8 +122,18 @@ int nvmrw_write(struct vba_context *ctx, enum nvm_type type)
 	return BDB_ERROR_NVM_WRITE;
 }
 
+int nvmrw_write(struct vba_context *ctx, enum nvm_type type)
+{
+	struct vb2_hmac_key key;
+
+	if (!ctx)
+		return BDB_ERROR_NVM_INVALID_PARAMETER;
+
+	return write_nvmrw(ctx, type, nvmrw_hmac_key(ctx->secrets, &key));
+}
+
 static int read_verify_nvmrw(enum nvm_type type,
-			     const struct bdb_secrets *secrets,
+			     const struct vb2_hmac_key *hk,
 			     uint8_t *buf, uint32_t buf_size)
 {
 	struct nvmrw *nvm = (struct nvmrw *)buf;
@@ -121,7 +153,7 @@ static int read_verify_nvmrw(enum nvm_type type,
 		return BDB_ERROR_NVM_VBE_READ;
 
 	/* Verify the content */
-	rv = nvmrw_verify(secrets, nvm, sizeof(*nvm));
+	rv = nvmrw_verify(hk, nvm, sizeof(*nvm));
 		return rv;
 
 	return BDB_SUCCESS;
@@ -133,15 +165,18 @@ int nvmrw_read(struct vba_context *ctx)
 	uint8_t buf2[NVM_RW_MAX_STRUCT_SIZE];
 	struct nvmrw *nvm1 = (struct nvmrw *)buf1;
 	struct nvmrw *nvm2 = (struct nvmrw *)buf2;
+	struct vb2_hmac_key key;
+	const struct vb2_hmac_key *hk;
 	int rv1, rv2;
 
+	/* Both copies and any rewrites below use the same key */
+	hk = nvmrw_hmac_key(ctx->secrets, &key);
+
 	/* Read and verify the 1st copy */
-	rv1 = read_verify_nvmrw(NVM_TYPE_RW_PRIMARY, ctx->secrets,
-				buf1, sizeof(buf1));
+	rv1 = read_verify_nvmrw(NVM_TYPE_RW_PRIMARY, hk, buf1, sizeof(buf1));
 
 	/* Read and verify the 2nd copy */
-	rv2 = read_verify_nvmrw(NVM_TYPE_RW_SECONDARY, ctx->secrets,
-				buf2, sizeof(buf2));
+	rv2 = read_verify_nvmrw(NVM_TYPE_RW_SECONDARY, hk, buf2, sizeof(buf2));
 
 	if (rv1 == BDB_SUCCESS && rv2 == BDB_SUCCESS) {
 		/* Sync primary and secondary based on update_count. */
@@ -171,14 +206,14 @@ int nvmrw_read(struct vba_context *ctx)
 		ctx->nvmrw.struct_size = sizeof(ctx->nvmrw);
 		/* We don't worry about calculating hmac twice because
 		 * this is a corner case. */
-		rv1 = nvmrw_write(ctx, NVM_TYPE_RW_PRIMARY);
-		rv2 = nvmrw_write(ctx, NVM_TYPE_RW_SECONDARY);
+		rv1 = write_nvmrw(ctx, NVM_TYPE_RW_PRIMARY, hk);
+		rv2 = write_nvmrw(ctx, NVM_TYPE_RW_SECONDARY, hk);
 	} else if (rv1 != BDB_SUCCESS) {
 		/* primary copy is bad. sync it with secondary copy */
-		rv1 = nvmrw_write(ctx, NVM_TYPE_RW_PRIMARY);
+		rv1 = write_nvmrw(ctx, NVM_TYPE_RW_PRIMARY, hk);
 	} else if (rv2 != BDB_SUCCESS){
 		/* secondary copy is bad. sync it with primary copy */
-		rv2 = nvmrw_write(ctx, NVM_TYPE_RW_SECONDARY);
+		rv2 = write_nvmrw(ctx, NVM_TYPE_RW_SECONDARY, hk);
 	} else {
 		/* Both copies are good and versions are same as the reader.
 		 * Skip writing. This should be the common case. */
@@ -203,8 +238,10 @@ int vba_update_kernel_version(struct vba_context *ctx,
 			      uint32_t kernel_version)
 {
 	struct nvmrw *nvm = &ctx->nvmrw;
+	struct vb2_hmac_key key;
+	const struct vb2_hmac_key *hk = nvmrw_hmac_key(ctx->secrets, &key);
 
-	if (nvmrw_verify(ctx->secrets, nvm, sizeof(*nvm))) {
+	if (nvmrw_verify(hk, nvm, sizeof(*nvm))) {
 		if (nvmrw_init(ctx))
 			return BDB_ERROR_NVM_INIT;
 	}
@@ -221,8 +258,8 @@ int vba_update_kernel_version(struct vba_context *ctx,
 		nvm->update_count++;
 
 		/* Update both copies */
-		rv1 = nvmrw_write(ctx, NVM_TYPE_RW_PRIMARY);
-		rv2 = nvmrw_write(ctx, NVM_TYPE_RW_SECONDARY);
+		rv1 = write_nvmrw(ctx, NVM_TYPE_RW_PRIMARY, hk);
+		rv2 = write_nvmrw(ctx, NVM_TYPE_RW_SECONDARY, hk);
 		if (rv1 || rv2)
 			return BDB_ERROR_RECOVERY_REQUEST;
 	}
@@ -234,9 +271,11 @@ int vba_update_buc(struct vba_context *ctx, uint8_t *new_buc)
 {
 	struct nvmrw *nvm = &ctx->nvmrw;
 	uint8_t buc[BUC_ENC_DIGEST_SIZE];
+	struct vb2_hmac_key key;
+	const struct vb2_hmac_key *hk = nvmrw_hmac_key(ctx->secrets, &key);
 	int rv1, rv2;
 
-	if (nvmrw_verify(ctx->secrets, nvm, sizeof(*nvm))) {
+	if (nvmrw_verify(hk, nvm, sizeof(*nvm))) {
 		if (nvmrw_init(ctx))
 			return BDB_ERROR_NVM_INIT;
 	}
@@ -258,8 +297,8 @@ int vba_update_buc(struct vba_context *ctx, uint8_t *new_buc)
 	nvm->update_count++;
 
 	/* Write new BUC */
-	rv1 = nvmrw_write(ctx, NVM_TYPE_RW_PRIMARY);
-	rv2 = nvmrw_write(ctx, NVM_TYPE_RW_SECONDARY);
+	rv1 = write_nvmrw(ctx, NVM_TYPE_RW_PRIMARY, hk);
+	rv2 = write_nvmrw(ctx, NVM_TYPE_RW_SECONDARY, hk);
 	if (rv1 || rv2)
 		return BDB_ERROR_WRITE_BUC;
 
@@ -62,8 +62,20 @@ enum {
 	GPT_UPDATE_ENTRY_INVALID = 4,
 };
 
+/*
+ * Most kernel partitions GptNextKernelEntry() tracks.  This is the largest
+ * number of entries a GPT may have (MAX_NUMBER_OF_ENTRIES).
+ */
+#define GPT_MAX_KERNEL_CANDIDATES 128
+
 /* If this bit is 1, the GPT is stored in another from the streaming data */
 #define GPT_FLAG_EXTERNAL	0x1
+/*
+ * If this bit is 1, AllocAndReadGptData() only reads the secondary GPT if the
+ * primary GPT is bad, and WriteAndFreeGptData() only looks at it if it has to
+ * be written.  Otherwise, both copies are always read and checked.
+ */
+#define GPT_FLAG_LAZY_SECONDARY	0x2
 
 /*
  * A note about stored_on_device and gpt_drive_sectors:
@@ -100,6 +112,12 @@ typedef struct {
 	/* Outputs */
 	/* Which inputs have been modified?  GPT_MODIFIED_* */
 	uint8_t modified;
+	/*
+	 * Which sectors of the primary and secondary entries have been
+	 * modified, one bit per sector.  If GPT_MODIFIED_ENTRIES1 or 2 is set
+	 * and its mask is 0, the whole array has been modified.
+	 */
+	uint32_t modified_sectors1, modified_sectors2;
 	/*
 	 * The current chromeos kernel index in partition table.  -1 means not
 	 * found on drive. Note that GPT partition numbers are traditionally
@@ -109,7 +127,22 @@ typedef struct {
 
 	/* Internal variables */
 	uint8_t valid_headers, valid_entries, ignored;
+	/*
+	 * Which GPT copies AllocAndReadGptData() filled in from the other copy
+	 * instead of reading them from the drive (MASK_*).
+	 */
+	uint8_t unread;
 	int current_priority;
+	/*
+	 * Kernel entries GptNextKernelEntry() may return, in the order it
+	 * returns them, and the priority of each.  kernel_next is the position
+	 * of the next one to return.  The first GptNextKernelEntry() call after
+	 * GptInit() fills these in, taking each entry's priority (including any
+	 * VbExOverrideGptEntryPriority() override) at that point.
+	 */
+	uint8_t kernel_order[GPT_MAX_KERNEL_CANDIDATES];
+	uint8_t kernel_priority[GPT_MAX_KERNEL_CANDIDATES];
+	uint32_t kernel_count, kernel_next;
 } GptData;
 
 /**
@@ -129,6 +162,12 @@ typedef struct {
  * On return the modified field may be set, if the GPT data has been modified
  * and should be written to disk.
  *
+ * This also starts a new walk of the kernels for GptNextKernelEntry().  A
+ * walk keeps the kernel priorities it started with, apart from changes made
+ * by GptUpdateKernelEntry() or GptUpdateKernelWithEntry(), so callers that
+ * change VbExOverrideGptEntryPriority() or the entries directly must call
+ * this again for GptNextKernelEntry() to see the new priorities.
+ *
  * Returns GPT_SUCCESS if successful, non-zero if error:
  *   GPT_ERROR_INVALID_HEADERS, both partition table headers are invalid, enters
  *                              recovery mode,
@@ -182,6 +221,9 @@ size_t GptGetEntrySizeBytes(const GptData *gpt, const GptEntry *e);
  * On return the modified field may be set, if the GPT data has been modified
  * and should be written to disk.
  *
+ * If GptNextKernelEntry() is walking the kernels, the entry is re-sorted
+ * within the current walk without restarting it.
+ *
  * Returns GPT_SUCCESS if successful, else
  *   GPT_ERROR_INVALID_UPDATE_TYPE, invalid 'update_type' is given.
  */
@@ -610,6 +610,37 @@ VbError_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
  */
 VbError_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer);
 
+/**
+ * Start reading from a stream on a disk, without waiting for the data
+ *
+ * @param stream	Stream to read from
+ * @param bytes		Number of bytes to read
+ * @param buffer	Destination to read into
+ *
+ * @return Error code, or VBERROR_SUCCESS if the read was started.
+ *
+ * Optional.  The caller waits for the data with VbExStreamReadWait() before
+ * touching <buffer> or starting another read, and can do other work, such as
+ * hashing the previous chunk, in the meantime.  Only one read is outstanding
+ * per stream.  Firmware which doesn't implement this and VbExStreamReadWait()
+ * gets weak defaults in vboot_reference, which read synchronously with
+ * VbExStreamRead().
+ */
+VbError_t VbExStreamReadAsync(VbExStream_t stream, uint32_t bytes,
+			      void *buffer);
+
+/**
+ * Wait for a read started by VbExStreamReadAsync() to finish
+ *
+ * @param stream	Stream the read was started on
+ *
+ * @return Error code, or VBERROR_SUCCESS.  Failure to read as much data as
+ * requested is an error.
+ *
+ * Optional; implemented together with VbExStreamReadAsync().
+ */
+VbError_t VbExStreamReadWait(VbExStream_t stream);
+
 /**
  * Close a stream
  *
@@ -19,6 +19,7 @@ int GptInit(GptData *gpt)
 	int retval;
 
 	gpt->modified = 0;
+	gpt->modified_sectors1 = gpt->modified_sectors2 = 0;
 	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
 	gpt->current_priority = 999;
 
@@ -32,83 +33,176 @@ int GptInit(GptData *gpt)
 	return GPT_SUCCESS;
 }
 
-int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
+/**
+ * Return the priority of a kernel entry GptNextKernelEntry() may return, or 0
+ * if it may not be returned.
+ */
+static int GetKernelCandidatePriority(const GptEntry *e)
+{
+	if (!IsKernelEntry(e))
+		return 0;
+	if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
+		return 0;
+	return GetEntryPriority(e);
+}
+
+/**
+ * Return non-zero if the walk has already passed the kernel with the given
+ * priority and index.  Kernels are returned in order of decreasing priority,
+ * then increasing index.
+ */
+static int KernelEntryPassed(const GptData *gpt, int priority, int index)
+{
+	return priority > gpt->current_priority ||
+		(priority == gpt->current_priority &&
+		 index <= gpt->current_kernel);
+}
+
+/**
+ * Sort the kernel candidates into the order GptNextKernelEntry() returns
+ * them.
+ *
+ * Priorities only go to 15, so this is a counting sort over the entries in
+ * partition order, which keeps kernels with the same priority in partition
+ * order.
+ */
+static void BuildKernelOrder(GptData *gpt)
 {
 	GptHeader *header = (GptHeader *)gpt->primary_header;
 	GptEntry *entries = (GptEntry *)gpt->primary_entries;
-	GptEntry *e;
-	int new_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
-	int new_prio = 0;
+	uint8_t priority[GPT_MAX_KERNEL_CANDIDATES];
+	uint32_t first[CGPT_ATTRIBUTE_MAX_PRIORITY + 2];
+	uint32_t count = header->number_of_entries;
 	uint32_t i;
+	int p;
 
-	/*
-	 * If we already found a kernel, continue the scan at the current
-	 * kernel's priority, in case there is another kernel with the same
-	 * priority.
-	 */
-	if (gpt->current_kernel != CGPT_KERNEL_ENTRY_NOT_FOUND) {
-		for (i = gpt->current_kernel + 1;
-		     i < header->number_of_entries; i++) {
-			e = entries + i;
-			if (!IsKernelEntry(e))
-				continue;
-			VB2_DEBUG("GptNextKernelEntry looking at same prio "
-				  "partition %d\n", i+1);
-			VB2_DEBUG("GptNextKernelEntry s%d t%d p%d\n",
-				  GetEntrySuccessful(e), GetEntryTries(e),
-				  GetEntryPriority(e));
-			if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
-				continue;
-			if (GetEntryPriority(e) == gpt->current_priority) {
-				gpt->current_kernel = i;
-				*start_sector = e->starting_lba;
-				*size = e->ending_lba - e->starting_lba + 1;
-				VB2_DEBUG("GptNextKernelEntry likes it\n");
-				return GPT_SUCCESS;
-			}
-		}
+	/* GptInit() doesn't accept tables larger than this */
+	if (count > GPT_MAX_KERNEL_CANDIDATES)
+		count = GPT_MAX_KERNEL_CANDIDATES;
+
+	memset(first, 0, sizeof(first));
+	for (i = 0; i < count; i++) {
+		priority[i] = GetKernelCandidatePriority(entries + i);
+		if (IsKernelEntry(entries + i))
+			VB2_DEBUG("GptNextKernelEntry partition %d s%d t%d "
+				  "p%d\n", i + 1,
+				  GetEntrySuccessful(entries + i),
+				  GetEntryTries(entries + i), priority[i]);
+		if (priority[i])
+			first[priority[i]]++;
 	}
 
-	/*
-	 * We're still here, so scan for the remaining kernel with the highest
-	 * priority less than the previous attempt.
-	 */
-	for (i = 0, e = entries; i < header->number_of_entries; i++, e++) {
-		int current_prio = GetEntryPriority(e);
-		if (!IsKernelEntry(e))
-			continue;
-		VB2_DEBUG("GptNextKernelEntry looking at new prio "
-			  "partition %d\n", i+1);
-		VB2_DEBUG("GptNextKernelEntry s%d t%d p%d\n",
-			  GetEntrySuccessful(e), GetEntryTries(e),
-			  GetEntryPriority(e));
-		if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
+	/* Each priority starts after all the higher ones */
+	gpt->kernel_count = 0;
+	for (p = CGPT_ATTRIBUTE_MAX_PRIORITY; p > 0; p--) {
+		uint32_t n = first[p];
+
+		first[p] = gpt->kernel_count;
+		gpt->kernel_count += n;
+	}
+
+	for (i = 0; i < count; i++) {
+		uint32_t pos;
+
+		if (!priority[i])
 			continue;
-		if (current_prio >= gpt->current_priority) {
-			/* Already returned this kernel in a previous call */
+		pos = first[priority[i]]++;
+		gpt->kernel_order[pos] = i;
+		gpt->kernel_priority[pos] = priority[i];
+	}
+
+	/* Skip kernels already returned, if the walk has ended */
+	for (gpt->kernel_next = 0; gpt->kernel_next < gpt->kernel_count;
+	     gpt->kernel_next++) {
+		i = gpt->kernel_next;
+		if (!KernelEntryPassed(gpt, gpt->kernel_priority[i],
+				       gpt->kernel_order[i]))
+			break;
+	}
+}
+
+/**
+ * Move a kernel entry to its place in the order after it has been updated,
+ * adding or removing it if it became or stopped being a candidate.
+ */
+static void UpdateKernelOrder(GptData *gpt, const GptEntry *e)
+{
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+	GptEntry *entries = (GptEntry *)gpt->primary_entries;
+	uint8_t *order = gpt->kernel_order;
+	uint8_t *priority = gpt->kernel_priority;
+	uint32_t index, pos, n;
+	int p;
+
+	/* Only primary entries are in the order */
+	if (e < entries)
+		return;
+	index = e - entries;
+	if (index >= header->number_of_entries ||
+	    index >= GPT_MAX_KERNEL_CANDIDATES)
+		return;
+
+	for (pos = 0; pos < gpt->kernel_count; pos++) {
+		if (order[pos] != index)
 			continue;
-		}
-		if (current_prio > new_prio) {
-			new_kernel = i;
-			new_prio = current_prio;
-		}
+		n = gpt->kernel_count - pos - 1;
+		memmove(order + pos, order + pos + 1, n);
+		memmove(priority + pos, priority + pos + 1, n);
+		gpt->kernel_count--;
+		if (pos < gpt->kernel_next)
+			gpt->kernel_next--;
+		break;
 	}
 
+	p = GetKernelCandidatePriority(e);
+	if (!p)
+		return;
+
+	for (pos = 0; pos < gpt->kernel_count; pos++) {
+		if (p > priority[pos] ||
+		    (p == priority[pos] && index < order[pos]))
+			break;
+	}
+	n = gpt->kernel_count - pos;
+	memmove(order + pos + 1, order + pos, n);
+	memmove(priority + pos + 1, priority + pos, n);
+	order[pos] = index;
+	priority[pos] = p;
+	gpt->kernel_count++;
+
+	/* Don't return it again if the walk is already past it */
+	if (KernelEntryPassed(gpt, p, index))
+		gpt->kernel_next++;
+}
+
+int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
+{
+	GptEntry *entries = (GptEntry *)gpt->primary_entries;
+	GptEntry *e;
+	uint32_t pos;
+
+	/* Work out the order at the start of the walk */
+	if (gpt->current_kernel == CGPT_KERNEL_ENTRY_NOT_FOUND)
+		BuildKernelOrder(gpt);
+
 	/*
-	 * Save what we found.  Note that if we didn't find a new kernel,
-	 * new_prio will still be -1, so future calls to this function will
-	 * also fail.
+	 * If we didn't find a new kernel, note that the walk has ended, so
+	 * future calls to this function will also fail.
 	 */
-	gpt->current_kernel = new_kernel;
-	gpt->current_priority = new_prio;
-
-	if (CGPT_KERNEL_ENTRY_NOT_FOUND == new_kernel) {
+	if (gpt->kernel_next >= gpt->kernel_count) {
+		gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+		gpt->current_priority = 0;
 		VB2_DEBUG("GptNextKernelEntry no more kernels\n");
 		return GPT_ERROR_NO_VALID_KERNEL;
 	}
 
-	VB2_DEBUG("GptNextKernelEntry likes partition %d\n", new_kernel + 1);
-	e = entries + new_kernel;
+	pos = gpt->kernel_next++;
+	gpt->current_kernel = gpt->kernel_order[pos];
+	gpt->current_priority = gpt->kernel_priority[pos];
+
+	VB2_DEBUG("GptNextKernelEntry likes partition %d\n",
+		  gpt->current_kernel + 1);
+	e = entries + gpt->current_kernel;
 	*start_sector = e->starting_lba;
 	*size = e->ending_lba - e->starting_lba + 1;
 	return GPT_SUCCESS;
@@ -121,11 +215,14 @@ int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
  */
 int GptUpdateKernelWithEntry(GptData *gpt, GptEntry *e, uint32_t update_type)
 {
+	GptEntry old;
 	int modified = 0;
 
 	if (!IsKernelEntry(e))
 		return GPT_ERROR_INVALID_UPDATE_TYPE;
 
+	memcpy(&old, e, sizeof(old));
+
 	switch (update_type) {
 	case GPT_UPDATE_ENTRY_TRY: {
 		/* Used up a try */
@@ -186,7 +283,10 @@ int GptUpdateKernelWithEntry(GptData *gpt, GptEntry *e, uint32_t update_type)
 	}
 
 	if (modified) {
-		GptModified(gpt);
+		GptEntryModified(gpt, e, &old);
+		/* Keep the order of an ongoing walk up to date */
+		if (gpt->current_kernel != CGPT_KERNEL_ENTRY_NOT_FOUND)
+			UpdateKernelOrder(gpt, e);
 	}
 
 	return GPT_SUCCESS;
@@ -161,21 +161,74 @@ int IsKernelEntry(const GptEntry *e)
 	return !memcmp(&e->type, &chromeos_kernel, sizeof(Guid));
 }
 
-int CheckEntries(GptEntry *entries, GptHeader *h)
+typedef int (*EntryCompare)(const GptEntry *e1, const GptEntry *e2);
+
+static int CompareStartingLba(const GptEntry *e1, const GptEntry *e2)
+{
+	if (e1->starting_lba < e2->starting_lba)
+		return -1;
+	return e1->starting_lba > e2->starting_lba;
+}
+
+static int CompareUniqueGuid(const GptEntry *e1, const GptEntry *e2)
+{
+	return memcmp(&e1->unique, &e2->unique, sizeof(Guid));
+}
+
+/**
+ * Heapsort the entry indices in order[] by the comparison function.
+ *
+ * Heapsort needs no recursion or extra memory, and is O(n log n) for any
+ * input, so a crafted table can't make firmware slow.
+ */
+static void SortEntries(const GptEntry *entries, uint16_t *order,
+			uint32_t count, EntryCompare compare)
+{
+	uint32_t start = count / 2;
+	uint32_t end = count;
+	uint32_t root, child;
+	uint16_t tmp;
+
+	while (end > 1) {
+		if (start > 0) {
+			/* Building the heap */
+			start--;
+		} else {
+			/* Move the largest entry to the end */
+			end--;
+			tmp = order[end];
+			order[end] = order[0];
+			order[0] = tmp;
+		}
+
+		/* Sift order[start] down to its place in the heap */
+		for (root = start; (child = 2 * root + 1) < end; root = child) {
+			if (child + 1 < end &&
+			    compare(entries + order[child],
+				    entries + order[child + 1]) < 0)
+				child++;
+			if (compare(entries + order[root],
+				    entries + order[child]) >= 0)
+				break;
+			tmp = order[root];
+			order[root] = order[child];
+			order[child] = tmp;
+		}
+	}
+}
+
+/**
+ * Compare every used entry against every other.
+ *
+ * This is O(n^2), so it's only used to work out which error to report once
+ * the table is known to be bad.  Reporting the first bad entry in table order
+ * keeps the error codes the same no matter how the entries sort.
+ */
+static int CheckEntriesPairwise(GptEntry *entries, GptHeader *h)
 {
-	if (!entries)
-		return GPT_ERROR_INVALID_ENTRIES;
 	GptEntry *entry;
-	uint32_t crc32;
 	uint32_t i;
 
-	/* Check CRC before examining entries. */
-	crc32 = Crc32((const uint8_t *)entries,
-		      h->size_of_entry * h->number_of_entries);
-	if (crc32 != h->entries_crc32)
-		return GPT_ERROR_CRC_CORRUPTED;
-
-	/* Check all entries. */
 	for (i = 0, entry = entries; i < h->number_of_entries; i++, entry++) {
 		GptEntry *e2;
 		uint32_t i2;
@@ -213,6 +266,69 @@ int CheckEntries(GptEntry *entries, GptHeader *h)
 	return 0;
 }
 
+int CheckEntries(GptEntry *entries, GptHeader *h)
+{
+	if (!entries)
+		return GPT_ERROR_INVALID_ENTRIES;
+	/* Indices of the used entries, kept on the stack so firmware doesn't
+	 * need to allocate */
+	uint16_t order[MAX_NUMBER_OF_ENTRIES];
+	GptEntry *entry, *prev;
+	uint32_t crc32;
+	uint32_t count = 0;
+	uint32_t i;
+
+	/* Check CRC before examining entries. */
+	crc32 = Crc32((const uint8_t *)entries,
+		      h->size_of_entry * h->number_of_entries);
+	if (crc32 != h->entries_crc32)
+		return GPT_ERROR_CRC_CORRUPTED;
+
+	/* CheckHeader() never accepts more entries than the array holds */
+	if (h->number_of_entries > MAX_NUMBER_OF_ENTRIES)
+		return CheckEntriesPairwise(entries, h);
+
+	/*
+	 * Check each used entry is in the valid region, and collect their
+	 * indices for sorting.
+	 */
+	for (i = 0, entry = entries; i < h->number_of_entries; i++, entry++) {
+		if (IsUnusedEntry(entry))
+			continue;
+
+		if ((entry->starting_lba < h->first_usable_lba) ||
+		    (entry->ending_lba > h->last_usable_lba) ||
+		    (entry->ending_lba < entry->starting_lba))
+			return CheckEntriesPairwise(entries, h);
+
+		order[count++] = i;
+	}
+
+	/*
+	 * Sorted by starting LBA, no entry may start at or before the end of
+	 * the one before it.  If none do, the ending LBAs are sorted too, so
+	 * checking neighbors finds any overlap.
+	 */
+	SortEntries(entries, order, count, CompareStartingLba);
+	for (i = 1; i < count; i++) {
+		entry = entries + order[i];
+		prev = entries + order[i - 1];
+		if (entry->starting_lba <= prev->ending_lba)
+			return CheckEntriesPairwise(entries, h);
+	}
+
+	/* Sorted by UniqueGuid, any duplicates are neighbors. */
+	SortEntries(entries, order, count, CompareUniqueGuid);
+	for (i = 1; i < count; i++) {
+		if (0 == CompareUniqueGuid(entries + order[i],
+					   entries + order[i - 1]))
+			return CheckEntriesPairwise(entries, h);
+	}
+
+	/* Success */
+	return 0;
+}
+
 int HeaderFieldsSame(GptHeader *h1, GptHeader *h2)
 {
 	if (memcmp(h1->signature, h2->signature, sizeof(h1->signature)))
@@ -330,6 +446,7 @@ int GptSanityCheck(GptData *gpt)
 	if (MASK_NONE != gpt->ignored) {
 		GptRepair(gpt);
 		gpt->modified = 0;
+		gpt->modified_sectors1 = gpt->modified_sectors2 = 0;
 	}
 
 	return GPT_SUCCESS;
@@ -377,11 +494,13 @@ void GptRepair(GptData *gpt)
 		/* Primary is good, secondary is bad */
 		memcpy(entries2, entries1, entries_size);
 		gpt->modified |= GPT_MODIFIED_ENTRIES2;
+		gpt->modified_sectors2 = 0;
 	}
 	else if (MASK_SECONDARY == gpt->valid_entries) {
 		/* Secondary is good, primary is bad */
 		memcpy(entries1, entries2, entries_size);
 		gpt->modified |= GPT_MODIFIED_ENTRIES1;
+		gpt->modified_sectors1 = 0;
 	}
 	gpt->valid_entries = MASK_BOTH;
 }
@@ -469,6 +588,7 @@ void GptModified(GptData *gpt) {
 				      header->number_of_entries);
 	header->header_crc32 = HeaderCrc(header);
 	gpt->modified |= GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1;
+	gpt->modified_sectors1 = 0;
 
 	/*
 	 * Use the repair function to update the other copy of the GPT.  This
@@ -480,6 +600,65 @@ void GptModified(GptData *gpt) {
 	GptRepair(gpt);
 }
 
+/**
+ * Mark a sector of one copy of the entries as needing to be written.
+ */
+static void MarkEntriesSector(GptData *gpt, uint8_t entries_bit,
+			      uint32_t *sectors, uint32_t sector_bit)
+{
+	/* If the whole array is already being written, leave it that way */
+	if ((gpt->modified & entries_bit) && !*sectors)
+		return;
+
+	gpt->modified |= entries_bit;
+	*sectors |= sector_bit;
+}
+
+void GptEntryModified(GptData *gpt, const GptEntry *e, const GptEntry *old)
+{
+	GptHeader *header1 = (GptHeader *)gpt->primary_header;
+	GptHeader *header2 = (GptHeader *)gpt->secondary_header;
+	GptEntry *entries1 = (GptEntry *)gpt->primary_entries;
+	GptEntry *entries2 = (GptEntry *)gpt->secondary_entries;
+	uint32_t entries_size, offset, sector;
+
+	/*
+	 * Patching the CRCs in place needs both copies to be valid, which
+	 * GptInit() leaves them.  Otherwise, recalculate everything.
+	 */
+	if (gpt->valid_headers != MASK_BOTH ||
+	    gpt->valid_entries != MASK_BOTH ||
+	    e < entries1 || e >= entries1 + header1->number_of_entries ||
+	    header1->size_of_entry != sizeof(GptEntry)) {
+		GptModified(gpt);
+		return;
+	}
+
+	entries_size = header1->size_of_entry * header1->number_of_entries;
+	offset = (e - entries1) * sizeof(GptEntry);
+	sector = offset / gpt->sector_bytes;
+	if (sector >= 32) {
+		GptModified(gpt);
+		return;
+	}
+
+	/* Both copies of the entries are the same, so share one CRC */
+	header1->entries_crc32 = Crc32Update(header1->entries_crc32, old, e,
+					     sizeof(GptEntry),
+					     entries_size - offset -
+					     sizeof(GptEntry));
+	header1->header_crc32 = HeaderCrc(header1);
+	header2->entries_crc32 = header1->entries_crc32;
+	header2->header_crc32 = HeaderCrc(header2);
+	memcpy(entries2 + (e - entries1), e, sizeof(GptEntry));
+
+	gpt->modified |= GPT_MODIFIED_HEADER1 | GPT_MODIFIED_HEADER2;
+	MarkEntriesSector(gpt, GPT_MODIFIED_ENTRIES1, &gpt->modified_sectors1,
+			  1U << sector);
+	MarkEntriesSector(gpt, GPT_MODIFIED_ENTRIES2, &gpt->modified_sectors2,
+			  1U << sector);
+}
+
 
 const char *GptErrorText(int error_code)
 {
@@ -0,0 +1,114 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * CRC32 using PCLMULQDQ, for x86-64 host utilities.  This folds the buffer
+ * 64 bytes at a time with carry-less multiplies and then does a Barrett
+ * reduction, as described in Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction".  The constants are for the
+ * bit-reflected polynomial 0xedb88320 used by GPT.
+ */
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#include "sysincludes.h"
+
+#include "crc32.h"
+
+#define TARGET __attribute__((target("pclmul,sse4.1")))
+
+int Crc32PclmulSupported(void)
+{
+	static int supported = -1;
+	unsigned int eax, ebx, ecx, edx;
+
+	if (supported < 0) {
+		supported = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+			(ecx & bit_PCLMUL) && (ecx & bit_SSE4_1);
+	}
+	return supported;
+}
+
+TARGET
+uint32_t Crc32Pclmul(uint32_t crc, const uint8_t *buffer, uint32_t len)
+{
+	/* x^(4*128+32) and x^(4*128-32) mod P, for folding by 64 bytes */
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	/* x^(128+32) and x^(128-32) mod P, for folding by 16 bytes */
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	/* x^64 mod P, for folding 96 bits to 64 */
+	const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124);
+	/* P and floor(x^64 / P), for the Barrett reduction */
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, t1, t2, t3, t4;
+
+	x1 = _mm_loadu_si128((const __m128i *)(buffer + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(buffer + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(buffer + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(buffer + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	buffer += 64;
+	len -= 64;
+
+	/* Fold four blocks in parallel while there are 64 bytes left */
+	while (len >= 64) {
+		t1 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		t2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		t3 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		t4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), _mm_loadu_si128(
+				(const __m128i *)(buffer + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, t2), _mm_loadu_si128(
+				(const __m128i *)(buffer + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, t3), _mm_loadu_si128(
+				(const __m128i *)(buffer + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, t4), _mm_loadu_si128(
+				(const __m128i *)(buffer + 0x30)));
+		buffer += 64;
+		len -= 64;
+	}
+
+	/* Fold the four accumulators into one */
+	t1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), x2);
+	t1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), x3);
+	t1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), x4);
+
+	/* Then any remaining 16-byte blocks */
+	while (len >= 16) {
+		t1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), _mm_loadu_si128(
+				(const __m128i *)buffer));
+		buffer += 16;
+		len -= 16;
+	}
+
+	/* Fold 128 bits to 64 */
+	t1 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), t1);
+	t1 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask32);
+	x1 = _mm_clmulepi64_si128(x1, k5, 0x00);
+	x1 = _mm_xor_si128(x1, t1);
+
+	/* Barrett reduction to 32 bits */
+	t1 = _mm_and_si128(x1, mask32);
+	t1 = _mm_clmulepi64_si128(t1, poly, 0x10);
+	t1 = _mm_and_si128(t1, mask32);
+	t1 = _mm_clmulepi64_si128(t1, poly, 0x00);
+	x1 = _mm_xor_si128(x1, t1);
+
+	return _mm_extract_epi32(x1, 1);
+}
@@ -11,7 +11,12 @@
 
 /**
  * Provides the location of the next kernel partition, in order of decreasing
- * priority.
+ * priority.  Kernels with the same priority are returned in partition order.
+ *
+ * The order is worked out by the first call after GptInit(), so later calls
+ * take constant time.  Changes made through GptUpdateKernelEntry() or
+ * GptUpdateKernelWithEntry() are reflected in the order; changes made to the
+ * entries directly aren't seen until the next GptInit().
  *
  * On return the start_sector parameter contains the LBA sector for the start
  * of the kernel partition, and the size parameter contains the size of the
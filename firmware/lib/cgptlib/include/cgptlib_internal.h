@@ -145,6 +145,17 @@ void GptRepair(GptData *gpt);
  */
 void GptModified(GptData *gpt);
 
+/**
+ * Called when a single primary entry is modified.  Patches the CRCs for the
+ * change and copies it to the secondary entries, marking only the sector
+ * holding the entry as needing to be written.
+ *
+ * @param gpt		GPT data
+ * @param e		Modified entry, in the primary entries
+ * @param old		Copy of the entry before it was modified
+ */
+void GptEntryModified(GptData *gpt, const GptEntry *e, const GptEntry *old);
+
 /**
  * Return 1 if the entry is a Chrome OS kernel partition, else 0.
  */
@@ -9,4 +9,67 @@
 
 uint32_t Crc32(const void *buffer, uint32_t len);
 
+/**
+ * Update the CRC32 of a buffer after a few of its bytes change, without
+ * reading the rest of the buffer.
+ *
+ * @param crc		Crc32() of the buffer before the change
+ * @param old		Old contents of the changed bytes
+ * @param new		New contents of the changed bytes
+ * @param len		Number of changed bytes
+ * @param after		Number of bytes in the buffer after the changed ones
+ * @return Crc32() of the buffer after the change.
+ */
+uint32_t Crc32Update(uint32_t crc, const void *old, const void *new,
+		     uint32_t len, uint32_t after);
+
+#ifdef CRC32_X86
+/*
+ * Below this size the setup and final reduction of the PCLMULQDQ code cost
+ * more than the table lookups they save.
+ */
+#define CRC32_PCLMUL_MIN_SIZE 64
+
+/**
+ * Return non-zero if the CPU supports Crc32Pclmul().
+ */
+int Crc32PclmulSupported(void);
+
+/**
+ * Update a CRC32 using carry-less multiplication.
+ *
+ * @param crc		Current CRC value, before the final inversion
+ * @param buffer	Data to add
+ * @param len		Length of data; must be a multiple of 16 and at least
+ *			CRC32_PCLMUL_MIN_SIZE.
+ * @return The updated CRC value, before the final inversion.
+ */
+uint32_t Crc32Pclmul(uint32_t crc, const uint8_t *buffer, uint32_t len);
+#endif
+
+#ifdef CHROMEOS_ENVIRONMENT
+/* CRC32 implementations, for testing and benchmarking */
+enum crc32_impl {
+	/* Fastest implementation the CPU supports */
+	CRC32_IMPL_BEST = 0,
+	/* One table lookup per byte */
+	CRC32_IMPL_BYTEWISE,
+	/* Eight table lookups per eight bytes */
+	CRC32_IMPL_SLICE8,
+	/* x86-64 PCLMULQDQ folding */
+	CRC32_IMPL_PCLMUL,
+
+	CRC32_IMPL_COUNT
+};
+
+/**
+ * Force Crc32() to use a particular implementation.
+ *
+ * @param impl		Implementation to use
+ * @return 0 if success, non-zero if the implementation isn't available on
+ * this build or CPU.
+ */
+int Crc32SetImpl(enum crc32_impl impl);
+#endif
+
 #endif  /* VBOOT_REFERENCE_GPT_CRC32_H_ */
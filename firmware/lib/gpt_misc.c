@@ -19,7 +19,9 @@
  * Allocate and read GPT data from the drive.
  *
  * The sector_bytes and gpt_drive_sectors fields should be filled on input.  The
- * primary and secondary header and entries are filled on output.
+ * primary and secondary header and entries are filled on output.  With
+ * GPT_FLAG_LAZY_SECONDARY, a valid primary GPT is also used to fill in the
+ * secondary GPT, which is then not read.
  *
  * Returns 0 if successful, 1 if error.
  */
@@ -30,8 +32,10 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 
 	/* No data to be written yet */
 	gptdata->modified = 0;
+	gptdata->modified_sectors1 = gptdata->modified_sectors2 = 0;
 	/* This should get overwritten by GptInit() */
 	gptdata->ignored = 0;
+	gptdata->unread = 0;
 
 	/* Allocate all buffers */
 	gptdata->primary_header = (uint8_t *)malloc(gptdata->sector_bytes);
@@ -80,6 +84,24 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 			  ? "invalid" : "being ignored");
 	}
 
+	/*
+	 * If the primary GPT is good and we don't need to look at the secondary
+	 * GPT until it's written, make it look in memory like the primary one,
+	 * the same way GptSanityCheck() does for an ignored GPT.
+	 */
+	if ((gptdata->flags & GPT_FLAG_LAZY_SECONDARY) && primary_valid &&
+	    0 == CheckEntries((GptEntry *)gptdata->primary_entries,
+			      primary_header)) {
+		VB2_DEBUG("Primary GPT is valid; not reading secondary GPT\n");
+		memset(gptdata->secondary_header, 0, gptdata->sector_bytes);
+		gptdata->valid_headers = gptdata->valid_entries = MASK_PRIMARY;
+		GptRepair(gptdata);
+		gptdata->modified = 0;
+		gptdata->modified_sectors2 = 0;
+		gptdata->unread = MASK_SECONDARY;
+		return 0;
+	}
+
 	/* Read secondary header from the end of the drive */
 	if (0 != VbExDiskRead(disk_handle, gptdata->gpt_drive_sectors - 1, 1,
 			      gptdata->secondary_header)) {
@@ -119,6 +141,82 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	return (primary_valid || secondary_valid) ? 0 : 1;
 }
 
+/**
+ * Write the modified sectors of a GPT entries array.
+ *
+ * @param disk_handle	Disk to write to
+ * @param gptdata	GPT data
+ * @param entries_lba	First sector of the entries on the disk
+ * @param entries_sectors	Number of sectors of entries
+ * @param entries	Entries to write
+ * @param sectors	Modified sectors, one bit per sector, or 0 to write
+ *			them all
+ * @return 0 if successful, 1 if error.
+ */
+static int WriteEntries(VbExDiskHandle_t disk_handle, GptData *gptdata,
+			uint64_t entries_lba, uint64_t entries_sectors,
+			const uint8_t *entries, uint32_t sectors)
+{
+	uint64_t start, end;
+
+	if (!sectors)
+		return VbExDiskWrite(disk_handle, entries_lba, entries_sectors,
+				     entries) ? 1 : 0;
+
+	/* Write each run of modified sectors */
+	for (start = 0; start < entries_sectors && start < 32; start++) {
+		if (!(sectors & (1U << start)))
+			continue;
+
+		end = start + 1;
+		while (end < entries_sectors && end < 32 &&
+		       (sectors & (1U << end)))
+			end++;
+
+		if (0 != VbExDiskWrite(disk_handle, entries_lba + start,
+				       end - start,
+				       entries + start * gptdata->sector_bytes))
+			return 1;
+
+		/* Sector end isn't modified, so carry on after it */
+		start = end;
+	}
+
+	return 0;
+}
+
+/**
+ * Prepare to write a secondary GPT which AllocAndReadGptData() didn't read.
+ *
+ * Reads the secondary header from the drive to see if it's being ignored.  If
+ * not, the whole secondary GPT is written, since we don't know what's on the
+ * drive.
+ *
+ * @param disk_handle	Disk to read from
+ * @param gptdata	GPT data
+ */
+static void PrepareUnreadSecondary(VbExDiskHandle_t disk_handle,
+				   GptData *gptdata)
+{
+	GptHeader *h = (GptHeader *)malloc(gptdata->sector_bytes);
+
+	if (h && 0 == VbExDiskRead(disk_handle, gptdata->gpt_drive_sectors - 1,
+				   1, h) &&
+	    !memcmp(h->signature, GPT_HEADER_SIGNATURE_IGNORED,
+		    GPT_HEADER_SIGNATURE_SIZE)) {
+		VB2_DEBUG("Not updating secondary GPT: "
+			  "marked to be ignored.\n");
+		gptdata->ignored |= MASK_SECONDARY;
+	} else {
+		gptdata->modified |= GPT_MODIFIED_HEADER2 |
+			GPT_MODIFIED_ENTRIES2;
+		gptdata->modified_sectors2 = 0;
+	}
+
+	if (h)
+		free(h);
+}
+
 /**
  * Write any changes for the GPT data back to the drive, then free the buffers.
  *
@@ -172,15 +270,22 @@ int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	if (gptdata->primary_entries && !skip_primary) {
 		if (gptdata->modified & GPT_MODIFIED_ENTRIES1) {
 			VB2_DEBUG("Updating GPT entries 1\n");
-			if (0 != VbExDiskWrite(disk_handle, entries_lba,
-					       entries_sectors,
-					       gptdata->primary_entries))
+			if (0 != WriteEntries(disk_handle, gptdata,
+					      entries_lba, entries_sectors,
+					      gptdata->primary_entries,
+					      gptdata->modified_sectors1))
 				goto fail;
 		}
 	}
 
 	entries_lba = (gptdata->gpt_drive_sectors - entries_sectors -
 		GPT_HEADER_SECTORS);
+	if ((gptdata->unread & MASK_SECONDARY) &&
+	    (gptdata->modified & (GPT_MODIFIED_HEADER2 |
+				  GPT_MODIFIED_ENTRIES2)) &&
+	    !(gptdata->ignored & MASK_SECONDARY))
+		PrepareUnreadSecondary(disk_handle, gptdata);
+
 	if (gptdata->secondary_header && !(gptdata->ignored & MASK_SECONDARY)) {
 		GptHeader *h = (GptHeader *)(gptdata->secondary_header);
 		entries_lba = h->entries_lba;
@@ -196,9 +301,10 @@ int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	if (gptdata->secondary_entries && !(gptdata->ignored & MASK_SECONDARY)){
 		if (gptdata->modified & GPT_MODIFIED_ENTRIES2) {
 			VB2_DEBUG("Updating GPT entries 2\n");
-			if (0 != VbExDiskWrite(disk_handle,
-					       entries_lba, entries_sectors,
-					       gptdata->secondary_entries))
+			if (0 != WriteEntries(disk_handle, gptdata,
+					      entries_lba, entries_sectors,
+					      gptdata->secondary_entries,
+					      gptdata->modified_sectors2))
 				goto fail;
 		}
 	}
@@ -18,6 +18,8 @@ struct vb2_context;
 /* Boot flags for LoadKernel().boot_flags */
 /* GPT is external */
 #define BOOT_FLAG_EXTERNAL_GPT (0x04ULL)
+/* Only read the secondary GPT if the primary GPT is bad or it's written */
+#define BOOT_FLAG_LAZY_GPT (0x08ULL)
 
 struct RollbackSpaceFwmp;
 
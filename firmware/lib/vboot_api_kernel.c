@@ -123,6 +123,12 @@ uint32_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 						?: lkp.gpt_lba_count;
 		lkp.boot_flags |= disk_info[i].flags & VB_DISK_FLAG_EXTERNAL_GPT
 				? BOOT_FLAG_EXTERNAL_GPT : 0;
+		/*
+		 * Removable media are booted once (recovery, USB boot), so
+		 * don't seek to the end of them for a GPT copy we won't use.
+		 */
+		lkp.boot_flags |= disk_info[i].flags & VB_DISK_FLAG_REMOVABLE
+				? BOOT_FLAG_LAZY_GPT : 0;
 		retval = LoadKernel(ctx, &lkp);
 
 		VB2_DEBUG("VbTryLoadKernel() LoadKernel() = %d\n", retval);
@@ -29,6 +29,26 @@
 
 #define LOWEST_TPM_VERSION 0xffffffff
 
+/* Bytes of kernel body to read and hash at a time */
+#define KBODY_CHUNK_SIZE (1024 * 1024)
+
+/*
+ * Default asynchronous stream reads, for firmware which doesn't overlap I/O
+ * with other work.  These just do the read up front.
+ */
+__attribute__((weak))
+VbError_t VbExStreamReadAsync(VbExStream_t stream, uint32_t bytes,
+			      void *buffer)
+{
+	return VbExStreamRead(stream, bytes, buffer);
+}
+
+__attribute__((weak))
+VbError_t VbExStreamReadWait(VbExStream_t stream)
+{
+	return VBERROR_SUCCESS;
+}
+
 enum vboot_mode {
 	kBootRecovery = 0,  /* Recovery firmware, any dev switch position */
 	kBootNormal = 1,    /* Normal boot - kernel must be verified */
@@ -300,6 +320,57 @@ enum vb2_load_partition_flags {
 #define VB2_LOAD_PARTITION_WORKBUF_BYTES	\
 	(VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES + KBUF_SIZE)
 
+/**
+ * Read the rest of the kernel body and add it to a digest.
+ *
+ * The body is read in chunks.  Each chunk is hashed while the next one is
+ * being read, if the stream supports VbExStreamReadAsync().
+ *
+ * @param stream	Stream to read from
+ * @param buf		Destination for the body data
+ * @param size		Number of bytes to read
+ * @param dc		Digest context to extend
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+static int vb2_read_and_hash_body(VbExStream_t stream, uint8_t *buf,
+				  uint32_t size, struct vb2_digest_context *dc)
+{
+	uint32_t chunk = size < KBODY_CHUNK_SIZE ? size : KBODY_CHUNK_SIZE;
+	uint32_t next;
+	int rv;
+
+	if (!size)
+		return VB2_SUCCESS;
+
+	if (VbExStreamReadAsync(stream, chunk, buf))
+		return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+
+	while (size) {
+		if (VbExStreamReadWait(stream))
+			return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+
+		/* Start on the next chunk before hashing this one */
+		next = size - chunk;
+		if (next > KBODY_CHUNK_SIZE)
+			next = KBODY_CHUNK_SIZE;
+		if (next && VbExStreamReadAsync(stream, next, buf + chunk))
+			return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+
+		rv = vb2_digest_extend(dc, buf, chunk);
+		if (rv) {
+			if (next)
+				VbExStreamReadWait(stream);
+			return rv;
+		}
+
+		buf += chunk;
+		size -= chunk;
+		chunk = next;
+	}
+
+	return VB2_SUCCESS;
+}
+
 /**
  * Load and verify a partition from the stream.
  *
@@ -373,6 +444,27 @@ int vb2_load_partition(struct vb2_context *ctx,
 		return 	VB2_ERROR_LOAD_PARTITION_BODY_SIZE;
 	}
 
+	/*
+	 * Get key for data verification from the key block.  This is needed
+	 * up front so the body can be hashed as it's read.
+	 */
+	struct vb2_public_key data_key;
+	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key)) {
+		VB2_DEBUG("Unable to unpack kernel data key\n");
+		shpart->check_result = VBSD_LKP_CHECK_DATA_KEY_PARSE;
+		return VB2_ERROR_LOAD_PARTITION_DATA_KEY;
+	}
+
+	uint32_t digest_size = vb2_digest_size(data_key.hash_alg);
+	uint8_t *digest = vb2_workbuf_alloc(&wblocal, digest_size);
+	struct vb2_digest_context *dc =
+		vb2_workbuf_alloc(&wblocal, sizeof(*dc));
+	if (!digest_size || !digest || !dc ||
+	    vb2_digest_init(dc, data_key.hash_alg)) {
+		shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
+		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+	}
+
 	uint32_t body_toread = preamble->body_signature.data_size;
 	uint8_t *body_readptr = kernbuf;
 
@@ -387,25 +479,25 @@ int vb2_load_partition(struct vb2_context *ctx,
 	body_toread -= body_copied;
 	body_readptr += body_copied;
 
-	/* Read the kernel data */
-	if (body_toread && VbExStreamRead(stream, body_toread, body_readptr)) {
+	/* Hash what we have, then read and hash the rest of the kernel */
+	int rv = vb2_digest_extend(dc, kernbuf, body_copied);
+	if (!rv)
+		rv = vb2_read_and_hash_body(stream, body_readptr,
+					    body_toread, dc);
+	if (rv == VB2_ERROR_LOAD_PARTITION_READ_BODY) {
 		VB2_DEBUG("Unable to read kernel data.\n");
 		shpart->check_result = VBSD_LKP_CHECK_READ_DATA;
-		return VB2_ERROR_LOAD_PARTITION_READ_BODY;
-	}
-
-	/* Get key for preamble/data verification from the key block. */
-	struct vb2_public_key data_key;
-	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key)) {
-		VB2_DEBUG("Unable to unpack kernel data key\n");
-		shpart->check_result = VBSD_LKP_CHECK_DATA_KEY_PARSE;
-		return VB2_ERROR_LOAD_PARTITION_DATA_KEY;
+		return rv;
 	}
 
 	/* Verify kernel data */
-	if (VB2_SUCCESS != vb2_verify_data(kernbuf, kernbuf_size,
-					   &preamble->body_signature,
-					   &data_key, &wblocal)) {
+	if (!rv)
+		rv = vb2_digest_finalize(dc, digest, digest_size);
+	vb2_workbuf_free(&wblocal, sizeof(*dc));
+	if (!rv)
+		rv = vb2_verify_digest(&data_key, &preamble->body_signature,
+				       digest, &wblocal);
+	if (rv) {
 		VB2_DEBUG("Kernel data verification failed.\n");
 		shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
 		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
@@ -479,6 +571,8 @@ VbError_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 	gpt.gpt_drive_sectors = params->gpt_lba_count;
 	gpt.flags = params->boot_flags & BOOT_FLAG_EXTERNAL_GPT
 			? GPT_FLAG_EXTERNAL : 0;
+	if (params->boot_flags & BOOT_FLAG_LAZY_GPT)
+		gpt.flags |= GPT_FLAG_LAZY_SECONDARY;
 	if (0 != AllocAndReadGptData(params->disk_handle, &gpt)) {
 		VB2_DEBUG("Unable to read GPT data\n");
 		shcall->check_result = VBSD_LKC_CHECK_GPT_READ_ERROR;
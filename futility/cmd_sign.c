@@ -15,6 +15,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "file_type.h"
@@ -26,6 +27,7 @@
 #include "host_common.h"
 #include "host_key2.h"
 #include "kernel_blob.h"
+#include "signd.h"
 #include "util_misc.h"
 #include "vb1_helper.h"
 #include "vb2_common.h"
@@ -63,6 +65,7 @@ int ft_sign_pubkey(const char *name, uint8_t *buf, uint32_t len, void *data)
 {
 	struct vb2_packed_key *data_key = (struct vb2_packed_key *)buf;
 	struct vb2_keyblock *block;
+	int rv;
 
 	if (!packed_key_looks_ok(data_key, len)) {
 		fprintf(stderr, "Public key looks bad.\n");
@@ -78,6 +81,12 @@ int ft_sign_pubkey(const char *name, uint8_t *buf, uint32_t len, void *data)
 				sign_option.pem_algo,
 				sign_option.flags,
 				sign_option.pem_external);
+			if (!block) {
+				fprintf(stderr,
+					"External signer failed: %s\n",
+					sign_option.pem_external);
+				return 1;
+			}
 		} else {
 			sign_option.signprivate = vb2_read_private_key_pem(
 				sign_option.pem_signpriv,
@@ -99,9 +108,11 @@ int ft_sign_pubkey(const char *name, uint8_t *buf, uint32_t len, void *data)
 	}
 
 	/* Write it out */
-	return WriteSomeParts(sign_option.outfile,
-			      block, block->keyblock_size,
-			      NULL, 0);
+	rv = WriteSomeParts(sign_option.outfile,
+			    block, block->keyblock_size,
+			    NULL, 0);
+	free(block);
+	return rv;
 }
 
 int ft_sign_raw_kernel(const char *name, uint8_t *buf, uint32_t len,
@@ -541,13 +552,38 @@ static const char usage_default[] = "\n"
 	"  usbpd1 firmware image               same, or signed in-place\n"
 	"  RW device image                     same, or signed in-place\n"
 	"\n"
+	"To sign many files in one run, reading each key only once, use\n"
+	"\n"
+	"  " MYNAME " %s [PARAMS] --manifest FILE [--jobs NUM]"
+	" [--report FILE]\n"
+	"                 [--pem_persistent]\n"
+	"\n"
+	"Each line of the manifest FILE has the [PARAMS] INFILE [OUTFILE]\n"
+	"for one job, added to the PARAMS on the command line. Words may be\n"
+	"quoted with \"\" or ''. Blank lines and lines starting with # are\n"
+	"ignored. Up to NUM jobs (default: one per CPU) are run at once. For\n"
+	"each job, the report FILE (default: stdout) gets a line with its\n"
+	"manifest line number, status (ok, failed or invalid), INFILE and\n"
+	"OUTFILE, separated by tabs.\n"
+	"\n"
+	"With --pem_persistent, the manifest's keyblocks made with\n"
+	"--pem_external are signed one at a time by " MYNAME " itself.\n"
+	"Each external signer is started once, with --persistent before\n"
+	"the PEM file, and signs all of them. Each request and reply is its\n"
+	"size in decimal on a line, followed by that many bytes; a reply of\n"
+	"size 0 means signing failed.\n"
+	"\n"
+	"With --signer-socket PATH, the --signprivate, --devsign and --prikey\n"
+	"keys are the names of keys held by \"" MYNAME " signd\" listening\n"
+	"on PATH, instead of files.\n"
+	"\n"
 	"For more information, use \"" MYNAME " help %s TYPE\", where\n"
 	"TYPE is one of:\n\n";
 static void print_help_default(int argc, char *argv[])
 {
 	enum futil_file_type type;
 
-	printf(usage_default, argv[0], argv[0]);
+	printf(usage_default, argv[0], argv[0], argv[0]);
 	for (type = 0; type < NUM_FILE_TYPES; type++)
 		if (help_type[type])
 			printf("  %s", futil_file_type_name(type));
@@ -588,6 +624,11 @@ enum no_short_opts {
 	OPT_DATA_SIZE,
 	OPT_SIG_SIZE,
 	OPT_PRIKEY,
+	OPT_MANIFEST,
+	OPT_JOBS,
+	OPT_REPORT,
+	OPT_PEM_PERSISTENT,
+	OPT_SIGNER_SOCKET,
 	OPT_HELP,
 };
 
@@ -627,6 +668,11 @@ static const struct option long_opts[] = {
 	{"sig_size",     1, NULL, OPT_SIG_SIZE},
 	{"prikey",       1, NULL, OPT_PRIKEY},
 	{"privkey",      1, NULL, OPT_PRIKEY},	/* alias */
+	{"manifest",     1, NULL, OPT_MANIFEST},
+	{"jobs",         1, NULL, OPT_JOBS},
+	{"report",       1, NULL, OPT_REPORT},
+	{"pem_persistent", 0, NULL, OPT_PEM_PERSISTENT},
+	{"signer-socket", 1, NULL, OPT_SIGNER_SOCKET},
 	{"help",         0, NULL, OPT_HELP},
 	{NULL,           0, NULL, 0},
 };
@@ -645,54 +691,143 @@ static int parse_number_opt(const char *arg, const char *name, uint32_t *dest)
 	return 0;
 }
 
-static int do_sign(int argc, char *argv[])
+/* Daemon holding the private keys, if they're not read here */
+static char *signer_socket;
+
+/* Keys named by the options, so that each one is only read once */
+enum key_kind {
+	KEY_PRIVATE,
+	KEY_KEYBLOCK,
+	KEY_PACKED,
+	KEY_VB21_PRIVATE,
+};
+
+struct key_cache_entry {
+	enum key_kind kind;
+	char *filename;
+	void *key;
+	struct key_cache_entry *next;
+};
+static struct key_cache_entry *key_cache;
+
+/* Return the key of this kind in filename, or NULL if it can't be read. */
+static void *read_key(enum key_kind kind, const char *filename)
 {
-	char *infile = 0;
-	int i;
-	int ifd = -1;
+	struct key_cache_entry *entry;
+	struct vb2_private_key *prikey;
+	void *key = NULL;
+
+	for (entry = key_cache; entry; entry = entry->next)
+		if (entry->kind == kind && !strcmp(entry->filename, filename))
+			return entry->key;
+
+	switch (kind) {
+	case KEY_PRIVATE:
+		if (signer_socket) {
+			key = signd_private_key(signer_socket, filename);
+			break;
+		}
+		/* This exits if it can't read the file, which a manifest can't */
+		if (access(filename, R_OK)) {
+			fprintf(stderr, "Can't read %s: %s\n",
+				filename, strerror(errno));
+			break;
+		}
+		key = vb2_read_private_key(filename);
+		break;
+	case KEY_KEYBLOCK:
+		key = vb2_read_keyblock(filename);
+		break;
+	case KEY_PACKED:
+		key = vb2_read_packed_key(filename);
+		break;
+	case KEY_VB21_PRIVATE:
+		if (signer_socket)
+			key = signd_private_key(signer_socket, filename);
+		else if (!vb21_private_key_read(&prikey, filename))
+			key = prikey;
+		break;
+	}
+	if (!key)
+		return NULL;
+
+	entry = malloc(sizeof(*entry));
+	if (!entry)
+		return key;
+	entry->kind = kind;
+	entry->filename = strdup(filename);
+	entry->key = key;
+	entry->next = key_cache;
+	key_cache = entry;
+	return key;
+}
+
+static void free_key_cache(void)
+{
+	struct key_cache_entry *entry;
+
+	while ((entry = key_cache)) {
+		key_cache = entry->next;
+		if (entry->kind == KEY_PRIVATE ||
+		    entry->kind == KEY_VB21_PRIVATE)
+			vb2_private_key_free(entry->key);
+		else
+			free(entry->key);
+		free(entry->filename);
+		free(entry);
+	}
+}
+
+/* Options for signing many files in one run */
+static char *manifest_file;
+static char *report_file;
+static int pem_persistent;
+static uint32_t max_jobs;
+
+/*
+ * Parse the options into sign_option.  If in_manifest is non-zero, these are
+ * a line of the manifest, which can't have the manifest options.  Returns the
+ * number of errors found.
+ */
+static int parse_sign_args(int argc, char *argv[], int in_manifest,
+			   char **infile, int *helpind)
+{
+	char *signprivate_file = NULL;
+	char *devsign_file = NULL;
+	char *prikey_file = NULL;
 	int errorcnt = 0;
-	uint8_t *buf;
-	uint32_t buf_len;
 	char *e = 0;
-	int mapping;
-	int helpind = 0;
 	int longindex;
+	int i;
 
+	optind = 0;
 	opterr = 0;		/* quiet, you */
 	while ((i = getopt_long(argc, argv, short_opts, long_opts,
 				&longindex)) != -1) {
 		switch (i) {
 		case 's':
-			sign_option.signprivate = vb2_read_private_key(optarg);
-			if (!sign_option.signprivate) {
-				fprintf(stderr, "Error reading %s\n", optarg);
-				errorcnt++;
-			}
+			/* Read after --signer-socket may have been seen */
+			signprivate_file = optarg;
 			break;
 		case 'b':
-			sign_option.keyblock = vb2_read_keyblock(optarg);
+			sign_option.keyblock = read_key(KEY_KEYBLOCK, optarg);
 			if (!sign_option.keyblock) {
 				fprintf(stderr, "Error reading %s\n", optarg);
 				errorcnt++;
 			}
 			break;
 		case 'k':
-			sign_option.kernel_subkey = vb2_read_packed_key(optarg);
+			sign_option.kernel_subkey = read_key(KEY_PACKED, optarg);
 			if (!sign_option.kernel_subkey) {
 				fprintf(stderr, "Error reading %s\n", optarg);
 				errorcnt++;
 			}
 			break;
 		case 'S':
-			sign_option.devsignprivate =
-				vb2_read_private_key(optarg);
-			if (!sign_option.devsignprivate) {
-				fprintf(stderr, "Error reading %s\n", optarg);
-				errorcnt++;
-			}
+			devsign_file = optarg;
 			break;
 		case 'B':
-			sign_option.devkeyblock = vb2_read_keyblock(optarg);
+			sign_option.devkeyblock = read_key(KEY_KEYBLOCK, optarg);
 			if (!sign_option.devkeyblock) {
 				fprintf(stderr, "Error reading %s\n", optarg);
 				errorcnt++;
@@ -724,7 +859,7 @@ static int do_sign(int argc, char *argv[])
 			/* fallthrough */
 		case OPT_INFILE:
 			sign_option.inout_file_count++;
-			infile = optarg;
+			*infile = optarg;
 			break;
 		case OPT_OUTFILE:
 			sign_option.inout_file_count++;
@@ -836,14 +971,34 @@ static int do_sign(int argc, char *argv[])
 			}
 			break;
 		case OPT_PRIKEY:
-			if (vb21_private_key_read(&sign_option.prikey,
-						  optarg)) {
-				fprintf(stderr, "Error reading %s\n", optarg);
+			/* Read after --signer-socket may have been seen */
+			prikey_file = optarg;
+			break;
+		case OPT_MANIFEST:
+		case OPT_JOBS:
+		case OPT_REPORT:
+		case OPT_PEM_PERSISTENT:
+		case OPT_SIGNER_SOCKET:
+			if (in_manifest) {
+				fprintf(stderr,
+					"--%s can't be used in a manifest\n",
+					long_opts[longindex].name);
 				errorcnt++;
+			} else if (i == OPT_MANIFEST) {
+				manifest_file = optarg;
+			} else if (i == OPT_JOBS) {
+				errorcnt += parse_number_opt(optarg, "jobs",
+							     &max_jobs);
+			} else if (i == OPT_SIGNER_SOCKET) {
+				signer_socket = optarg;
+			} else if (i == OPT_PEM_PERSISTENT) {
+				pem_persistent = 1;
+			} else {
+				report_file = optarg;
 			}
 			break;
 		case OPT_HELP:
-			helpind = optind - 1;
+			*helpind = optind - 1;
 			break;
 
 		case '?':
@@ -867,26 +1022,49 @@ static int do_sign(int argc, char *argv[])
 		}
 	}
 
-	if (helpind) {
-		/* Skip all the options we've already parsed */
-		optind--;
-		argv[optind] = argv[0];
-		argc -= optind;
-		argv += optind;
-		print_help(argc, argv);
-		return !!errorcnt;
+
+	if (signprivate_file) {
+		sign_option.signprivate = read_key(KEY_PRIVATE,
+						   signprivate_file);
+		if (!sign_option.signprivate) {
+			fprintf(stderr, "Error reading %s\n",
+				signprivate_file);
+			errorcnt++;
+		}
 	}
+	if (devsign_file) {
+		sign_option.devsignprivate = read_key(KEY_PRIVATE,
+						      devsign_file);
+		if (!sign_option.devsignprivate) {
+			fprintf(stderr, "Error reading %s\n", devsign_file);
+			errorcnt++;
+		}
+	}
+	if (prikey_file) {
+		sign_option.prikey = read_key(KEY_VB21_PRIVATE, prikey_file);
+		if (!sign_option.prikey) {
+			fprintf(stderr, "Error reading %s\n", prikey_file);
+			errorcnt++;
+		}
+	}
+
+	return errorcnt;
+}
 
+/*
+ * Take the input and output files from the arguments left after the
+ * options, if they weren't given as options.  Returns the number of errors.
+ */
+static int get_sign_files(int argc, char *argv[], char **infile)
+{
 	/* If we don't have an input file already, we need one */
-	if (!infile) {
+	if (!*infile) {
 		if (argc - optind <= 0) {
-			errorcnt++;
 			fprintf(stderr, "ERROR: missing input filename\n");
-			goto done;
-		} else {
-			sign_option.inout_file_count++;
-			infile = argv[optind++];
+			return 1;
 		}
+		sign_option.inout_file_count++;
+		*infile = argv[optind++];
 	}
 
 	/* Look for an output file if we don't have one, just in case. */
@@ -895,12 +1073,26 @@ static int do_sign(int argc, char *argv[])
 		sign_option.outfile = argv[optind++];
 	}
 
+	if (argc - optind > 0) {
+		fprintf(stderr, "ERROR: too many arguments left over\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Work out what infile is, and check that sign_option has everything needed
+ * to sign it.  Returns the number of errors found.
+ */
+static int check_sign_args(char *infile)
+{
+	int errorcnt = 0;
+
 	/* What are we looking at? */
 	if (sign_option.type == FILE_TYPE_UNKNOWN &&
-	    futil_file_type(infile, &sign_option.type)) {
-		errorcnt++;
-		goto done;
-	}
+	    futil_file_type(infile, &sign_option.type))
+		return 1;
 
 	/* We may be able to infer the type based on the other args */
 	if (sign_option.type == FILE_TYPE_UNKNOWN) {
@@ -993,9 +1185,8 @@ static int do_sign(int argc, char *argv[])
 	/* Make sure we have an output file if one is needed */
 	if (!sign_option.outfile) {
 		if (sign_option.create_new_outfile) {
-			errorcnt++;
 			fprintf(stderr, "Missing output filename\n");
-			goto done;
+			return errorcnt + 1;
 		} else {
 			sign_option.outfile = infile;
 		}
@@ -1003,13 +1194,17 @@ static int do_sign(int argc, char *argv[])
 
 	Debug("sign_option.outfile=%s\n", sign_option.outfile);
 
-	if (argc - optind > 0) {
-		errorcnt++;
-		fprintf(stderr, "ERROR: too many arguments left over\n");
-	}
+	return errorcnt;
+}
 
-	if (errorcnt)
-		goto done;
+/* Sign infile as sign_option says.  Returns the number of errors. */
+static int sign_file(char *infile)
+{
+	int errorcnt = 0;
+	int ifd = -1;
+	uint8_t *buf;
+	uint32_t buf_len;
+	int mapping;
 
 	if (sign_option.create_new_outfile) {
 		/* The input is read-only, the output is write-only. */
@@ -1055,14 +1250,318 @@ done:
 			strerror(errno));
 	}
 
-	if (sign_option.signprivate)
-		free(sign_option.signprivate);
-	if (sign_option.keyblock)
-		free(sign_option.keyblock);
-	if (sign_option.kernel_subkey)
-		free(sign_option.kernel_subkey);
-	if (sign_option.prikey)
-		vb2_private_key_free(sign_option.prikey);
+	return errorcnt;
+}
+
+/* Longest manifest line, and most words on it */
+#define MANIFEST_MAX_LINE 4096
+#define MANIFEST_MAX_ARGS 64
+
+/* A manifest job being signed by a child process */
+struct sign_job {
+	pid_t pid;
+	int line_num;
+	char *infile;
+	char *outfile;
+};
+
+/*
+ * Write a line of the report: the manifest line number, its status (ok,
+ * failed or invalid), and the files it reads and writes.
+ */
+static void report_job(FILE *report, int line_num, const char *status,
+		       const char *infile, const char *outfile)
+{
+	fprintf(report, "%d\t%s\t%s\t%s\n", line_num, status,
+		infile ? infile : "-",
+		outfile ? outfile : infile ? infile : "-");
+	fflush(report);
+}
+
+/*
+ * Wait for a job to finish and report it.  Persistent signers are children
+ * too, so one which exits while waiting is reported and counted as a failure.
+ * Returns the number of failures: 1 if the job failed, plus any signers.
+ */
+static int wait_for_job(struct sign_job *jobs, FILE *report)
+{
+	struct sign_job *job;
+	int failures = 0;
+	int status;
+	pid_t pid;
+	int i;
+
+	for (;;) {
+		do {
+			pid = wait(&status);
+		} while (pid < 0 && errno == EINTR);
+		if (pid < 0)
+			DIE;
+
+		for (i = 0; i < max_jobs && jobs[i].pid != pid; i++)
+			;
+		if (i < max_jobs)
+			break;
+
+		if (vb2_external_signer_reaped(pid)) {
+			fprintf(stderr, "External signer %d exited\n", pid);
+			failures++;
+		}
+	}
+	job = &jobs[i];
+
+	status = !WIFEXITED(status) || WEXITSTATUS(status);
+	report_job(report, job->line_num, status ? "failed" : "ok",
+		   job->infile, job->outfile);
+	free(job->infile);
+	free(job->outfile);
+	memset(job, 0, sizeof(*job));
+	return failures + status;
+}
+
+/*
+ * Read the lines of the manifest into *lines, before any job is started, so
+ * no child can share the stream.  Returns the number of lines, or -1 if error.
+ */
+static int read_manifest(char ***lines)
+{
+	char line[MANIFEST_MAX_LINE];
+	FILE *fp = stdin;
+	char **more;
+	int count = 0;
+
+	*lines = NULL;
+	if (strcmp(manifest_file, "-")) {
+		fp = fopen(manifest_file, "r");
+		if (!fp) {
+			fprintf(stderr, "Can't open %s: %s\n",
+				manifest_file, strerror(errno));
+			return -1;
+		}
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (!strchr(line, '\n') && !feof(fp)) {
+			fprintf(stderr, "%s:%d: line too long\n",
+				manifest_file, count + 1);
+			break;
+		}
+		more = realloc(*lines, (count + 1) * sizeof(*more));
+		if (!more)
+			break;
+		*lines = more;
+		(*lines)[count] = strdup(line);
+		if (!(*lines)[count])
+			break;
+		count++;
+	}
+
+	if (!feof(fp)) {
+		if (ferror(fp))
+			fprintf(stderr, "Can't read %s\n", manifest_file);
+		while (count--)
+			free((*lines)[count]);
+		free(*lines);
+		*lines = NULL;
+		count = -1;
+	}
+	if (fp != stdin)
+		fclose(fp);
+	return count;
+}
+
+/*
+ * Sign every job in the manifest, running up to max_jobs of them at once.
+ * Each line of the manifest has the options and files for one job, which
+ * start out with the options given on the command line.  Keys are read once
+ * here, and each job is signed in a child process, since signing works on
+ * the global sign_option.  Returns the number of jobs which failed.
+ */
+static int sign_manifest(void)
+{
+	struct sign_option_s defaults = sign_option;
+	char *words[MANIFEST_MAX_ARGS + 1];
+	struct sign_job *jobs;
+	FILE *report = stdout;
+	char **lines;
+	int num_lines, line_num;
+	int running = 0;
+	int errorcnt = 0;
+	char *infile;
+	int helpind;
+	int count;
+	int i;
+
+	if (!max_jobs) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		max_jobs = cpus > 0 ? cpus : 1;
+	}
+	jobs = calloc(max_jobs, sizeof(*jobs));
+	if (!jobs) {
+		fprintf(stderr, "Couldn't allocate %u jobs\n", max_jobs);
+		return 1;
+	}
+
+	num_lines = read_manifest(&lines);
+	if (num_lines < 0) {
+		free(jobs);
+		return 1;
+	}
+
+	/* Jobs signed here, not by a child, can share external signers */
+	vb2_external_signer_persist(pem_persistent);
+
+	if (report_file && strcmp(report_file, "-")) {
+		report = fopen(report_file, "w");
+		if (!report) {
+			fprintf(stderr, "Can't open %s for writing: %s\n",
+				report_file, strerror(errno));
+			report = NULL;
+			errorcnt++;
+		}
+	}
+
+	for (line_num = 1; report && line_num <= num_lines; line_num++) {
+		words[0] = "sign";
+		count = SplitWords(lines[line_num - 1], words + 1,
+				   MANIFEST_MAX_ARGS);
+		if (!count)
+			continue;
+
+		sign_option = defaults;
+		infile = NULL;
+		helpind = 0;
+		if (count < 0) {
+			fprintf(stderr, "%s:%d: too many words or unclosed "
+				"quote\n", manifest_file, line_num);
+		} else if (parse_sign_args(count + 1, words, 1, &infile,
+					   &helpind) || helpind ||
+			   get_sign_files(count + 1, words, &infile)) {
+			fprintf(stderr, "%s:%d: invalid job\n",
+				manifest_file, line_num);
+			count = -1;
+		}
+		if (count < 0) {
+			report_job(report, line_num, "invalid", infile,
+				   sign_option.outfile);
+			errorcnt++;
+			goto next;
+		}
+
+		/*
+		 * Keyblocks from a persistent external signer are signed
+		 * here, so they all use the same running signer.
+		 */
+		if (pem_persistent && sign_option.pem_external) {
+			count = check_sign_args(infile);
+			if (count || sign_option.type == FILE_TYPE_PUBKEY) {
+				count = count || sign_file(infile);
+				report_job(report, line_num,
+					   count ? "failed" : "ok", infile,
+					   sign_option.outfile);
+				errorcnt += count;
+				goto next;
+			}
+		}
+
+		/* Wait for a free slot */
+		if (running == max_jobs) {
+			errorcnt += wait_for_job(jobs, report);
+			running--;
+		}
+		for (i = 0; jobs[i].pid; i++)
+			;
+
+		fflush(stdout);
+		fflush(stderr);
+		jobs[i].pid = fork();
+		if (!jobs[i].pid) {
+			/* The child checks its input and signs it */
+			count = check_sign_args(infile) || sign_file(infile);
+			fflush(stdout);
+			fflush(stderr);
+			_exit(count);
+		}
+		if (jobs[i].pid < 0) {
+			fprintf(stderr, "%s:%d: can't fork: %s\n",
+				manifest_file, line_num, strerror(errno));
+			report_job(report, line_num, "failed", infile,
+				   sign_option.outfile);
+			jobs[i].pid = 0;
+			errorcnt++;
+			goto next;
+		}
+		jobs[i].line_num = line_num;
+		jobs[i].infile = strdup(infile);
+		if (sign_option.outfile)
+			jobs[i].outfile = strdup(sign_option.outfile);
+		running++;
+
+next:
+		/* Only the child needs the files this job read */
+		if (sign_option.bootloader_data != defaults.bootloader_data)
+			free(sign_option.bootloader_data);
+		if (sign_option.config_data != defaults.config_data)
+			free(sign_option.config_data);
+	}
+
+	while (running--)
+		errorcnt += wait_for_job(jobs, report);
+	vb2_external_signer_persist(0);
+
+	sign_option = defaults;
+	if (report && report != stdout && fclose(report)) {
+		fprintf(stderr, "Error writing %s: %s\n",
+			report_file, strerror(errno));
+		errorcnt++;
+	}
+	for (i = 0; i < num_lines; i++)
+		free(lines[i]);
+	free(lines);
+	free(jobs);
+	return errorcnt;
+}
+
+static int do_sign(int argc, char *argv[])
+{
+	char *infile = 0;
+	int errorcnt = 0;
+	int helpind = 0;
+
+	errorcnt += parse_sign_args(argc, argv, 0, &infile, &helpind);
+
+	if (helpind) {
+		/* Skip all the options we've already parsed */
+		optind--;
+		argv[optind] = argv[0];
+		argc -= optind;
+		argv += optind;
+		print_help(argc, argv);
+		free_key_cache();
+		return !!errorcnt;
+	}
+
+	if (manifest_file) {
+		/* The manifest has the files */
+		if (infile || sign_option.outfile || argc - optind > 0) {
+			fprintf(stderr,
+				"ERROR: files can't be given with --manifest\n");
+			errorcnt++;
+		}
+		if (!errorcnt && sign_manifest()) {
+			fprintf(stderr, "Some manifest jobs failed\n");
+			free_key_cache();
+			return 1;
+		}
+	} else if (get_sign_files(argc, argv, &infile)) {
+		errorcnt++;
+	} else {
+		errorcnt += check_sign_args(infile);
+		if (!errorcnt)
+			errorcnt += sign_file(infile);
+	}
+
+	free_key_cache();
 
 	if (errorcnt)
 		fprintf(stderr, "Use --help for usage instructions\n");
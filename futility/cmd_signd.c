@@ -0,0 +1,520 @@
+/*
+ * Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "file_type.h"
+#include "futility.h"
+#include "host_key2.h"
+#include "host_signature.h"
+#include "openssl_compat.h"
+#include "signd.h"
+#include "vb2_common.h"
+
+/* A key the daemon signs with, and how much it's been used */
+struct signd_key_entry {
+	char *name;
+	struct vb2_private_key *key;
+	uint64_t requests;
+	uint64_t bytes;
+	uint64_t usecs;
+};
+
+static struct signd_key_entry *keys;
+static int num_keys;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Older OpenSSL shares state between keys, such as the random numbers used
+ * for blinding, so it only signs for one client at a time.
+ */
+static pthread_mutex_t sign_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Socket to remove when we're stopped */
+static const char *listen_path;
+
+static const char usage[] = "\n"
+	"Usage:  " MYNAME " %s [OPTIONS] --socket PATH [NAME=]KEYFILE [...]\n"
+	"\n"
+	"Keep private keys loaded, and sign with them for clients connecting\n"
+	"to the Unix domain socket PATH, such as \"" MYNAME " sign"
+	" --signer-socket\".\n"
+	"Each KEYFILE is a .vbprivk or .vbprik2 file, which clients call NAME\n"
+	"(default: KEYFILE). Clients may sign blobs or digests, and may send\n"
+	"several requests before reading the replies. See futility/signd.h\n"
+	"for the protocol.\n"
+	"\n"
+	"Options:\n"
+	"  --socket PATH       Socket to listen on (required)\n"
+	"  --stats             Instead, show the counters for each key of\n"
+	"                        the daemon listening on PATH\n"
+	"\n";
+
+static void print_help(int argc, char *argv[])
+{
+	printf(usage, argv[0]);
+}
+
+static uint64_t now_usecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Read the key named in arg, as [NAME=]KEYFILE.  Returns 0 if success. */
+static int add_key(const char *arg)
+{
+	struct signd_key_entry *entry, *more;
+	enum futil_file_type type;
+	const char *filename = arg;
+	const char *eq = strchr(arg, '=');
+	struct vb2_private_key *key = NULL;
+	int i;
+
+	if (eq)
+		filename = eq + 1;
+	if (futil_file_type(filename, &type))
+		return 1;
+
+	if (type == FILE_TYPE_PRIVKEY)
+		key = vb2_read_private_key(filename);
+	else if (type == FILE_TYPE_VB2_PRIVKEY)
+		vb21_private_key_read(&key, filename);
+	else
+		fprintf(stderr, "%s isn't a private key\n", filename);
+	if (!key) {
+		fprintf(stderr, "Error reading %s\n", filename);
+		return 1;
+	}
+
+	more = realloc(keys, (num_keys + 1) * sizeof(*keys));
+	if (!more) {
+		vb2_private_key_free(key);
+		return 1;
+	}
+	keys = more;
+	entry = &keys[num_keys];
+	memset(entry, 0, sizeof(*entry));
+	entry->key = key;
+	entry->name = eq ? strndup(arg, eq - arg) : strdup(arg);
+
+	if (!entry->name || !*entry->name ||
+	    strpbrk(entry->name, " \t\n")) {
+		fprintf(stderr, "Bad key name in \"%s\"\n", arg);
+		free(entry->name);
+		vb2_private_key_free(key);
+		return 1;
+	}
+	for (i = 0; i < num_keys; i++) {
+		if (!strcmp(keys[i].name, entry->name)) {
+			fprintf(stderr, "Key %s given twice\n", entry->name);
+			free(entry->name);
+			vb2_private_key_free(key);
+			return 1;
+		}
+	}
+
+	num_keys++;
+	return 0;
+}
+
+static struct signd_key_entry *find_key(const char *name)
+{
+	int i;
+
+	for (i = 0; i < num_keys; i++)
+		if (!strcmp(keys[i].name, name))
+			return &keys[i];
+	return NULL;
+}
+
+/* Queue a successful reply with size bytes of data. */
+static int reply_ok(struct signd_conn *conn, const void *data, uint32_t size)
+{
+	char line[SIGND_MAX_LINE];
+
+	snprintf(line, sizeof(line), "OK %u\n", size);
+	return signd_write(conn, line, strlen(line)) ||
+		signd_write(conn, data, size);
+}
+
+static int reply_error(struct signd_conn *conn, const char *message)
+{
+	char line[SIGND_MAX_LINE];
+
+	snprintf(line, sizeof(line), "ERR %s\n", message);
+	return signd_write(conn, line, strlen(line));
+}
+
+static int reply_stats(struct signd_conn *conn)
+{
+	char *text = NULL;
+	size_t text_size = 0;
+	FILE *fp;
+	int rv;
+	int i;
+
+	fp = open_memstream(&text, &text_size);
+	if (!fp)
+		return reply_error(conn, "out of memory");
+
+	pthread_mutex_lock(&stats_lock);
+	for (i = 0; i < num_keys; i++)
+		fprintf(fp, "%s %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+			keys[i].name, keys[i].requests, keys[i].bytes,
+			keys[i].usecs);
+	pthread_mutex_unlock(&stats_lock);
+	fclose(fp);
+
+	rv = reply_ok(conn, text, text_size);
+	free(text);
+	return rv;
+}
+
+/*
+ * Sign size bytes of data (a digest, if is_digest) with the key and queue the
+ * reply.  Returns non-zero if the connection should be dropped.
+ */
+static int reply_signature(struct signd_conn *conn,
+			   struct signd_key_entry *entry, int is_digest,
+			   const uint8_t *data, uint32_t size)
+{
+	struct vb2_private_key *key = entry->key;
+	struct vb2_signature *sig;
+	uint64_t start = now_usecs();
+	int rv;
+
+	if (is_digest && size != vb2_digest_size(key->hash_alg))
+		return reply_error(conn, "wrong digest size");
+
+	if (!VB2_OPENSSL_THREAD_SAFE)
+		pthread_mutex_lock(&sign_lock);
+	if (is_digest)
+		sig = vb2_sign_digest(data, 0, key);
+	else
+		sig = vb2_calculate_signature(data, size, key);
+	if (!VB2_OPENSSL_THREAD_SAFE)
+		pthread_mutex_unlock(&sign_lock);
+	if (!sig)
+		return reply_error(conn, "signing failed");
+
+	pthread_mutex_lock(&stats_lock);
+	entry->requests++;
+	entry->bytes += size;
+	entry->usecs += now_usecs() - start;
+	pthread_mutex_unlock(&stats_lock);
+
+	rv = reply_ok(conn, vb2_signature_data(sig), sig->sig_size);
+	free(sig);
+	return rv;
+}
+
+/*
+ * Handle a request, queueing its reply.  Returns non-zero if the connection
+ * should be dropped.
+ */
+static int handle_request(struct signd_conn *conn, char *line)
+{
+	struct signd_key_entry *entry;
+	char *words[5];
+	char *save, *e;
+	char info[SIGND_MAX_LINE];
+	int len;
+	unsigned long size = 0;
+	uint8_t *data;
+	int count = 0;
+	int rv, i;
+
+	for (words[count] = strtok_r(line, " ", &save);
+	     words[count] && count < 4;
+	     words[++count] = strtok_r(NULL, " ", &save))
+		;
+	if (!count)
+		return reply_error(conn, "empty request");
+
+	if (!strcmp(words[0], "STATS") && count == 1)
+		return reply_stats(conn);
+
+	if (count < 2)
+		return reply_error(conn, "no key given");
+	entry = find_key(words[1]);
+
+	if (!strcmp(words[0], "INFO") && count == 2) {
+		if (!entry)
+			return reply_error(conn, "no such key");
+		len = snprintf(info, sizeof(info), "%u %u ",
+			       entry->key->sig_alg, entry->key->hash_alg);
+		for (i = 0; i < VB2_ID_NUM_BYTES; i++)
+			len += snprintf(info + len, sizeof(info) - len,
+					"%02x", entry->key->id.raw[i]);
+		snprintf(info + len, sizeof(info) - len, " %s",
+			 entry->key->desc ? entry->key->desc : "");
+		return reply_ok(conn, info, strlen(info));
+	}
+
+	if ((strcmp(words[0], "DIGEST") && strcmp(words[0], "BLOB")) ||
+	    count != 3)
+		return reply_error(conn, "unknown request");
+
+	/* Any data has to be read, even if it can't be signed */
+	size = strtoul(words[2], &e, 0);
+	if (*e || size > SIGND_MAX_DATA) {
+		reply_error(conn, "bad size");
+		return 1;
+	}
+	data = malloc(size ? size : 1);
+	if (!data) {
+		reply_error(conn, "out of memory");
+		return 1;
+	}
+	if (signd_read_data(conn, data, size)) {
+		free(data);
+		return 1;
+	}
+
+	if (!entry)
+		rv = reply_error(conn, "no such key");
+	else
+		rv = reply_signature(conn, entry, words[0][0] == 'D',
+				     data, size);
+	free(data);
+	return rv;
+}
+
+/* Serve a client until it goes away. */
+static void *serve_client(void *arg)
+{
+	struct signd_conn *conn = arg;
+	char line[SIGND_MAX_LINE];
+
+	while (!signd_read_line(conn, line)) {
+		if (handle_request(conn, line))
+			break;
+		/* Answer a batch of requests at once */
+		if (!signd_has_input(conn) && signd_flush(conn))
+			break;
+	}
+	signd_flush(conn);
+
+	close(conn->fd);
+	free(conn);
+	return NULL;
+}
+
+static void stop(int sig)
+{
+	if (listen_path)
+		unlink(listen_path);
+	_exit(0);
+}
+
+/* Listen on socket_path.  Returns the fd, or -1 if error. */
+static int listen_on(const char *socket_path)
+{
+	struct sockaddr_un addr;
+	mode_t old_umask;
+	int fd;
+
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket name %s is too long\n", socket_path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		fprintf(stderr, "Can't create socket: %s\n", strerror(errno));
+		return -1;
+	}
+
+	/* Replace a socket left behind, but not a running daemon's */
+	if (!connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		fprintf(stderr, "Something is already listening on %s\n",
+			socket_path);
+		close(fd);
+		return -1;
+	}
+	unlink(socket_path);
+
+	/* Only our user may connect */
+	old_umask = umask(077);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(fd, SOMAXCONN)) {
+		fprintf(stderr, "Can't listen on %s: %s\n",
+			socket_path, strerror(errno));
+		umask(old_umask);
+		close(fd);
+		return -1;
+	}
+	umask(old_umask);
+
+	return fd;
+}
+
+/* Print the daemon's counters.  Returns 0 if success. */
+static int show_stats(const char *socket_path)
+{
+	struct signd_conn conn;
+	uint8_t *reply;
+	uint32_t reply_size;
+	int fd;
+
+	fd = signd_connect(socket_path);
+	if (fd < 0)
+		return 1;
+	signd_conn_init(&conn, fd);
+
+	if (signd_request(&conn, "STATS\n", NULL, 0, &reply, &reply_size)) {
+		close(fd);
+		return 1;
+	}
+	fwrite(reply, 1, reply_size, stdout);
+	free(reply);
+	close(fd);
+	return 0;
+}
+
+enum no_short_opts {
+	OPT_SOCKET = 1000,
+	OPT_STATS,
+	OPT_HELP,
+};
+
+static const struct option long_opts[] = {
+	/* name    hasarg *flag  val */
+	{"socket",       1, NULL, OPT_SOCKET},
+	{"stats",        0, NULL, OPT_STATS},
+	{"help",         0, NULL, OPT_HELP},
+	{NULL,           0, NULL, 0},
+};
+
+static int do_signd(int argc, char *argv[])
+{
+	struct signd_conn *conn;
+	const char *socket_path = NULL;
+	pthread_attr_t attr;
+	pthread_t thread;
+	int stats = 0;
+	int errorcnt = 0;
+	int fd, cfd;
+	int i;
+
+	opterr = 0;		/* quiet, you */
+	while ((i = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (i) {
+		case OPT_SOCKET:
+			socket_path = optarg;
+			break;
+		case OPT_STATS:
+			stats = 1;
+			break;
+		case OPT_HELP:
+			print_help(argc, argv);
+			return !!errorcnt;
+		case '?':
+			if (optopt)
+				fprintf(stderr, "Unrecognized option: -%c\n",
+					optopt);
+			else
+				fprintf(stderr, "Unrecognized option: %s\n",
+					argv[optind - 1]);
+			errorcnt++;
+			break;
+		case ':':
+			fprintf(stderr, "Missing argument to -%c\n", optopt);
+			errorcnt++;
+			break;
+		default:
+			DIE;
+		}
+	}
+
+	if (!socket_path) {
+		fprintf(stderr, "Missing --socket option\n");
+		errorcnt++;
+	} else if (stats) {
+		if (argc - optind > 0) {
+			fprintf(stderr, "--stats doesn't take any keys\n");
+			errorcnt++;
+		}
+	} else if (argc - optind <= 0) {
+		fprintf(stderr, "No keys given\n");
+		errorcnt++;
+	}
+	if (errorcnt) {
+		print_help(argc, argv);
+		return 1;
+	}
+
+	if (stats)
+		return show_stats(socket_path);
+
+	for (i = optind; i < argc; i++)
+		if (add_key(argv[i]))
+			return 1;
+
+	fd = listen_on(socket_path);
+	if (fd < 0)
+		return 1;
+	listen_path = socket_path;
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+	signal(SIGPIPE, SIG_IGN);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	/* Each client gets a thread of its own */
+	while (1) {
+		cfd = accept(fd, NULL, NULL);
+		if (cfd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			fprintf(stderr, "Can't accept connections: %s\n",
+				strerror(errno));
+			break;
+		}
+
+		conn = malloc(sizeof(*conn));
+		if (!conn) {
+			close(cfd);
+			continue;
+		}
+		signd_conn_init(conn, cfd);
+		if (pthread_create(&thread, &attr, serve_client, conn)) {
+			close(cfd);
+			free(conn);
+		}
+	}
+
+	unlink(socket_path);
+	close(fd);
+	return 1;
+}
+
+DECLARE_FUTIL_COMMAND(signd, do_signd, VBOOT_VERSION_ALL,
+		      "Sign with keys kept loaded, for clients on a socket");
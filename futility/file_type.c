@@ -14,9 +14,13 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "bdb_struct.h"
 #include "file_type.h"
+#include "fmap.h"
 #include "futility.h"
 #include "gbb_header.h"
+#include "vb21_struct.h"
+#include "vboot_struct.h"
 
 /* Description and functions to handle each file type */
 struct futil_file_type_s {
@@ -81,18 +85,75 @@ void print_file_types_and_exit(int retval)
 	exit(retval);
 }
 
+typedef enum futil_file_type (*recognize_fn)(uint8_t *buf, uint32_t len);
+
+static const uint32_t vb21_packed_key_magic = VB21_MAGIC_PACKED_KEY;
+static const uint32_t vb21_private_key_magic = VB21_MAGIC_PACKED_PRIVATE_KEY;
+static const uint32_t bdb_header_magic = BDB_HEADER_MAGIC;
+
+/*
+ * Recognizers which can only match a buffer that starts with one of their
+ * magic numbers, or for FMAPs and PEM text, contains it somewhere. The rest
+ * are tried on every buffer.
+ */
+static const struct {
+	recognize_fn recognize;
+	const void *magic;
+	uint32_t magic_size;
+	int anywhere;
+} magic_recognizers[] = {
+	{ft_recognize_bios_image, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE, 1},
+	{ft_recognize_gbb, GBB_SIGNATURE, GBB_SIGNATURE_SIZE, 0},
+	{ft_recognize_vblock1, KEY_BLOCK_MAGIC, KEY_BLOCK_MAGIC_SIZE, 0},
+	{ft_recognize_vb21_key, &vb21_packed_key_magic,
+	 sizeof(vb21_packed_key_magic), 0},
+	{ft_recognize_vb21_key, &vb21_private_key_magic,
+	 sizeof(vb21_private_key_magic), 0},
+	{ft_recognize_pem, "-----BEGIN", 10, 1},
+	{ft_recognize_bdb, &bdb_header_magic, sizeof(bdb_header_magic), 0},
+};
+
+/* Return true if the magic numbers in buf don't rule out the recognizer. */
+static int magic_may_match(recognize_fn recognize, uint8_t *buf, uint32_t len)
+{
+	int listed = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(magic_recognizers); i++) {
+		if (magic_recognizers[i].recognize != recognize)
+			continue;
+		listed = 1;
+		if (len < magic_recognizers[i].magic_size)
+			continue;
+		if (magic_recognizers[i].anywhere ?
+		    !!memmem(buf, len, magic_recognizers[i].magic,
+			     magic_recognizers[i].magic_size) :
+		    !memcmp(buf, magic_recognizers[i].magic,
+			    magic_recognizers[i].magic_size))
+			return 1;
+	}
+
+	return !listed;
+}
+
 /* Try to figure out what we're looking at */
 enum futil_file_type futil_file_type_buf(uint8_t *buf, uint32_t len)
 {
 	enum futil_file_type type;
+	recognize_fn recognize, tried = NULL;
 	int i;
 
 	for (i = 0; i < NUM_FILE_TYPES; i++) {
-		if (futil_file_types[i].recognize) {
-			type = futil_file_types[i].recognize(buf, len);
-			if (type != FILE_TYPE_UNKNOWN)
-				return type;
-		}
+		recognize = futil_file_types[i].recognize;
+		/* Types sharing a recognizer are next to each other */
+		if (!recognize || recognize == tried)
+			continue;
+		tried = recognize;
+		if (!magic_may_match(recognize, buf, len))
+			continue;
+		type = recognize(buf, len);
+		if (type != FILE_TYPE_UNKNOWN)
+			return type;
 	}
 
 	return FILE_TYPE_UNKNOWN;
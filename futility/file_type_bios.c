@@ -5,6 +5,7 @@
  */
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -17,6 +18,8 @@
 #include "futility_options.h"
 #include "gbb_header.h"
 #include "host_common.h"
+#include "host_signature.h"
+#include "openssl_compat.h"
 #include "vb1_helper.h"
 #include "vb2_common.h"
 
@@ -325,15 +328,24 @@ whatever:
 	return 0;
 }
 
+/*
+ * Sign fw_body and write a new keyblock and preamble to vblock.  If digest
+ * isn't NULL, it's the digest of fw_body using signkey's hash algorithm.
+ */
 static int write_new_preamble(struct bios_area_s *vblock,
 			      struct bios_area_s *fw_body,
+			      const uint8_t *digest,
 			      struct vb2_private_key *signkey,
 			      struct vb2_keyblock *keyblock)
 {
 	struct vb2_signature *body_sig;
 	struct vb2_fw_preamble *preamble;
 
-	body_sig = vb2_calculate_signature(fw_body->buf, fw_body->len, signkey);
+	if (digest)
+		body_sig = vb2_sign_digest(digest, fw_body->len, signkey);
+	else
+		body_sig = vb2_calculate_signature(fw_body->buf, fw_body->len,
+						   signkey);
 	if (!body_sig) {
 		fprintf(stderr, "Error calculating body signature\n");
 		return 1;
@@ -396,6 +408,61 @@ static int write_loem(const char *ab, struct bios_area_s *vblock)
 	return 0;
 }
 
+/* Amount of FW A to hash and compare with FW B at a time */
+#define SIGN_CHUNK_SIZE (64 * 1024)
+
+/* One slot's signing, which may run on a thread of its own */
+struct sign_slot_s {
+	struct bios_area_s *vblock;
+	struct bios_area_s *fw_body;
+	struct vb2_private_key *signkey;
+	struct vb2_keyblock *keyblock;
+	pthread_t thread;
+	int threaded;
+	int retval;
+};
+
+static void *sign_slot_thread(void *arg)
+{
+	struct sign_slot_s *slot = arg;
+
+	slot->retval = write_new_preamble(slot->vblock, slot->fw_body, NULL,
+					  slot->signkey, slot->keyblock);
+	return NULL;
+}
+
+/*
+ * Start signing a slot on a thread, or sign it now if there isn't one or
+ * OpenSSL can't be used by two threads at once.
+ */
+static void start_slot(struct sign_slot_s *slot)
+{
+	slot->threaded = VB2_OPENSSL_THREAD_SAFE &&
+		!pthread_create(&slot->thread, NULL, sign_slot_thread, slot);
+	if (!slot->threaded)
+		sign_slot_thread(slot);
+}
+
+/* Wait for a slot started by start_slot(); returns its result. */
+static int finish_slot(struct sign_slot_s *slot)
+{
+	if (slot->threaded)
+		pthread_join(slot->thread, NULL);
+	return slot->retval;
+}
+
+/* A & B differ, so start signing B now; returns non-zero if A can't be. */
+static int start_differing_slots(struct sign_slot_s *slot_b)
+{
+	/* A must use DEV keys */
+	if (!sign_option.devsignprivate || !sign_option.devkeyblock) {
+		fprintf(stderr, "FW A & B differ. DEV keys are required.\n");
+		return 1;
+	}
+	start_slot(slot_b);
+	return 0;
+}
+
 /* This signs a full BIOS image after it's been traversed. */
 static int sign_bios_at_end(struct bios_state_s *state)
 {
@@ -403,6 +470,19 @@ static int sign_bios_at_end(struct bios_state_s *state)
 	struct bios_area_s *vblock_b = &state->area[BIOS_FMAP_VBLOCK_B];
 	struct bios_area_s *fw_a = &state->area[BIOS_FMAP_FW_MAIN_A];
 	struct bios_area_s *fw_b = &state->area[BIOS_FMAP_FW_MAIN_B];
+	/* FW B is always normal keys */
+	struct sign_slot_s slot_b = {
+		.vblock = vblock_b,
+		.fw_body = fw_b,
+		.signkey = sign_option.signprivate,
+		.keyblock = sign_option.keyblock,
+	};
+	enum vb2_hash_algorithm hash_alg = sign_option.signprivate->hash_alg;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	struct vb2_digest_context dc;
+	struct vb2_fw_preamble *preamble;
+	uint32_t offset, chunk;
+	int same, hashing = 1;
 	int retval = 0;
 
 	if (!vblock_a->is_valid || !vblock_b->is_valid ||
@@ -411,32 +491,60 @@ static int sign_bios_at_end(struct bios_state_s *state)
 		return 1;
 	}
 
-	/* Do A & B differ ? */
-	if (fw_a->len != fw_b->len ||
-	    memcmp(fw_a->buf, fw_b->buf, fw_a->len)) {
-		/* Yes, must use DEV keys for A */
-		if (!sign_option.devsignprivate || !sign_option.devkeyblock) {
-			fprintf(stderr,
-				"FW A & B differ. DEV keys are required.\n");
-			return 1;
+	/*
+	 * Do A & B differ? Find out while hashing A, so it's only read once.
+	 * As soon as they do, B is signed on another thread meanwhile.
+	 */
+	if (VB2_SUCCESS != vb2_digest_init(&dc, hash_alg))
+		return 1;
+	same = fw_a->len == fw_b->len;
+	if (!same && start_differing_slots(&slot_b))
+		return 1;
+	for (offset = 0; offset < fw_a->len && (same || hashing);
+	     offset += chunk) {
+		chunk = fw_a->len - offset;
+		if (chunk > SIGN_CHUNK_SIZE)
+			chunk = SIGN_CHUNK_SIZE;
+
+		if (same && memcmp(fw_a->buf + offset,
+				   fw_b->buf + offset, chunk)) {
+			same = 0;
+			if (start_differing_slots(&slot_b))
+				return 1;
 		}
+		/* A's digest is only any use if the DEV key hashes alike */
+		if (!same && sign_option.devsignprivate->hash_alg != hash_alg)
+			hashing = 0;
+		if (hashing && VB2_SUCCESS != vb2_digest_extend(
+				&dc, fw_a->buf + offset, chunk))
+			hashing = 0;
+	}
+	if (hashing &&
+	    VB2_SUCCESS != vb2_digest_finalize(&dc, digest,
+					       vb2_digest_size(hash_alg)))
+		hashing = 0;
+
+	if (same) {
+		/* Both slots get the same signature, so only make it once */
 		retval |= write_new_preamble(vblock_a, fw_a,
-					     sign_option.devsignprivate,
-					     sign_option.devkeyblock);
-	} else {
-		retval |= write_new_preamble(vblock_a, fw_a,
+					     hashing ? digest : NULL,
 					     sign_option.signprivate,
 					     sign_option.keyblock);
+		if (!retval) {
+			preamble = (struct vb2_fw_preamble *)(vblock_a->buf +
+				sign_option.keyblock->keyblock_size);
+			memcpy(vblock_b->buf, vblock_a->buf,
+			       sign_option.keyblock->keyblock_size +
+			       preamble->preamble_size);
+		}
+	} else {
+		retval |= write_new_preamble(vblock_a, fw_a,
+					     hashing ? digest : NULL,
+					     sign_option.devsignprivate,
+					     sign_option.devkeyblock);
+		retval |= finish_slot(&slot_b);
 	}
 
-	/* FW B is always normal keys */
-	retval |= write_new_preamble(vblock_b, fw_b,
-				     sign_option.signprivate,
-				     sign_option.keyblock);
-
-
-
-
 	if (sign_option.loemid) {
 		retval |= write_loem("A", vblock_a);
 		retval |= write_loem("B", vblock_b);
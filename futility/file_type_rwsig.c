@@ -347,6 +347,13 @@ int ft_sign_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 			goto done;
 		}
 
+		/* A key held by signd has no public half to put in RO */
+		if (!sign_option.prikey->rsa_private_key) {
+			fprintf(stderr, "Can't replace the public key in RO"
+				" with a key held elsewhere\n");
+			goto done;
+		}
+
 		/* Extract the keyb blob */
 		if (vb_keyb_from_rsa(sign_option.prikey->rsa_private_key,
 					&keyb_data, &keyb_size)) {
@@ -0,0 +1,366 @@
+/*
+ * Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Connections to "futility signd", and keys which sign through it.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "host_key2.h"
+#include "host_misc2.h"
+#include "signd.h"
+
+void signd_conn_init(struct signd_conn *conn, int fd)
+{
+	conn->fd = fd;
+	conn->in_start = conn->in_end = 0;
+	conn->out_len = 0;
+}
+
+int signd_has_input(struct signd_conn *conn)
+{
+	return conn->in_start < conn->in_end;
+}
+
+/* Read more input into the buffer.  Returns 0 if success. */
+static int fill_input(struct signd_conn *conn)
+{
+	ssize_t n;
+
+	if (conn->in_start == conn->in_end)
+		conn->in_start = conn->in_end = 0;
+	if (conn->in_end == sizeof(conn->in)) {
+		memmove(conn->in, conn->in + conn->in_start,
+			conn->in_end - conn->in_start);
+		conn->in_end -= conn->in_start;
+		conn->in_start = 0;
+	}
+
+	do {
+		n = read(conn->fd, conn->in + conn->in_end,
+			 sizeof(conn->in) - conn->in_end);
+	} while (n < 0 && errno == EINTR);
+	if (n <= 0)
+		return 1;
+
+	conn->in_end += n;
+	return 0;
+}
+
+int signd_read_line(struct signd_conn *conn, char *line)
+{
+	uint32_t len = 0;
+	uint8_t c;
+
+	while (1) {
+		if (!signd_has_input(conn) && fill_input(conn))
+			return 1;
+		c = conn->in[conn->in_start++];
+		if (c == '\n')
+			break;
+		if (len == SIGND_MAX_LINE - 1)
+			return 1;
+		line[len++] = c;
+	}
+
+	line[len] = '\0';
+	return 0;
+}
+
+int signd_read_data(struct signd_conn *conn, void *buf, uint32_t size)
+{
+	uint8_t *p = buf;
+	uint32_t chunk;
+
+	while (size) {
+		if (!signd_has_input(conn) && fill_input(conn))
+			return 1;
+		chunk = conn->in_end - conn->in_start;
+		if (chunk > size)
+			chunk = size;
+		memcpy(p, conn->in + conn->in_start, chunk);
+		conn->in_start += chunk;
+		p += chunk;
+		size -= chunk;
+	}
+
+	return 0;
+}
+
+/* Write size bytes to fd.  Returns 0 if success. */
+static int write_all(int fd, const uint8_t *buf, uint32_t size)
+{
+	ssize_t n;
+
+	while (size) {
+		n = write(fd, buf, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return 1;
+		buf += n;
+		size -= n;
+	}
+
+	return 0;
+}
+
+int signd_write(struct signd_conn *conn, const void *buf, uint32_t size)
+{
+	if (conn->out_len + size > sizeof(conn->out)) {
+		if (signd_flush(conn))
+			return 1;
+		/* Don't bother buffering a big write */
+		if (size > sizeof(conn->out))
+			return write_all(conn->fd, buf, size);
+	}
+
+	memcpy(conn->out + conn->out_len, buf, size);
+	conn->out_len += size;
+	return 0;
+}
+
+int signd_flush(struct signd_conn *conn)
+{
+	int rv = write_all(conn->fd, conn->out, conn->out_len);
+
+	conn->out_len = 0;
+	return rv;
+}
+
+int signd_connect(const char *socket_path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket name %s is too long\n", socket_path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		fprintf(stderr, "Can't create socket: %s\n", strerror(errno));
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		fprintf(stderr, "Can't connect to %s: %s\n",
+			socket_path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int signd_request(struct signd_conn *conn, const char *request,
+		  const void *data, uint32_t size,
+		  uint8_t **reply, uint32_t *reply_size)
+{
+	char line[SIGND_MAX_LINE];
+	char *e;
+	unsigned long len;
+
+	*reply = NULL;
+	*reply_size = 0;
+
+	if (signd_write(conn, request, strlen(request)) ||
+	    (data && signd_write(conn, data, size)) ||
+	    signd_flush(conn) ||
+	    signd_read_line(conn, line)) {
+		fprintf(stderr, "Lost connection to signd\n");
+		return 1;
+	}
+
+	if (strncmp(line, "OK ", 3)) {
+		fprintf(stderr, "signd: %s\n", line);
+		return 1;
+	}
+	len = strtoul(line + 3, &e, 0);
+	if (*e || len > SIGND_MAX_DATA) {
+		fprintf(stderr, "Bad reply from signd: %s\n", line);
+		return 1;
+	}
+
+	*reply = malloc(len + 1);
+	if (!*reply)
+		return 1;
+	if (signd_read_data(conn, *reply, len)) {
+		fprintf(stderr, "Lost connection to signd\n");
+		free(*reply);
+		*reply = NULL;
+		return 1;
+	}
+	/* Text replies can be used as strings */
+	(*reply)[len] = '\0';
+	*reply_size = len;
+	return 0;
+}
+
+/*
+ * The connection which keys use.  Threads take turns with it, and a process
+ * forked from the one which opened it opens its own.
+ */
+static struct {
+	pthread_mutex_t lock;
+	char *socket_path;
+	pid_t pid;
+	struct signd_conn conn;
+} client = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.conn.fd = -1,
+};
+
+/* Make sure the client connection is open.  Returns 0 if success. */
+static int client_connect(const char *socket_path)
+{
+	int fd;
+
+	if (client.conn.fd >= 0 && client.pid == getpid() &&
+	    !strcmp(client.socket_path, socket_path))
+		return 0;
+
+	if (client.conn.fd >= 0)
+		close(client.conn.fd);
+	client.conn.fd = -1;
+
+	fd = signd_connect(socket_path);
+	if (fd < 0)
+		return 1;
+
+	free(client.socket_path);
+	client.socket_path = strdup(socket_path);
+	client.pid = getpid();
+	signd_conn_init(&client.conn, fd);
+	return 0;
+}
+
+/* Send a request on the client connection; see signd_request(). */
+static int client_request(const char *socket_path, const char *request,
+			  const void *data, uint32_t size,
+			  uint8_t **reply, uint32_t *reply_size)
+{
+	int rv;
+
+	pthread_mutex_lock(&client.lock);
+	rv = client_connect(socket_path) ||
+		signd_request(&client.conn, request, data, size,
+			      reply, reply_size);
+	pthread_mutex_unlock(&client.lock);
+	return rv;
+}
+
+/* A key held by the daemon */
+struct signd_key {
+	struct vb2_private_key key;	/* Must be first, to free it */
+	char *socket_path;
+	char name[];
+};
+
+static int signd_sign_digest(const struct vb2_private_key *key,
+			     const uint8_t *digest, uint32_t digest_size,
+			     uint8_t *sig)
+{
+	const struct signd_key *skey = (const struct signd_key *)key;
+	uint32_t sig_size = vb2_rsa_sig_size(key->sig_alg);
+	char request[SIGND_MAX_LINE];
+	uint8_t *reply;
+	uint32_t reply_size;
+
+	snprintf(request, sizeof(request), "DIGEST %s %u\n",
+		 skey->name, digest_size);
+	if (client_request(skey->socket_path, request, digest, digest_size,
+			   &reply, &reply_size))
+		return 1;
+
+	if (reply_size != sig_size) {
+		fprintf(stderr, "signd signature is %u bytes, not %u\n",
+			reply_size, sig_size);
+		free(reply);
+		return 1;
+	}
+
+	memcpy(sig, reply, sig_size);
+	free(reply);
+	return 0;
+}
+
+struct vb2_private_key *signd_private_key(const char *socket_path,
+					  const char *name)
+{
+	struct signd_key *skey;
+	char request[SIGND_MAX_LINE];
+	unsigned int sig_alg, hash_alg;
+	int id_start = 0, id_end = 0;
+	struct vb2_id id;
+	char *desc;
+	uint8_t *reply;
+	uint32_t reply_size;
+	size_t name_len = strlen(name);
+	size_t path_len = strlen(socket_path);
+
+	if (strpbrk(name, " \t\n") ||
+	    name_len + sizeof("INFO \n") > sizeof(request)) {
+		fprintf(stderr, "Bad signd key name \"%s\"\n", name);
+		return NULL;
+	}
+	snprintf(request, sizeof(request), "INFO %s\n", name);
+	if (client_request(socket_path, request, NULL, 0,
+			   &reply, &reply_size))
+		return NULL;
+
+	if (2 != sscanf((char *)reply, "%u %u %n%*[0-9a-fA-F]%n",
+			&sig_alg, &hash_alg, &id_start, &id_end) ||
+	    !vb2_rsa_sig_size(sig_alg) || !vb2_digest_size(hash_alg) ||
+	    id_end - id_start != 2 * VB2_ID_NUM_BYTES ||
+	    vb2_str_to_id((char *)reply + id_start, &id) ||
+	    (reply[id_end] && reply[id_end] != ' ')) {
+		fprintf(stderr, "Bad signd key info \"%s\"\n", reply);
+		free(reply);
+		return NULL;
+	}
+	/* The description is the rest of the reply, after a space */
+	desc = (char *)reply + id_end + !!reply[id_end];
+
+	/* The names go after the key, so vb2_private_key_free() frees them */
+	skey = calloc(1, sizeof(*skey) + name_len + 1 + path_len + 1);
+	if (!skey) {
+		free(reply);
+		return NULL;
+	}
+	skey->key.sig_alg = sig_alg;
+	skey->key.hash_alg = hash_alg;
+	skey->key.id = id;
+	if (*desc) {
+		skey->key.desc = strdup(desc);
+		if (!skey->key.desc) {
+			free(reply);
+			free(skey);
+			return NULL;
+		}
+	}
+	free(reply);
+	skey->key.sign_digest = signd_sign_digest;
+	strcpy(skey->name, name);
+	skey->socket_path = skey->name + name_len + 1;
+	strcpy(skey->socket_path, socket_path);
+
+	return &skey->key;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Protocol for "futility signd", which keeps private keys loaded and signs
+ * with them for its clients over a Unix domain socket.
+ *
+ * Each request is a line of text, followed by SIZE bytes of data if it has
+ * a SIZE:
+ *
+ *   INFO KEY             Describe the key named KEY
+ *   DIGEST KEY SIZE      Sign a digest made with KEY's hash algorithm
+ *   BLOB KEY SIZE        Hash and sign the data with KEY
+ *   STATS                Report the counters for each key
+ *
+ * Each reply is either "OK SIZE\n" followed by SIZE bytes, or "ERR MESSAGE\n".
+ * INFO replies with the text "SIG_ALG HASH_ALG ID DESC": the algorithms as
+ * enum numbers, the key ID as hex, and the rest is the key's description,
+ * which may be empty.  DIGEST and BLOB reply with the signature
+ * (vb2_rsa_sig_size(SIG_ALG) bytes), and STATS with a line of
+ * "KEY REQUESTS BYTES USECS" for each key.
+ *
+ * Requests on a connection are answered in order, so a client may send a
+ * batch of them before reading any replies.
+ */
+
+#ifndef VBOOT_REFERENCE_FUTILITY_SIGND_H_
+#define VBOOT_REFERENCE_FUTILITY_SIGND_H_
+
+#include <stdint.h>
+
+struct vb2_private_key;
+
+/* Longest request or reply line, and most data in a request */
+#define SIGND_MAX_LINE 1024
+#define SIGND_MAX_DATA (256 * 1024 * 1024)
+
+/* Size of the buffers for each direction of a connection */
+#define SIGND_BUF_SIZE 65536
+
+/* One end of a connection to the daemon */
+struct signd_conn {
+	int fd;
+	uint8_t in[SIGND_BUF_SIZE];
+	uint32_t in_start, in_end;
+	uint8_t out[SIGND_BUF_SIZE];
+	uint32_t out_len;
+};
+
+void signd_conn_init(struct signd_conn *conn, int fd);
+
+/* Return non-zero if more input is already buffered. */
+int signd_has_input(struct signd_conn *conn);
+
+/*
+ * Read a line, without its newline, into a buffer of SIGND_MAX_LINE bytes.
+ * Returns 0 if success, or non-zero at EOF or error.
+ */
+int signd_read_line(struct signd_conn *conn, char *line);
+
+/* Read exactly size bytes.  Returns 0 if success. */
+int signd_read_data(struct signd_conn *conn, void *buf, uint32_t size);
+
+/* Buffer size bytes to be written.  Returns 0 if success. */
+int signd_write(struct signd_conn *conn, const void *buf, uint32_t size);
+
+/* Write everything buffered.  Returns 0 if success. */
+int signd_flush(struct signd_conn *conn);
+
+/* Connect to the daemon's socket.  Returns the fd, or -1 if error. */
+int signd_connect(const char *socket_path);
+
+/*
+ * Send a request with size bytes of data (none if data is NULL), and read
+ * the reply's data into a malloc()ed buffer.  Returns 0 if the reply was OK,
+ * setting *reply and *reply_size, which the caller must free().
+ */
+int signd_request(struct signd_conn *conn, const char *request,
+		  const void *data, uint32_t size,
+		  uint8_t **reply, uint32_t *reply_size);
+
+/*
+ * Return a private key which signs by asking the daemon at socket_path to
+ * use its key called name, or NULL if error.  Free it with
+ * vb2_private_key_free().
+ */
+struct vb2_private_key *signd_private_key(const char *socket_path,
+					  const char *name);
+
+#endif	/* VBOOT_REFERENCE_FUTILITY_SIGND_H_ */
@@ -8,6 +8,12 @@
 
 #include <openssl/rsa.h>
 
+/*
+ * Without locking callbacks, which nothing here installs, OpenSSL before 1.1
+ * may only be used by one thread at a time.
+ */
+#define VB2_OPENSSL_THREAD_SAFE (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 
 static inline void RSA_get0_key(const RSA *rsa, const BIGNUM **n,
@@ -6,9 +6,11 @@
  */
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -21,23 +23,218 @@
 #include "host_common.h"
 #include "signature_digest.h"
 
+/*
+ * Bytes hashed per step.  This is the size of each read() and of each
+ * read-ahead window when the file is mapped.
+ */
+#define DIGEST_CHUNK_SIZE (1024 * 1024)
+
+/* Alignment of read buffers; a page keeps the kernel's copies cheap */
+#define DIGEST_BUF_ALIGN 4096
+
+/**
+ * Hash a regular file by mapping it.
+ *
+ * The kernel is asked to read ahead one chunk past the one being hashed, so
+ * I/O for the next chunk overlaps hashing of this one.
+ *
+ * @return 0 if success, non-zero if the file couldn't be mapped.
+ */
+static int digest_fd_mmap(int fd, uint64_t size,
+			  struct vb2_digest64_context *ctx)
+{
+	uint8_t *map;
+	uint64_t offset, n, ahead;
+
+	if (!size || size > SIZE_MAX)
+		return -1;
+
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return -1;
+
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	for (offset = 0; offset < size; offset += n) {
+		n = size - offset;
+		if (n > DIGEST_CHUNK_SIZE)
+			n = DIGEST_CHUNK_SIZE;
+
+		ahead = size - offset - n;
+		if (ahead > DIGEST_CHUNK_SIZE)
+			ahead = DIGEST_CHUNK_SIZE;
+		if (ahead)
+			madvise(map + offset + n, ahead, MADV_WILLNEED);
+
+		vb2_digest64_extend(ctx, map + offset, n);
+	}
+
+	munmap(map, size);
+	return 0;
+}
+
+/* Double buffer shared between the reader thread and the hashing thread */
+struct digest_reader {
+	int fd;
+	uint8_t *buf[2];
+	/* Bytes in each buffer; 0 at EOF, -1 on error */
+	ssize_t len[2];
+	/* Non-zero if the buffer has data the hasher hasn't consumed */
+	int full[2];
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+/* Fill buf with up to DIGEST_CHUNK_SIZE bytes; returns bytes read or -1. */
+static ssize_t read_chunk(int fd, uint8_t *buf)
+{
+	ssize_t total = 0, len;
+
+	while (total < DIGEST_CHUNK_SIZE) {
+		len = read(fd, buf + total, DIGEST_CHUNK_SIZE - total);
+		if (len < 0)
+			return -1;
+		if (!len)
+			break;
+		total += len;
+	}
+
+	return total;
+}
+
+static void *digest_reader_thread(void *arg)
+{
+	struct digest_reader *r = arg;
+	ssize_t len;
+	int i;
+
+	for (i = 0; ; i ^= 1) {
+		pthread_mutex_lock(&r->lock);
+		while (r->full[i])
+			pthread_cond_wait(&r->cond, &r->lock);
+		pthread_mutex_unlock(&r->lock);
+
+		len = read_chunk(r->fd, r->buf[i]);
+
+		pthread_mutex_lock(&r->lock);
+		r->len[i] = len;
+		r->full[i] = 1;
+		pthread_cond_signal(&r->cond);
+		pthread_mutex_unlock(&r->lock);
+
+		if (len < DIGEST_CHUNK_SIZE)
+			return NULL;
+	}
+}
+
+/**
+ * Hash a file with large reads, using a thread to read the next chunk while
+ * this one is hashed.
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+static int digest_fd_read(int fd, struct vb2_digest64_context *ctx)
+{
+	struct digest_reader r = {
+		.fd = fd,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+	pthread_t thread;
+	int threaded;
+	ssize_t len;
+	int rv = VB2_SUCCESS;
+	int i;
+
+	if (posix_memalign((void **)&r.buf[0], DIGEST_BUF_ALIGN,
+			   2 * DIGEST_CHUNK_SIZE))
+		return VB2_ERROR_READ_FILE_ALLOC;
+	r.buf[1] = r.buf[0] + DIGEST_CHUNK_SIZE;
+
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	threaded = !pthread_create(&thread, NULL, digest_reader_thread, &r);
+
+	for (i = 0; ; i ^= 1) {
+		if (threaded) {
+			pthread_mutex_lock(&r.lock);
+			while (!r.full[i])
+				pthread_cond_wait(&r.cond, &r.lock);
+			len = r.len[i];
+			pthread_mutex_unlock(&r.lock);
+		} else {
+			len = read_chunk(fd, r.buf[i]);
+		}
+
+		if (len < 0) {
+			rv = VB2_ERROR_READ_FILE_DATA;
+			break;
+		}
+		if (len)
+			vb2_digest64_extend(ctx, r.buf[i], len);
+		if (len < DIGEST_CHUNK_SIZE)
+			break;
+
+		if (threaded) {
+			pthread_mutex_lock(&r.lock);
+			r.full[i] = 0;
+			pthread_cond_signal(&r.cond);
+			pthread_mutex_unlock(&r.lock);
+		}
+	}
+
+	/* The reader stops by itself after a short or failed read */
+	if (threaded)
+		pthread_join(thread, NULL);
+
+	free(r.buf[0]);
+	return rv;
+}
+
+int DigestFd(int fd, enum vb2_hash_algorithm alg,
+	     enum digest_file_mode mode,
+	     uint8_t *digest, uint32_t digest_size)
+{
+	struct vb2_digest64_context ctx;
+	struct stat sb;
+	int rv;
+
+	/* Files may be whole disk images, so use the 64-bit length API */
+	rv = vb2_digest64_init(&ctx, alg);
+	if (rv)
+		return rv;
+
+	if (mode != DIGEST_FILE_READ) {
+		if (fstat(fd, &sb))
+			return VB2_ERROR_READ_FILE_SIZE;
+		if (mode == DIGEST_FILE_AUTO && !S_ISREG(sb.st_mode))
+			mode = DIGEST_FILE_READ;
+	}
+
+	if (mode == DIGEST_FILE_READ ||
+	    digest_fd_mmap(fd, sb.st_size, &ctx)) {
+		/* Also the fallback for empty or unmappable files */
+		rv = digest_fd_read(fd, &ctx);
+		if (rv)
+			return rv;
+	}
+
+	return vb2_digest64_finalize(&ctx, digest, digest_size);
+}
+
 int DigestFile(char *input_file, enum vb2_hash_algorithm alg,
 	       uint8_t *digest, uint32_t digest_size)
 {
-	int input_fd, len;
-	uint8_t data[VB2_SHA1_BLOCK_SIZE];
-	struct vb2_digest_context ctx;
+	int input_fd;
+	int rv;
 
 	if( (input_fd = open(input_file, O_RDONLY)) == -1 ) {
 		fprintf(stderr, "Couldn't open %s\n", input_file);
 		return VB2_ERROR_UNKNOWN;
 	}
-	vb2_digest_init(&ctx, alg);
-	while ((len = read(input_fd, data, sizeof(data))) == sizeof(data))
-		vb2_digest_extend(&ctx, data, len);
-	if (len != -1)
-		vb2_digest_extend(&ctx, data, len);
+
+	rv = DigestFd(input_fd, alg, DIGEST_FILE_AUTO, digest, digest_size);
 	close(input_fd);
 
-	return vb2_digest_finalize(&ctx, digest, digest_size);
+	return rv;
 }
@@ -135,6 +135,10 @@ struct vb2_keyblock *vb2_create_keyblock_external(
 		vb2_external_signature((uint8_t*)h, signed_size,
 				       signing_key_pem_file, algorithm,
 				       external_signer);
+	if (!sigtmp) {
+		free(h);
+		return NULL;
+	}
 	vb2_copy_signature(&h->keyblock_signature, sigtmp);
 	free(sigtmp);
 
@@ -7,6 +7,7 @@
 
 /* TODO: change all 'return 0', 'return 1' into meaningful return codes */
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -117,3 +118,36 @@ int WriteFile(const char* filename, const void *data, uint64_t size)
 	fclose(f);
 	return 0;
 }
+
+int SplitWords(char* line, char* words[], int max_words)
+{
+	char *in = line, *out = line;
+	char quote;
+	int count = 0;
+
+	while (1) {
+		while (isspace((unsigned char)*in))
+			in++;
+		if (!*in || (!count && *in == '#'))
+			return count;
+		if (count == max_words)
+			return -1;
+
+		words[count++] = out;
+		while (*in && !isspace((unsigned char)*in)) {
+			if (*in == '"' || *in == '\'') {
+				quote = *in++;
+				while (*in && *in != quote)
+					*out++ = *in++;
+				if (!*in)
+					return -1;
+				in++;
+			} else {
+				*out++ = *in++;
+			}
+		}
+		if (*in)
+			in++;
+		*out++ = '\0';
+	}
+}
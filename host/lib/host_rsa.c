@@ -0,0 +1,93 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host-side RSA verification helpers.
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "host_rsa.h"
+
+/* Don't bother starting a thread for fewer items than this */
+#define MIN_ITEMS_PER_THREAD 4
+
+/* Upper limit on threads, regardless of how many CPUs are online */
+#define MAX_THREADS 64
+
+struct verify_slice {
+	const struct vb2_public_key *key;
+	const struct vb2_rsa_verify_item *items;
+	int *results;
+	uint32_t count;
+};
+
+static void *verify_slice_thread(void *arg)
+{
+	struct verify_slice *s = arg;
+	uint8_t workbuf[VB2_VERIFY_RSA_DIGEST_WORKBUF_BYTES]
+		 __attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	vb2_rsa_verify_digests(s->key, s->items, s->results, s->count, &wb);
+	return NULL;
+}
+
+int vb2_rsa_verify_digests_parallel(const struct vb2_public_key *key,
+				    const struct vb2_rsa_verify_item *items,
+				    int *results,
+				    uint32_t count)
+{
+	struct verify_slice slices[MAX_THREADS];
+	pthread_t threads[MAX_THREADS];
+	int started[MAX_THREADS];
+	uint32_t nthreads, start, i;
+	long cpus;
+
+	if (!key || (count && (!items || !results)))
+		return VB2_ERROR_RSA_VERIFY_PARAM;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	nthreads = cpus > 0 ? cpus : 1;
+	if (nthreads > MAX_THREADS)
+		nthreads = MAX_THREADS;
+	if (nthreads > count / MIN_ITEMS_PER_THREAD)
+		nthreads = count / MIN_ITEMS_PER_THREAD;
+	if (!nthreads)
+		nthreads = 1;
+
+	/* Hand out contiguous ranges, spreading the remainder */
+	for (i = 0, start = 0; i < nthreads; i++) {
+		uint32_t n = count / nthreads + (i < count % nthreads);
+
+		slices[i].key = key;
+		slices[i].items = items + start;
+		slices[i].results = results + start;
+		slices[i].count = n;
+		start += n;
+	}
+
+	/* The calling thread does the first range itself */
+	for (i = 1; i < nthreads; i++)
+		started[i] = !pthread_create(&threads[i], NULL,
+					     verify_slice_thread, &slices[i]);
+	verify_slice_thread(&slices[0]);
+
+	for (i = 1; i < nthreads; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else
+			verify_slice_thread(&slices[i]);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (results[i])
+			return results[i];
+	}
+	return VB2_SUCCESS;
+}
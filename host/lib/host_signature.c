@@ -9,10 +9,16 @@
 
 #include <openssl/rsa.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "2sysincludes.h"
@@ -24,6 +30,156 @@
 #include "host_signature2.h"
 #include "vb2_common.h"
 
+/* Most requests sent to a persistent signer before reading its replies */
+#define SIGNER_PIPELINE 32
+
+/* An external signer kept running between signatures */
+struct external_signer {
+	struct external_signer *next;
+	pid_t pid;
+	int to_fd;		/* Its stdin */
+	int from_fd;		/* Its stdout */
+	char *program;
+	char *key_file;
+};
+
+static struct external_signer *signers;
+static pid_t signers_pid;	/* Process which started them */
+static int persist_signers;
+
+/*
+ * Write size bytes to fd.  Returns 0 if success.  SIGPIPE is blocked while
+ * writing, so a signer which has exited makes this fail with EPIPE instead
+ * of killing us.
+ */
+static int write_all(int fd, const uint8_t *buf, uint32_t size)
+{
+	static const struct timespec no_wait;
+	sigset_t pipe_set, old_set, pending;
+	int was_pending;
+	int rv = 0;
+	ssize_t n;
+
+	sigemptyset(&pipe_set);
+	sigaddset(&pipe_set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+	sigpending(&pending);
+	was_pending = sigismember(&pending, SIGPIPE);
+
+	while (size) {
+		n = write(fd, buf, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			if (n < 0 && errno == EPIPE) {
+				VB2_DEBUG("External signer has exited\n");
+				/* Discard the SIGPIPE this write raised */
+				if (!was_pending)
+					sigtimedwait(&pipe_set, NULL,
+						     &no_wait);
+			}
+			rv = 1;
+			break;
+		}
+		buf += n;
+		size -= n;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+	return rv;
+}
+
+/* Read exactly size bytes from fd.  Returns 0 if success. */
+static int read_all(int fd, uint8_t *buf, uint32_t size)
+{
+	ssize_t n;
+
+	while (size) {
+		n = read(fd, buf, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return 1;
+		buf += n;
+		size -= n;
+	}
+
+	return 0;
+}
+
+/* Make fd be the descriptor numbered to, kept open across exec. */
+static int move_fd(int fd, int to)
+{
+	if (fd == to)
+		return fcntl(fd, F_SETFD, 0) < 0;
+	return dup2(fd, to) != to;
+}
+
+/*
+ * Start [external_signer] as a co-process, with [mode] (unless NULL) and
+ * [pem_file] as its arguments.  Sets *to_fd to a pipe to its stdin and
+ * *from_fd to a pipe from its stdout.  Returns its pid, or -1 if error.
+ */
+static pid_t start_signer(const char *external_signer, const char *mode,
+			  const char *pem_file, int *to_fd, int *from_fd)
+{
+	int p_to_c[2], c_to_p[2];  /* pipe descriptors */
+	pid_t pid;
+	int i;
+
+	VB2_DEBUG("Will invoke \"%s %s%s%s\" to perform signing.\n"
+		  "Input to the signer will be provided on standard in.\n"
+		  "Output of the signer will be read from standard out.\n",
+		  external_signer, mode ? mode : "", mode ? " " : "",
+		  pem_file);
+
+	if (pipe(p_to_c) < 0)
+		goto pipe_error;
+	if (pipe(c_to_p) < 0) {
+		close(p_to_c[0]);
+		close(p_to_c[1]);
+		goto pipe_error;
+	}
+	/* Other signers mustn't hold these open, or EOF never comes */
+	for (i = 0; i < 2; i++) {
+		fcntl(p_to_c[i], F_SETFD, FD_CLOEXEC);
+		fcntl(c_to_p[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	pid = fork();
+	if (pid == 0) {
+		/* Child: stdin is the first pipe, stdout the second */
+		if (move_fd(p_to_c[STDIN_FILENO], STDIN_FILENO) ||
+		    move_fd(c_to_p[STDOUT_FILENO], STDOUT_FILENO))
+			_exit(1);
+		if (mode)
+			execl(external_signer, external_signer, mode,
+			      pem_file, (char *)0);
+		else
+			execl(external_signer, external_signer, pem_file,
+			      (char *)0);
+		VB2_DEBUG("execl() of external signer failed\n");
+		_exit(1);
+	}
+
+	close(p_to_c[STDIN_FILENO]);
+	close(c_to_p[STDOUT_FILENO]);
+	if (pid < 0) {
+		VB2_DEBUG("fork() error\n");
+		close(p_to_c[STDOUT_FILENO]);
+		close(c_to_p[STDIN_FILENO]);
+		return -1;
+	}
+
+	*to_fd = p_to_c[STDOUT_FILENO];
+	*from_fd = c_to_p[STDIN_FILENO];
+	return pid;
+
+pipe_error:
+	VB2_DEBUG("pipe() error\n");
+	return -1;
+}
+
 /* Invoke [external_signer] command with [pem_file] as an argument, contents of
  * [inbuf] passed redirected to stdin, and the stdout of the command is put
  * back into [outbuf].  Returns -1 on error, 0 on success.
@@ -36,88 +192,221 @@ static int sign_external(uint32_t size,
 			 const char *external_signer)
 {
 	int rv = 0, n;
-	int p_to_c[2], c_to_p[2];  /* pipe descriptors */
+	int to_fd, from_fd;
 	pid_t pid;
 
-	VB2_DEBUG("Will invoke \"%s %s\" to perform signing.\n"
-		 "Input to the signer will be provided on standard in.\n"
-		 "Output of the signer will be read from standard out.\n",
-		  external_signer, pem_file);
-
-	/* Need two pipes since we want to invoke the external_signer as
-	 * a co-process writing to its stdin and reading from its stdout. */
-	if (pipe(p_to_c) < 0 || pipe(c_to_p) < 0) {
-		VB2_DEBUG("pipe() error\n");
+	pid = start_signer(external_signer, NULL, pem_file, &to_fd, &from_fd);
+	if (pid < 0)
 		return -1;
+
+	/* We provide input to the child process (external signer). */
+	if (write_all(to_fd, inbuf, size)) {
+		VB2_DEBUG("write() error\n");
+		rv = -1;
 	}
-	if ((pid = fork()) < 0) {
-		VB2_DEBUG("fork() error\n");
-		return -1;
-	} else if (pid > 0) {  /* Parent. */
-		close(p_to_c[STDIN_FILENO]);
-		close(c_to_p[STDOUT_FILENO]);
+	/* Send EOF to child (signer process). */
+	close(to_fd);
+
+	if (!rv) {
+		do {
+			n = read(from_fd, outbuf, outbufsize);
+			outbuf += n;
+			outbufsize -= n;
+		} while (n > 0 && outbufsize);
 
-		/* We provide input to the child process (external signer). */
-		if (write(p_to_c[STDOUT_FILENO], inbuf, size) != size) {
-			VB2_DEBUG("write() error\n");
+		if (n < 0) {
+			VB2_DEBUG("read() error\n");
 			rv = -1;
-		} else {
-			/* Send EOF to child (signer process). */
-			close(p_to_c[STDOUT_FILENO]);
-
-			do {
-				n = read(c_to_p[STDIN_FILENO], outbuf,
-					 outbufsize);
-				outbuf += n;
-				outbufsize -= n;
-			} while (n > 0 && outbufsize);
-
-			if (n < 0) {
-				VB2_DEBUG("read() error\n");
-				rv = -1;
-			}
 		}
-		if (waitpid(pid, NULL, 0) < 0) {
-			VB2_DEBUG("waitpid() error\n");
-			rv = -1;
+	}
+	close(from_fd);
+
+	if (waitpid(pid, NULL, 0) < 0) {
+		VB2_DEBUG("waitpid() error\n");
+		rv = -1;
+	}
+	return rv;
+}
+
+/*
+ * Stop a persistent signer and free it.  Its stdin reaching EOF tells it to
+ * exit; only the process which started it can wait for that, unless it has
+ * already been reaped (pid 0).
+ */
+static void stop_signer(struct external_signer *signer)
+{
+	close(signer->to_fd);
+	close(signer->from_fd);
+	if (signer->pid && signers_pid == getpid() &&
+	    waitpid(signer->pid, NULL, 0) < 0)
+		VB2_DEBUG("waitpid() error\n");
+	free(signer);
+}
+
+static void stop_all_signers(void)
+{
+	struct external_signer *next;
+
+	while (signers) {
+		next = signers->next;
+		stop_signer(signers);
+		signers = next;
+	}
+}
+
+/* Remove a signer which has failed from the list, and stop it. */
+static void drop_signer(struct external_signer *signer)
+{
+	struct external_signer **s;
+
+	for (s = &signers; *s; s = &(*s)->next) {
+		if (*s == signer) {
+			*s = signer->next;
+			break;
 		}
-	} else {  /* Child. */
-		close (p_to_c[STDOUT_FILENO]);
-		close (c_to_p[STDIN_FILENO]);
-		/* Map the stdin to the first pipe (this pipe gets input
-		 * from the parent) */
-		if (STDIN_FILENO != p_to_c[STDIN_FILENO]) {
-			if (dup2(p_to_c[STDIN_FILENO], STDIN_FILENO) !=
-			    STDIN_FILENO) {
-				VB2_DEBUG("stdin dup2() failed\n");
-				close(p_to_c[0]);
+	}
+	stop_signer(signer);
+}
+
+/* Return the persistent signer for the key, starting it if needed. */
+static struct external_signer *get_signer(const char *pem_file,
+					  const char *external_signer)
+{
+	struct external_signer *signer;
+	size_t program_len = strlen(external_signer);
+
+	/* Signers inherited across fork() still belong to the parent */
+	if (signers && signers_pid != getpid())
+		stop_all_signers();
+
+	for (signer = signers; signer; signer = signer->next) {
+		if (!strcmp(signer->program, external_signer) &&
+		    !strcmp(signer->key_file, pem_file))
+			return signer;
+	}
+
+	signer = calloc(1, sizeof(*signer) + program_len + 1 +
+			strlen(pem_file) + 1);
+	if (!signer)
+		return NULL;
+	signer->program = (char *)(signer + 1);
+	strcpy(signer->program, external_signer);
+	signer->key_file = signer->program + program_len + 1;
+	strcpy(signer->key_file, pem_file);
+
+	signer->pid = start_signer(external_signer, "--persistent", pem_file,
+				   &signer->to_fd, &signer->from_fd);
+	if (signer->pid < 0) {
+		free(signer);
+		return NULL;
+	}
+
+	signer->next = signers;
+	signers = signer;
+	signers_pid = getpid();
+	return signer;
+}
+
+/* Send a request or reply: its size as a line of text, then the data. */
+static int write_frame(int fd, const uint8_t *buf, uint32_t size)
+{
+	char line[16];
+	int len = snprintf(line, sizeof(line), "%u\n", size);
+
+	return write_all(fd, (uint8_t *)line, len) || write_all(fd, buf, size);
+}
+
+/*
+ * Read a reply, which must be exactly size bytes; an empty reply means the
+ * signer failed.  Returns 0 if success.
+ */
+static int read_frame(int fd, uint8_t *buf, uint32_t size)
+{
+	char line[16];
+	char *e;
+	int len = 0;
+
+	do {
+		if (len == sizeof(line) ||
+		    read_all(fd, (uint8_t *)line + len, 1))
+			return 1;
+	} while (line[len++] != '\n');
+	line[len - 1] = '\0';
+
+	if (strtoul(line, &e, 10) != size || *e || e == line) {
+		VB2_DEBUG("External signer replied \"%s\", not %u bytes\n",
+			  line, size);
+		return 1;
+	}
+
+	return read_all(fd, buf, size);
+}
+
+/*
+ * Have a persistent signer sign count inputs, each of size bytes, into the
+ * signatures.  Up to SIGNER_PIPELINE requests are sent before reading their
+ * replies, few enough that the replies can't fill the pipe and leave both
+ * processes stuck writing.  Returns -1 on error, 0 on success.
+ */
+static int sign_persistent(struct external_signer *signer,
+			   uint8_t *const *inbufs, uint32_t size,
+			   struct vb2_signature **sigs, uint32_t count)
+{
+	uint32_t done, sent;
+
+	for (done = 0; done < count; done = sent) {
+		for (sent = done; sent < count && sent < done + SIGNER_PIPELINE;
+		     sent++) {
+			if (write_frame(signer->to_fd, inbufs[sent], size)) {
+				VB2_DEBUG("write() error\n");
 				return -1;
 			}
 		}
-		/* Map the stdout to the second pipe (this pipe sends back
-		 * signer output to the parent) */
-		if (STDOUT_FILENO != c_to_p[STDOUT_FILENO]) {
-			if (dup2(c_to_p[STDOUT_FILENO], STDOUT_FILENO) !=
-			    STDOUT_FILENO) {
-				VB2_DEBUG("stdout dup2() failed\n");
-				close(c_to_p[STDOUT_FILENO]);
+		for (; done < sent; done++) {
+			if (read_frame(signer->from_fd,
+				       vb2_signature_data(sigs[done]),
+				       sigs[done]->sig_size))
 				return -1;
-			}
-		}
-		/* External signer is invoked here. */
-		if (execl(external_signer, external_signer, pem_file,
-			  (char *) 0) < 0) {
-			VB2_DEBUG("execl() of external signer failed\n");
 		}
 	}
-	return rv;
+
+	return 0;
 }
 
-struct vb2_signature *vb2_external_signature(const uint8_t *data,
-					     uint32_t size,
-					     const char *key_file,
-					     uint32_t key_algorithm,
-					     const char *external_signer)
+int vb2_external_signer_reaped(pid_t pid)
+{
+	struct external_signer **s;
+	struct external_signer *signer;
+
+	if (signers_pid != getpid())
+		return 0;
+
+	for (s = &signers; *s; s = &(*s)->next) {
+		if ((*s)->pid != pid)
+			continue;
+		signer = *s;
+		*s = signer->next;
+		signer->pid = 0;
+		stop_signer(signer);
+		return 1;
+	}
+	return 0;
+}
+
+void vb2_external_signer_persist(int enable)
+{
+	persist_signers = enable;
+	if (!enable)
+		stop_all_signers();
+}
+
+/*
+ * Return the digest info and digest of the data, to be signed, in a buffer
+ * which the caller must free(), and set *out_size to its size.  Returns NULL
+ * if error.
+ */
+static uint8_t *signature_digest(const uint8_t *data, uint32_t size,
+				 uint32_t key_algorithm, uint32_t *out_size)
 {
 	int vb2_alg = vb2_crypto_to_hash(key_algorithm);
 	uint8_t digest[VB2_MAX_DIGEST_SIZE];
@@ -129,11 +418,8 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data,
 					   &digest_info, &digest_info_size))
 		return NULL;
 
-
 	uint8_t *signature_digest;
-	uint64_t signature_digest_len = digest_size + digest_info_size;
-
-	int rv;
+	uint32_t signature_digest_len = digest_size + digest_info_size;
 
 	/* Calculate the digest */
 	if (VB2_SUCCESS != vb2_digest_buffer(data, size, vb2_alg,
@@ -148,29 +434,80 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data,
 	memcpy(signature_digest, digest_info, digest_info_size);
 	memcpy(signature_digest + digest_info_size, digest, digest_size);
 
-	/* Allocate output signature */
+	*out_size = signature_digest_len;
+	return signature_digest;
+}
+
+int vb2_external_signatures(const uint8_t *const *data,
+			    const uint32_t *sizes,
+			    uint32_t count,
+			    const char *key_file,
+			    uint32_t key_algorithm,
+			    const char *external_signer,
+			    struct vb2_signature **sigs)
+{
 	uint32_t sig_size =
 		vb2_rsa_sig_size(vb2_crypto_to_signature(key_algorithm));
-	struct vb2_signature *sig = vb2_alloc_signature(sig_size, size);
-	if (!sig) {
-		free(signature_digest);
-		return NULL;
+	struct external_signer *signer;
+	uint8_t **digests;
+	uint32_t digest_len = 0;
+	uint32_t i;
+	int rv = 0;
+
+	memset(sigs, 0, count * sizeof(*sigs));
+	digests = calloc(count, sizeof(*digests));
+	if (!digests)
+		return -1;
+
+	/* Allocate output signatures, and the digests to sign into them */
+	for (i = 0; i < count && !rv; i++) {
+		digests[i] = signature_digest(data[i], sizes[i],
+					      key_algorithm, &digest_len);
+		sigs[i] = vb2_alloc_signature(sig_size, sizes[i]);
+		if (!digests[i] || !sigs[i])
+			rv = -1;
 	}
 
-	/* Sign the signature_digest into our output buffer */
-	rv = sign_external(signature_digest_len,    /* Input length */
-			   signature_digest,        /* Input data */
-			   vb2_signature_data(sig), /* Output sig */
-			   sig_size,                /* Max Output sig size */
-			   key_file,                /* Key file to use */
-			   external_signer);        /* External cmd to invoke */
-	free(signature_digest);
+	if (!rv && persist_signers) {
+		signer = get_signer(key_file, external_signer);
+		rv = signer ? sign_persistent(signer, digests, digest_len,
+					      sigs, count) : -1;
+		/* Don't leave a signer in an unknown state */
+		if (rv && signer)
+			drop_signer(signer);
+	} else {
+		for (i = 0; i < count && !rv; i++)
+			rv = sign_external(digest_len, digests[i],
+					   vb2_signature_data(sigs[i]),
+					   sig_size, key_file,
+					   external_signer);
+	}
 
-	if (-1 == rv) {
-		VB2_DEBUG("RSA_private_encrypt() failed.\n");
-		free(sig);
-		return NULL;
+	for (i = 0; i < count; i++) {
+		free(digests[i]);
+		if (rv) {
+			free(sigs[i]);
+			sigs[i] = NULL;
+		}
 	}
+	free(digests);
+
+	if (rv)
+		VB2_DEBUG("External signer failed.\n");
+	return rv;
+}
+
+struct vb2_signature *vb2_external_signature(const uint8_t *data,
+					     uint32_t size,
+					     const char *key_file,
+					     uint32_t key_algorithm,
+					     const char *external_signer)
+{
+	struct vb2_signature *sig;
+
+	if (vb2_external_signatures(&data, &size, 1, key_file, key_algorithm,
+				    external_signer, &sig))
+		return NULL;
 
 	/* Return the signature */
 	return sig;
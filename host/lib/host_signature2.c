@@ -81,6 +81,73 @@ struct vb2_signature *vb2_sha512_signature(const uint8_t *data, uint32_t size)
 	return sig;
 }
 
+int vb2_signing_init(struct vb2_signing_ctx *ctx,
+		     const struct vb2_private_key *key)
+{
+	const uint8_t *digest_info;
+
+	ctx->key = key;
+	ctx->digest_size = vb2_digest_size(key->hash_alg);
+	ctx->sig_size = vb2_rsa_sig_size(key->sig_alg);
+	if (!ctx->sig_size)
+		return VB2_SIGNING_INIT_SIG_SIZE;
+
+	if (VB2_SUCCESS != vb2_digest_info(key->hash_alg, &digest_info,
+					   &ctx->digest_info_size) ||
+	    ctx->digest_info_size > VB2_MAX_DIGEST_INFO_SIZE)
+		return VB2_SIGNING_INIT_DIGEST_INFO;
+
+	/* Each digest goes after the digest info */
+	memcpy(ctx->buf, digest_info, ctx->digest_info_size);
+	return VB2_SUCCESS;
+}
+
+int vb2_signing_sign_digest(struct vb2_signing_ctx *ctx,
+			    const uint8_t *digest,
+			    uint8_t *sig, uint32_t sig_size)
+{
+	const struct vb2_private_key *key = ctx->key;
+	int rv;
+
+	if (sig_size < ctx->sig_size)
+		return VB2_SIGNING_SIG_SIZE;
+
+	if (key->sign_digest) {
+		rv = key->sign_digest(key, digest, ctx->digest_size, sig) ?
+			-1 : 0;
+	} else {
+		memcpy(ctx->buf + ctx->digest_info_size, digest,
+		       ctx->digest_size);
+		rv = RSA_private_encrypt(ctx->digest_info_size +
+					 ctx->digest_size,
+					 ctx->buf, sig,
+					 key->rsa_private_key,
+					 RSA_PKCS1_PADDING);
+	}
+
+	if (-1 == rv) {
+		fprintf(stderr, "%s: %s failed\n", __func__,
+			key->sign_digest ? "sign_digest()" :
+			"RSA_private_encrypt()");
+		return VB2_SIGNING_RSA_ENCRYPT;
+	}
+
+	return VB2_SUCCESS;
+}
+
+int vb2_signing_sign(struct vb2_signing_ctx *ctx,
+		     const uint8_t *data, uint32_t size,
+		     uint8_t *sig, uint32_t sig_size)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+
+	if (VB2_SUCCESS != vb2_digest_buffer(data, size, ctx->key->hash_alg,
+					     digest, ctx->digest_size))
+		return VB2_SIGNING_DIGEST;
+
+	return vb2_signing_sign_digest(ctx, digest, sig, sig_size);
+}
+
 struct vb2_signature *vb2_calculate_signature(
 		const uint8_t *data, uint32_t size,
 		const struct vb2_private_key *key)
@@ -88,44 +155,33 @@ struct vb2_signature *vb2_calculate_signature(
 	uint8_t digest[VB2_MAX_DIGEST_SIZE];
 	uint32_t digest_size = vb2_digest_size(key->hash_alg);
 
-	uint32_t digest_info_size = 0;
-	const uint8_t *digest_info = NULL;
-	if (VB2_SUCCESS != vb2_digest_info(key->hash_alg,
-					   &digest_info, &digest_info_size))
-		return NULL;
-
 	/* Calculate the digest */
 	if (VB2_SUCCESS != vb2_digest_buffer(data, size, key->hash_alg,
 					     digest, digest_size))
 		return NULL;
 
-	/* Prepend the digest info to the digest */
-	int signature_digest_len = digest_size + digest_info_size;
-	uint8_t *signature_digest = malloc(signature_digest_len);
-	if (!signature_digest)
-		return NULL;
+	return vb2_sign_digest(digest, size, key);
+}
 
-	memcpy(signature_digest, digest_info, digest_info_size);
-	memcpy(signature_digest + digest_info_size, digest, digest_size);
+struct vb2_signature *vb2_sign_digest(
+		const uint8_t *digest, uint32_t size,
+		const struct vb2_private_key *key)
+{
+	struct vb2_signing_ctx ctx;
+	struct vb2_signature *sig;
 
-	/* Allocate output signature */
-	struct vb2_signature *sig = (struct vb2_signature *)
-		vb2_alloc_signature(vb2_rsa_sig_size(key->sig_alg), size);
-	if (!sig) {
-		free(signature_digest);
+	if (VB2_SUCCESS != vb2_signing_init(&ctx, key))
 		return NULL;
-	}
 
-	/* Sign the signature_digest into our output buffer */
-	int rv = RSA_private_encrypt(signature_digest_len,    /* Input length */
-				     signature_digest,        /* Input data */
-				     vb2_signature_data(sig), /* Output sig */
-				     key->rsa_private_key,    /* Key to use */
-				     RSA_PKCS1_PADDING);      /* Padding */
-	free(signature_digest);
+	/* Allocate output signature */
+	sig = vb2_alloc_signature(ctx.sig_size, size);
+	if (!sig)
+		return NULL;
 
-	if (-1 == rv) {
-		fprintf(stderr, "%s: RSA_private_encrypt() failed\n", __func__);
+	/* Sign the digest into our output buffer */
+	if (VB2_SUCCESS != vb2_signing_sign_digest(&ctx, digest,
+						   vb2_signature_data(sig),
+						   sig->sig_size)) {
 		free(sig);
 		return NULL;
 	}
@@ -10,6 +10,25 @@
 
 #include "2sha.h"
 
+/* How DigestFd() reads the file */
+enum digest_file_mode {
+	/* mmap() regular files, read() anything else */
+	DIGEST_FILE_AUTO = 0,
+	/* mmap() the file, falling back to read() if that fails */
+	DIGEST_FILE_MMAP,
+	/* Large read()s, in a separate thread from the hashing */
+	DIGEST_FILE_READ,
+};
+
+/* Calculates the digest of the data in the file open on [fd], which must be
+ * at offset 0, using hash algorithm [alg] and read method [mode].  Stores
+ * the digest into [digest], which is of size [digest_size].  Returns
+ * VB2_SUCCESS, or non-zero on error.
+ */
+int DigestFd(int fd, enum vb2_hash_algorithm alg,
+	     enum digest_file_mode mode,
+	     uint8_t *digest, uint32_t digest_size);
+
 /* Calculates the appropriate digest for the data in [input_file] based on the
  * hash algorithm [alg] and stores it into [digest], which is of size
  * [digest_size].  Returns VB2_SUCCESS, or non-zero on error.
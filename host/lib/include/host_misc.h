@@ -43,6 +43,14 @@ int ReadFileBit(const char* filename, int bitmask);
  * Returns 0 if success, 1 if error. */
 int WriteFile(const char* filename, const void *data, uint64_t size);
 
+/* Split [line] into at most [max_words] words in place, storing pointers to
+ * them in [words].  Words are separated by whitespace, and may be quoted with
+ * "" or ''.  A line starting with # has no words.
+ *
+ * Returns the number of words, or -1 if there are too many or a quote isn't
+ * closed. */
+int SplitWords(char* line, char* words[], int max_words);
+
 /**
  * Read data from a file into a newly allocated buffer.
  *
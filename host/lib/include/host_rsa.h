@@ -0,0 +1,32 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host-side RSA verification helpers.
+ */
+
+#ifndef VBOOT_REFERENCE_HOST_RSA_H_
+#define VBOOT_REFERENCE_HOST_RSA_H_
+
+#include "2rsa.h"
+
+/**
+ * Verify several RSA signatures made with the same key, using all CPUs.
+ *
+ * Splits the items into one contiguous range per online CPU and runs
+ * vb2_rsa_verify_digests() on each range in its own thread, with its own
+ * work buffer.  Callers must link with -lpthread.
+ *
+ * @param key		Key to use in signature verification
+ * @param items		Array of count signatures and digests
+ * @param results	Destination for count per-item results
+ * @param count		Number of items
+ * @return VB2_SUCCESS if every item verified, else the first non-zero
+ * entry in results[].
+ */
+int vb2_rsa_verify_digests_parallel(const struct vb2_public_key *key,
+				    const struct vb2_rsa_verify_item *items,
+				    int *results,
+				    uint32_t count);
+
+#endif  /* VBOOT_REFERENCE_HOST_RSA_H_ */
@@ -8,6 +8,9 @@
 #ifndef VBOOT_REFERENCE_HOST_SIGNATURE_H_
 #define VBOOT_REFERENCE_HOST_SIGNATURE_H_
 
+#include <sys/types.h>
+
+#include "2sha.h"
 #include "host_key.h"
 #include "utility.h"
 #include "vboot_struct.h"
@@ -71,6 +74,77 @@ struct vb2_signature *vb2_calculate_signature(
 		const uint8_t *data, uint32_t size,
 		const struct vb2_private_key *key);
 
+/**
+ * Calculate a signature from a digest of the data, using the specified key.
+ *
+ * @param digest	Digest of the data, using the key's hash algorithm
+ * @param size		Length of the data in bytes
+ * @param key		Private key to use to sign data
+ *
+ * @return The signature, or NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_sign_digest(
+		const uint8_t *digest, uint32_t size,
+		const struct vb2_private_key *key);
+
+/* Largest DigestInfo prefix which vb2_digest_info() returns */
+#define VB2_MAX_DIGEST_INFO_SIZE 19
+
+/*
+ * Context for signing many pieces of data with one key, without allocating
+ * memory for each signature.  It holds the DigestInfo prefix for the key's
+ * hash algorithm and the buffer the digest is signed in, so it can be kept on
+ * the stack but not shared between threads.
+ */
+struct vb2_signing_ctx {
+	const struct vb2_private_key *key;
+	uint32_t digest_size;
+	uint32_t sig_size;
+	uint32_t digest_info_size;
+	/* DigestInfo prefix, followed by the digest being signed */
+	uint8_t buf[VB2_MAX_DIGEST_INFO_SIZE + VB2_MAX_DIGEST_SIZE];
+};
+
+/**
+ * Prepare a signing context for a key.
+ *
+ * @param ctx		Context to initialize
+ * @param key		Private key to sign with; must outlive the context
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_signing_init(struct vb2_signing_ctx *ctx,
+		     const struct vb2_private_key *key);
+
+/**
+ * Sign a digest into a buffer, using a signing context.
+ *
+ * @param ctx		Signing context
+ * @param digest	Digest of the data, using the key's hash algorithm
+ * @param sig		Buffer for the signature, of ctx->sig_size bytes
+ * @param sig_size	Size of the buffer in bytes
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_signing_sign_digest(struct vb2_signing_ctx *ctx,
+			    const uint8_t *digest,
+			    uint8_t *sig, uint32_t sig_size);
+
+/**
+ * Sign data into a buffer, using a signing context.
+ *
+ * @param ctx		Signing context
+ * @param data		Pointer to data to sign
+ * @param size		Length of data in bytes
+ * @param sig		Buffer for the signature, of ctx->sig_size bytes
+ * @param sig_size	Size of the buffer in bytes
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+int vb2_signing_sign(struct vb2_signing_ctx *ctx,
+		     const uint8_t *data, uint32_t size,
+		     uint8_t *sig, uint32_t sig_size);
+
 /**
  * Calculate a signature for the data using an external signer.
  *
@@ -88,4 +162,55 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data,
 					     uint32_t key_algorithm,
 					     const char *external_signer);
 
+/**
+ * Calculate signatures for several pieces of data using an external signer.
+ *
+ * @param data			Pointers to the data to sign
+ * @param sizes			Length of each piece of data in bytes
+ * @param count			Number of pieces of data
+ * @param key_file		Name of file containing private key
+ * @param key_algorithm		Key algorithm
+ * @param external_signer	Path to external signer program
+ * @param sigs			Signatures for the data, which the caller
+ *				must free() on success
+ *
+ * @return 0 if success, non-zero if error.
+ */
+int vb2_external_signatures(const uint8_t *const *data,
+			    const uint32_t *sizes,
+			    uint32_t count,
+			    const char *key_file,
+			    uint32_t key_algorithm,
+			    const char *external_signer,
+			    struct vb2_signature **sigs);
+
+/**
+ * Keep external signers running to make many signatures, or stop them.
+ *
+ * By default, an external signer is run for each signature, reads the digest
+ * to sign from stdin until EOF, and writes the signature to stdout.  While
+ * signers persist, each is run once per key file with "--persistent" before
+ * the key file, and stays running until its stdin reaches EOF.  Requests and
+ * replies are both framed as their size in decimal on a line, followed by
+ * that many bytes; a reply of size 0 means signing failed.  Replies come in
+ * the order of the requests, which may be sent before earlier replies are
+ * read.
+ *
+ * @param enable		Non-zero to keep signers running; zero to
+ *				stop any which are
+ */
+void vb2_external_signer_persist(int enable);
+
+/**
+ * Tell the external signers that a child process has been reaped.
+ *
+ * A caller which waits for any of its children can reap a persistent signer
+ * which has exited.  The signer is then dropped, so it isn't waited for
+ * again, and the next signature with its key starts a new one.
+ *
+ * @param pid		Child process which was reaped
+ * @return 1 if it was a persistent signer, 0 if not.
+ */
+int vb2_external_signer_reaped(pid_t pid);
+
 #endif  /* VBOOT_REFERENCE_HOST_SIGNATURE_H_ */
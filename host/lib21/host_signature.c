@@ -154,6 +154,14 @@ int vb21_sign_data(struct vb21_signature **sig_ptr,
 	if (s.sig_alg == VB2_SIG_NONE) {
 		/* Bare hash signature is just the digest */
 		memcpy(buf + s.sig_offset, sig_digest, sig_digest_size);
+	} else if (key->sign_digest) {
+		/* Let the key sign the digest, wherever it is */
+		if (key->sign_digest(key, sig_digest + info_size, digest_size,
+				     buf + s.sig_offset)) {
+			free(sig_digest);
+			free(buf);
+			return VB2_SIGN_DATA_RSA_ENCRYPT;
+		}
 	} else {
 		/* RSA-encrypt the signature */
 		if (RSA_private_encrypt(sig_digest_size,
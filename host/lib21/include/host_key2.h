@@ -21,6 +21,15 @@ struct vb2_private_key {
 	enum vb2_signature_algorithm sig_alg;	/* Signature algorithm */
 	char *desc;				/* Description */
 	struct vb2_id id;			/* Key ID */
+
+	/*
+	 * If not NULL, this signs instead of rsa_private_key, for keys held
+	 * elsewhere.  It signs the hash_alg digest into sig, which holds
+	 * vb2_rsa_sig_size(sig_alg) bytes, and returns 0 if success.
+	 */
+	int (*sign_digest)(const struct vb2_private_key *key,
+			   const uint8_t *digest, uint32_t digest_size,
+			   uint8_t *sig);
 };
 
 struct vb2_packed_private_key {
@@ -430,6 +430,13 @@ static void test_nvm_read(void)
 	TEST_SUCC(nvmrw_read(&ctx), NULL);
 	TEST_EQ(ctx.nvmrw.struct_minor_version, NVM_HEADER_VERSION_MINOR, NULL);
 	TEST_EQ(ctx.nvmrw.struct_size, sizeof(*nvm), NULL);
+
+	/* Test missing secrets */
+	install_nvm(NVM_TYPE_RW_PRIMARY, 0, 1, 0);
+	install_nvm(NVM_TYPE_RW_SECONDARY, 1, 0, 0);
+	memset(&ctx.nvmrw, 0, sizeof(ctx.nvmrw));
+	ctx.secrets = NULL;
+	TEST_EQ(nvmrw_read(&ctx), BDB_ERROR_NVM_INVALID_PARAMETER, NULL);
 }
 
 static void verify_nvm_write(struct vba_context *ctx,
@@ -501,6 +508,11 @@ static void test_nvm_write(void)
 	ctx.nvmrw.struct_major_version = NVM_HEADER_VERSION_MAJOR - 1;
 	verify_nvm_write(&ctx, BDB_ERROR_NVM_STRUCT_VERSION);
 
+	/* Test missing secrets */
+	memcpy(&ctx.nvmrw, &nvm, sizeof(nvm));
+	ctx.secrets = NULL;
+	verify_nvm_write(&ctx, BDB_ERROR_NVM_INVALID_SECRET);
+
 	vbe_write_nvm_failure = 0;
 }
 
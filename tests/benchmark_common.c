@@ -0,0 +1,47 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Common functions used by benchmarks.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "benchmark_common.h"
+#include "timer_utils.h"
+
+double benchmark_report(const char *label, const char *units, double count,
+			uint32_t msecs)
+{
+	double speed;
+
+	if (!msecs)
+		msecs = 1;
+	speed = count * 1000.0 / msecs;
+	fprintf(stderr, "# %s %.0f %s in %u ms, %f %s/sec\n",
+		label, count, units, msecs, speed, units);
+	fprintf(stdout, "%s_per_sec_%s:%f\n", units, label, speed);
+	return speed;
+}
+
+double benchmark_run(const char *label, const char *units,
+		     double (*func)(void *arg), void *arg)
+{
+	ClockTimerState ct;
+	uint32_t msecs = 0;
+	double count = 0;
+	double done;
+
+	StartTimer(&ct);
+	while (msecs < BENCHMARK_MSECS) {
+		done = func(arg);
+		if (!done)
+			return 0;
+		count += done;
+		StopTimer(&ct);
+		msecs = GetDurationMsecs(&ct);
+	}
+
+	return benchmark_report(label, units, count, msecs);
+}
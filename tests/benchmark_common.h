@@ -0,0 +1,45 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Common functions used by benchmarks.
+ */
+
+#ifndef VBOOT_REFERENCE_BENCHMARK_COMMON_H_
+#define VBOOT_REFERENCE_BENCHMARK_COMMON_H_
+
+#include <stdint.h>
+
+/* How long benchmark_run() repeats an operation for */
+#define BENCHMARK_MSECS 500
+
+/**
+ * Report a benchmark result.
+ *
+ * Prints "# <label> <count> <units> in <msecs> ms" to stderr, and the rate as
+ * "<units>_per_sec_<label>:<rate>" to stdout for scripts to pick up.
+ *
+ * @param label		What was measured
+ * @param units		What was counted, e.g. "mbytes"
+ * @param count		How many units were done
+ * @param msecs		How long they took
+ * @return The rate in units per second.
+ */
+double benchmark_report(const char *label, const char *units, double count,
+			uint32_t msecs);
+
+/**
+ * Repeat an operation for BENCHMARK_MSECS and report its rate.
+ *
+ * @param label		What is measured
+ * @param units		What is counted, e.g. "mbytes"
+ * @param func		Does the operation one or more times, and returns
+ *			the number of units done.  If it fails, it prints why
+ *			and returns 0.
+ * @param arg		Passed to func
+ * @return The rate in units per second, or 0 if func failed.
+ */
+double benchmark_run(const char *label, const char *units,
+		     double (*func)(void *arg), void *arg);
+
+#endif  /* VBOOT_REFERENCE_BENCHMARK_COMMON_H_ */
@@ -0,0 +1,224 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the NOR flash access in cgpt, using a flash image file.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../cgpt/cgpt.h"
+#include "../cgpt/cgpt_nor.h"
+#include "cgptlib_internal.h"
+#include "fmap.h"
+#include "test_common.h"
+#include "vboot_host.h"
+
+#define FLASH_SIZE 0x20000
+#define GPT_OFFSET 0x10000
+#define GPT_SIZE 0x10000
+#define ERASE_SIZE NOR_IMAGE_ERASE_SIZE
+
+/* Drive whose GPT is in the flash, and its size */
+#define NOR_DRIVE "/dev/cgpt_nor_tests"
+#define NOR_DRIVE_SIZE (1024ULL * 1024 * 1024)
+
+static char image_name[] = "/tmp/cgpt_nor_tests.XXXXXX";
+static uint8_t image[FLASH_SIZE];
+
+/* Offsets passed to write_area(), and the backend's write_area() */
+static uint64_t write_offsets[FLASH_SIZE / ERASE_SIZE];
+static int write_count;
+static int write_fail_below;
+static int (*file_write_area)(struct nor_flash *flash, struct nor_area *area,
+			      uint64_t offset, uint64_t size);
+
+int GenerateGuid(Guid *newguid)
+{
+	memset(newguid, 0x42, sizeof(*newguid));
+	return CGPT_OK;
+}
+
+static int counting_write_area(struct nor_flash *flash, struct nor_area *area,
+			       uint64_t offset, uint64_t size)
+{
+	if (offset < write_fail_below)
+		return 1;
+	write_offsets[write_count++] = offset;
+	return file_write_area(flash, area, offset, size);
+}
+
+static void add_area(FmapHeader *fmap, const char *name, uint32_t offset,
+		     uint32_t size)
+{
+	FmapAreaHeader *ah = (FmapAreaHeader *)(fmap + 1) + fmap->fmap_nareas;
+
+	ah->area_offset = offset;
+	ah->area_size = size;
+	strcpy(ah->area_name, name);
+	fmap->fmap_nareas++;
+}
+
+/* Write a flash image with an FMAP and a pattern everywhere else. */
+static int create_image(void)
+{
+	FmapHeader *fmap = (FmapHeader *)image;
+	int fd, i;
+
+	for (i = 0; i < FLASH_SIZE; i++)
+		image[i] = i * 7;
+
+	memset(fmap, 0, 0x1000);
+	memcpy(fmap->fmap_signature, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE);
+	fmap->fmap_ver_major = FMAP_VER_MAJOR;
+	fmap->fmap_size = FLASH_SIZE;
+	strcpy(fmap->fmap_name, "FMAP");
+	add_area(fmap, "FMAP", 0, 0x1000);
+	add_area(fmap, "UNALIGNED", 0x1800, 0x2000);
+	add_area(fmap, "RW_GPT", GPT_OFFSET, GPT_SIZE);
+
+	fd = mkstemp(image_name);
+	if (fd < 0)
+		return 1;
+	if (write(fd, image, sizeof(image)) != sizeof(image)) {
+		close(fd);
+		return 1;
+	}
+	close(fd);
+	return 0;
+}
+
+/* Return 0 if the image file matches 'image' with 'area' in it. */
+static int check_image(struct nor_area *area)
+{
+	uint8_t buf[FLASH_SIZE];
+	int fd = open(image_name, O_RDONLY);
+	int rv;
+
+	if (fd < 0)
+		return 1;
+	rv = read(fd, buf, sizeof(buf)) != sizeof(buf);
+	close(fd);
+
+	memcpy(image + GPT_OFFSET, area->data, GPT_SIZE);
+	return rv || memcmp(buf, image, sizeof(buf));
+}
+
+static void open_tests(void)
+{
+	struct nor_flash flash;
+	struct nor_area area;
+
+	TEST_NEQ(NorFlashOpenFile(&flash, "/dev/null/nothing"), 0,
+		 "Open missing file");
+	TEST_NEQ(NorFlashOpenFile(&flash, "/dev/null"), 0,
+		 "Open non-flash device");
+
+	TEST_SUCC(NorFlashOpenFile(&flash, image_name), "Open image");
+	TEST_EQ(flash.size, FLASH_SIZE, "  size");
+	TEST_EQ(flash.erase_size, ERASE_SIZE, "  erase size");
+
+	TEST_NEQ(NorAreaRead(&flash, "MISSING", &area), 0, "Missing area");
+	TEST_PTR_EQ(area.data, NULL, "  no data");
+	TEST_NEQ(NorAreaRead(&flash, "UNALIGNED", &area), 0,
+		 "Area not in erase blocks");
+	TEST_PTR_EQ(area.data, NULL, "  no data");
+
+	TEST_SUCC(NorAreaRead(&flash, "RW_GPT", &area), "Read RW_GPT");
+	TEST_EQ(area.offset, GPT_OFFSET, "  offset");
+	TEST_EQ(area.size, GPT_SIZE, "  size");
+	TEST_SUCC(memcmp(area.data, image + GPT_OFFSET, GPT_SIZE), "  data");
+
+	NorAreaFree(&area);
+	NorFlashClose(&flash);
+}
+
+static void write_tests(void)
+{
+	struct nor_flash flash;
+	struct nor_area area;
+	struct drive drive;
+	CgptCreateParams create;
+	int i;
+
+	NorFlashOpenFile(&flash, image_name);
+	file_write_area = flash.write_area;
+	flash.write_area = counting_write_area;
+	NorAreaRead(&flash, "RW_GPT", &area);
+
+	write_count = 0;
+	TEST_SUCC(NorAreaWrite(&flash, &area), "Write unchanged area");
+	TEST_EQ(write_count, 0, "  no writes");
+
+	/* Create a GPT on a drive kept in the area */
+	DriveUseMemory(NOR_DRIVE, area.data, area.size);
+	memset(&create, 0, sizeof(create));
+	create.drive_name = NOR_DRIVE;
+	create.drive_size = NOR_DRIVE_SIZE;
+	TEST_SUCC(CgptCreate(&create), "Create GPT in memory");
+	TEST_SUCC(DriveOpen(NOR_DRIVE, &drive, O_RDONLY, NOR_DRIVE_SIZE),
+		  "  open it");
+	TEST_SUCC(GptSanityCheck(&drive.gpt), "  valid");
+	DriveClose(&drive, 0);
+	DriveUseMemory(NULL, NULL, 0);
+	TEST_NEQ(check_image(&area), 0, "  image not written yet");
+
+	write_count = 0;
+	TEST_SUCC(NorAreaWrite(&flash, &area), "Write GPT");
+	TEST_NEQ(write_count, 0, "  writes");
+	TEST_TRUE(write_count < GPT_SIZE / ERASE_SIZE,
+		  "  not every block");
+	for (i = 1; i < write_count; i++)
+		TEST_TRUE(write_offsets[i] > write_offsets[i - 1],
+			  "  in order");
+	TEST_SUCC(check_image(&area), "  image matches");
+
+	write_count = 0;
+	TEST_SUCC(NorAreaWrite(&flash, &area), "Write again");
+	TEST_EQ(write_count, 0, "  no writes");
+
+	area.data[GPT_SIZE / 2 + ERASE_SIZE + 5] ^= 0xff;
+	write_count = 0;
+	TEST_SUCC(NorAreaWrite(&flash, &area), "Write one changed byte");
+	TEST_EQ(write_count, 1, "  one write");
+	TEST_EQ(write_offsets[0], GPT_SIZE / 2 + ERASE_SIZE, "  its block");
+	TEST_SUCC(check_image(&area), "  image matches");
+
+	/* Failing to write the 1st half still writes the 2nd */
+	area.data[0] ^= 0xff;
+	area.data[GPT_SIZE / 2] ^= 0xff;
+	write_count = 0;
+	write_fail_below = GPT_SIZE / 2;
+	TEST_NEQ(NorAreaWrite(&flash, &area), 0, "Write 1st half fails");
+	TEST_EQ(write_count, 1, "  one write");
+	TEST_EQ(write_offsets[0], GPT_SIZE / 2, "  2nd half");
+	write_fail_below = 0;
+
+	write_count = 0;
+	TEST_SUCC(NorAreaWrite(&flash, &area), "Write again");
+	TEST_EQ(write_count, 1, "  one write");
+	TEST_EQ(write_offsets[0], 0, "  1st half");
+	TEST_SUCC(check_image(&area), "  image matches");
+
+	NorAreaFree(&area);
+	NorFlashClose(&flash);
+}
+
+int main(int argc, char *argv[])
+{
+	if (create_image()) {
+		fprintf(stderr, "Couldn't create %s\n", image_name);
+		return 1;
+	}
+
+	open_tests();
+	write_tests();
+
+	unlink(image_name);
+	return gTestSuccess ? 0 : 255;
+}
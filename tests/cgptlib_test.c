@@ -863,6 +863,73 @@ static int OverlappedPartitionTest(void) {
 	return TEST_OK;
 }
 
+/*
+ * Fill all 128 entries with 3-sector partitions, in shuffled LBA order, so
+ * neighbors by LBA and by GUID are far apart in the table.
+ */
+static void BuildFullEntries(GptData *gpt)
+{
+	GptEntry *e = (GptEntry *)gpt->primary_entries;
+	uint32_t i, slot;
+
+	BuildTestGptData(gpt);
+	ZeroEntries(gpt);
+	for (i = 0; i < MAX_NUMBER_OF_ENTRIES; i++) {
+		/* 37 is coprime with 128, so each slot is used once */
+		slot = (i * 37) % MAX_NUMBER_OF_ENTRIES;
+		memcpy(&e[i].type, &guid_kernel, sizeof(Guid));
+		SetGuid(&e[i].unique, (i * 91) % MAX_NUMBER_OF_ENTRIES);
+		e[i].starting_lba = 34 + 3 * slot;
+		e[i].ending_lba = e[i].starting_lba + 2;
+	}
+	RefreshCrc32(gpt);
+}
+
+/* Test CheckEntries() on full tables, where entries are sorted to check */
+static int FullEntriesTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptHeader *h = (GptHeader *)gpt->primary_header;
+	GptEntry *e = (GptEntry *)gpt->primary_entries;
+
+	BuildFullEntries(gpt);
+	EXPECT(0 == CheckEntries(e, h));
+
+	/* Entry 0 (slot 0) runs into entry 45 (slot 1) */
+	BuildFullEntries(gpt);
+	e[0].ending_lba++;
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_END_LBA_OVERLAP == CheckEntries(e, h));
+
+	/* Entry 7 (slot 3) starts inside entry 90 (slot 2) */
+	BuildFullEntries(gpt);
+	e[7].starting_lba--;
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_START_LBA_OVERLAP == CheckEntries(e, h));
+
+	/* Entry 83 has the last slot, so can grow off the end of the disk */
+	BuildFullEntries(gpt);
+	e[83].ending_lba = h->last_usable_lba + 1;
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_OUT_OF_REGION == CheckEntries(e, h));
+
+	BuildFullEntries(gpt);
+	memcpy(&e[100].unique, &e[3].unique, sizeof(Guid));
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_DUP_GUID == CheckEntries(e, h));
+
+	/* Unused entries aren't checked */
+	BuildFullEntries(gpt);
+	memcpy(&e[100].unique, &e[3].unique, sizeof(Guid));
+	e[7].starting_lba--;
+	memset(&e[7].type, 0, sizeof(Guid));
+	memset(&e[100].type, 0, sizeof(Guid));
+	RefreshCrc32(gpt);
+	EXPECT(0 == CheckEntries(e, h));
+
+	return TEST_OK;
+}
+
 /* Test both sanity checking and repair. */
 static int SanityCheckTest(void)
 {
@@ -1413,9 +1480,119 @@ static int GetNextTriesTest(void)
 	return TEST_OK;
 }
 
+/*
+ * The scan GptNextKernelEntry() used to do on each call, as a reference for
+ * the order it should return kernels in.
+ */
+static int RefNextKernelEntry(GptData *gpt, int *kernel, int *prio)
+{
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+	GptEntry *entries = (GptEntry *)gpt->primary_entries;
+	GptEntry *e;
+	int new_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+	int new_prio = 0;
+	int i;
+
+	if (*kernel != CGPT_KERNEL_ENTRY_NOT_FOUND) {
+		for (i = *kernel + 1; i < header->number_of_entries; i++) {
+			e = entries + i;
+			if (!IsKernelEntry(e))
+				continue;
+			if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
+				continue;
+			if (GetEntryPriority(e) == *prio) {
+				*kernel = i;
+				return GPT_SUCCESS;
+			}
+		}
+	}
+
+	for (i = 0, e = entries; i < header->number_of_entries; i++, e++) {
+		if (!IsKernelEntry(e))
+			continue;
+		if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
+			continue;
+		if (GetEntryPriority(e) >= *prio)
+			continue;
+		if (GetEntryPriority(e) > new_prio) {
+			new_kernel = i;
+			new_prio = GetEntryPriority(e);
+		}
+	}
+
+	*kernel = new_kernel;
+	*prio = new_prio;
+	return new_kernel == CGPT_KERNEL_ENTRY_NOT_FOUND ?
+		GPT_ERROR_NO_VALID_KERNEL : GPT_SUCCESS;
+}
+
+/* Deterministic pseudo-random number less than n */
+static int Rand(int n)
+{
+	static uint32_t seed = 1;
+
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+/*
+ * Walk random tables while updating random entries, and check the kernels
+ * come out in the same order as the reference scan.
+ */
+static int KernelOrderTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptEntry *e = (GptEntry *)(gpt->primary_entries);
+	uint64_t start, size;
+	int ref_kernel, ref_prio;
+	int round, i, rv, ref_rv;
+	int kernel, prio, successful, tries;
+
+	for (round = 0; round < 200; round++) {
+		BuildTestGptData(gpt);
+		ZeroEntries(gpt);
+		for (i = 0; i < 24; i++) {
+			kernel = Rand(4) != 0;
+			prio = Rand(16);
+			successful = Rand(2);
+			tries = Rand(3);
+			FillEntry(e + i, kernel, prio, successful, tries);
+			SetGuid(&e[i].unique, i);
+			e[i].starting_lba = 34 + 10 * i;
+			e[i].ending_lba = e[i].starting_lba + 9;
+		}
+		RefreshCrc32(gpt);
+		EXPECT(GPT_SUCCESS == GptInit(gpt));
+		ref_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+		ref_prio = 999;
+
+		do {
+			rv = GptNextKernelEntry(gpt, &start, &size);
+			ref_rv = RefNextKernelEntry(gpt, &ref_kernel,
+						    &ref_prio);
+			EXPECT(ref_rv == rv);
+			EXPECT(ref_kernel == gpt->current_kernel);
+			if (rv != GPT_SUCCESS)
+				break;
+
+			/* Update the current kernel, or any other one */
+			if (Rand(2))
+				GptUpdateKernelEntry(gpt, 1 + Rand(2));
+			i = Rand(24);
+			if (Rand(2))
+				GptUpdateKernelWithEntry(gpt, e + i,
+							 1 + Rand(4));
+		} while (1);
+	}
+
+	return TEST_OK;
+}
+
 static int GptUpdateTest(void)
 {
 	GptData *gpt = GetEmptyGptData();
+	GptHeader *h1 = (GptHeader *)gpt->primary_header;
+	GptHeader *h2 = (GptHeader *)gpt->secondary_header;
 	GptEntry *e = (GptEntry *)(gpt->primary_entries);
 	GptEntry *e2 = (GptEntry *)(gpt->secondary_entries);
 	uint64_t start, size;
@@ -1468,6 +1645,16 @@ static int GptUpdateTest(void)
 	EXPECT(0 == GetEntryTries(e2 + KERNEL_B));
 	/* And that's caused the GPT to need updating */
 	EXPECT(0x0F == gpt->modified);
+	/* But only the sector holding the entry, with patched CRCs */
+	EXPECT(1 == gpt->modified_sectors1);
+	EXPECT(1 == gpt->modified_sectors2);
+	EXPECT(h1->entries_crc32 ==
+	       Crc32(gpt->primary_entries, TOTAL_ENTRIES_SIZE));
+	EXPECT(h2->entries_crc32 == h1->entries_crc32);
+	EXPECT(0 == CheckHeader(h1, 0, gpt->streaming_drive_sectors,
+				gpt->gpt_drive_sectors, 0, gpt->sector_bytes));
+	EXPECT(0 == CheckHeader(h2, 1, gpt->streaming_drive_sectors,
+				gpt->gpt_drive_sectors, 0, gpt->sector_bytes));
 
 	/* Another kernel with tries */
 	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
@@ -1497,6 +1684,17 @@ static int GptUpdateTest(void)
 	EXPECT(GPT_ERROR_INVALID_UPDATE_TYPE ==
 	       GptUpdateKernelEntry(gpt, GPT_UPDATE_ENTRY_BAD));
 
+	/* Entries already being rewritten in full stay that way */
+	BuildTestGptData(gpt);
+	FillEntry(e + KERNEL_A, 1, 4, 0, 2);
+	RefreshCrc32(gpt);
+	GptInit(gpt);
+	gpt->modified = GPT_MODIFIED_ENTRIES2;
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(GPT_SUCCESS == GptUpdateKernelEntry(gpt, GPT_UPDATE_ENTRY_TRY));
+	EXPECT(0x0F == gpt->modified);
+	EXPECT(1 == gpt->modified_sectors1);
+	EXPECT(0 == gpt->modified_sectors2);
 
 	return TEST_OK;
 }
@@ -1526,6 +1724,9 @@ static int GptOverridePriorityTest(void)
 	override_counter = 0;
 	override_priority = 0;
 
+	/* A walk keeps its priorities, so start a new one to see the change */
+	GptInit(gpt);
+
 	/* Now, we should get A */
 	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
 	EXPECT(KERNEL_A == gpt->current_kernel);
@@ -1732,6 +1933,7 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(EntriesCrcTest), },
 		{ TEST_CASE(ValidEntryTest), },
 		{ TEST_CASE(OverlappedPartitionTest), },
+		{ TEST_CASE(FullEntriesTest), },
 		{ TEST_CASE(SanityCheckTest), },
 		{ TEST_CASE(NoValidKernelEntryTest), },
 		{ TEST_CASE(EntryAttributeGetSetTest), },
@@ -1739,11 +1941,14 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(GetNextNormalTest), },
 		{ TEST_CASE(GetNextPrioTest), },
 		{ TEST_CASE(GetNextTriesTest), },
+		{ TEST_CASE(KernelOrderTest), },
 		{ TEST_CASE(GptUpdateTest), },
 		{ TEST_CASE(GptOverridePriorityTest), },
 		{ TEST_CASE(UpdateInvalidKernelTypeTest), },
 		{ TEST_CASE(DuplicateUniqueGuidTest), },
 		{ TEST_CASE(TestCrc32TestVectors), },
+		{ TEST_CASE(TestCrc32Implementations), },
+		{ TEST_CASE(TestCrc32Update), },
 		{ TEST_CASE(GetKernelGuidTest), },
 		{ TEST_CASE(ErrorTextTest), },
 		{ TEST_CASE(CheckHeaderOffDevice), },
@@ -0,0 +1,164 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for CheckEntries() on full GPT entry tables of 16 to
+ * MAX_NUMBER_OF_ENTRIES entries, compared with the pairwise check it used to
+ * do.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "benchmark_common.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "gpt.h"
+
+/* Partitions are this many sectors each */
+#define PARTITION_SECTORS 8
+
+static const Guid guid_kernel = GPT_ENT_TYPE_CHROMEOS_KERNEL;
+
+/* The original CheckEntries(), comparing every pair of entries */
+static int check_entries_pairwise(GptEntry *entries, GptHeader *h)
+{
+	GptEntry *entry, *e2;
+	uint32_t crc32;
+	uint32_t i, i2;
+
+	crc32 = Crc32((const uint8_t *)entries,
+		      h->size_of_entry * h->number_of_entries);
+	if (crc32 != h->entries_crc32)
+		return GPT_ERROR_CRC_CORRUPTED;
+
+	for (i = 0, entry = entries; i < h->number_of_entries; i++, entry++) {
+		if (IsUnusedEntry(entry))
+			continue;
+
+		if ((entry->starting_lba < h->first_usable_lba) ||
+		    (entry->ending_lba > h->last_usable_lba) ||
+		    (entry->ending_lba < entry->starting_lba))
+			return GPT_ERROR_OUT_OF_REGION;
+
+		for (i2 = 0, e2 = entries; i2 < h->number_of_entries;
+		     i2++, e2++) {
+			if (i2 == i || IsUnusedEntry(e2))
+				continue;
+
+			if ((entry->starting_lba >= e2->starting_lba) &&
+			    (entry->starting_lba <= e2->ending_lba))
+				return GPT_ERROR_START_LBA_OVERLAP;
+			if ((entry->ending_lba >= e2->starting_lba) &&
+			    (entry->ending_lba <= e2->ending_lba))
+				return GPT_ERROR_END_LBA_OVERLAP;
+
+			if (0 == memcmp(&entry->unique, &e2->unique,
+					sizeof(Guid)))
+				return GPT_ERROR_DUP_GUID;
+		}
+	}
+
+	return 0;
+}
+
+/* Build a valid table with every entry used, in shuffled LBA order. */
+static void build_table(GptHeader *h, GptEntry *entries, uint32_t count)
+{
+	uint32_t seed = 0x12345678;
+	uint32_t i, j, tmp;
+	uint32_t *slot = malloc(count * sizeof(*slot));
+
+	for (i = 0; i < count; i++)
+		slot[i] = i;
+	for (i = count - 1; i > 0; i--) {
+		seed = seed * 1103515245 + 12345;
+		j = (seed >> 8) % (i + 1);
+		tmp = slot[i];
+		slot[i] = slot[j];
+		slot[j] = tmp;
+	}
+
+	memset(h, 0, sizeof(*h));
+	h->size_of_entry = sizeof(GptEntry);
+	h->number_of_entries = count;
+	h->first_usable_lba = 34;
+	h->last_usable_lba = 34 + count * PARTITION_SECTORS - 1;
+
+	memset(entries, 0, count * sizeof(GptEntry));
+	for (i = 0; i < count; i++) {
+		memcpy(&entries[i].type, &guid_kernel, sizeof(Guid));
+		/* Random-looking GUIDs which are still unique */
+		seed = seed * 1103515245 + 12345;
+		memcpy(&entries[i].unique, &seed, sizeof(seed));
+		memcpy((uint8_t *)&entries[i].unique + 12, &i, sizeof(i));
+		entries[i].starting_lba = h->first_usable_lba +
+			slot[i] * PARTITION_SECTORS;
+		entries[i].ending_lba = entries[i].starting_lba +
+			PARTITION_SECTORS - 1;
+	}
+
+	h->entries_crc32 = Crc32((const uint8_t *)entries,
+				 count * sizeof(GptEntry));
+	free(slot);
+}
+
+struct check_args {
+	GptHeader *h;
+	GptEntry *entries;
+	int pairwise;
+	const char *label;
+};
+
+/* Check the table a few times; returns the number of checks, or 0 if error. */
+static double check_table(void *arg)
+{
+	struct check_args *args = arg;
+	int rv, j;
+
+	for (j = 0; j < 4; j++) {
+		if (args->pairwise)
+			rv = check_entries_pairwise(args->entries, args->h);
+		else
+			rv = CheckEntries(args->entries, args->h);
+		if (rv) {
+			fprintf(stderr, "%s: check failed (%d)\n",
+				args->label, rv);
+			return 0;
+		}
+	}
+	return j;
+}
+
+int main(int argc, char *argv[])
+{
+	GptEntry *entries = malloc(MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry));
+	GptHeader h;
+	char label[64];
+	struct check_args args = { &h, entries, 0, label };
+	uint32_t count;
+	int rv = 0;
+
+	if (!entries)
+		return 1;
+
+	for (count = 16; count <= MAX_NUMBER_OF_ENTRIES; count *= 2) {
+		build_table(&h, entries, count);
+
+		snprintf(label, sizeof(label), "pairwise_%u", count);
+		args.pairwise = 1;
+		if (!benchmark_run(label, "checks", check_table, &args))
+			rv = 1;
+		snprintf(label, sizeof(label), "sorted_%u", count);
+		args.pairwise = 0;
+		if (!benchmark_run(label, "checks", check_table, &args))
+			rv = 1;
+	}
+
+	free(entries);
+	return rv;
+}
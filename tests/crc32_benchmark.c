@@ -0,0 +1,92 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for the cgptlib CRC32 implementations, at the sizes of a GPT
+ * header, a GPT entry array and a large buffer.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "benchmark_common.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "gpt.h"
+
+#define MAX_BUFFER_SIZE (4 * 1024 * 1024)
+
+static const char *impl_names[CRC32_IMPL_COUNT] = {
+	"best", "bytewise", "slice8", "pclmul",
+};
+
+static const struct {
+	uint32_t size;
+	const char *name;
+} sizes[] = {
+	{ sizeof(GptHeader), "header" },
+	{ MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry), "entries" },
+	{ MAX_BUFFER_SIZE, "4M" },
+};
+
+struct crc_args {
+	const uint8_t *buffer;
+	uint32_t size;
+};
+
+/* CRC the buffer a few times; returns the number of Mbytes done. */
+static double crc_buffer(void *arg)
+{
+	struct crc_args *args = arg;
+	volatile uint32_t crc;
+	int j;
+
+	for (j = 0; j < 16; j++)
+		crc = Crc32(args->buffer, args->size);
+	(void)crc;
+	return j * (args->size / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t *buffer = malloc(MAX_BUFFER_SIZE);
+	struct crc_args args = { buffer };
+	char label[64];
+	uint32_t expect;
+	int i, impl;
+	int rv = 0;
+
+	if (!buffer)
+		return 1;
+	for (i = 0; i < MAX_BUFFER_SIZE; i++)
+		buffer[i] = (uint8_t)(i * 31 + (i >> 8));
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		Crc32SetImpl(CRC32_IMPL_BYTEWISE);
+		expect = Crc32(buffer, sizes[i].size);
+
+		for (impl = 0; impl < CRC32_IMPL_COUNT; impl++) {
+			if (Crc32SetImpl(impl)) {
+				fprintf(stderr, "# crc32_%s not supported\n",
+					impl_names[impl]);
+				continue;
+			}
+			snprintf(label, sizeof(label), "crc32_%s_%s",
+				 impl_names[impl], sizes[i].name);
+			if (Crc32(buffer, sizes[i].size) != expect) {
+				fprintf(stderr, "%s: wrong CRC\n", label);
+				rv = 1;
+				continue;
+			}
+			args.size = sizes[i].size;
+			benchmark_run(label, "mbytes", crc_buffer, &args);
+		}
+	}
+	Crc32SetImpl(CRC32_IMPL_BEST);
+
+	free(buffer);
+	return rv;
+}
@@ -46,3 +46,56 @@ int TestCrc32TestVectors() {
   }
   return TEST_OK;
 }
+
+int TestCrc32Implementations() {
+  uint8_t buf[1024 + 16];
+  uint32_t expect, len, offset;
+  int impl;
+  int i;
+
+  for (i = 0; i < sizeof(buf); ++i)
+    buf[i] = (i * 167 + 13) ^ (i >> 3);
+
+  /* Cover every tail length and alignment around the block sizes */
+  for (len = 0; len <= 1024; len += (len < 200 ? 1 : 61)) {
+    for (offset = 0; offset < 16; offset += 5) {
+      Crc32SetImpl(CRC32_IMPL_BYTEWISE);
+      expect = Crc32(buf + offset, len);
+      for (impl = 0; impl < CRC32_IMPL_COUNT; ++impl) {
+        if (Crc32SetImpl(impl))
+          continue;
+        EXPECT(Crc32(buf + offset, len) == expect);
+      }
+    }
+  }
+  Crc32SetImpl(CRC32_IMPL_BEST);
+  return TEST_OK;
+}
+
+int TestCrc32Update() {
+  uint8_t buf[16384];
+  uint8_t old[128];
+  uint32_t crc, len, offset;
+  int i, j;
+
+  for (i = 0; i < sizeof(buf); ++i)
+    buf[i] = (i * 167 + 13) ^ (i >> 3);
+  crc = Crc32(buf, sizeof(buf));
+
+  /* Change spans of each size at the start, middle and end */
+  for (len = 1; len <= sizeof(old); len = len * 2 + 1) {
+    for (j = 0; j < 3; ++j) {
+      offset = j * (sizeof(buf) - len) / 2;
+      memcpy(old, buf + offset, len);
+      for (i = 0; i < len; ++i)
+        buf[offset + i] ^= (uint8_t)(i * 29 + len);
+      crc = Crc32Update(crc, old, buf + offset, len,
+                        sizeof(buf) - offset - len);
+      EXPECT(crc == Crc32(buf, sizeof(buf)));
+    }
+  }
+
+  /* Changing nothing leaves the CRC alone */
+  EXPECT(Crc32Update(crc, buf, buf, 16, 100) == crc);
+  return TEST_OK;
+}
@@ -1,8 +1,51 @@
 #!/bin/bash
 
+if [ $# -eq 2 ] && [ "$1" = "--persistent" ]; then
+  # Sign requests until EOF.  Each request and reply is its size on a line,
+  # followed by that many bytes; a reply of size 0 means signing failed.
+  # Requests are signed in parallel, and each reply waits for the previous
+  # one to pass it a turn through a FIFO, so they're written in order.
+  #
+  # For testing, SIGNER_STOP_AFTER=N makes it stop reading after N requests,
+  # as if it had died, and only then reply to them.
+  tmp=$(mktemp -d)
+  trap 'rm -rf "$tmp"' EXIT
+  n=0
+  mkfifo "$tmp/turn.0"
+  if [ -z "${SIGNER_STOP_AFTER:-}" ]; then
+    echo > "$tmp/turn.0" &
+  fi
+  while [ "$n" != "${SIGNER_STOP_AFTER:-}" ] && read -r size; do
+    head -c "$size" > "$tmp/in.$n"
+    mkfifo "$tmp/turn.$((n + 1))"
+    (
+      openssl rsautl -sign -inkey "$2" -in "$tmp/in.$n" \
+        -out "$tmp/sig.$n" || rm -f "$tmp/sig.$n"
+      read -r _ < "$tmp/turn.$n"
+      if [ -f "$tmp/sig.$n" ]; then
+        stat -c %s "$tmp/sig.$n"
+        cat "$tmp/sig.$n"
+      else
+        echo 0
+      fi
+      echo > "$tmp/turn.$((n + 1))"
+    ) &
+    n=$((n + 1))
+  done
+  if [ -n "${SIGNER_STOP_AFTER:-}" ]; then
+    exec 0<&-
+    echo > "$tmp/turn.0" &
+  fi
+  # Take the turn after the last reply, so all of them are written
+  read -r _ < "$tmp/turn.$n"
+  wait
+  exit 0
+fi
+
 if [ $# -ne 1 ]; then
-  echo "Usage: $0 <private_key_pem_file>"
+  echo "Usage: $0 [--persistent] <private_key_pem_file>"
   echo "Reads data to sign from stdin, encrypted data is output to stdout"
+  echo "With --persistent, reads and writes many, each preceded by its size"
   exit 1
 fi
 
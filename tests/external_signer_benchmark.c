@@ -0,0 +1,140 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for signing with an external signer, started for each signature
+ * or kept running, using tests/external_rsa_signer.sh as the signer.
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "benchmark_common.h"
+#include "host_common.h"
+#include "host_signature.h"
+#include "timer_utils.h"
+#include "vb2_common.h"
+
+/* Signatures made by each method */
+#define NUM_SIGS 32
+
+#define DATA_SIZE 4096
+
+static uint8_t data[NUM_SIGS][DATA_SIZE];
+static const uint8_t *data_ptrs[NUM_SIGS];
+static uint32_t data_sizes[NUM_SIGS];
+
+/* Signatures from the one-shot signer, which the others must match */
+static struct vb2_signature *expect[NUM_SIGS];
+
+static char signer[PATH_MAX];
+static char key_file[PATH_MAX];
+
+enum method {
+	ONESHOT,	/* A signer started for each signature */
+	PERSISTENT,	/* One signer, waiting for each signature */
+	PIPELINED,	/* One signer, sent the requests together */
+};
+
+static const char *method_names[] = {
+	"oneshot", "persistent", "pipelined",
+};
+
+/* Sign all the data.  Returns signatures per second, or 0 if error. */
+static double benchmark(enum method method)
+{
+	const char *label = method_names[method];
+	struct vb2_signature *sigs[NUM_SIGS];
+	ClockTimerState ct;
+	int rv = 0;
+	int i;
+
+	StartTimer(&ct);
+	vb2_external_signer_persist(method != ONESHOT);
+	if (method == PIPELINED) {
+		rv = vb2_external_signatures(data_ptrs, data_sizes, NUM_SIGS,
+					     key_file, VB2_ALG_RSA2048_SHA256,
+					     signer, sigs);
+	} else {
+		for (i = 0; i < NUM_SIGS; i++) {
+			sigs[i] = vb2_external_signature(
+				data[i], DATA_SIZE, key_file,
+				VB2_ALG_RSA2048_SHA256, signer);
+			if (!sigs[i]) {
+				while (i--)
+					free(sigs[i]);
+				rv = 1;
+				break;
+			}
+		}
+	}
+	/* Include stopping the signer, as its user would have to */
+	vb2_external_signer_persist(0);
+	StopTimer(&ct);
+
+	if (rv) {
+		fprintf(stderr, "%s: signing failed\n", label);
+		return 0;
+	}
+
+	for (i = 0; i < NUM_SIGS; i++) {
+		if (method == ONESHOT) {
+			expect[i] = sigs[i];
+			continue;
+		}
+		if (memcmp(vb2_signature_data(sigs[i]),
+			   vb2_signature_data(expect[i]), sigs[i]->sig_size)) {
+			fprintf(stderr, "%s: signature %d doesn't match\n",
+				label, i);
+			rv = 1;
+		}
+		free(sigs[i]);
+	}
+	if (rv)
+		return 0;
+
+	return benchmark_report(label, "signatures", NUM_SIGS,
+				GetDurationMsecs(&ct));
+}
+
+int main(int argc, char *argv[])
+{
+	char *srcdir;
+	int i, j;
+	int rv = 0;
+
+	/* Where's the source directory? */
+	srcdir = getenv("SRCDIR");
+	if (argc > 1)
+		srcdir = argv[1];
+	if (!srcdir)
+		srcdir = ".";
+
+	snprintf(signer, sizeof(signer), "%s/tests/external_rsa_signer.sh",
+		 srcdir);
+	snprintf(key_file, sizeof(key_file),
+		 "%s/tests/testkeys/key_rsa2048.pem", srcdir);
+
+	for (i = 0; i < NUM_SIGS; i++) {
+		for (j = 0; j < DATA_SIZE; j++)
+			data[i][j] = i * 31 + j * 7;
+		data_ptrs[i] = data[i];
+		data_sizes[i] = DATA_SIZE;
+	}
+
+	/* The one-shot signatures are the ones the others must match */
+	if (!benchmark(ONESHOT))
+		return 1;
+	if (!benchmark(PERSISTENT) || !benchmark(PIPELINED))
+		rv = 1;
+
+	for (i = 0; i < NUM_SIGS; i++)
+		free(expect[i]);
+	return rv;
+}
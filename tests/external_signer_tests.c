@@ -0,0 +1,171 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for signing with an external signer, using
+ * tests/external_rsa_signer.sh as the signer.
+ */
+
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "host_common.h"
+#include "host_signature.h"
+#include "test_common.h"
+#include "vb2_common.h"
+
+/* More than the 32 requests a persistent signer is sent at once */
+#define NUM_SIGS 40
+
+#define DATA_SIZE 256
+
+static uint8_t data[NUM_SIGS][DATA_SIZE];
+static const uint8_t *data_ptrs[NUM_SIGS];
+static uint32_t data_sizes[NUM_SIGS];
+
+static char signer[PATH_MAX];
+static char key_file[PATH_MAX];
+
+/* Sign all the data.  Returns 0 if success. */
+static int sign_all(struct vb2_signature **sigs)
+{
+	return vb2_external_signatures(data_ptrs, data_sizes, NUM_SIGS,
+				       key_file, VB2_ALG_RSA2048_SHA256,
+				       signer, sigs);
+}
+
+static void free_all(struct vb2_signature **sigs)
+{
+	int i;
+
+	for (i = 0; i < NUM_SIGS; i++)
+		free(sigs[i]);
+}
+
+/* Check the signer dying partway through a batch fails it cleanly. */
+static void test_signer_dies(int stop_after, const char *desc)
+{
+	struct vb2_signature *sigs[NUM_SIGS];
+	char stop[16];
+	sigset_t pending;
+	int i;
+
+	snprintf(stop, sizeof(stop), "%d", stop_after);
+	setenv("SIGNER_STOP_AFTER", stop, 1);
+	vb2_external_signer_persist(1);
+	TEST_NEQ(sign_all(sigs), 0, desc);
+	unsetenv("SIGNER_STOP_AFTER");
+
+	for (i = 0; i < NUM_SIGS && !sigs[i]; i++)
+		;
+	TEST_EQ(i, NUM_SIGS, "  no signatures");
+	sigpending(&pending);
+	TEST_EQ(sigismember(&pending, SIGPIPE), 0, "  no SIGPIPE pending");
+
+	/* The dead signer is replaced for the next batch */
+	TEST_SUCC(sign_all(sigs), "  next batch signed");
+	free_all(sigs);
+	vb2_external_signer_persist(0);
+}
+
+/* Check a signer reaped by the caller's wait() is dropped. */
+static void test_signer_reaped(void)
+{
+	struct vb2_signature *sigs[NUM_SIGS];
+	struct vb2_signature *sig;
+	pid_t pid;
+
+	/* The signer exits once it has replied to one request */
+	setenv("SIGNER_STOP_AFTER", "1", 1);
+	vb2_external_signer_persist(1);
+	TEST_SUCC(vb2_external_signatures(data_ptrs, data_sizes, 1, key_file,
+					  VB2_ALG_RSA2048_SHA256, signer,
+					  &sig), "Signer exits after a reply");
+	unsetenv("SIGNER_STOP_AFTER");
+	free(sig);
+
+	pid = wait(NULL);
+	TEST_NEQ(pid, -1, "  signer reaped");
+	TEST_EQ(vb2_external_signer_reaped(pid), 1, "  reaped signer dropped");
+	TEST_EQ(vb2_external_signer_reaped(pid), 0, "  only once");
+	TEST_EQ(vb2_external_signer_reaped(getpid()), 0, "  not a signer");
+
+	/* A new signer replaces it, and stopping doesn't wait for the old */
+	TEST_SUCC(sign_all(sigs), "  next batch signed");
+	free_all(sigs);
+	vb2_external_signer_persist(0);
+}
+
+static void test_external_signer(void)
+{
+	struct vb2_signature *expect[NUM_SIGS];
+	struct vb2_signature *sigs[NUM_SIGS];
+	int i;
+
+	/* A SIGPIPE would kill the test, rather than go unnoticed */
+	signal(SIGPIPE, SIG_DFL);
+
+	vb2_external_signer_persist(0);
+	TEST_SUCC(sign_all(expect), "Sign with one-shot signers");
+
+	vb2_external_signer_persist(1);
+	TEST_SUCC(sign_all(sigs), "Sign with a persistent signer");
+	vb2_external_signer_persist(0);
+	for (i = 0; i < NUM_SIGS; i++) {
+		if (memcmp(vb2_signature_data(sigs[i]),
+			   vb2_signature_data(expect[i]), sigs[i]->sig_size))
+			break;
+	}
+	TEST_EQ(i, NUM_SIGS, "  signatures match one-shot");
+	free_all(sigs);
+	free_all(expect);
+
+	/*
+	 * Stopping after the first 32 requests, the signer has stopped
+	 * reading by the time the next are written, so writing them fails.
+	 * Stopping sooner, the replies run out instead.
+	 */
+	test_signer_dies(32, "Signer stops before a write");
+	test_signer_dies(5, "Signer stops before a reply");
+	test_signer_dies(0, "Signer reads nothing");
+	test_signer_reaped();
+}
+
+int main(int argc, char *argv[])
+{
+	char *srcdir;
+	int i, j;
+
+	/* Where's the source directory? */
+	srcdir = getenv("SRCDIR");
+	if (argc > 1)
+		srcdir = argv[1];
+	if (!srcdir)
+		srcdir = ".";
+
+	snprintf(signer, sizeof(signer), "%s/tests/external_rsa_signer.sh",
+		 srcdir);
+	snprintf(key_file, sizeof(key_file),
+		 "%s/tests/testkeys/key_rsa2048.pem", srcdir);
+
+	for (i = 0; i < NUM_SIGS; i++) {
+		for (j = 0; j < DATA_SIZE; j++)
+			data[i][j] = i * 31 + j * 7;
+		data_ptrs[i] = data[i];
+		data_sizes[i] = DATA_SIZE;
+	}
+
+	test_external_signer();
+
+	return gTestSuccess ? 0 : 255;
+}
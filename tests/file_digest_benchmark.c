@@ -0,0 +1,171 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for hashing files with DigestFd(), compared with the block-sized
+ * read() loop DigestFile() used to have.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2sha.h"
+#include "benchmark_common.h"
+#include "file_keys.h"
+#include "timer_utils.h"
+
+/* Size of the temporary file, if no file is given */
+#define TEST_FILE_SIZE (64 * 1024 * 1024)
+
+/* Report the best of this many runs of each method */
+#define TEST_RUNS 3
+
+static const char *mode_names[] = { "auto", "mmap", "read" };
+
+/* The original DigestFile() loop, one hash block per read() */
+static int digest_fd_legacy(int fd, enum vb2_hash_algorithm alg,
+			    uint8_t *digest, uint32_t digest_size)
+{
+	uint8_t data[VB2_SHA1_BLOCK_SIZE];
+	struct vb2_digest64_context ctx;
+	int len;
+	int rv;
+
+	rv = vb2_digest64_init(&ctx, alg);
+	if (rv)
+		return rv;
+	while ((len = read(fd, data, sizeof(data))) == sizeof(data))
+		vb2_digest64_extend(&ctx, data, len);
+	if (len != -1)
+		vb2_digest64_extend(&ctx, data, len);
+
+	return vb2_digest64_finalize(&ctx, digest, digest_size);
+}
+
+/*
+ * Hash the file with the given mode, or the legacy loop if mode < 0.  Returns
+ * Mbytes/sec, or 0 if error.
+ */
+static double benchmark(const char *filename, uint64_t size, int mode,
+			const uint8_t *expect, uint8_t *digest)
+{
+	const char *label = mode < 0 ? "legacy" : mode_names[mode];
+	ClockTimerState ct;
+	uint32_t msecs, best = 0;
+	int run, fd, rv;
+
+	for (run = 0; run < TEST_RUNS; run++) {
+		fd = open(filename, O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr, "Couldn't open %s\n", filename);
+			return 0;
+		}
+
+		StartTimer(&ct);
+		if (mode < 0)
+			rv = digest_fd_legacy(fd, VB2_HASH_SHA256, digest,
+					      VB2_SHA256_DIGEST_SIZE);
+		else
+			rv = DigestFd(fd, VB2_HASH_SHA256, mode, digest,
+				      VB2_SHA256_DIGEST_SIZE);
+		StopTimer(&ct);
+		close(fd);
+
+		if (rv) {
+			fprintf(stderr, "%s: digest failed (0x%x)\n",
+				label, rv);
+			return 0;
+		}
+		if (expect && memcmp(digest, expect, VB2_SHA256_DIGEST_SIZE)) {
+			fprintf(stderr, "%s: digest mismatch\n", label);
+			return 0;
+		}
+
+		msecs = GetDurationMsecs(&ct);
+		if (!run || msecs < best)
+			best = msecs;
+	}
+
+	return benchmark_report(label, "mbytes", size / 1048576.0, best);
+}
+
+/* Create a file of pseudo-random data; returns 0 if success. */
+static int create_test_file(char *filename)
+{
+	uint32_t buf[16384];
+	uint32_t seed = 0x12345678;
+	uint64_t written;
+	int fd, i;
+
+	fd = mkstemp(filename);
+	if (fd < 0)
+		return -1;
+
+	for (written = 0; written < TEST_FILE_SIZE; written += sizeof(buf)) {
+		for (i = 0; i < ARRAY_SIZE(buf); i++) {
+			seed = seed * 1103515245 + 12345;
+			buf[i] = seed;
+		}
+		if (write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+			close(fd);
+			unlink(filename);
+			return -1;
+		}
+	}
+
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t expect[VB2_SHA256_DIGEST_SIZE];
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	char temp_name[] = "/tmp/file_digest_benchmark.XXXXXX";
+	const char *filename;
+	struct stat sb;
+	int mode;
+	int rv = 0;
+
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [file]\n", argv[0]);
+		return 1;
+	}
+
+	if (argc == 2) {
+		filename = argv[1];
+	} else {
+		if (create_test_file(temp_name)) {
+			fprintf(stderr, "Couldn't create %s\n", temp_name);
+			return 1;
+		}
+		filename = temp_name;
+	}
+
+	if (stat(filename, &sb)) {
+		fprintf(stderr, "Couldn't stat %s\n", filename);
+		rv = 1;
+		goto out;
+	}
+
+	/* The legacy loop provides the digest the others must match */
+	if (!benchmark(filename, sb.st_size, -1, NULL, expect)) {
+		rv = 1;
+		goto out;
+	}
+	for (mode = DIGEST_FILE_AUTO; mode <= DIGEST_FILE_READ; mode++) {
+		if (!benchmark(filename, sb.st_size, mode, expect, digest))
+			rv = 1;
+	}
+
+out:
+	if (argc != 2)
+		unlink(temp_name);
+	return rv;
+}
@@ -0,0 +1,148 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for futil_file_type_buf() over the files in tests/futility/data,
+ * compared with trying every recognizer in turn, as it used to.
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchmark_common.h"
+#include "file_type.h"
+#include "futility.h"
+#include "host_misc.h"
+
+#define MAX_FILES 64
+
+typedef enum futil_file_type (*recognize_fn)(uint8_t *buf, uint32_t len);
+
+/* Recognizers in file_type.inc order, as the old loop tried them */
+static const recognize_fn recognizers[] = {
+#define R_(x) x
+#define NONE 0
+#define FILE_TYPE(A, B, C, D, E, F) D,
+#include "file_type.inc"
+#undef FILE_TYPE
+#undef NONE
+#undef R_
+};
+
+static struct {
+	char name[NAME_MAX + 1];
+	uint8_t *buf;
+	uint64_t len;
+	enum futil_file_type type;
+} files[MAX_FILES];
+static int num_files;
+
+/* The original futil_file_type_buf() loop */
+static enum futil_file_type file_type_buf_legacy(uint8_t *buf, uint32_t len)
+{
+	enum futil_file_type type;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(recognizers); i++) {
+		if (recognizers[i]) {
+			type = recognizers[i](buf, len);
+			if (type != FILE_TYPE_UNKNOWN)
+				return type;
+		}
+	}
+
+	return FILE_TYPE_UNKNOWN;
+}
+
+/* Read the regular files in dirname; returns 0 if success. */
+static int load_files(const char *dirname)
+{
+	char filename[PATH_MAX + NAME_MAX + 2];
+	struct dirent *ent;
+	DIR *dir;
+
+	dir = opendir(dirname);
+	if (!dir)
+		return 1;
+
+	while ((ent = readdir(dir)) && num_files < MAX_FILES) {
+		if (ent->d_name[0] == '.')
+			continue;
+		snprintf(filename, sizeof(filename), "%s/%s",
+			 dirname, ent->d_name);
+		files[num_files].buf = ReadFile(filename,
+						&files[num_files].len);
+		if (!files[num_files].buf)
+			continue;
+		strcpy(files[num_files].name, ent->d_name);
+		num_files++;
+	}
+
+	closedir(dir);
+	return num_files ? 0 : 1;
+}
+
+/*
+ * Identify every file once, with the legacy loop if *arg is set.  Returns the
+ * number of files, or 0 if a file's type doesn't match the legacy loop's.
+ */
+static double identify_files(void *arg)
+{
+	int legacy = *(int *)arg;
+	enum futil_file_type type;
+	int i;
+
+	for (i = 0; i < num_files; i++) {
+		if (legacy) {
+			files[i].type = file_type_buf_legacy(files[i].buf,
+							     files[i].len);
+			continue;
+		}
+		type = futil_file_type_buf(files[i].buf, files[i].len);
+		if (type != files[i].type) {
+			fprintf(stderr, "magic: %s is %s, not %s\n",
+				files[i].name, futil_file_type_name(type),
+				futil_file_type_name(files[i].type));
+			return 0;
+		}
+	}
+	return i;
+}
+
+int main(int argc, char *argv[])
+{
+	char dirname[PATH_MAX];
+	char *srcdir;
+	int legacy = 1, magic = 0;
+	int i;
+	int rv = 0;
+
+	/* Where's the source directory? */
+	srcdir = getenv("SRCDIR");
+	if (argc > 1)
+		srcdir = argv[1];
+	if (!srcdir)
+		srcdir = ".";
+
+	snprintf(dirname, sizeof(dirname), "%s/tests/futility/data", srcdir);
+	if (load_files(dirname)) {
+		fprintf(stderr, "Couldn't read files in %s\n", dirname);
+		return 1;
+	}
+
+	/* The legacy loop provides the types the other must match */
+	if (!benchmark_run("legacy", "files", identify_files, &legacy) ||
+	    !benchmark_run("magic", "files", identify_files, &magic))
+		rv = 1;
+
+	for (i = 0; i < num_files; i++) {
+		fprintf(stderr, "# %s: %s\n", files[i].name,
+			futil_file_type_name(files[i].type));
+		free(files[i].buf);
+	}
+	return rv;
+}
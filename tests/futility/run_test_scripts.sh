@@ -51,11 +51,14 @@ ${SCRIPTDIR}/test_show_contents.sh
 ${SCRIPTDIR}/test_show_kernel.sh
 ${SCRIPTDIR}/test_show_vs_verify.sh
 ${SCRIPTDIR}/test_show_usbpd1.sh
+${SCRIPTDIR}/test_sign_bios_slots.sh
 ${SCRIPTDIR}/test_sign_firmware.sh
 ${SCRIPTDIR}/test_sign_fw_main.sh
 ${SCRIPTDIR}/test_sign_kernel.sh
 ${SCRIPTDIR}/test_sign_keyblocks.sh
+${SCRIPTDIR}/test_sign_manifest.sh
 ${SCRIPTDIR}/test_sign_usbpd1.sh
+${SCRIPTDIR}/test_signd.sh
 ${SCRIPTDIR}/test_file_types.sh
 "
 
@@ -0,0 +1,88 @@
+#!/bin/bash -eux
+# Copyright 2017 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+DEVKEYS=${SRCDIR}/tests/devkeys
+
+# The A slot's keys when A & B differ.  Any key will do.
+DEV_KEY=${DEVKEYS}/recovery_kernel_data_key.vbprivk
+DEV_KEYBLOCK=${DEVKEYS}/recovery_kernel.keyblock
+
+FW_SIZE=$((0x40000))
+
+# Little-endian integers, and a name padded to 32 bytes
+le16() { printf "$(printf '\\x%02x\\x%02x' $(($1 & 0xff)) $(($1 >> 8)))"; }
+le32() { le16 $(($1 & 0xffff)); le16 $(($1 >> 16 & 0xffff)); }
+name32() { printf "%s" "$1"; head -c $((32 - ${#1})) /dev/zero; }
+area() { le32 $1; le32 $2; name32 $3; le16 0; }
+
+# Make an image with an FMAP and empty VBLOCKs, from FW A and B files.
+make_image() {
+  local image=$1 fw_a=$2 fw_b=$3
+  {
+    printf "__FMAP__\\x01\\x01"
+    le32 0; le32 0
+    le32 $((0xa2000))
+    name32 "FMAP"
+    le16 5
+    area $((0x1000)) $((0x1000)) GBB
+    area $((0x2000)) $((0x10000)) VBLOCK_A
+    area $((0x12000)) $((0x10000)) VBLOCK_B
+    area $((0x22000)) ${FW_SIZE} FW_MAIN_A
+    area $((0x62000)) ${FW_SIZE} FW_MAIN_B
+  } > "${image}"
+  head -c $((0x22000 - $(stat -c %s "${image}"))) /dev/zero >> "${image}"
+  cat "${fw_a}" "${fw_b}" >> "${image}"
+}
+
+# Sign the image, and check each VBLOCK against one made for its slot alone.
+check_slots() {
+  local name=$1 fw_a=$2 fw_b=$3 key_a=$4 keyblock_a=$5
+  local image=${TMP}.${name}.bin
+
+  make_image "${image}" "${fw_a}" "${fw_b}"
+  ${FUTILITY} sign \
+    -s ${DEVKEYS}/firmware_data_key.vbprivk \
+    -b ${DEVKEYS}/firmware.keyblock \
+    -k ${DEVKEYS}/kernel_subkey.vbpubk \
+    -S ${DEV_KEY} -B ${DEV_KEYBLOCK} \
+    "${image}" "${image}.signed"
+  ${FUTILITY} dump_fmap -x "${image}.signed" VBLOCK_A VBLOCK_B
+
+  ${FUTILITY} vbutil_firmware --vblock ${TMP}.${name}.ref_a \
+    --keyblock "${keyblock_a}" --signprivate "${key_a}" \
+    --version 1 --fv "${fw_a}" --flags 0 \
+    --kernelkey ${DEVKEYS}/kernel_subkey.vbpubk
+  ${FUTILITY} vbutil_firmware --vblock ${TMP}.${name}.ref_b \
+    --keyblock ${DEVKEYS}/firmware.keyblock \
+    --signprivate ${DEVKEYS}/firmware_data_key.vbprivk \
+    --version 1 --fv "${fw_b}" --flags 0 \
+    --kernelkey ${DEVKEYS}/kernel_subkey.vbpubk
+
+  cmp -n $(stat -c %s ${TMP}.${name}.ref_a) ${TMP}.${name}.ref_a VBLOCK_A
+  cmp -n $(stat -c %s ${TMP}.${name}.ref_b) ${TMP}.${name}.ref_b VBLOCK_B
+  rm -f VBLOCK_A VBLOCK_B
+}
+
+# Firmware bodies: two the same, one differing from the start, and one
+# differing only in its last byte, after A's first chunk has been hashed.
+head -c ${FW_SIZE} /dev/urandom > ${TMP}.fw
+head -c ${FW_SIZE} /dev/urandom > ${TMP}.fw_other
+{ head -c $((FW_SIZE - 1)) ${TMP}.fw; printf "\\x5a"; } > ${TMP}.fw_last
+cmp -s ${TMP}.fw ${TMP}.fw_last && exit 1
+
+check_slots same ${TMP}.fw ${TMP}.fw \
+  ${DEVKEYS}/firmware_data_key.vbprivk ${DEVKEYS}/firmware.keyblock
+check_slots differ ${TMP}.fw ${TMP}.fw_other ${DEV_KEY} ${DEV_KEYBLOCK}
+check_slots differ_last ${TMP}.fw ${TMP}.fw_last ${DEV_KEY} ${DEV_KEYBLOCK}
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
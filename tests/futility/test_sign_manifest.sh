@@ -0,0 +1,121 @@
+#!/bin/bash -eux
+# Copyright 2017 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+KEYDIR=${SRCDIR}/tests/devkeys
+
+# create some firmware blobs
+for i in 1 2 3 4 5; do
+  dd bs=1024 count=16 if=/dev/urandom of=${TMP}.fw_main.$i
+done
+
+# sign them one at a time
+for i in 1 2 3 4 5; do
+  ${FUTILITY} sign \
+    --signprivate ${KEYDIR}/firmware_data_key.vbprivk \
+    --keyblock ${KEYDIR}/firmware.keyblock \
+    --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+    --version $i \
+    --fv ${TMP}.fw_main.$i \
+    ${TMP}.vblock.$i.old
+done
+${FUTILITY} sign \
+  --signprivate ${KEYDIR}/root_key.vbprivk \
+  ${KEYDIR}/firmware_data_key.vbpubk \
+  ${TMP}.keyblock.old
+
+# and all at once
+PUBKEY=${KEYDIR}/firmware_data_key.vbpubk
+cat > ${TMP}.manifest <<EOF2
+# firmware
+--version 1 --fv ${TMP}.fw_main.1 ${TMP}.vblock.1.new
+--version 2 --fv ${TMP}.fw_main.2 ${TMP}.vblock.2.new
+
+--version 3 --fv "${TMP}.fw_main.3" '${TMP}.vblock.3.new'
+--version 4 --fv ${TMP}.fw_main.4 ${TMP}.vblock.4.new
+--version 5 --fv ${TMP}.fw_main.5 ${TMP}.vblock.5.new
+# keyblock
+--signprivate ${KEYDIR}/root_key.vbprivk ${PUBKEY} ${TMP}.keyblock.new
+EOF2
+
+${FUTILITY} sign \
+  --signprivate ${KEYDIR}/firmware_data_key.vbprivk \
+  --keyblock ${KEYDIR}/firmware.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --manifest ${TMP}.manifest --jobs 2 --report ${TMP}.report
+
+# They should match
+for i in 1 2 3 4 5; do
+  cmp ${TMP}.vblock.$i.old ${TMP}.vblock.$i.new
+done
+cmp ${TMP}.keyblock.old ${TMP}.keyblock.new
+
+# Every job is reported as ok
+[ "$(grep -c '	ok	' ${TMP}.report)" = "6" ]
+grep -q "^9	ok	${PUBKEY}	${TMP}.keyblock.new$" ${TMP}.report
+
+# Bad jobs are reported, and don't stop the others
+cat > ${TMP}.manifest <<EOF2
+--version 1 --fv ${TMP}.fw_main.1 ${TMP}.vblock.1.bad
+--bogus --fv ${TMP}.fw_main.2 ${TMP}.vblock.2.bad
+--version 3 --fv ${TMP}.nothing ${TMP}.vblock.3.bad
+--version 4 --fv ${TMP}.fw_main.4 ${TMP}.vblock.4.bad
+EOF2
+if ${FUTILITY} sign \
+  --signprivate ${KEYDIR}/firmware_data_key.vbprivk \
+  --keyblock ${KEYDIR}/firmware.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --manifest ${TMP}.manifest > ${TMP}.report; then false; fi
+grep -q "^1	ok	" ${TMP}.report
+grep -q "^2	invalid	" ${TMP}.report
+grep -q "^3	failed	" ${TMP}.report
+grep -q "^4	ok	" ${TMP}.report
+cmp ${TMP}.vblock.1.old ${TMP}.vblock.1.bad
+cmp ${TMP}.vblock.4.old ${TMP}.vblock.4.bad
+
+# Keyblocks from an external signer, started once for the whole manifest.
+# The wrapper logs how it's started.
+TESTKEYS=${SRCDIR}/tests/testkeys
+cat > ${TMP}.signer <<EOF2
+#!/bin/bash
+echo "\$@" >> ${PWD}/${TMP}.signer.log
+exec ${SRCDIR}/tests/external_rsa_signer.sh "\$@"
+EOF2
+chmod +x ${TMP}.signer
+for i in 1 2 3 4; do
+  ${FUTILITY} sign \
+    --pem_signpriv ${TESTKEYS}/key_rsa4096.pem --pem_algo 8 \
+    --pem_external ${SRCDIR}/tests/external_rsa_signer.sh \
+    --flags $i ${PUBKEY} ${TMP}.ext_keyblock.$i.old
+done
+EXT="--pem_signpriv ${TESTKEYS}/key_rsa4096.pem --pem_algo 8"
+EXT="${EXT} --pem_external ${PWD}/${TMP}.signer"
+cat > ${TMP}.manifest <<EOF2
+${EXT} --flags 1 ${PUBKEY} ${TMP}.ext_keyblock.1.new
+--signprivate ${KEYDIR}/firmware_data_key.vbprivk --version 1 \
+  --keyblock ${KEYDIR}/firmware.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --fv ${TMP}.fw_main.1 ${TMP}.vblock.1.ext
+${EXT} --flags 2 ${PUBKEY} ${TMP}.ext_keyblock.2.new
+${EXT} --flags 3 ${PUBKEY} ${TMP}.ext_keyblock.3.new
+${EXT} --flags 4 ${PUBKEY} ${TMP}.ext_keyblock.4.new
+EOF2
+${FUTILITY} sign --pem_persistent \
+  --manifest ${TMP}.manifest --report ${TMP}.report
+for i in 1 2 3 4; do
+  cmp ${TMP}.ext_keyblock.$i.old ${TMP}.ext_keyblock.$i.new
+done
+cmp ${TMP}.vblock.1.old ${TMP}.vblock.1.ext
+[ "$(grep -c '	ok	' ${TMP}.report)" = "5" ]
+[ "$(cat ${TMP}.signer.log)" = "--persistent ${TESTKEYS}/key_rsa4096.pem" ]
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
@@ -0,0 +1,110 @@
+#!/bin/bash -eux
+# Copyright 2017 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+KEYDIR=${SRCDIR}/tests/devkeys
+SOCKET=${OUTDIR}/${TMP}.socket
+
+# a vb21 key, which signs with its ID and description
+${FUTILITY} create --desc "Test key" --hash_alg SHA256 \
+  ${SRCDIR}/tests/testkeys/key_rsa2048.pem ${TMP}.key21
+
+# start the daemon, and wait until it answers
+${FUTILITY} signd --socket ${SOCKET} \
+  fw=${KEYDIR}/firmware_data_key.vbprivk \
+  ${KEYDIR}/root_key.vbprivk \
+  rw=${TMP}.key21.vbprik2 &
+DAEMON=$!
+trap "kill ${DAEMON}" EXIT
+for i in $(seq 50); do
+  ${FUTILITY} signd --socket ${SOCKET} --stats && break
+  sleep 0.1
+done
+
+# a second one can't take over the socket
+if ${FUTILITY} signd --socket ${SOCKET} ${KEYDIR}/root_key.vbprivk; then
+  false
+fi
+
+# create a firmware blob
+dd bs=1024 count=16 if=/dev/urandom of=${TMP}.fw_main
+
+# sign it here and through the daemon
+${FUTILITY} sign \
+  --signprivate ${KEYDIR}/firmware_data_key.vbprivk \
+  --keyblock ${KEYDIR}/firmware.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --version 12 \
+  --fv ${TMP}.fw_main \
+  ${TMP}.vblock.local
+${FUTILITY} sign \
+  --signer-socket ${SOCKET} \
+  --signprivate fw \
+  --keyblock ${KEYDIR}/firmware.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --version 12 \
+  --fv ${TMP}.fw_main \
+  ${TMP}.vblock.signd
+
+# They should match
+cmp ${TMP}.vblock.local ${TMP}.vblock.signd
+
+# same for a keyblock, with a key named by its file
+${FUTILITY} sign \
+  --signprivate ${KEYDIR}/root_key.vbprivk \
+  ${KEYDIR}/firmware_data_key.vbpubk \
+  ${TMP}.keyblock.local
+${FUTILITY} sign \
+  --signer-socket ${SOCKET} \
+  --signprivate ${KEYDIR}/root_key.vbprivk \
+  ${KEYDIR}/firmware_data_key.vbpubk \
+  ${TMP}.keyblock.signd
+cmp ${TMP}.keyblock.local ${TMP}.keyblock.signd
+
+# same for an EC RW signature made with the vb21 key
+${FUTILITY} sign --type rwsig --prikey ${TMP}.key21.vbprik2 \
+  --version 2 ${SCRIPTDIR}/data/EC_RW.bin ${TMP}.rwsig.local
+${FUTILITY} sign --type rwsig --signer-socket ${SOCKET} --prikey rw \
+  --version 2 ${SCRIPTDIR}/data/EC_RW.bin ${TMP}.rwsig.signd
+cmp ${TMP}.rwsig.local ${TMP}.rwsig.signd
+
+# which only verifies if it has the key's ID; put it at the end of the RW
+# image, padded to the signature area's size
+size=$(stat -c %s ${TMP}.rwsig.signd)
+( cat ${SCRIPTDIR}/data/EC_RW.bin ${TMP}.rwsig.signd
+  head -c $((1024 - size)) /dev/zero | tr '\0' '\377' ) > ${TMP}.ec_rw
+${FUTILITY} show --type rwsig --pubkey ${TMP}.key21.vbpubk2 ${TMP}.ec_rw
+
+# a key held by the daemon can't replace the public key in a full image
+cp ${SCRIPTDIR}/data/hammer_dev.bin ${TMP}.ec
+if ${FUTILITY} sign --type rwsig --signer-socket ${SOCKET} --prikey rw \
+  --version 2 ${TMP}.ec; then false; fi
+
+# unknown keys aren't used
+if ${FUTILITY} sign \
+  --signer-socket ${SOCKET} \
+  --signprivate nothing \
+  ${KEYDIR}/firmware_data_key.vbpubk \
+  ${TMP}.keyblock.bad; then false; fi
+
+# each key counts its signatures: the body and preamble, and the keyblock
+${FUTILITY} signd --socket ${SOCKET} --stats > ${TMP}.stats
+grep -q "^fw 2 " ${TMP}.stats
+grep -q "^${KEYDIR}/root_key.vbprivk 1 " ${TMP}.stats
+
+# stopping the daemon removes the socket
+kill ${DAEMON}
+trap - EXIT
+wait ${DAEMON} || true
+[ ! -e ${SOCKET} ]
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
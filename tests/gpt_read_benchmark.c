@@ -0,0 +1,216 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Counts the disk accesses AllocAndReadGptData() and WriteAndFreeGptData()
+ * make while picking a kernel, with and without GPT_FLAG_LAZY_SECONDARY.  The
+ * disk is a stub which only stores the GPT at each end of a 32 GB drive, and
+ * counts reads, sectors and seeks (accesses which don't start where the last
+ * one ended).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "gpt.h"
+#include "vboot_api.h"
+
+#define SECTOR_SIZE 512
+#define DISK_SECTORS (32ULL * 1024 * 1024 * 1024 / SECTOR_SIZE)
+
+/* Protective MBR, primary header and entries */
+#define HEAD_SECTORS (GPT_PMBR_SECTORS + GPT_HEADER_SECTORS + 32)
+/* Secondary entries and header */
+#define TAIL_SECTORS (32 + GPT_HEADER_SECTORS)
+#define TAIL_START (DISK_SECTORS - TAIL_SECTORS)
+
+static uint8_t head[HEAD_SECTORS * SECTOR_SIZE];
+static uint8_t tail[TAIL_SECTORS * SECTOR_SIZE];
+
+static struct {
+	uint32_t reads, sectors_read, writes, sectors_written, seeks;
+	uint64_t next_lba;
+} stats;
+
+static const Guid guid_kernel = GPT_ENT_TYPE_CHROMEOS_KERNEL;
+
+/* Return the stub storage for a sector, or NULL if it isn't stored. */
+static uint8_t *stub_sector(uint64_t lba)
+{
+	if (lba < HEAD_SECTORS)
+		return head + lba * SECTOR_SIZE;
+	if (lba >= TAIL_START && lba < DISK_SECTORS)
+		return tail + (lba - TAIL_START) * SECTOR_SIZE;
+	return NULL;
+}
+
+static void count_access(uint64_t lba_start, uint64_t lba_count)
+{
+	if (lba_start != stats.next_lba)
+		stats.seeks++;
+	stats.next_lba = lba_start + lba_count;
+}
+
+VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
+		       uint64_t lba_count, void *buffer)
+{
+	uint8_t *buf = buffer;
+	uint8_t *s;
+	uint64_t i;
+
+	count_access(lba_start, lba_count);
+	stats.reads++;
+	stats.sectors_read += lba_count;
+
+	for (i = 0; i < lba_count; i++, buf += SECTOR_SIZE) {
+		s = stub_sector(lba_start + i);
+		if (s)
+			memcpy(buf, s, SECTOR_SIZE);
+		else
+			memset(buf, 0, SECTOR_SIZE);
+	}
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
+			uint64_t lba_count, const void *buffer)
+{
+	const uint8_t *buf = buffer;
+	uint8_t *s;
+	uint64_t i;
+
+	count_access(lba_start, lba_count);
+	stats.writes++;
+	stats.sectors_written += lba_count;
+
+	for (i = 0; i < lba_count; i++, buf += SECTOR_SIZE) {
+		s = stub_sector(lba_start + i);
+		if (s)
+			memcpy(s, buf, SECTOR_SIZE);
+	}
+	return VBERROR_SUCCESS;
+}
+
+static void setup_header(GptHeader *h, int is_secondary, uint32_t crc)
+{
+	memset(h, 0, SECTOR_SIZE);
+	memcpy(h->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
+	h->revision = GPT_HEADER_REVISION;
+	h->size = MIN_SIZE_OF_HEADER;
+	h->size_of_entry = sizeof(GptEntry);
+	h->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+	if (is_secondary) {
+		h->my_lba = DISK_SECTORS - GPT_HEADER_SECTORS;
+		h->alternate_lba = GPT_PMBR_SECTORS;
+		h->entries_lba = TAIL_START;
+	} else {
+		h->my_lba = GPT_PMBR_SECTORS;
+		h->alternate_lba = DISK_SECTORS - GPT_HEADER_SECTORS;
+		h->entries_lba = h->my_lba + 1;
+	}
+	h->first_usable_lba = HEAD_SECTORS;
+	h->last_usable_lba = TAIL_START - 1;
+	h->entries_crc32 = crc;
+	h->header_crc32 = HeaderCrc(h);
+}
+
+/*
+ * Build the GPT, with kernel A already booted successfully and kernel B being
+ * tried if try_b is non-zero.
+ */
+static void setup_disk(int try_b)
+{
+	GptEntry *entries = (GptEntry *)(head + 2 * SECTOR_SIZE);
+	uint32_t entries_bytes = MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry);
+	uint32_t crc;
+	int i;
+
+	memset(head, 0, sizeof(head));
+	memset(tail, 0, sizeof(tail));
+
+	for (i = 0; i < 2; i++) {
+		memcpy(&entries[i].type, &guid_kernel, sizeof(Guid));
+		entries[i].unique.u.raw[0] = i + 1;
+		entries[i].starting_lba = HEAD_SECTORS + i * 32768;
+		entries[i].ending_lba = entries[i].starting_lba + 32767;
+	}
+	SetEntryPriority(entries + 0, 1);
+	SetEntrySuccessful(entries + 0, 1);
+	if (try_b) {
+		SetEntryPriority(entries + 1, 2);
+		SetEntryTries(entries + 1, 6);
+	}
+
+	crc = Crc32((const uint8_t *)entries, entries_bytes);
+	setup_header((GptHeader *)(head + SECTOR_SIZE), 0, crc);
+	memcpy(tail, entries, entries_bytes);
+	setup_header((GptHeader *)(tail + 32 * SECTOR_SIZE), 1, crc);
+}
+
+/*
+ * Pick a kernel the way LoadKernel() does, then report the disk accesses.
+ * Returns 0 if success.
+ */
+static int run(const char *scenario, int try_b, int bad_primary, int lazy)
+{
+	const char *mode = lazy ? "lazy" : "eager";
+	uint64_t start, size;
+	GptData gpt;
+
+	setup_disk(try_b);
+	if (bad_primary)
+		memset(head + SECTOR_SIZE, 0, SECTOR_SIZE);
+
+	memset(&stats, 0, sizeof(stats));
+	memset(&gpt, 0, sizeof(gpt));
+	gpt.sector_bytes = SECTOR_SIZE;
+	gpt.streaming_drive_sectors = gpt.gpt_drive_sectors = DISK_SECTORS;
+	gpt.flags = lazy ? GPT_FLAG_LAZY_SECONDARY : 0;
+
+	if (AllocAndReadGptData(NULL, &gpt) || GptInit(&gpt) ||
+	    GptNextKernelEntry(&gpt, &start, &size)) {
+		fprintf(stderr, "%s_%s: no kernel found\n", scenario, mode);
+		return 1;
+	}
+	if (try_b)
+		GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_TRY);
+	if (WriteAndFreeGptData(NULL, &gpt)) {
+		fprintf(stderr, "%s_%s: write failed\n", scenario, mode);
+		return 1;
+	}
+
+	fprintf(stderr, "# %s %s: %u reads (%u sectors), %u writes "
+		"(%u sectors), %u seeks\n", scenario, mode, stats.reads,
+		stats.sectors_read, stats.writes, stats.sectors_written,
+		stats.seeks);
+	fprintf(stdout, "reads_%s_%s:%u\n", scenario, mode, stats.reads);
+	fprintf(stdout, "sectors_read_%s_%s:%u\n", scenario, mode,
+		stats.sectors_read);
+	fprintf(stdout, "writes_%s_%s:%u\n", scenario, mode, stats.writes);
+	fprintf(stdout, "seeks_%s_%s:%u\n", scenario, mode, stats.seeks);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int lazy;
+	int rv = 0;
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		/* Booting a kernel which needs no GPT update */
+		rv |= run("boot", 0, 0, lazy);
+		/* Trying a new kernel, which updates its tries count */
+		rv |= run("try", 1, 0, lazy);
+		/* Booting from a drive whose primary GPT is bad */
+		rv |= run("bad_primary", 0, 1, lazy);
+	}
+
+	return rv;
+}
@@ -89,10 +89,62 @@ static void test_hmac(void)
 	}
 }
 
+static void test_hmac_stream(void)
+{
+	uint8_t mac[VB2_MAX_DIGEST_SIZE];
+	uint8_t md[VB2_MAX_DIGEST_SIZE];
+	uint32_t msg_size = strlen(message);
+	struct vb2_hmac_key hk;
+	struct vb2_hmac_context hc;
+	char test_name[256];
+	int alg, i;
+
+	for (alg = 1; alg < VB2_HASH_ALG_COUNT; alg++) {
+		sprintf(test_name, "%s: HMAC-%s",
+			__func__, vb2_get_hash_algorithm_name(alg));
+		TEST_SUCC(hmac_key_init(&hk, alg, long_key, strlen(long_key)),
+			  test_name);
+
+		/* Same key state used for several MACs */
+		for (i = 0; i <= msg_size; i += 7) {
+			hmac(alg, long_key, strlen(long_key),
+			     message, msg_size - i, md, sizeof(md));
+			hmac_init(&hc, &hk);
+			hmac_update(&hc, message, msg_size - i);
+			hmac_final(&hc, mac, sizeof(mac));
+			TEST_SUCC(memcmp(mac, md, vb2_digest_size(alg)),
+				  "  reused key");
+		}
+
+		/* Message split into chunks */
+		hmac(alg, long_key, strlen(long_key),
+		     message, msg_size, md, sizeof(md));
+		hmac_init(&hc, &hk);
+		for (i = 0; i < msg_size; i += 5)
+			hmac_update(&hc, message + i,
+				    msg_size - i < 5 ? msg_size - i : 5);
+		hmac_final(&hc, mac, sizeof(mac));
+		TEST_SUCC(memcmp(mac, md, vb2_digest_size(alg)),
+			  "  chunked message");
+	}
+
+	hmac_key_init(&hk, VB2_HASH_SHA256, short_key, strlen(short_key));
+	TEST_TRUE(hmac_key_init(&hk, VB2_HASH_SHA256, NULL, 0), "key = NULL");
+	TEST_TRUE(hmac_key_init(&hk, -1, short_key, strlen(short_key)),
+		  "Invalid algorithm");
+	TEST_TRUE(hmac_init(&hc, NULL), "key state = NULL");
+	hmac_init(&hc, &hk);
+	TEST_TRUE(hmac_update(&hc, NULL, 0), "msg = NULL");
+	TEST_TRUE(hmac_final(&hc, NULL, 0), "mac = NULL");
+	TEST_TRUE(hmac_final(&hc, mac, VB2_SHA256_DIGEST_SIZE - 1),
+		  "Buffer too small");
+}
+
 int main(void)
 {
 	test_hmac();
 	test_hmac_error();
+	test_hmac_stream();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -0,0 +1,135 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for RSA signature verification, using the keys in tests/testkeys
+ * and the signatures in tests/testcases.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "benchmark_common.h"
+#include "file_keys.h"
+#include "host_common.h"
+#include "host_key.h"
+#include "host_misc.h"
+#include "vb2_common.h"
+
+/* Key sizes, in the same order as the vb2_crypto_algorithm values */
+static const char *key_names[] = {
+	"1024", "2048", "4096", "8192", "2048_exp3", "3072_exp3",
+};
+
+static const char *sqr_impl_names[VB2_RSA_SQR_COUNT] = {
+	"fixed", "generic", "mul",
+};
+
+struct verify_args {
+	const struct vb2_public_key *key;
+	const uint8_t *sig;
+	uint32_t sig_size;
+	const uint8_t *digest;
+	const char *label;
+};
+
+/*
+ * Verify the signature a few times; returns the number of verifications, or 0
+ * if error.
+ */
+static double verify_sig(void *arg)
+{
+	struct verify_args *args = arg;
+	uint8_t workbuf[VB2_VERIFY_RSA_DIGEST_WORKBUF_BYTES]
+		__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	uint8_t sig_copy[1024];
+	struct vb2_workbuf wb;
+	int j;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+
+	for (j = 0; j < 16; j++) {
+		memcpy(sig_copy, args->sig, args->sig_size);
+		if (vb2_rsa_verify_digest(args->key, sig_copy, args->digest,
+					  &wb)) {
+			fprintf(stderr, "%s: verification failed\n",
+				args->label);
+			return 0;
+		}
+	}
+	return j;
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	struct vb2_packed_key *pk;
+	struct vb2_public_key key;
+	char filename[1024];
+	char label[64];
+	uint8_t *sig;
+	uint32_t sig_size;
+	struct verify_args args = { &key, NULL, 0, digest, label };
+	int i, impl;
+	int rv = 0;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <testkeys dir> <testcases dir>\n",
+			argv[0]);
+		return 1;
+	}
+
+	snprintf(filename, sizeof(filename), "%s/test_file", argv[2]);
+	if (DigestFile(filename, VB2_HASH_SHA256, digest, sizeof(digest))) {
+		fprintf(stderr, "Couldn't hash %s\n", filename);
+		return 1;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(key_names); i++) {
+		/* The SHA-256 variant of each key size */
+		int alg = 3 * i + 1;
+
+		snprintf(filename, sizeof(filename), "%s/key_rsa%s.keyb",
+			 argv[1], key_names[i]);
+		pk = vb2_read_packed_keyb(filename, alg, 0);
+		if (!pk || vb2_unpack_key(&key, pk)) {
+			fprintf(stderr, "Couldn't read key %s\n", filename);
+			free(pk);
+			rv = 1;
+			continue;
+		}
+
+		snprintf(filename, sizeof(filename),
+			 "%s/test_file.rsa%s_sha256.sig", argv[2],
+			 key_names[i]);
+		if (vb2_read_file(filename, &sig, &sig_size) ||
+		    sig_size != vb2_rsa_sig_size(key.sig_alg)) {
+			fprintf(stderr, "Couldn't read sig %s\n", filename);
+			free(pk);
+			rv = 1;
+			continue;
+		}
+
+		args.sig = sig;
+		args.sig_size = sig_size;
+		for (impl = 0; impl < VB2_RSA_SQR_COUNT; impl++) {
+			vb2_rsa_set_sqr_impl(impl);
+			snprintf(label, sizeof(label), "RSA%s_%s",
+				 key_names[i], sqr_impl_names[impl]);
+			if (!benchmark_run(label, "verifies", verify_sig,
+					   &args))
+				rv = 1;
+		}
+		vb2_rsa_set_sqr_impl(VB2_RSA_SQR_FIXED);
+
+		free(sig);
+		free(pk);
+	}
+
+	return rv;
+}
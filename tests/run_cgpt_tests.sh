@@ -275,6 +275,39 @@ run_prioritize_tests() {
 }
 run_prioritize_tests
 
+echo "Test the cgpt batch command..."
+$CGPT create $MTD ${DEV}
+cat >batch.txt <<EOF
+# comments and blank lines are skipped
+
+create
+add -b ${DATA_START} -s ${DATA_SIZE} -t data -l "${DATA_LABEL}"
+add -b ${KERN_START} -s ${KERN_SIZE} -t kernel -l '${KERN_LABEL}'
+add -b ${ROOTFS_START} -s ${ROOTFS_SIZE} -t rootfs -l "${ROOTFS_LABEL}"
+add -i ${KERN_NUM} -P 5 -T 3
+boot -p -i ${KERN_NUM}
+EOF
+$CGPT batch $MTD -f batch.txt ${DEV} >/dev/null
+X=$($CGPT show $MTD -b -i $KERN_NUM ${DEV})
+Y=$($CGPT show $MTD -l -i $KERN_NUM ${DEV})
+Z=$($CGPT show $MTD -P -i $KERN_NUM ${DEV})
+[ "$X $Y $Z" = "$KERN_START $KERN_LABEL 5" ] || error
+X=$($CGPT boot $MTD ${DEV})
+Y=$($CGPT show $MTD -u -i $KERN_NUM ${DEV})
+[ "$X" = "$Y" ] || error
+# Commands can also come from stdin
+echo "prioritize -i ${KERN_NUM} -P 2" | $CGPT batch $MTD ${DEV}
+[ "$($CGPT show $MTD -P -i $KERN_NUM ${DEV})" = "2" ] || error
+# Nothing is written if any command fails
+cp ${DEV} batch_orig.bin
+printf 'add -i 1 -l changed\nadd -i 2 -b 9999999 -s 1\n' >batch_bad.txt
+assert_fail $CGPT batch $MTD -f batch_bad.txt ${DEV}
+cmp -s ${DEV} batch_orig.bin || error
+# Or if the GPT isn't valid at the end
+echo "create -z" >batch_bad.txt
+assert_fail $CGPT batch $MTD -f batch_bad.txt ${DEV}
+cmp -s ${DEV} batch_orig.bin || error
+
 echo "Test cgpt repair command"
 $CGPT repair $MTD ${DEV}
 ($CGPT show $MTD ${DEV} | grep -q INVALID) && error
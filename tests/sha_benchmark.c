@@ -10,36 +10,106 @@
 #include "2sysincludes.h"
 #include "2common.h"
 #include "2sha.h"
+#include "benchmark_common.h"
 #include "host_common.h"
 #include "timer_utils.h"
 
 #define TEST_BUFFER_SIZE 4000000
+#define TEST_ITERATIONS 10
 
-int main(int argc, char *argv[]) {
-	int i;
-	double speed;
-	uint32_t msecs;
-	uint8_t *buffer = malloc(TEST_BUFFER_SIZE);
+/* Hash the buffer and report throughput; returns speed in Mbytes/sec. */
+static double benchmark(const uint8_t *buffer, enum vb2_hash_algorithm alg,
+			const char *label)
+{
 	uint8_t digest[VB2_MAX_DIGEST_SIZE];
 	ClockTimerState ct;
+	int j;
+
+	StartTimer(&ct);
+	for (j = 0; j < TEST_ITERATIONS; j++)
+		vb2_digest_buffer(buffer, TEST_BUFFER_SIZE, alg,
+				  digest, sizeof(digest));
+	StopTimer(&ct);
+
+	return benchmark_report(label, "mbytes",
+				TEST_ITERATIONS * (TEST_BUFFER_SIZE / 1e6),
+				GetDurationMsecs(&ct));
+}
+
+/*
+ * Hash TEST_BUFFER_SIZE bytes as many objects of obj_size bytes with
+ * vb2_digest_buffers() and report throughput.
+ */
+static void benchmark_multi(const uint8_t *buffer, uint32_t obj_size,
+			    const char *label)
+{
+	uint32_t count = TEST_BUFFER_SIZE / obj_size;
+	const uint8_t **bufs = malloc(count * sizeof(*bufs));
+	uint32_t *sizes = malloc(count * sizeof(*sizes));
+	uint8_t *digests = malloc(count * VB2_SHA256_DIGEST_SIZE);
+	ClockTimerState ct;
+	uint32_t i;
+	int j;
+
+	for (i = 0; i < count; i++) {
+		bufs[i] = buffer + i * obj_size;
+		sizes[i] = obj_size;
+	}
+
+	StartTimer(&ct);
+	for (j = 0; j < TEST_ITERATIONS; j++)
+		vb2_digest_buffers(bufs, sizes, count, VB2_HASH_SHA256,
+				   digests, VB2_SHA256_DIGEST_SIZE);
+	StopTimer(&ct);
+
+	benchmark_report(label, "mbytes",
+			 TEST_ITERATIONS * (count * (double)obj_size / 1e6),
+			 GetDurationMsecs(&ct));
+
+	free(digests);
+	free(sizes);
+	free(bufs);
+}
+
+int main(int argc, char *argv[]) {
+	const uint32_t obj_sizes[] = {1024, 4096, 65536};
+	int i, b;
+	char label[64];
+	uint8_t *buffer = malloc(TEST_BUFFER_SIZE);
+
+	memset(buffer, 0xa5, TEST_BUFFER_SIZE);
 
 	/* Iterate through all the hash functions. */
 	for(i = VB2_HASH_SHA1; i < VB2_HASH_ALG_COUNT; i++) {
-		StartTimer(&ct);
-		vb2_digest_buffer(buffer, TEST_BUFFER_SIZE, i,
-				  digest, sizeof(digest));
-		StopTimer(&ct);
+		/* Default (fastest available) implementation */
+		vb2_digest_set_backend(i, VB2_SHA_BACKEND_AUTO);
+		benchmark(buffer, i, vb2_get_hash_algorithm_name(i));
 
-		msecs = GetDurationMsecs(&ct);
-		speed = ((TEST_BUFFER_SIZE / 10e6)
-			 / (msecs / 10e3)); /* Mbytes/sec */
+		/* Each backend this CPU supports */
+		for (b = VB2_SHA_BACKEND_C; b < VB2_SHA_BACKEND_COUNT; b++) {
+			if (vb2_digest_set_backend(i, b))
+				continue;
+			snprintf(label, sizeof(label), "%s_%s",
+				 vb2_get_hash_algorithm_name(i),
+				 vb2_get_sha_backend_name(b));
+			benchmark(buffer, i, label);
+		}
+
+		vb2_digest_set_backend(i, VB2_SHA_BACKEND_AUTO);
+	}
 
-		fprintf(stderr,
-			"# %s Time taken = %u ms, Speed = %f Mbytes/sec\n",
-			vb2_get_hash_algorithm_name(i), msecs, speed);
-		fprintf(stdout, "mbytes_per_sec_%s:%f\n",
-			vb2_get_hash_algorithm_name(i), speed);
+	/* Many independent SHA-256 objects, e.g. hash tree blocks */
+	for (i = 0; i < ARRAY_SIZE(obj_sizes); i++) {
+		for (b = VB2_SHA_BACKEND_C; b < VB2_SHA_BACKEND_COUNT; b++) {
+			if (vb2_sha256_set_multi_backend(b))
+				continue;
+			snprintf(label, sizeof(label), "SHA256_multi_%uk_%s",
+				 obj_sizes[i] / 1024,
+				 vb2_get_sha_backend_name(b));
+			benchmark_multi(buffer, obj_sizes[i], label);
+		}
 	}
+	vb2_sha256_set_multi_backend(VB2_SHA_BACKEND_AUTO);
 
 	free(buffer);
 	return 0;
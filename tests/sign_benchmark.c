@@ -0,0 +1,148 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark for RSA signing with the private keys in tests/testkeys, with a
+ * signature allocated for each call or a signing context reused for all.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2sysincludes.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "benchmark_common.h"
+#include "host_common.h"
+#include "host_key2.h"
+#include "host_signature.h"
+#include "vb2_common.h"
+
+#define DATA_SIZE 1024
+
+/* Key sizes, in the same order as the vb2_crypto_algorithm values */
+static const char *key_names[] = {
+	"1024", "2048", "4096", "8192", "2048_exp3", "3072_exp3",
+};
+
+static const char *hash_names[] = {
+	"sha1", "sha256", "sha512",
+};
+
+static uint8_t data[DATA_SIZE];
+
+struct sign_args {
+	const struct vb2_private_key *key;
+	struct vb2_signing_ctx ctx;
+	int use_ctx;
+	const uint8_t *expect;
+	char label[64];
+};
+
+/*
+ * Sign once, allocating the signature or using the context.  Returns 1, or 0
+ * if the signature doesn't match the expected one.
+ */
+static double sign_data(void *arg)
+{
+	struct sign_args *args = arg;
+	uint8_t sig_buf[8192 / 8];
+	struct vb2_signature *sig;
+
+	if (args->use_ctx) {
+		if (vb2_signing_sign(&args->ctx, data, sizeof(data),
+				     sig_buf, sizeof(sig_buf)))
+			return 0;
+	} else {
+		sig = vb2_calculate_signature(data, sizeof(data), args->key);
+		if (!sig)
+			return 0;
+		memcpy(sig_buf, vb2_signature_data(sig), sig->sig_size);
+		free(sig);
+	}
+
+	if (memcmp(sig_buf, args->expect,
+		   vb2_rsa_sig_size(args->key->sig_alg))) {
+		fprintf(stderr, "%s: signature doesn't match\n", args->label);
+		return 0;
+	}
+	return 1;
+}
+
+/* Sign with either method; returns signatures per second, or 0 if error. */
+static double benchmark_signing(const struct vb2_private_key *key,
+				int use_ctx, const uint8_t *expect,
+				const char *name)
+{
+	struct sign_args args = {
+		.key = key,
+		.use_ctx = use_ctx,
+		.expect = expect,
+	};
+
+	snprintf(args.label, sizeof(args.label), "%s_%s", name,
+		 use_ctx ? "ctx" : "alloc");
+
+	if (use_ctx && vb2_signing_init(&args.ctx, key)) {
+		fprintf(stderr, "%s: can't make signing context\n",
+			args.label);
+		return 0;
+	}
+
+	return benchmark_run(args.label, "signs", sign_data, &args);
+}
+
+int main(int argc, char *argv[])
+{
+	struct vb2_private_key *key;
+	struct vb2_signature *expect;
+	char filename[1024];
+	char name[32];
+	int i, h;
+	int rv = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <testkeys dir>\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 7;
+
+	for (i = 0; i < ARRAY_SIZE(key_names); i++) {
+		for (h = 0; h < ARRAY_SIZE(hash_names); h++) {
+			snprintf(filename, sizeof(filename),
+				 "%s/key_rsa%s.%s.vbprivk", argv[1],
+				 key_names[i], hash_names[h]);
+			key = vb2_read_private_key(filename);
+			if (!key) {
+				fprintf(stderr, "Couldn't read key %s\n",
+					filename);
+				rv = 1;
+				continue;
+			}
+
+			/* The allocating path makes the signature to match */
+			expect = vb2_calculate_signature(data, sizeof(data),
+							 key);
+			snprintf(name, sizeof(name), "RSA%s_%s",
+				 key_names[i], hash_names[h]);
+			if (!expect ||
+			    !benchmark_signing(key, 0,
+					       vb2_signature_data(expect),
+					       name) ||
+			    !benchmark_signing(key, 1,
+					       vb2_signature_data(expect),
+					       name))
+				rv = 1;
+
+			free(expect);
+			vb2_private_key_free(key);
+		}
+	}
+
+	return rv;
+}
@@ -138,6 +138,31 @@ static void test_verify_data(const struct vb2_packed_key *key1,
 	free(sig2);
 }
 
+static void test_signing_ctx(const struct vb2_private_key *key,
+			     const struct vb2_signature *sig)
+{
+	struct vb2_signing_ctx ctx;
+	uint8_t buf[1024];
+	int i;
+
+	TEST_SUCC(vb2_signing_init(&ctx, key), "vb2_signing_init() ok");
+	TEST_EQ(ctx.sig_size, sig->sig_size, "  sig size");
+
+	/* Reusing the context gives the same signature each time */
+	for (i = 0; i < 2; i++) {
+		memset(buf, 0, sizeof(buf));
+		TEST_SUCC(vb2_signing_sign(&ctx, test_data, sizeof(test_data),
+					   buf, sizeof(buf)),
+			  "vb2_signing_sign() ok");
+		TEST_SUCC(memcmp(buf, vb2_signature_data(
+					(struct vb2_signature *)sig),
+				 sig->sig_size), "  matches signature");
+	}
+
+	TEST_EQ(vb2_signing_sign(&ctx, test_data, sizeof(test_data),
+				 buf, ctx.sig_size - 1),
+		VB2_SIGNING_SIG_SIZE, "vb2_signing_sign() buffer too small");
+}
 
 int test_algorithm(int key_algorithm, const char *keys_dir)
 {
@@ -178,6 +203,7 @@ int test_algorithm(int key_algorithm, const char *keys_dir)
 
 	test_unpack_key(key1);
 	test_verify_data(key1, sig);
+	test_signing_ctx(private_key, sig);
 
 	retval = 0;
 
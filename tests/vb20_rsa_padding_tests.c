@@ -14,8 +14,11 @@
 #include "2sysincludes.h"
 #include "2rsa.h"
 #include "host_key.h"
+#include "host_rsa.h"
 #include "vb2_common.h"
 
+#define NUM_SIGS (sizeof(signatures) / sizeof(signatures[0]))
+
 /**
  * Test valid and invalid signatures.
  */
@@ -102,6 +105,98 @@ static void test_verify_digest(struct vb2_public_key *key) {
 		VB2_ERROR_RSA_PADDING, "vb2_rsa_verify_digest() bad sig end");
 }
 
+/**
+ * Test batch verification with vb2_rsa_verify_digests() and its parallel
+ * host wrapper.
+ */
+static void test_verify_digests(struct vb2_public_key *key)
+{
+	uint8_t workbuf[VB2_VERIFY_DIGEST_WORKBUF_BYTES]
+		 __attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+	uint8_t sigs[NUM_SIGS][RSA1024NUMBYTES];
+	struct vb2_rsa_verify_item items[NUM_SIGS];
+	int results[NUM_SIGS];
+	struct vb2_workbuf wb;
+	int unexpected_success;
+	int i, pass;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+
+	for (i = 0; i < NUM_SIGS; i++) {
+		items[i].sig = sigs[i];
+		items[i].digest = test_message_sha1_hash;
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		const char *name = pass ? "vb2_rsa_verify_digests_parallel()" :
+			"vb2_rsa_verify_digests()";
+		int rv;
+
+		for (i = 0; i < NUM_SIGS; i++)
+			memcpy(sigs[i], signatures[i], RSA1024NUMBYTES);
+
+		if (pass)
+			rv = vb2_rsa_verify_digests_parallel(key, items,
+							     results, NUM_SIGS);
+		else
+			rv = vb2_rsa_verify_digests(key, items, results,
+						    NUM_SIGS, &wb);
+		TEST_NEQ(rv, VB2_SUCCESS, name);
+		TEST_EQ(rv, results[1], "  returns first failure");
+		TEST_SUCC(results[0], "  valid sig");
+
+		unexpected_success = 0;
+		for (i = 1; i < NUM_SIGS; i++) {
+			if (!results[i]) {
+				fprintf(stderr, "%s: vector %d passed!\n",
+					name, i);
+				unexpected_success++;
+			}
+		}
+		TEST_EQ(unexpected_success, 0, "  invalid sigs");
+
+		/* Every item good */
+		for (i = 0; i < NUM_SIGS; i++)
+			memcpy(sigs[i], signatures[0], RSA1024NUMBYTES);
+		if (pass)
+			rv = vb2_rsa_verify_digests_parallel(key, items,
+							     results,
+							     NUM_SIGS - 1);
+		else
+			rv = vb2_rsa_verify_digests(key, items, results,
+						    NUM_SIGS - 1, &wb);
+		TEST_SUCC(rv, "  all good");
+	}
+
+	TEST_SUCC(vb2_rsa_verify_digests(key, items, results, 0, &wb),
+		  "vb2_rsa_verify_digests() empty");
+	TEST_EQ(vb2_rsa_verify_digests(key, NULL, results, 1, &wb),
+		VB2_ERROR_RSA_VERIFY_PARAM,
+		"vb2_rsa_verify_digests() no items");
+
+	memcpy(sigs[0], signatures[0], RSA1024NUMBYTES);
+	items[1].sig = NULL;
+	TEST_EQ(vb2_rsa_verify_digests(key, items, results, 2, &wb),
+		VB2_ERROR_RSA_VERIFY_PARAM,
+		"vb2_rsa_verify_digests() null sig");
+	TEST_SUCC(results[0], "  other item still verified");
+	items[1].sig = sigs[1];
+
+	vb2_workbuf_init(&wb, workbuf, RSA1024NUMBYTES * 3 - 1);
+	TEST_EQ(vb2_rsa_verify_digests(key, items, results, 2, &wb),
+		VB2_ERROR_RSA_VERIFY_WORKBUF,
+		"vb2_rsa_verify_digests() small workbuf");
+	TEST_EQ(results[0], VB2_ERROR_RSA_VERIFY_WORKBUF,
+		"  error copied to results");
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+
+	key->arrsize *= 2;
+	TEST_EQ(vb2_rsa_verify_digests_parallel(key, items, results, 2),
+		VB2_ERROR_RSA_VERIFY_SIG_LEN,
+		"vb2_rsa_verify_digests_parallel() bad sig len");
+	key->arrsize /= 2;
+}
+
 int main(int argc, char *argv[])
 {
 	struct vb2_public_key k2;
@@ -126,6 +221,7 @@ int main(int argc, char *argv[])
 	/* Run tests */
 	test_signatures(&k2);
 	test_verify_digest(&k2);
+	test_verify_digests(&k2);
 
 	/* Clean up and exit */
 	free(pk);
@@ -5,12 +5,14 @@
  * Tests for host misc library vboot2 functions
  */
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
 
 #include "2sysincludes.h"
 #include "2common.h"
 #include "vb21_common.h"
+#include "file_keys.h"
 #include "host_common.h"
 #include "host_misc.h"
 
@@ -71,6 +73,85 @@ static void file_tests(const char *temp_dir)
 	unlink(testfile);
 }
 
+/* Check DigestFd() in each mode against the digest of the whole buffer */
+static void digest_file_size_tests(const char *testfile, uint32_t size)
+{
+	static const char *mode_names[] = { "auto", "mmap", "read" };
+	uint8_t expect[VB2_SHA256_DIGEST_SIZE];
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	uint8_t *data = malloc(size + 1);
+	char name[64];
+	uint32_t i;
+	int mode, fd;
+
+	for (i = 0; i < size; i++)
+		data[i] = (uint8_t)(i * 31 + (i >> 8));
+
+	vb2_digest_buffer(data, size, VB2_HASH_SHA256, expect, sizeof(expect));
+	/* vb2_write_file() doesn't create empty files */
+	fd = open(testfile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	TEST_EQ(write(fd, data, size), size, "write test file");
+	close(fd);
+
+	for (mode = DIGEST_FILE_AUTO; mode <= DIGEST_FILE_READ; mode++) {
+		snprintf(name, sizeof(name), "DigestFd() %s size %u",
+			 mode_names[mode], size);
+		fd = open(testfile, O_RDONLY);
+		memset(digest, 0, sizeof(digest));
+		TEST_SUCC(DigestFd(fd, VB2_HASH_SHA256, mode, digest,
+				   sizeof(digest)), name);
+		TEST_EQ(memcmp(digest, expect, sizeof(digest)), 0, "  digest");
+		close(fd);
+	}
+
+	memset(digest, 0, sizeof(digest));
+	TEST_SUCC(DigestFile((char *)testfile, VB2_HASH_SHA256, digest,
+			     sizeof(digest)), "DigestFile()");
+	TEST_EQ(memcmp(digest, expect, sizeof(digest)), 0, "  digest");
+
+	unlink(testfile);
+	free(data);
+}
+
+static void digest_file_tests(const char *temp_dir)
+{
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	uint8_t expect[VB2_SHA256_DIGEST_SIZE];
+	const uint8_t test_data[] = "Some test data";
+	char *testfile;
+	int fds[2];
+
+	xasprintf(&testfile, "%s/digest_file_tests.dat", temp_dir);
+
+	digest_file_size_tests(testfile, 0);
+	digest_file_size_tests(testfile, 1);
+	digest_file_size_tests(testfile, 1024 * 1024 - 1);
+	digest_file_size_tests(testfile, 1024 * 1024);
+	digest_file_size_tests(testfile, 1024 * 1024 + 1);
+	digest_file_size_tests(testfile, 3 * 1024 * 1024 + 17);
+
+	TEST_NEQ(DigestFile((char *)testfile, VB2_HASH_SHA256, digest,
+			    sizeof(digest)), 0, "DigestFile() missing");
+
+	/* Pipes can't be mapped, so auto mode has to read them */
+	vb2_digest_buffer(test_data, sizeof(test_data), VB2_HASH_SHA256,
+			  expect, sizeof(expect));
+	TEST_SUCC(pipe(fds), "pipe()");
+	TEST_EQ(write(fds[1], test_data, sizeof(test_data)), sizeof(test_data),
+		"  write");
+	close(fds[1]);
+	TEST_SUCC(DigestFd(fds[0], VB2_HASH_SHA256, DIGEST_FILE_AUTO, digest,
+			   sizeof(digest)), "DigestFd() pipe");
+	TEST_EQ(memcmp(digest, expect, sizeof(digest)), 0, "  digest");
+	close(fds[0]);
+
+	TEST_EQ(DigestFd(-1, VB2_HASH_SHA256, DIGEST_FILE_READ, digest,
+			 sizeof(digest)), VB2_ERROR_READ_FILE_DATA,
+		"DigestFd() bad fd");
+
+	free(testfile);
+}
+
 int main(int argc, char* argv[])
 {
 	if (argc != 2) {
@@ -81,6 +162,7 @@ int main(int argc, char* argv[])
 
 	misc_tests();
 	file_tests(temp_dir);
+	digest_file_tests(temp_dir);
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -34,6 +34,9 @@ function test_signatures {
   done
   echo -e "Peforming ${COL_YELLOW}PKCS #1 v1.5 Padding Tests${COL_STOP}..."
   ${TEST_DIR}/vb20_rsa_padding_tests ${TESTKEY_DIR}/rsa_padding_test_pubkey.keyb
+  echo -e "Peforming ${COL_YELLOW}Padding Tests with 32-bit limbs${COL_STOP}..."
+  ${TEST_DIR}/vb20_rsa_padding_tests_limb32 \
+    ${TESTKEY_DIR}/rsa_padding_test_pubkey.keyb
 }
 
 check_test_keys
@@ -8,8 +8,10 @@
 #include <stdio.h>
 
 #include "2sysincludes.h"
+#include "2common.h"
 #include "2rsa.h"
 #include "2sha.h"
+#include "2sha_private.h"
 #include "2return_codes.h"
 
 #include "sha_test_vectors.h"
@@ -170,6 +172,248 @@ void misc_tests(void)
 		"vb2_digest_finalize() invalid alg");
 }
 
+static void backend_tests(void)
+{
+	const struct {
+		enum vb2_hash_algorithm alg;
+		void (*tests)(void);
+	} algs[] = {
+		{VB2_HASH_SHA1, sha1_tests},
+		{VB2_HASH_SHA256, sha256_tests},
+		{VB2_HASH_SHA512, sha512_tests},
+	};
+	enum vb2_sha_backend backend;
+	int i;
+
+	TEST_SUCC(vb2_sha256_set_backend(VB2_SHA_BACKEND_C),
+		  "vb2_sha256_set_backend(C)");
+	TEST_EQ(vb2_sha256_get_backend(), VB2_SHA_BACKEND_C,
+		"vb2_sha256_get_backend(C)");
+	TEST_EQ(vb2_sha256_set_backend(VB2_SHA_BACKEND_COUNT),
+		VB2_ERROR_SHA_BACKEND_UNSUPPORTED,
+		"vb2_sha256_set_backend() invalid");
+	TEST_EQ(vb2_sha1_set_backend(VB2_SHA_BACKEND_AVX2),
+		VB2_ERROR_SHA_BACKEND_UNSUPPORTED,
+		"vb2_sha1_set_backend(AVX2)");
+	TEST_EQ(vb2_sha512_set_backend(VB2_SHA_BACKEND_SHA_NI),
+		VB2_ERROR_SHA_BACKEND_UNSUPPORTED,
+		"vb2_sha512_set_backend(SHA_NI)");
+	TEST_EQ(vb2_digest_set_backend(VB2_HASH_INVALID, VB2_SHA_BACKEND_C),
+		VB2_ERROR_SHA_BACKEND_UNSUPPORTED,
+		"vb2_digest_set_backend() invalid alg");
+	TEST_STR_EQ(vb2_get_sha_backend_name(VB2_SHA_BACKEND_COUNT),
+		    VB2_INVALID_ALG_NAME, "backend name invalid");
+
+	/* Repeat the digest tests with every backend this CPU supports */
+	for (i = 0; i < ARRAY_SIZE(algs); i++) {
+		for (backend = VB2_SHA_BACKEND_C;
+		     backend < VB2_SHA_BACKEND_COUNT; backend++) {
+			/* Skip backends this CPU doesn't have */
+			if (vb2_digest_set_backend(algs[i].alg, backend))
+				continue;
+			algs[i].tests();
+		}
+		TEST_SUCC(vb2_digest_set_backend(algs[i].alg,
+						 VB2_SHA_BACKEND_AUTO),
+			  "vb2_digest_set_backend(AUTO)");
+	}
+
+	TEST_SUCC(vb2_sha256_set_backend(VB2_SHA_BACKEND_AUTO),
+		  "vb2_sha256_set_backend(AUTO)");
+	TEST_NEQ(vb2_sha256_get_backend(), VB2_SHA_BACKEND_AUTO,
+		 "vb2_sha256_get_backend() resolves AUTO");
+}
+
+static void multi_buffer_tests(void)
+{
+	/* Sizes around the padding boundaries, plus some longer buffers */
+	const uint32_t sizes[] = {
+		0, 1, 3, 55, 56, 57, 63, 64, 65, 119, 120, 127, 128, 129,
+		1000, 1024, 4096, 4097, 5000, 8191, 65536, 70000, 17, 256,
+		300, 9, 777, 2048, 191, 192, 193, 4000, 31, 12345, 100, 60,
+	};
+	const int count = ARRAY_SIZE(sizes);
+	const uint8_t *bufs[ARRAY_SIZE(sizes)];
+	uint8_t digests[ARRAY_SIZE(sizes)][VB2_SHA256_DIGEST_SIZE];
+	uint8_t expect[ARRAY_SIZE(sizes)][VB2_SHA256_DIGEST_SIZE];
+	uint8_t digest512[VB2_SHA512_DIGEST_SIZE];
+	uint8_t *data;
+	enum vb2_sha_backend backend;
+	int i, j, ok;
+
+	data = malloc(count * 70000);
+	for (i = 0; i < count * 70000; i++)
+		data[i] = (uint8_t)(i * 7 + (i >> 8));
+	for (i = 0; i < count; i++) {
+		bufs[i] = data + i * 70000 + i;
+		TEST_SUCC(vb2_digest_buffer(bufs[i], sizes[i], VB2_HASH_SHA256,
+					    expect[i], sizeof(expect[i])),
+			  "vb2_digest_buffer() reference");
+	}
+
+	TEST_EQ(vb2_sha256_set_multi_backend(VB2_SHA_BACKEND_SHA_NI),
+		VB2_ERROR_SHA_BACKEND_UNSUPPORTED,
+		"vb2_sha256_set_multi_backend(SHA_NI)");
+	TEST_EQ(vb2_sha256_set_multi_backend(VB2_SHA_BACKEND_COUNT),
+		VB2_ERROR_SHA_BACKEND_UNSUPPORTED,
+		"vb2_sha256_set_multi_backend() invalid");
+	TEST_EQ(vb2_digest_buffers(bufs, sizes, count, VB2_HASH_INVALID,
+				   digests[0], sizeof(digests[0])),
+		VB2_ERROR_SHA_INIT_ALGORITHM,
+		"vb2_digest_buffers() invalid alg");
+	TEST_EQ(vb2_digest_buffers(bufs, sizes, count, VB2_HASH_SHA256,
+				   digests[0], sizeof(digests[0]) - 1),
+		VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE,
+		"vb2_digest_buffers() digest size");
+
+	for (backend = VB2_SHA_BACKEND_C; backend < VB2_SHA_BACKEND_COUNT;
+	     backend++) {
+		/* Skip backends this CPU doesn't have */
+		if (vb2_sha256_set_multi_backend(backend))
+			continue;
+
+		/* All buffers at once, then a batch smaller than the lanes */
+		for (j = count; j > 0; j -= count - 3) {
+			memset(digests, 0, sizeof(digests));
+			TEST_SUCC(vb2_digest_buffers(bufs, sizes, j,
+						     VB2_HASH_SHA256,
+						     digests[0],
+						     sizeof(digests[0])),
+				  "vb2_digest_buffers()");
+			for (i = 0, ok = 1; i < j; i++)
+				ok &= !memcmp(digests[i], expect[i],
+					      sizeof(expect[i]));
+			TEST_TRUE(ok, vb2_get_sha_backend_name(backend));
+		}
+	}
+
+	TEST_SUCC(vb2_sha256_set_multi_backend(VB2_SHA_BACKEND_AUTO),
+		  "vb2_sha256_set_multi_backend(AUTO)");
+	TEST_NEQ(vb2_sha256_get_multi_backend(), VB2_SHA_BACKEND_AUTO,
+		 "vb2_sha256_get_multi_backend() resolves AUTO");
+#ifdef VB2_SHA_X86
+	/* AVX2 can be forced above, but AUTO prefers SHA-NI */
+	if (vb2_sha_x86_supported(VB2_HASH_SHA256, VB2_SHA_BACKEND_SHA_NI))
+		TEST_NEQ(vb2_sha256_get_multi_backend(), VB2_SHA_BACKEND_AVX2,
+			 "  not AVX2 with SHA-NI");
+#endif
+
+	/* Other algorithms fall back to hashing one buffer at a time */
+	TEST_SUCC(vb2_digest_buffers(bufs, sizes, 2, VB2_HASH_SHA512,
+				     digests[0], VB2_SHA512_DIGEST_SIZE),
+		  "vb2_digest_buffers(SHA512)");
+	TEST_SUCC(vb2_digest_buffer(bufs[1], sizes[1], VB2_HASH_SHA512,
+				    digest512, sizeof(digest512)),
+		  "vb2_digest_buffer(SHA512)");
+	TEST_SUCC(memcmp(digests[2], digest512, sizeof(digest512)),
+		  "vb2_digest_buffers(SHA512) result");
+
+	free(data);
+}
+
+/* Store words big-endian, the way the finalize functions output state */
+static void store_be(uint8_t *out, const void *state, int words, int width)
+{
+	uint64_t w;
+	int i, j;
+
+	for (i = 0; i < words; i++) {
+		if (width == 4)
+			w = ((const uint32_t *)state)[i];
+		else
+			w = ((const uint64_t *)state)[i];
+		for (j = 0; j < width; j++)
+			*out++ = (uint8_t)(w >> (8 * (width - 1 - j)));
+	}
+}
+
+static void digest64_tests(void)
+{
+	const enum vb2_hash_algorithm algs[] = {
+		VB2_HASH_SHA1, VB2_HASH_SHA256, VB2_HASH_SHA512,
+	};
+	struct vb2_digest64_context dc;
+	struct vb2_sha1_context sha1;
+	struct vb2_sha256_context sha256;
+	struct vb2_sha512_context sha512;
+	uint8_t block[VB2_SHA512_BLOCK_SIZE];
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint8_t expect[VB2_MAX_DIGEST_SIZE];
+	uint32_t len = strlen(long_msg);
+	uint32_t off, chunk;
+	int i;
+
+	/* Same results as the 32-bit API, in uneven pieces */
+	for (i = 0; i < ARRAY_SIZE(algs); i++) {
+		TEST_SUCC(vb2_digest_buffer((uint8_t *)long_msg, len, algs[i],
+					    expect, sizeof(expect)),
+			  "vb2_digest_buffer()");
+		TEST_SUCC(vb2_digest64_init(&dc, algs[i]),
+			  "vb2_digest64_init()");
+		for (off = 0, chunk = 1; off < len; off += chunk, chunk *= 3) {
+			if (chunk > len - off)
+				chunk = len - off;
+			vb2_digest64_extend(&dc, (uint8_t *)long_msg + off,
+					    chunk);
+		}
+		TEST_EQ(dc.total_size, len, "vb2_digest64_extend() size");
+		TEST_SUCC(vb2_digest64_finalize(&dc, digest, sizeof(digest)),
+			  "vb2_digest64_finalize()");
+		TEST_SUCC(memcmp(digest, expect, vb2_digest_size(algs[i])),
+			  "vb2_digest64 matches vb2_digest_buffer()");
+	}
+
+	TEST_EQ(vb2_digest64_init(&dc, VB2_HASH_INVALID),
+		VB2_ERROR_SHA_INIT_ALGORITHM, "vb2_digest64_init() invalid");
+	vb2_digest64_init(&dc, VB2_HASH_SHA256);
+	TEST_EQ(vb2_digest64_finalize(&dc, digest, VB2_SHA256_DIGEST_SIZE - 1),
+		VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE,
+		"vb2_digest64_finalize() digest size");
+
+	/*
+	 * Lengths of 4 GiB and up.  Hashing that much data would be too slow
+	 * here, so pad "abc" by hand as if it were the tail of a long message
+	 * and check the final block comes out the same.
+	 */
+	memset(block, 0, sizeof(block));
+	memcpy(block, "abc\x80", 4);
+	block[VB2_SHA256_BLOCK_SIZE - 5] = 0x08;
+	block[VB2_SHA256_BLOCK_SIZE - 1] = 0x18;
+
+	vb2_sha1_init(&sha1);
+	vb2_sha1_update(&sha1, block, VB2_SHA1_BLOCK_SIZE);
+	store_be(expect, sha1.state, 5, 4);
+	vb2_sha1_init(&sha1);
+	vb2_sha1_update(&sha1, (uint8_t *)"abc", 3);
+	vb2_sha1_finalize_size(&sha1, digest, 0x100000003ULL);
+	TEST_SUCC(memcmp(digest, expect, VB2_SHA1_DIGEST_SIZE),
+		  "vb2_sha1_finalize_size() above 4 GiB");
+
+	vb2_sha256_init(&sha256);
+	vb2_sha256_update(&sha256, block, VB2_SHA256_BLOCK_SIZE);
+	store_be(expect, sha256.h, 8, 4);
+	vb2_sha256_init(&sha256);
+	vb2_sha256_update(&sha256, (uint8_t *)"abc", 3);
+	vb2_sha256_finalize_size(&sha256, digest, 0x100000003ULL);
+	TEST_SUCC(memcmp(digest, expect, VB2_SHA256_DIGEST_SIZE),
+		  "vb2_sha256_finalize_size() above 4 GiB");
+
+	/* SHA-512 has a 128-bit length field; use bits above 64 too */
+	memset(block, 0, sizeof(block));
+	memcpy(block, "abc\x80", 4);
+	block[VB2_SHA512_BLOCK_SIZE - 9] = 0x02;
+	block[VB2_SHA512_BLOCK_SIZE - 1] = 0x18;
+
+	vb2_sha512_init(&sha512);
+	vb2_sha512_update(&sha512, block, VB2_SHA512_BLOCK_SIZE);
+	store_be(expect, sha512.h, 8, 8);
+	vb2_sha512_init(&sha512);
+	vb2_sha512_update(&sha512, (uint8_t *)"abc", 3);
+	vb2_sha512_finalize_size(&sha512, digest, 0x4000000000000003ULL);
+	TEST_SUCC(memcmp(digest, expect, VB2_SHA512_DIGEST_SIZE),
+		  "vb2_sha512_finalize_size() above 2^61 bytes");
+}
+
 static void hash_algorithm_name_tests(void)
 {
 	enum vb2_hash_algorithm alg;
@@ -197,6 +441,9 @@ int main(int argc, char *argv[])
 	sha256_tests();
 	sha512_tests();
 	misc_tests();
+	backend_tests();
+	multi_buffer_tests();
+	digest64_tests();
 	hash_algorithm_name_tests();
 
 	free(long_msg);
@@ -227,6 +227,7 @@ static const char *got_find_disk;
 static const char *got_load_disk;
 static uint32_t got_return_val;
 static uint32_t got_external_mismatch;
+static uint32_t got_lazy_mismatch;
 static struct vb2_context ctx;
 
 /**
@@ -328,6 +329,10 @@ VbError_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 	if (t->external_expected[load_kernel_calls] !=
 			!!(params->boot_flags & BOOT_FLAG_EXTERNAL_GPT))
 		got_external_mismatch++;
+	/* Only removable disks skip reading the secondary GPT */
+	if (!!(t->want_flags & VB_DISK_FLAG_REMOVABLE) !=
+			!!(params->boot_flags & BOOT_FLAG_LAZY_GPT))
+		got_lazy_mismatch++;
 	return t->loadkernel_return_val[load_kernel_calls++];
 }
 
@@ -361,6 +366,7 @@ static void VbTryLoadKernelTest(void)
 				    "  load disk");
 		}
 		TEST_EQ(got_external_mismatch, 0, "  external GPT errors");
+		TEST_EQ(got_lazy_mismatch, 0, "  lazy GPT errors");
 	}
 }
 
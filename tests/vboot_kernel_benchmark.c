@@ -0,0 +1,322 @@
+/* Copyright 2017 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Timing harness for loading a kernel body with LoadKernel().  Runs the
+ * stub stream backend over a mock disk with simulated read bandwidth, once
+ * reading synchronously and once overlapping reads with hashing through
+ * VbExStreamReadAsync().  Key and signature checks are mocked out, so only
+ * I/O and hashing are measured.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "2sysincludes.h"
+#include "2api.h"
+#include "2common.h"
+#include "2misc.h"
+#include "2nvstorage.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "gbb_header.h"
+#include "gpt.h"
+#include "load_kernel_fw.h"
+#include "timer_utils.h"
+#include "vb2_struct.h"
+#include "vboot_api.h"
+#include "vboot_common.h"
+#include "vboot_kernel.h"
+
+#define SECTOR_SIZE 512
+#define KERNEL_SIZE (16 * 1024 * 1024)
+#define VBLOCK_SIZE 4096
+#define PART_START 64
+#define PART_SECTORS ((VBLOCK_SIZE + KERNEL_SIZE) / SECTOR_SIZE)
+#define DISK_SECTORS (PART_START + PART_SECTORS + 64)
+
+/* Simulated storage read bandwidth */
+#define DISK_MBYTES_PER_SEC 200
+
+/* Runs of each mode; the fastest is reported */
+#define TEST_ITERATIONS 3
+
+static uint8_t *disk;
+static uint8_t *kernel_buffer;
+static uint8_t expect_digest[VB2_SHA256_DIGEST_SIZE];
+static int digest_ok;
+static int use_async;
+
+static uint8_t gbb_data[sizeof(GoogleBinaryBlockHeader) + 2048];
+static uint8_t shared_data[VB_SHARED_DATA_MIN_SIZE];
+static VbSharedDataHeader *shared = (VbSharedDataHeader *)shared_data;
+static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
+static LoadKernelParams lkp;
+static VbKeyBlockHeader kbh;
+static VbKernelPreambleHeader kph;
+static struct vb2_context ctx;
+static int part_next;
+
+/* Outstanding asynchronous read */
+static struct {
+	pthread_t thread;
+	VbExStream_t stream;
+	uint32_t bytes;
+	void *buffer;
+	VbError_t rv;
+} pending;
+
+static void SetupGptHeader(GptHeader *h, int is_secondary)
+{
+	memset(h, 0, SECTOR_SIZE);
+	memcpy(h->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
+	h->revision = GPT_HEADER_REVISION;
+	h->size = MIN_SIZE_OF_HEADER;
+	h->size_of_entry = sizeof(GptEntry);
+	h->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+	if (is_secondary) {
+		h->my_lba = DISK_SECTORS - GPT_HEADER_SECTORS;
+		h->entries_lba = h->my_lba -
+			CalculateEntriesSectors(h, SECTOR_SIZE);
+	} else {
+		h->my_lba = GPT_PMBR_SECTORS;
+		h->entries_lba = h->my_lba + 1;
+	}
+	h->first_usable_lba = 2 + CalculateEntriesSectors(h, SECTOR_SIZE);
+	h->last_usable_lba = DISK_SECTORS - 2 -
+		CalculateEntriesSectors(h, SECTOR_SIZE);
+	h->header_crc32 = HeaderCrc(h);
+}
+
+static void ResetMocks(void)
+{
+	SetupGptHeader((GptHeader *)(disk + SECTOR_SIZE), 0);
+	SetupGptHeader((GptHeader *)(disk + (DISK_SECTORS - 1) * SECTOR_SIZE),
+		       1);
+
+	memset(&shared_data, 0, sizeof(shared_data));
+	VbSharedDataInit(shared, sizeof(shared_data));
+
+	memset(&lkp, 0, sizeof(lkp));
+	lkp.bytes_per_lba = SECTOR_SIZE;
+	lkp.streaming_lba_count = DISK_SECTORS;
+	lkp.gpt_lba_count = DISK_SECTORS;
+	lkp.kernel_buffer = kernel_buffer;
+	lkp.kernel_buffer_size = KERNEL_SIZE;
+	lkp.disk_handle = (VbExDiskHandle_t)1;
+
+	memset(&kbh, 0, sizeof(kbh));
+	kbh.key_block_flags = -1;
+	kbh.key_block_size = sizeof(kbh);
+
+	memset(&kph, 0, sizeof(kph));
+	kph.preamble_size = VBLOCK_SIZE - kbh.key_block_size;
+	kph.body_signature.data_size = KERNEL_SIZE;
+
+	part_next = 0;
+	digest_ok = 0;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.workbuf = workbuf;
+	ctx.workbuf_size = sizeof(workbuf);
+	vb2_nv_init(&ctx);
+
+	struct vb2_shared_data *sd = vb2_get_sd(&ctx);
+	sd->vbsd = shared;
+	sd->gbb = (struct vb2_gbb_header *)gbb_data;
+	sd->gbb_size = sizeof(gbb_data);
+}
+
+/* Mocks */
+
+VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
+		       uint64_t lba_count, void *buffer)
+{
+	uint64_t bytes = lba_count * SECTOR_SIZE;
+	uint64_t nsecs = bytes * 1000 / DISK_MBYTES_PER_SEC;
+	struct timespec ts = {
+		.tv_sec = nsecs / 1000000000,
+		.tv_nsec = nsecs % 1000000000,
+	};
+
+	/* Time spent waiting for the device doesn't need the CPU */
+	nanosleep(&ts, NULL);
+	memcpy(buffer, disk + lba_start * SECTOR_SIZE, bytes);
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
+			uint64_t lba_count, const void *buffer)
+{
+	return VBERROR_SUCCESS;
+}
+
+static void *ReadThread(void *arg)
+{
+	pending.rv = VbExStreamRead(pending.stream, pending.bytes,
+				    pending.buffer);
+	return NULL;
+}
+
+VbError_t VbExStreamReadAsync(VbExStream_t stream, uint32_t bytes,
+			      void *buffer)
+{
+	if (!use_async)
+		return VbExStreamRead(stream, bytes, buffer);
+
+	pending.stream = stream;
+	pending.bytes = bytes;
+	pending.buffer = buffer;
+	pending.rv = VBERROR_UNKNOWN;
+	if (pthread_create(&pending.thread, NULL, ReadThread, NULL))
+		return VBERROR_UNKNOWN;
+
+	/*
+	 * Let the reader issue its "device" request before we go back to
+	 * hashing, as a DMA engine would; on a single CPU it may otherwise not
+	 * run until we wait for it.
+	 */
+	sched_yield();
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExStreamReadWait(VbExStream_t stream)
+{
+	if (!use_async)
+		return VBERROR_SUCCESS;
+
+	pthread_join(pending.thread, NULL);
+	return pending.rv;
+}
+
+int GptInit(GptData *gpt)
+{
+	return GPT_SUCCESS;
+}
+
+int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
+{
+	if (part_next++)
+		return GPT_ERROR_NO_VALID_KERNEL;
+
+	gpt->current_kernel = 0;
+	*start_sector = PART_START;
+	*size = PART_SECTORS;
+	return GPT_SUCCESS;
+}
+
+int vb2_unpack_key_buffer(struct vb2_public_key *key,
+			  const uint8_t *buf,
+			  uint32_t size)
+{
+	key->hash_alg = VB2_HASH_SHA256;
+	return VB2_SUCCESS;
+}
+
+int vb2_verify_keyblock(struct vb2_keyblock *block,
+			uint32_t size,
+			const struct vb2_public_key *key,
+			const struct vb2_workbuf *wb)
+{
+	memcpy((void *)block, &kbh, sizeof(kbh));
+	return VB2_SUCCESS;
+}
+
+int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
+			       uint32_t size,
+			       const struct vb2_public_key *key,
+			       const struct vb2_workbuf *wb)
+{
+	memcpy((void *)preamble, &kph, sizeof(kph));
+	return VB2_SUCCESS;
+}
+
+int vb2_verify_digest(const struct vb2_public_key *key,
+		      struct vb2_signature *sig,
+		      const uint8_t *digest,
+		      const struct vb2_workbuf *wb)
+{
+	digest_ok = !memcmp(digest, expect_digest, sizeof(expect_digest));
+	return digest_ok ? VB2_SUCCESS : VB2_ERROR_MOCK;
+}
+
+/*
+ * Load the kernel a few times; returns the best time taken in ms, or 0 if
+ * error.
+ */
+static uint32_t TimeLoadKernel(int async)
+{
+	ClockTimerState ct;
+	uint32_t msecs, best = 0;
+	VbError_t rv;
+	int i;
+
+	for (i = 0; i < TEST_ITERATIONS; i++) {
+		ResetMocks();
+		use_async = async;
+
+		StartTimer(&ct);
+		rv = LoadKernel(&ctx, &lkp);
+		StopTimer(&ct);
+
+		if (rv || !digest_ok) {
+			fprintf(stderr,
+				"LoadKernel() failed (rv=0x%x, digest %s)\n",
+				rv, digest_ok ? "ok" : "bad");
+			return 0;
+		}
+
+		msecs = GetDurationMsecs(&ct) ? GetDurationMsecs(&ct) : 1;
+		if (!best || msecs < best)
+			best = msecs;
+	}
+	return best;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t sync_ms, async_ms, hash_ms;
+	ClockTimerState ct;
+	uint32_t i;
+
+	disk = malloc((uint64_t)DISK_SECTORS * SECTOR_SIZE);
+	kernel_buffer = malloc(KERNEL_SIZE);
+	if (!disk || !kernel_buffer)
+		return 1;
+
+	/* Touch every page up front so page faults don't skew the timing */
+	memset(disk, 0, (uint64_t)DISK_SECTORS * SECTOR_SIZE);
+	memset(kernel_buffer, 0, KERNEL_SIZE);
+	for (i = 0; i < KERNEL_SIZE; i++)
+		disk[(PART_START * SECTOR_SIZE) + VBLOCK_SIZE + i] =
+			(uint8_t)(i * 13 + (i >> 12));
+
+	StartTimer(&ct);
+	vb2_digest_buffer(disk + PART_START * SECTOR_SIZE + VBLOCK_SIZE,
+			  KERNEL_SIZE, VB2_HASH_SHA256,
+			  expect_digest, sizeof(expect_digest));
+	StopTimer(&ct);
+	hash_ms = GetDurationMsecs(&ct);
+
+	sync_ms = TimeLoadKernel(0);
+	async_ms = TimeLoadKernel(1);
+	if (!sync_ms || !async_ms)
+		return 1;
+
+	fprintf(stderr, "# %u MB kernel, disk %u MB/s, SHA-256 alone %u ms\n",
+		KERNEL_SIZE >> 20, DISK_MBYTES_PER_SEC, hash_ms);
+	fprintf(stderr, "# sync %u ms, async %u ms\n", sync_ms, async_ms);
+	fprintf(stdout, "load_kernel_ms_sync:%u\n", sync_ms);
+	fprintf(stdout, "load_kernel_ms_async:%u\n", async_ms);
+
+	free(kernel_buffer);
+	free(disk);
+	return 0;
+}
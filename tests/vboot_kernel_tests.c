@@ -15,6 +15,7 @@
 #include "2common.h"
 #include "2misc.h"
 #include "2nvstorage.h"
+#include "2rsa.h"
 #include "2sha.h"
 #include "cgptlib.h"
 #include "cgptlib_internal.h"
@@ -36,6 +37,10 @@
 #define MOCK_SECTOR_SIZE  512
 #define MOCK_SECTOR_COUNT 1024
 
+/* Kernel body big enough to be read and hashed in several chunks */
+#define BIG_KERNEL_SIZE (5 * 512 * 1024)
+#define BIG_KERNEL_START 2000
+
 /* Mock kernel partition */
 struct mock_part {
 	uint32_t start;
@@ -50,12 +55,15 @@ static int mock_part_next;
 /* Mock data */
 static char call_log[4096];
 static uint8_t kernel_buffer[80000];
+static uint8_t big_kernel_buffer[BIG_KERNEL_SIZE];
 static int disk_read_to_fail;
 static int disk_write_to_fail;
 static int gpt_init_fail;
 static int key_block_verify_fail;  /* 0=ok, 1=sig, 2=hash */
 static int preamble_verify_fail;
 static int verify_data_fail;
+static int verify_digest_calls;
+static uint8_t verify_digest_seen[VB2_SHA256_DIGEST_SIZE];
 static int unpack_key_fail;
 static int gpt_flag_external;
 
@@ -133,6 +141,8 @@ static void ResetMocks(void)
 	key_block_verify_fail = 0;
 	preamble_verify_fail = 0;
 	verify_data_fail = 0;
+	verify_digest_calls = 0;
+	memset(verify_digest_seen, 0, sizeof(verify_digest_seen));
 	unpack_key_fail = 0;
 
 	gpt_flag_external = 0;
@@ -187,6 +197,18 @@ static void ResetMocks(void)
 	// TODO: more workbuf fields - flags, secdata, secdatak
 }
 
+/*
+ * Fill a buffer with the made-up data at a byte offset past the end of the
+ * mock disk.
+ */
+static void FillDiskPattern(uint8_t *buf, uint64_t offset, uint64_t size)
+{
+	uint64_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (offset + i) % 251;
+}
+
 /* Mocks */
 
 VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
@@ -197,6 +219,13 @@ VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 	if ((int)lba_start == disk_read_to_fail)
 		return VBERROR_SIMULATED;
 
+	if (lba_start >= MOCK_SECTOR_COUNT) {
+		/* Past the mock disk, the data is made up from its position */
+		FillDiskPattern(buffer, lba_start * MOCK_SECTOR_SIZE,
+				lba_count * MOCK_SECTOR_SIZE);
+		return VBERROR_SUCCESS;
+	}
+
 	memcpy(buffer, &mock_disk[lba_start * MOCK_SECTOR_SIZE],
 	       lba_count * MOCK_SECTOR_SIZE);
 
@@ -253,6 +282,8 @@ int vb2_unpack_key_buffer(struct vb2_public_key *key,
 	if (--unpack_key_fail == 0)
 		return VB2_ERROR_MOCK;
 
+	key->hash_alg = VB2_HASH_SHA256;
+
 	return VB2_SUCCESS;
 }
 
@@ -294,12 +325,14 @@ int vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 	return VB2_SUCCESS;
 }
 
-int vb2_verify_data(const uint8_t *data,
-		    uint32_t size,
-		    struct vb2_signature *sig,
-		    const struct vb2_public_key *key,
-		    const struct vb2_workbuf *wb)
+int vb2_verify_digest(const struct vb2_public_key *key,
+		      struct vb2_signature *sig,
+		      const uint8_t *digest,
+		      const struct vb2_workbuf *wb)
 {
+	verify_digest_calls++;
+	memcpy(verify_digest_seen, digest, sizeof(verify_digest_seen));
+
 	if (verify_data_fail)
 		return VB2_ERROR_MOCK;
 
@@ -326,6 +359,7 @@ static void ReadWriteGptTest(void)
 
 	g.sector_bytes = MOCK_SECTOR_SIZE;
 	g.streaming_drive_sectors = g.gpt_drive_sectors = MOCK_SECTOR_COUNT;
+	g.flags = 0;
 	g.valid_headers = g.valid_entries = MASK_BOTH;
 
 	ResetMocks();
@@ -482,6 +516,20 @@ static void ReadWriteGptTest(void)
 		   "VbExDiskWrite(h, 1023, 1)\n"
 		   "VbExDiskWrite(h, 991, 32)\n");
 
+	/* Only modified sectors of the entries are written */
+	ResetMocks();
+	AllocAndReadGptData(handle, &g);
+	g.modified = -1;
+	g.modified_sectors1 = 0x61;
+	g.modified_sectors2 = 0x80000000;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree sectors");
+	TEST_CALLS("VbExDiskWrite(h, 1, 1)\n"
+		   "VbExDiskWrite(h, 2, 1)\n"
+		   "VbExDiskWrite(h, 7, 2)\n"
+		   "VbExDiskWrite(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 1022, 1)\n");
+
 	/* If legacy signature, don't modify GPT header/entries 1 */
 	ResetMocks();
 	AllocAndReadGptData(handle, &g);
@@ -567,6 +615,136 @@ static void ReadWriteGptTest(void)
 
 }
 
+/**
+ * Set the entries CRC of a mock GPT header, so its entries are valid.
+ */
+static void SetupGptEntriesCrc(GptHeader *h)
+{
+	h->entries_crc32 = Crc32(&mock_disk[h->entries_lba * MOCK_SECTOR_SIZE],
+				 h->number_of_entries * h->size_of_entry);
+	h->header_crc32 = HeaderCrc(h);
+}
+
+/**
+ * Reading and writing the GPT with GPT_FLAG_LAZY_SECONDARY
+ */
+static void LazySecondaryGptTest(void)
+{
+	GptData g;
+
+	g.sector_bytes = MOCK_SECTOR_SIZE;
+	g.streaming_drive_sectors = g.gpt_drive_sectors = MOCK_SECTOR_COUNT;
+	g.flags = GPT_FLAG_LAZY_SECONDARY;
+
+	/* Valid primary GPT means the secondary isn't read */
+	ResetMocks();
+	SetupGptEntriesCrc(mock_gpt_primary);
+	SetupGptEntriesCrc(mock_gpt_secondary);
+	TEST_EQ(AllocAndReadGptData(handle, &g), 0, "Lazy AllocAndRead");
+	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
+		   "VbExDiskRead(h, 2, 32)\n");
+	TEST_EQ(g.unread, MASK_SECONDARY, "  secondary unread");
+	TEST_EQ(g.modified, 0, "  not modified");
+	TEST_EQ(CheckHeader((GptHeader *)g.secondary_header, 1,
+			    g.streaming_drive_sectors, g.gpt_drive_sectors,
+			    0, g.sector_bytes), 0, "  secondary header");
+	TEST_EQ(memcmp(g.secondary_entries, &mock_disk[991 * MOCK_SECTOR_SIZE],
+		       32 * MOCK_SECTOR_SIZE), 0, "  secondary entries");
+	TEST_EQ(GptSanityCheck(&g), GPT_SUCCESS, "  sanity check");
+	TEST_EQ(g.valid_headers, MASK_BOTH, "  valid headers");
+	TEST_EQ(g.valid_entries, MASK_BOTH, "  valid entries");
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "Lazy WriteAndFree");
+	TEST_CALLS("");
+
+	/* Writing an unread secondary GPT checks it and writes all of it */
+	ResetMocks();
+	SetupGptEntriesCrc(mock_gpt_primary);
+	AllocAndReadGptData(handle, &g);
+	g.modified = -1;
+	g.modified_sectors1 = 0x01;
+	g.modified_sectors2 = 0x80000000;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "Lazy WriteAndFree mod");
+	TEST_CALLS("VbExDiskWrite(h, 1, 1)\n"
+		   "VbExDiskWrite(h, 2, 1)\n"
+		   "VbExDiskRead(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 991, 32)\n");
+	TEST_EQ(CheckHeader(mock_gpt_secondary, 1, g.streaming_drive_sectors,
+		g.gpt_drive_sectors, 0, g.sector_bytes),
+		0, "  secondary header is valid");
+
+	/* Also if only the primary GPT needs repair */
+	ResetMocks();
+	SetupGptEntriesCrc(mock_gpt_primary);
+	AllocAndReadGptData(handle, &g);
+	g.modified = GPT_MODIFIED_HEADER1;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "Lazy WriteAndFree mod 1");
+	TEST_CALLS("VbExDiskWrite(h, 1, 1)\n");
+
+	/* Unless the secondary GPT on the drive is being ignored */
+	ResetMocks();
+	SetupGptEntriesCrc(mock_gpt_primary);
+	memcpy(mock_gpt_secondary->signature, GPT_HEADER_SIGNATURE_IGNORED,
+	       GPT_HEADER_SIGNATURE_SIZE);
+	AllocAndReadGptData(handle, &g);
+	g.modified = GPT_MODIFIED_HEADER2 | GPT_MODIFIED_ENTRIES2;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0,
+		"Lazy WriteAndFree secondary ignored");
+	TEST_CALLS("VbExDiskRead(h, 1023, 1)\n");
+
+	/* Or can't be read, in which case it's overwritten */
+	ResetMocks();
+	SetupGptEntriesCrc(mock_gpt_primary);
+	disk_read_to_fail = 1023;
+	AllocAndReadGptData(handle, &g);
+	g.modified = GPT_MODIFIED_ENTRIES2;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0,
+		"Lazy WriteAndFree secondary read fail");
+	TEST_CALLS("VbExDiskRead(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 1023, 1)\n"
+		   "VbExDiskWrite(h, 991, 32)\n");
+
+	/* Bad primary entries mean the secondary is read */
+	ResetMocks();
+	SetupGptEntriesCrc(mock_gpt_secondary);
+	TEST_EQ(AllocAndReadGptData(handle, &g), 0,
+		"Lazy AllocAndRead primary entries invalid");
+	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
+		   "VbExDiskRead(h, 2, 32)\n"
+		   "VbExDiskRead(h, 1023, 1)\n"
+		   "VbExDiskRead(h, 991, 32)\n");
+	TEST_EQ(g.unread, 0, "  secondary read");
+	WriteAndFreeGptData(handle, &g);
+
+	/* As does a bad primary header */
+	ResetMocks();
+	SetupGptEntriesCrc(mock_gpt_secondary);
+	memset(mock_gpt_primary, '\0', sizeof(*mock_gpt_primary));
+	TEST_EQ(AllocAndReadGptData(handle, &g), 0,
+		"Lazy AllocAndRead primary invalid");
+	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
+		   "VbExDiskRead(h, 1023, 1)\n"
+		   "VbExDiskRead(h, 991, 32)\n");
+	WriteAndFreeGptData(handle, &g);
+
+	/* Or not being able to read the primary entries */
+	ResetMocks();
+	SetupGptEntriesCrc(mock_gpt_primary);
+	disk_read_to_fail = 2;
+	TEST_EQ(AllocAndReadGptData(handle, &g), 0,
+		"Lazy AllocAndRead primary read fail");
+	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
+		   "VbExDiskRead(h, 2, 32)\n"
+		   "VbExDiskRead(h, 1023, 1)\n"
+		   "VbExDiskRead(h, 991, 32)\n");
+	WriteAndFreeGptData(handle, &g);
+}
+
 static void TestLoadKernel(int expect_retval, char *test_name)
 {
 	TEST_EQ(LoadKernel(&ctx, &lkp), expect_retval, test_name);
@@ -807,11 +985,58 @@ static void LoadKernelTest(void)
 	TestLoadKernel(0, "Can't read disk");
 }
 
+/* Set up a kernel bigger than one chunk, past the end of the mock disk */
+static void ResetBigKernelMocks(void)
+{
+	ResetMocks();
+	mock_parts[0].start = BIG_KERNEL_START;
+	mock_parts[0].size = BIG_KERNEL_SIZE / MOCK_SECTOR_SIZE + 256;
+	kph.body_signature.data_size = BIG_KERNEL_SIZE;
+	lkp.kernel_buffer = big_kernel_buffer;
+	lkp.kernel_buffer_size = sizeof(big_kernel_buffer);
+}
+
+/**
+ * Test loading kernel bodies read and hashed in several chunks
+ */
+static void LoadBigKernelTest(void)
+{
+	struct vb2_digest_context dc;
+	uint8_t expect[VB2_SHA256_DIGEST_SIZE];
+	uint8_t chunk[4096];
+	/* The body follows the 4 KB key block and preamble */
+	uint64_t body_start = BIG_KERNEL_START * MOCK_SECTOR_SIZE + 4096;
+	uint32_t offset;
+
+	/* What the digest of the whole body should be */
+	vb2_digest_init(&dc, VB2_HASH_SHA256);
+	for (offset = 0; offset < BIG_KERNEL_SIZE; offset += sizeof(chunk)) {
+		FillDiskPattern(chunk, body_start + offset, sizeof(chunk));
+		vb2_digest_extend(&dc, chunk, sizeof(chunk));
+	}
+	vb2_digest_finalize(&dc, expect, sizeof(expect));
+
+	ResetBigKernelMocks();
+	TestLoadKernel(0, "Big kernel");
+	TEST_EQ(verify_digest_calls, 1, "  digest checked once");
+	TEST_SUCC(memcmp(verify_digest_seen, expect, sizeof(expect)),
+		  "  digest of whole body");
+
+	/* The 64 KB vblock read, then the first 1 MB chunk, then this */
+	ResetBigKernelMocks();
+	disk_read_to_fail = BIG_KERNEL_START + 128 + 2048;
+	TestLoadKernel(VBERROR_INVALID_KERNEL_FOUND,
+		       "Fail reading big kernel partway");
+	TEST_EQ(verify_digest_calls, 0, "  partial digest not checked");
+}
+
 int main(void)
 {
 	ReadWriteGptTest();
+	LazySecondaryGptTest();
 	InvalidParamsTest();
 	LoadKernelTest();
+	LoadBigKernelTest();
 
 	return gTestSuccess ? 0 : 255;
 }